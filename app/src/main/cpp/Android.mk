@@ -21,12 +21,20 @@ LOCAL_SRC_FILES := \
     audio_extract.c \
     html_media_extract.c \
     html_dom.c \
+    html_selector.c \
+    html_tokenizer.c \
     http_download.c \
     jobs.c \
     media_store.c \
     tls_client.c \
     url_analyzer.c \
+    media_cache.c \
+    job_arena.c \
+    byte_scan.c \
+    trace_log.c \
     js_quickjs.c \
+    js_event_loop.c \
+    js_runtime_pool.c \
     browser_stubs.c \
     third_party/quickjs/quickjs.c \
     third_party/quickjs/libregexp.c \
@@ -1,4 +1,5 @@
 #include "audio_extract.h"
+#include "trace_log.h"
 
 #include <media/NdkMediaExtractor.h>
 #include <media/NdkMediaCodec.h>
@@ -10,11 +11,10 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
-#include <android/log.h>
 
 #define LOG_TAG "audio_extract"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
 
 static void set_err(char *err, size_t errLen, const char *msg) {
     if (err && errLen > 0) {
@@ -3,13 +3,14 @@
  */
 #include <string.h>
 #include <stdlib.h>
-#include <android/log.h>
 #include <quickjs.h>
 #include "browser_stubs.h"
 #include "html_dom.h"
+#include "js_event_loop.h"
+#include "trace_log.h"
 
 #define LOG_TAG "browser_stubs"
-#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
 
 // External symbols from js_quickjs.c
 extern GCValue js_document_create_element(JSContext *ctx, GCValue this_val, int argc, GCValue *argv);
@@ -97,11 +98,6 @@ GCValue js_get_prototype(JSContext *ctx, GCValue ctor) {
     return JS_GetPropertyStr(ctx, ctor, "prototype");
 }
 
-static GCValue js_zero(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
-    (void)this_val; (void)argc; (void)argv;
-    return JS_NewInt32(ctx, 0);
-}
-
 static GCValue js_console_log(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
     (void)ctx; (void)this_val; (void)argc; (void)argv;
     return JS_UNDEFINED;
@@ -137,7 +133,7 @@ static GCValue js_dummy_function(JSContext *ctx, GCValue this_val, int argc, GCV
 // ============================================================================
 
 #define DOM_EXCEPTION_LOG_TAG "DOMException"
-#define DOM_EX_LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, DOM_EXCEPTION_LOG_TAG, __VA_ARGS__)
+#define DOM_EX_LOGD(...) TLOG_DEBUG(DOM_EXCEPTION_LOG_TAG, __VA_ARGS__)
 
 #define DOM_EXCEPTION_INDEX_SIZE_ERR 1
 #define DOM_EXCEPTION_HIERARCHY_REQUEST_ERR 3
@@ -791,9 +787,17 @@ static void js_map_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_map_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    MapData *map = JS_GetOpaque(val, js_map_class_id);
+    if (map) {
+        JS_MarkValue(rt, map->entries, mark_func);
+    }
+}
+
 static JSClassDef js_map_class_def = {
     "Map",
     .finalizer = js_map_finalizer,
+    .gc_mark = js_map_mark,
 };
 
 static GCValue js_map_constructor(JSContext *ctx, GCValue new_target, int argc, GCValue *argv) {
@@ -1053,9 +1057,18 @@ static void js_shadow_root_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_shadow_root_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    ShadowRootData *sr = JS_GetOpaque(val, js_shadow_root_class_id);
+    if (sr) {
+        JS_MarkValue(rt, sr->host, mark_func);
+        JS_MarkValue(rt, sr->innerHTML, mark_func);
+    }
+}
+
 static JSClassDef js_shadow_root_class_def = {
     "ShadowRoot",
     .finalizer = js_shadow_root_finalizer,
+    .gc_mark = js_shadow_root_mark,
 };
 
 static GCValue js_shadow_root_get_host(JSContext *ctx, GCValue this_val) {
@@ -1214,19 +1227,24 @@ static GCValue js_event_target_dispatchEvent(JSContext *ctx, GCValue this_val, i
 // Node Implementation
 // ============================================================================
 
+// There is no stub tree; attaching only makes the child findable through
+// the document lookups (see html_document_attach_element)
 static GCValue js_node_appendChild(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
     if (argc < 1) return JS_NULL;
+    html_document_attach_element(ctx, argv[0]);
     // Return the appended child
     return argv[0];
 }
 
 static GCValue js_node_insertBefore(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
     if (argc < 1) return JS_NULL;
+    html_document_attach_element(ctx, argv[0]);
     return argv[0];
 }
 
 static GCValue js_node_removeChild(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
     if (argc < 1) return JS_NULL;
+    html_document_detach_element(ctx, argv[0]);
     return argv[0];
 }
 
@@ -1255,9 +1273,17 @@ static void js_custom_element_registry_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_custom_element_registry_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    CustomElementRegistryData *cer = JS_GetOpaque(val, js_custom_element_registry_class_id);
+    if (cer) {
+        JS_MarkValue(rt, cer->registry, mark_func);
+    }
+}
+
 static JSClassDef js_custom_element_registry_class_def = {
     "CustomElementRegistry",
     .finalizer = js_custom_element_registry_finalizer,
+    .gc_mark = js_custom_element_registry_mark,
 };
 
 // customElements.define(name, constructor, options)
@@ -1334,6 +1360,14 @@ static void js_animation_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_animation_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    AnimationData *anim = JS_GetOpaque(val, js_animation_class_id);
+    if (anim) {
+        JS_MarkValue(rt, anim->onfinish, mark_func);
+        JS_MarkValue(rt, anim->effect, mark_func);
+    }
+}
+
 static void js_keyframe_effect_finalizer(JSRuntime *rt, GCValue val) {
     KeyFrameEffectData *effect = JS_GetOpaque(val, js_keyframe_effect_class_id);
     if (effect) {
@@ -1343,14 +1377,24 @@ static void js_keyframe_effect_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_keyframe_effect_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    KeyFrameEffectData *effect = JS_GetOpaque(val, js_keyframe_effect_class_id);
+    if (effect) {
+        JS_MarkValue(rt, effect->target, mark_func);
+        JS_MarkValue(rt, effect->keyframes, mark_func);
+    }
+}
+
 static JSClassDef js_animation_class_def = {
     "Animation",
     .finalizer = js_animation_finalizer,
+    .gc_mark = js_animation_mark,
 };
 
 static JSClassDef js_keyframe_effect_class_def = {
     "KeyframeEffect",
     .finalizer = js_keyframe_effect_finalizer,
+    .gc_mark = js_keyframe_effect_mark,
 };
 
 // Animation constructor
@@ -1598,6 +1642,13 @@ static void js_font_face_set_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_font_face_set_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    FontFaceSetData *ffs = JS_GetOpaque(val, js_font_face_set_class_id);
+    if (ffs) {
+        JS_MarkValue(rt, ffs->loaded_fonts, mark_func);
+    }
+}
+
 static JSClassDef js_font_face_class_def = {
     "FontFace",
     .finalizer = js_font_face_finalizer,
@@ -1606,6 +1657,7 @@ static JSClassDef js_font_face_class_def = {
 static JSClassDef js_font_face_set_class_def = {
     "FontFaceSet",
     .finalizer = js_font_face_set_finalizer,
+    .gc_mark = js_font_face_set_mark,
 };
 
 // FontFace constructor
@@ -1781,9 +1833,17 @@ static void js_mutation_observer_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_mutation_observer_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    MutationObserverData *mo = JS_GetOpaque(val, js_mutation_observer_class_id);
+    if (mo) {
+        JS_MarkValue(rt, mo->callback, mark_func);
+    }
+}
+
 static JSClassDef js_mutation_observer_class_def = {
     "MutationObserver",
     .finalizer = js_mutation_observer_finalizer,
+    .gc_mark = js_mutation_observer_mark,
 };
 
 // MutationObserver constructor
@@ -1841,9 +1901,17 @@ static void js_resize_observer_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_resize_observer_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    ResizeObserverData *ro = JS_GetOpaque(val, js_resize_observer_class_id);
+    if (ro) {
+        JS_MarkValue(rt, ro->callback, mark_func);
+    }
+}
+
 static JSClassDef js_resize_observer_class_def = {
     "ResizeObserver",
     .finalizer = js_resize_observer_finalizer,
+    .gc_mark = js_resize_observer_mark,
 };
 
 // ResizeObserver constructor
@@ -1905,9 +1973,18 @@ static void js_intersection_observer_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_intersection_observer_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    IntersectionObserverData *io = JS_GetOpaque(val, js_intersection_observer_class_id);
+    if (io) {
+        JS_MarkValue(rt, io->callback, mark_func);
+        JS_MarkValue(rt, io->root, mark_func);
+    }
+}
+
 static JSClassDef js_intersection_observer_class_def = {
     "IntersectionObserver",
     .finalizer = js_intersection_observer_finalizer,
+    .gc_mark = js_intersection_observer_mark,
 };
 
 // IntersectionObserver constructor
@@ -2019,6 +2096,13 @@ static void js_performance_observer_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_performance_observer_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    PerformanceObserverData *po = JS_GetOpaque(val, js_performance_observer_class_id);
+    if (po) {
+        JS_MarkValue(rt, po->callback, mark_func);
+    }
+}
+
 static JSClassDef js_performance_class_def = {
     "Performance",
     .finalizer = js_performance_finalizer,
@@ -2032,16 +2116,14 @@ static JSClassDef js_performance_entry_class_def = {
 static JSClassDef js_performance_observer_class_def = {
     "PerformanceObserver",
     .finalizer = js_performance_observer_finalizer,
+    .gc_mark = js_performance_observer_mark,
 };
 
 // Performance.now()
-static double g_performance_time = 0.0;
-
 static GCValue js_performance_now(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
-    // Return a monotonically increasing timestamp (in milliseconds)
-    // Use a static counter since we don't need actual wall-clock time
-    g_performance_time += 0.1;  // Increment slightly on each call
-    return JS_NewFloat64(ctx, g_performance_time);
+    // The event loop's virtual clock, nudged forward on each call so that
+    // busy-wait loops still see time pass
+    return JS_NewFloat64(ctx, js_event_loop_advance(ctx, 0.1));
 }
 
 // Performance.timeOrigin getter
@@ -2969,12 +3051,8 @@ skip_dom_exception:
     DEF_PROP_FLOAT(ctx, window, "devicePixelRatio", 1.0);
     DEF_PROP_INT(ctx, window, "length", 0);
     DEF_PROP_BOOL(ctx, window, "closed", 0);
-    DEF_FUNC(ctx, window, "setTimeout", js_zero, 2);
-    DEF_FUNC(ctx, window, "setInterval", js_zero, 2);
-    DEF_FUNC(ctx, window, "clearTimeout", js_undefined, 1);
-    DEF_FUNC(ctx, window, "clearInterval", js_undefined, 1);
-    DEF_FUNC(ctx, window, "requestAnimationFrame", js_zero, 1);
-    DEF_FUNC(ctx, window, "cancelAnimationFrame", js_undefined, 1);
+    // Timers, animation frames and queueMicrotask run on the event loop
+    js_event_loop_install(ctx, window);
     DEF_FUNC(ctx, window, "alert", js_undefined, 1);
     DEF_FUNC(ctx, window, "confirm", js_true, 0);
     DEF_FUNC(ctx, window, "prompt", js_empty_string, 1);
@@ -3039,11 +3117,8 @@ skip_dom_exception:
     DEF_FUNC(ctx, document, "createTextNode", js_empty_string, 1);
     DEF_FUNC(ctx, document, "createComment", js_empty_string, 1);
     DEF_FUNC(ctx, document, "createDocumentFragment", js_null, 0);
-    DEF_FUNC(ctx, document, "getElementById", js_null, 1);
-    DEF_FUNC(ctx, document, "querySelector", js_null, 1);
-    DEF_FUNC(ctx, document, "querySelectorAll", js_empty_array, 1);
-    DEF_FUNC(ctx, document, "getElementsByTagName", js_empty_array, 1);
-    DEF_FUNC(ctx, document, "getElementsByClassName", js_empty_array, 1);
+    // Lookups find attached elements until a parsed page is bound
+    html_bind_document_queries(ctx, document, NULL);
     DEF_FUNC(ctx, document, "getElementsByName", js_empty_array, 1);
     DEF_FUNC(ctx, document, "addEventListener", js_undefined, 2);
     DEF_FUNC(ctx, document, "removeEventListener", js_undefined, 2);
@@ -3424,9 +3499,6 @@ void browser_stubs_reset(void) {
     /* Reset DOMException class ID - it will be reallocated on next init */
     js_dom_exception_class_id = 0;
     
-    /* Note: g_performance_time is a minor timing counter that accumulates 
-     * 0.1ms per call to js_performance_now(). Over multiple downloads it 
-     * could drift but it's not critical - the GC reset is the main fix.
-     * A full reset of this variable would require moving its declaration
-     * or using a different approach. For now, the GC reset is sufficient. */
+    /* The virtual clock behind performance.now() belongs to the event loop
+     * and goes away with its context. */
 }
@@ -30,4 +30,7 @@ void init_browser_stubs(JSContext *ctx, GCValue global);
 // Helper to get a prototype from a constructor: Constructor.prototype
 GCValue js_get_prototype(JSContext *ctx, GCValueConst ctor);
 
+// Clear stub state tied to a GC heap (class IDs), see gc_reset_full
+void browser_stubs_reset(void);
+
 #endif // BROWSER_STUBS_H
@@ -0,0 +1,136 @@
+#include "byte_scan.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+// BYTE_SCAN_SCALAR forces the scalar fallback (host tests compare the two)
+#if defined(BYTE_SCAN_SCALAR)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SCAN_BLOCK 16
+typedef uint8x16_t scan_vec;
+static inline scan_vec scan_load(const char *p) { return vld1q_u8((const uint8_t *)p); }
+static inline scan_vec scan_splat(uint8_t c) { return vdupq_n_u8(c); }
+static inline scan_vec scan_eq(scan_vec a, scan_vec b) { return vceqq_u8(a, b); }
+static inline scan_vec scan_or(scan_vec a, scan_vec b) { return vorrq_u8(a, b); }
+static inline scan_vec scan_and(scan_vec a, scan_vec b) { return vandq_u8(a, b); }
+// NEON has no movemask; narrowing by 4 leaves one nibble per lane
+static inline uint64_t scan_mask(scan_vec m) {
+    uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(n), 0);
+}
+#define SCAN_LANE_SHIFT 2
+#define SCAN_LANE_BITS 0xfull
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_BLOCK 32
+typedef __m256i scan_vec;
+static inline scan_vec scan_load(const char *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline scan_vec scan_splat(uint8_t c) { return _mm256_set1_epi8((char)c); }
+static inline scan_vec scan_eq(scan_vec a, scan_vec b) { return _mm256_cmpeq_epi8(a, b); }
+static inline scan_vec scan_or(scan_vec a, scan_vec b) { return _mm256_or_si256(a, b); }
+static inline scan_vec scan_and(scan_vec a, scan_vec b) { return _mm256_and_si256(a, b); }
+static inline uint64_t scan_mask(scan_vec m) { return (uint32_t)_mm256_movemask_epi8(m); }
+#define SCAN_LANE_SHIFT 0
+#define SCAN_LANE_BITS 1ull
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_BLOCK 16
+typedef __m128i scan_vec;
+static inline scan_vec scan_load(const char *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline scan_vec scan_splat(uint8_t c) { return _mm_set1_epi8((char)c); }
+static inline scan_vec scan_eq(scan_vec a, scan_vec b) { return _mm_cmpeq_epi8(a, b); }
+static inline scan_vec scan_or(scan_vec a, scan_vec b) { return _mm_or_si128(a, b); }
+static inline scan_vec scan_and(scan_vec a, scan_vec b) { return _mm_and_si128(a, b); }
+static inline uint64_t scan_mask(scan_vec m) { return (uint32_t)_mm_movemask_epi8(m); }
+#define SCAN_LANE_SHIFT 0
+#define SCAN_LANE_BITS 1ull
+#endif
+
+static const char g_js_special[] = { '"', '\'', '`', '/', '<', '\\' };
+
+static inline uint8_t fold_bits(uint8_t c) {
+    uint8_t lower = c | 0x20;
+    return (lower >= 'a' && lower <= 'z') ? 0x20 : 0;
+}
+
+const char *byte_scan_any(const char *p, const char *end, const char *set, size_t set_len) {
+    if (!p || p >= end || set_len == 0) return end;
+    if (set_len > BYTE_SCAN_MAX_SET) set_len = BYTE_SCAN_MAX_SET;
+
+    if (set_len == 1) {
+        const char *hit = memchr(p, set[0], (size_t)(end - p));
+        return hit ? hit : end;
+    }
+
+#ifdef SCAN_BLOCK
+    scan_vec targets[BYTE_SCAN_MAX_SET];
+    for (size_t i = 0; i < set_len; i++) targets[i] = scan_splat((uint8_t)set[i]);
+
+    while (end - p >= SCAN_BLOCK) {
+        scan_vec v = scan_load(p);
+        scan_vec m = scan_eq(v, targets[0]);
+        for (size_t i = 1; i < set_len; i++) m = scan_or(m, scan_eq(v, targets[i]));
+        uint64_t mask = scan_mask(m);
+        if (mask) return p + (__builtin_ctzll(mask) >> SCAN_LANE_SHIFT);
+        p += SCAN_BLOCK;
+    }
+#endif
+
+    for (; p < end; p++) {
+        for (size_t i = 0; i < set_len; i++) {
+            if (*p == set[i]) return p;
+        }
+    }
+    return end;
+}
+
+const char *byte_scan_find_ci(const char *p, const char *end, const char *needle, size_t needle_len) {
+    if (!p || !needle || needle_len == 0 || p >= end) return end;
+    if ((size_t)(end - p) < needle_len) return end;
+
+    uint8_t first = (uint8_t)needle[0];
+    if (needle_len == 1) {
+        char set[2] = { (char)(first | fold_bits(first)), (char)(first & ~fold_bits(first)) };
+        return byte_scan_any(p, end, set, 2);
+    }
+
+    // Last position a match can start at
+    const char *last = end - needle_len;
+
+#ifdef SCAN_BLOCK
+    // Filter on the first two bytes, then confirm candidates with strncasecmp
+    uint8_t second = (uint8_t)needle[1];
+    scan_vec fold0 = scan_splat(fold_bits(first));
+    scan_vec fold1 = scan_splat(fold_bits(second));
+    scan_vec want0 = scan_splat(first | fold_bits(first));
+    scan_vec want1 = scan_splat(second | fold_bits(second));
+
+    while (end - p >= SCAN_BLOCK + 1) {
+        scan_vec m = scan_and(scan_eq(scan_or(scan_load(p), fold0), want0),
+                              scan_eq(scan_or(scan_load(p + 1), fold1), want1));
+        uint64_t mask = scan_mask(m);
+        while (mask) {
+            unsigned lane = (unsigned)__builtin_ctzll(mask) >> SCAN_LANE_SHIFT;
+            const char *cand = p + lane;
+            if (cand > last) return end;
+            if (strncasecmp(cand, needle, needle_len) == 0) return cand;
+            mask &= ~(SCAN_LANE_BITS << (lane << SCAN_LANE_SHIFT));
+        }
+        p += SCAN_BLOCK;
+    }
+#endif
+
+    for (; p <= last; p++) {
+        if (((uint8_t)*p | fold_bits(first)) == (first | fold_bits(first)) &&
+            strncasecmp(p, needle, needle_len) == 0) {
+            return p;
+        }
+    }
+    return end;
+}
+
+const char *byte_scan_js_special(const char *p, const char *end) {
+    return byte_scan_any(p, end, g_js_special, sizeof(g_js_special));
+}
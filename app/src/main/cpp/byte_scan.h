@@ -0,0 +1,31 @@
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Byte scanning kernels for the HTML and script scanners. NEON on arm64,
+ * AVX2 or SSE2 on x86_64, scalar elsewhere. Every function searches the
+ * half-open range [p, end) and returns end when nothing matches; none of
+ * them read past end or depend on a NUL terminator. */
+
+#define BYTE_SCAN_MAX_SET 8
+
+/* First byte equal to any of set[0..set_len), set_len <= BYTE_SCAN_MAX_SET */
+const char *byte_scan_any(const char *p, const char *end, const char *set, size_t set_len);
+
+/* First occurrence of needle, ASCII case-insensitive */
+const char *byte_scan_find_ci(const char *p, const char *end, const char *needle, size_t needle_len);
+
+/* Next byte a JS lexer looking for </script> has to inspect:
+ * quotes, '/', '<' and '\\'. Everything in between is skipped in bulk. */
+const char *byte_scan_js_special(const char *p, const char *end);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
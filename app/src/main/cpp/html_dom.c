@@ -10,50 +10,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
-#include <android/log.h>
 #include "html_dom.h"
+#include "html_selector.h"
 #include "gc_value_helpers.h"
+#include "trace_log.h"
 
 #define LOG_TAG "html_dom"
-#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define LOG_WARN(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
-
-/* List of self-closing HTML tags (void elements) */
-static const char *SELF_CLOSING_TAGS[] = {
-    "area", "base", "br", "col", "embed", "hr", "img", "input",
-    "link", "meta", "param", "source", "track", "wbr", NULL
-};
-
-/* List of tags that contain raw text content */
-static const char *RAW_CONTENT_TAGS[] = {
-    "script", "style", "textarea", "title", NULL
-};
+#define LOG_INFO(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
+#define LOG_WARN(...) TLOG_WARN(LOG_TAG, __VA_ARGS__)
 
 /* ============================================================================
  * Utility Functions
  * ============================================================================ */
 
-bool html_is_self_closing_tag(const char *tag_name) {
-    if (!tag_name) return false;
-    for (int i = 0; SELF_CLOSING_TAGS[i]; i++) {
-        if (strcasecmp(tag_name, SELF_CLOSING_TAGS[i]) == 0) {
-            return true;
-        }
-    }
-    return false;
-}
-
-bool html_is_raw_content_tag(const char *tag_name) {
-    if (!tag_name) return false;
-    for (int i = 0; RAW_CONTENT_TAGS[i]; i++) {
-        if (strcasecmp(tag_name, RAW_CONTENT_TAGS[i]) == 0) {
-            return true;
-        }
-    }
-    return false;
-}
-
 void html_tag_name_normalize(char *tag_name) {
     if (!tag_name) return;
     for (char *p = tag_name; *p; p++) {
@@ -61,605 +31,589 @@ void html_tag_name_normalize(char *tag_name) {
     }
 }
 
-/* Decode common HTML entities */
-int html_decode_entities(char *str, size_t len) {
-    if (!str || len == 0) return 0;
-    
-    char *dest = str;
-    const char *src = str;
-    const char *end = str + len;
-    
-    while (*src && src < end) {
-        if (*src == '&') {
-            if (strncmp(src, "&lt;", 4) == 0) {
-                *dest++ = '<';
-                src += 4;
-            } else if (strncmp(src, "&gt;", 4) == 0) {
-                *dest++ = '>';
-                src += 4;
-            } else if (strncmp(src, "&amp;", 5) == 0) {
-                *dest++ = '&';
-                src += 5;
-            } else if (strncmp(src, "&quot;", 6) == 0) {
-                *dest++ = '"';
-                src += 6;
-            } else if (strncmp(src, "&apos;", 6) == 0) {
-                *dest++ = '\'';
-                src += 6;
-            } else if (strncmp(src, "&nbsp;", 6) == 0) {
-                *dest++ = ' ';
-                src += 6;
-            } else if (src[1] == '#' && isdigit((unsigned char)src[2])) {
-                /* Numeric entity: &#123; */
-                src += 2;
-                int val = 0;
-                while (isdigit((unsigned char)*src)) {
-                    val = val * 10 + (*src - '0');
-                    src++;
-                }
-                if (*src == ';') src++;
-                *dest++ = (char)(val > 0 && val < 256 ? val : '?');
-            } else {
-                *dest++ = *src++;
-            }
-        } else {
-            *dest++ = *src++;
-        }
-    }
-    *dest = '\0';
-    return (int)(dest - str);
-}
-
 /* ============================================================================
  * Memory Management
  * ============================================================================ */
 
-static HtmlNode* html_node_create(HtmlNodeType type) {
-    HtmlNode *node = calloc(1, sizeof(HtmlNode));
+static HtmlNode* html_node_create(HtmlDocument *doc, HtmlNodeType type) {
+    HtmlNode *node = job_arena_alloc(&doc->arena, sizeof(HtmlNode));
     if (!node) return NULL;
     
+    memset(node, 0, sizeof(*node));
     node->type = type;
+    node->tag_name = "";
     node->js_object = JS_UNDEFINED;
     node->has_js_object = 0;
     
     return node;
 }
 
-static HtmlAttribute* html_attribute_create(const char *name, const char *value) {
-    HtmlAttribute *attr = calloc(1, sizeof(HtmlAttribute));
-    if (!attr) return NULL;
-    
-    strncpy(attr->name, name, HTML_MAX_ATTR_NAME_LEN - 1);
-    attr->name[HTML_MAX_ATTR_NAME_LEN - 1] = '\0';
-    
-    if (value) {
-        strncpy(attr->value, value, HTML_MAX_ATTR_VALUE_LEN - 1);
-        attr->value[HTML_MAX_ATTR_VALUE_LEN - 1] = '\0';
-        html_decode_entities(attr->value, strlen(attr->value));
+/* Copies a span into the arena, decoding entities only if it has any */
+static const char *html_span_to_cstr(HtmlDocument *doc, HtmlSpan span, bool decode,
+                                     size_t *out_len) {
+    char *copy = job_arena_strndup(&doc->arena, doc->source + span.offset, span.len);
+    if (!copy) return NULL;
+    size_t len = span.len;
+    if (decode) len = (size_t)html_decode_entities(copy, len);
+    if (out_len) *out_len = len;
+    return copy;
+}
+
+bool html_attr_name_is(const HtmlDocument *doc, const HtmlAttribute *attr, const char *name) {
+    if (!doc || !attr || !name) return false;
+    if (attr->name_cstr) return strcasecmp(attr->name_cstr, name) == 0;
+    size_t len = strlen(name);
+    return attr->name.len == len &&
+           strncasecmp(doc->source + attr->name.offset, name, len) == 0;
+}
+
+const char *html_attr_name(const HtmlDocument *doc, const HtmlAttribute *attr, size_t *out_len) {
+    if (!doc || !attr) return NULL;
+    if (attr->name_cstr) {
+        if (out_len) *out_len = strlen(attr->name_cstr);
+        return attr->name_cstr;
     }
-    
-    return attr;
+    if (out_len) *out_len = attr->name.len;
+    return doc->source + attr->name.offset;
 }
 
-static void html_node_free(HtmlNode *node) {
-    if (!node) return;
-    
-    /* Free attributes */
-    HtmlAttribute *attr = node->attributes;
-    while (attr) {
-        HtmlAttribute *next = attr->next;
-        free(attr);
-        attr = next;
+const char *html_attr_value(HtmlDocument *doc, HtmlAttribute *attr, size_t *out_len) {
+    if (!doc || !attr) return NULL;
+    if (!attr->value_has_entity) {
+        if (out_len) *out_len = attr->value.len;
+        return doc->source + attr->value.offset;
     }
-    
-    /* Free text content */
-    if (node->text_content) {
-        free(node->text_content);
+    const char *value = html_attr_value_cstr(doc, attr);
+    if (out_len) *out_len = value ? strlen(value) : 0;
+    return value;
+}
+
+const char *html_attr_value_cstr(HtmlDocument *doc, HtmlAttribute *attr) {
+    if (!doc || !attr) return NULL;
+    if (!attr->value_cstr) {
+        attr->value_cstr = html_span_to_cstr(doc, attr->value, attr->value_has_entity, NULL);
     }
-    
-    /* Note: We don't free js_object here - that's managed by QuickJS GC */
-    
-    free(node);
+    return attr->value_cstr;
 }
 
-void html_document_free(HtmlDocument *doc) {
-    if (!doc) return;
-    
-    /* Free all nodes recursively starting from root */
-    HtmlNode *current = doc->root;
-    while (current) {
-        HtmlNode *next = current->next_sibling;
-        
-        /* Free children recursively */
-        HtmlNode *child = current->first_child;
-        while (child) {
-            HtmlNode *child_next = child->next_sibling;
-            
-            /* Recursively free grandchildren */
-            if (child->first_child) {
-                /* Use a simple stack-based approach for grandchildren */
-                HtmlNode *stack[HTML_MAX_NESTING_DEPTH];
-                int stack_top = 0;
-                
-                HtmlNode *gc = child->first_child;
-                while (gc || stack_top > 0) {
-                    if (gc) {
-                        if (stack_top < HTML_MAX_NESTING_DEPTH) {
-                            stack[stack_top++] = gc;
-                        }
-                        gc = gc->first_child;
-                    } else {
-                        gc = stack[--stack_top];
-                        HtmlNode *gc_next = gc->next_sibling;
-                        html_node_free(gc);
-                        gc = gc_next;
-                    }
-                }
-            }
-            
-            html_node_free(child);
-            child = child_next;
-        }
-        
-        html_node_free(current);
-        current = next;
+HtmlAttribute *html_node_get_attr(const HtmlDocument *doc, const HtmlNode *node, const char *name) {
+    if (!node) return NULL;
+    for (HtmlAttribute *attr = node->attributes; attr; attr = attr->next) {
+        if (html_attr_name_is(doc, attr, name)) return attr;
     }
-    
-    if (doc->title) free(doc->title);
-    free(doc);
+    return NULL;
+}
+
+const char *html_node_text(HtmlDocument *doc, HtmlNode *node, size_t *out_len) {
+    if (!doc || !node) return NULL;
+    if (!node->text_cstr) {
+        node->text_cstr = html_span_to_cstr(doc, node->text,
+                                            !node->text_is_raw && node->text_has_entity,
+                                            &node->text_len);
+    }
+    if (out_len) *out_len = node->text_cstr ? node->text_len : 0;
+    return node->text_cstr;
 }
 
 /* ============================================================================
- * Parser Implementation
+ * Indexes
  * ============================================================================ */
 
-static void parser_skip_whitespace(HtmlParser *p) {
-    while (p->pos < p->html_len && isspace((unsigned char)p->html[p->pos])) {
-        if (p->html[p->pos] == '\n') {
-            p->line++;
-            p->column = 1;
-        } else {
-            p->column++;
-        }
-        p->pos++;
+#define HTML_INDEX_INITIAL_CAPACITY 64
+
+bool html_node_list_push(HtmlNodeList *list, HtmlNode *node) {
+    if (list->count == list->capacity) {
+        uint32_t new_capacity = list->capacity ? list->capacity * 2 : 4;
+        HtmlNode **items = realloc(list->items, new_capacity * sizeof(HtmlNode *));
+        if (!items) return false;
+        list->items = items;
+        list->capacity = new_capacity;
     }
+    list->items[list->count++] = node;
+    return true;
 }
 
-static bool parser_match(HtmlParser *p, const char *str) {
-    size_t len = strlen(str);
-    if (p->pos + len > p->html_len) return false;
-    return (strncasecmp(p->html + p->pos, str, len) == 0);
+void html_node_list_free(HtmlNodeList *list) {
+    if (!list) return;
+    free(list->items);
+    memset(list, 0, sizeof(*list));
 }
 
-static char* parser_read_tag_name(HtmlParser *p) {
-    static char tag_name[HTML_MAX_TAG_NAME_LEN];
-    size_t i = 0;
-    
-    /* Skip initial whitespace */
-    parser_skip_whitespace(p);
-    
-    /* Read tag name */
-    while (p->pos < p->html_len && i < HTML_MAX_TAG_NAME_LEN - 1) {
-        char c = p->html[p->pos];
-        if (c == '>' || c == '/' || c == ' ' || c == '\t' || 
-            c == '\n' || c == '\r' || c == '\f') {
-            break;
+/* Removes node, keeping the rest in document order */
+static void html_node_list_remove(HtmlNodeList *list, HtmlNode *node) {
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (list->items[i] == node) {
+            memmove(&list->items[i], &list->items[i + 1],
+                    (list->count - i - 1) * sizeof(HtmlNode *));
+            list->count--;
+            return;
         }
-        tag_name[i++] = c;
-        p->pos++;
-        p->column++;
     }
-    
-    tag_name[i] = '\0';
-    html_tag_name_normalize(tag_name);
-    
-    return i > 0 ? tag_name : NULL;
 }
 
-static HtmlAttribute* parser_read_attribute(HtmlParser *p) {
-    parser_skip_whitespace(p);
-    
-    /* Check for end of tag */
-    if (p->pos >= p->html_len || p->html[p->pos] == '>' || 
-        (p->html[p->pos] == '/' && p->pos + 1 < p->html_len && p->html[p->pos + 1] == '>')) {
-        return NULL;
+static uint32_t html_index_hash(const char *key, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
     }
-    
-    /* Read attribute name */
-    char name[HTML_MAX_ATTR_NAME_LEN];
-    size_t name_len = 0;
-    
-    while (p->pos < p->html_len && name_len < HTML_MAX_ATTR_NAME_LEN - 1) {
-        char c = p->html[p->pos];
-        if (c == '=' || c == '>' || c == '/' || isspace((unsigned char)c)) {
-            break;
+    return hash;
+}
+
+static HtmlIndexEntry *html_index_slot(HtmlIndexEntry *entries, uint32_t capacity,
+                                       const char *key, size_t len, uint32_t hash) {
+    uint32_t mask = capacity - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        HtmlIndexEntry *entry = &entries[i];
+        if (!entry->key) return entry;
+        if (entry->hash == hash && entry->key_len == len && memcmp(entry->key, key, len) == 0) {
+            return entry;
         }
-        name[name_len++] = c;
-        p->pos++;
-        p->column++;
     }
-    name[name_len] = '\0';
-    
-    if (name_len == 0) return NULL;
-    
-    /* Check for value */
-    char value[HTML_MAX_ATTR_VALUE_LEN] = {0};
-    
-    parser_skip_whitespace(p);
-    
-    if (p->pos < p->html_len && p->html[p->pos] == '=') {
-        p->pos++; /* skip = */
-        p->column++;
-        
-        parser_skip_whitespace(p);
-        
-        /* Read value */
-        if (p->pos < p->html_len) {
-            char quote = p->html[p->pos];
-            if (quote == '"' || quote == '\'') {
-                p->pos++; /* skip opening quote */
-                p->column++;
-                
-                size_t val_len = 0;
-                while (p->pos < p->html_len && p->html[p->pos] != quote && 
-                       val_len < HTML_MAX_ATTR_VALUE_LEN - 1) {
-                    value[val_len++] = p->html[p->pos++];
-                    p->column++;
-                }
-                value[val_len] = '\0';
-                
-                if (p->pos < p->html_len && p->html[p->pos] == quote) {
-                    p->pos++; /* skip closing quote */
-                    p->column++;
-                }
-            } else {
-                /* Unquoted value */
-                size_t val_len = 0;
-                while (p->pos < p->html_len && val_len < HTML_MAX_ATTR_VALUE_LEN - 1) {
-                    char c = p->html[p->pos];
-                    if (c == '>' || c == '/' || isspace((unsigned char)c)) {
-                        break;
-                    }
-                    value[val_len++] = c;
-                    p->pos++;
-                    p->column++;
-                }
-                value[val_len] = '\0';
-            }
+}
+
+static HtmlIndexEntry *html_index_find(const HtmlIndex *index, const char *key, size_t len) {
+    if (!index->entries || !key) return NULL;
+    HtmlIndexEntry *entry = html_index_slot(index->entries, index->capacity, key, len,
+                                            html_index_hash(key, len));
+    return entry->key ? entry : NULL;
+}
+
+/* Finds or adds the entry for key. Keys are never removed; an entry whose
+ * nodes all went away just has an empty list. */
+static HtmlIndexEntry *html_index_get(HtmlIndex *index, const char *key, size_t len) {
+    if ((index->count + 1) * 4 > index->capacity * 3) {
+        uint32_t new_capacity = index->capacity ? index->capacity * 2 : HTML_INDEX_INITIAL_CAPACITY;
+        HtmlIndexEntry *entries = calloc(new_capacity, sizeof(HtmlIndexEntry));
+        if (!entries) return NULL;
+        for (uint32_t i = 0; i < index->capacity; i++) {
+            HtmlIndexEntry *old = &index->entries[i];
+            if (!old->key) continue;
+            *html_index_slot(entries, new_capacity, old->key, old->key_len, old->hash) = *old;
         }
+        free(index->entries);
+        index->entries = entries;
+        index->capacity = new_capacity;
     }
     
-    return html_attribute_create(name, value[0] ? value : NULL);
+    uint32_t hash = html_index_hash(key, len);
+    HtmlIndexEntry *entry = html_index_slot(index->entries, index->capacity, key, len, hash);
+    if (!entry->key) {
+        entry->key = key;
+        entry->key_len = len;
+        entry->hash = hash;
+        index->count++;
+    }
+    return entry;
 }
 
-static HtmlNode* parser_parse_element(HtmlParser *p);
-static HtmlNode* parser_parse_text(HtmlParser *p);
+static void html_index_free(HtmlIndex *index) {
+    for (uint32_t i = 0; i < index->capacity; i++) {
+        html_node_list_free(&index->entries[i].nodes);
+    }
+    free(index->entries);
+    memset(index, 0, sizeof(*index));
+}
 
-static void parser_skip_comment(HtmlParser *p) {
-    if (parser_match(p, "<!--")) {
-        p->pos += 4;
-        while (p->pos < p->html_len) {
-            if (parser_match(p, "-->")) {
-                p->pos += 3;
-                break;
-            }
-            p->pos++;
-        }
+static void html_index_add(HtmlIndex *index, const char *key, size_t len, HtmlNode *node) {
+    HtmlIndexEntry *entry = html_index_get(index, key, len);
+    if (!entry) return;
+    
+    /* Nodes are numbered as they are indexed, so appending keeps order
+     * unless an earlier key of the same node is being re-added */
+    HtmlNodeList *list = &entry->nodes;
+    if (list->count > 0 && list->items[list->count - 1]->order >= node->order) {
+        uint32_t at = list->count;
+        while (at > 0 && list->items[at - 1]->order > node->order) at--;
+        if (at > 0 && list->items[at - 1] == node) return;   /* class="a a" */
+        if (!html_node_list_push(list, node)) return;
+        memmove(&list->items[at + 1], &list->items[at],
+                (list->count - at - 1) * sizeof(HtmlNode *));
+        list->items[at] = node;
+        return;
     }
+    html_node_list_push(list, node);
 }
 
-static void parser_skip_doctype(HtmlParser *p) {
-    if (parser_match(p, "<!doctype") || parser_match(p, "<!DOCTYPE")) {
-        p->pos += 9;
-        while (p->pos < p->html_len && p->html[p->pos] != '>') {
-            p->pos++;
-        }
-        if (p->pos < p->html_len) p->pos++; /* skip > */
+static void html_index_remove(HtmlIndex *index, const char *key, size_t len, HtmlNode *node) {
+    HtmlIndexEntry *entry = html_index_find(index, key, len);
+    if (entry) html_node_list_remove(&entry->nodes, node);
+}
+
+/* Calls fn for each whitespace separated class name in value */
+static void html_for_each_class(HtmlIndex *index, const char *value, size_t len, HtmlNode *node,
+                                void (*fn)(HtmlIndex *, const char *, size_t, HtmlNode *)) {
+    const char *end = value + len;
+    const char *p = value;
+    while (p < end) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        const char *start = p;
+        while (p < end && !isspace((unsigned char)*p)) p++;
+        if (p > start) fn(index, start, (size_t)(p - start), node);
     }
 }
 
-static char* parser_read_raw_content(HtmlParser *p, const char *end_tag) {
-    size_t start = p->pos;
-    size_t end_tag_len = strlen(end_tag);
-    
-    while (p->pos < p->html_len) {
-        if (p->html[p->pos] == '<') {
-            /* Check for end tag */
-            if (p->pos + 1 < p->html_len && p->html[p->pos + 1] == '/') {
-                if (strncasecmp(p->html + p->pos + 2, end_tag, end_tag_len) == 0) {
-                    break;
-                }
-            }
-        }
-        p->pos++;
+/* Adds or removes one attribute's contribution to the id and class indexes */
+static void html_index_attr(HtmlDocument *doc, HtmlNode *node, HtmlAttribute *attr, bool add) {
+    void (*fn)(HtmlIndex *, const char *, size_t, HtmlNode *) = add ? html_index_add
+                                                                    : html_index_remove;
+    bool is_id = html_attr_name_is(doc, attr, "id");
+    if (!is_id && !html_attr_name_is(doc, attr, "class")) return;
+    
+    size_t len = 0;
+    const char *value = html_attr_value(doc, attr, &len);
+    if (!value) return;
+    if (is_id) {
+        if (len > 0) fn(&doc->ids, value, len, node);
+    } else {
+        html_for_each_class(&doc->classes, value, len, node, fn);
     }
-    
-    size_t len = p->pos - start;
-    char *content = malloc(len + 1);
-    if (content) {
-        memcpy(content, p->html + start, len);
-        content[len] = '\0';
+}
+
+static void html_index_node(HtmlDocument *doc, HtmlNode *node, bool add) {
+    if (node->type != HTML_NODE_ELEMENT) return;
+    if (add) {
+        html_index_add(&doc->tags, node->tag_name, strlen(node->tag_name), node);
+    } else {
+        html_index_remove(&doc->tags, node->tag_name, strlen(node->tag_name), node);
+    }
+    for (HtmlAttribute *attr = node->attributes; attr; attr = attr->next) {
+        html_index_attr(doc, node, attr, add);
     }
-    
-    return content;
 }
 
-static HtmlNode* parser_parse_element(HtmlParser *p) {
-    if (p->pos >= p->html_len || p->html[p->pos] != '<') {
-        return NULL;
+/* Connects and renumbers a subtree in document order, or disconnects it */
+static void html_index_subtree(HtmlDocument *doc, HtmlNode *root, bool add) {
+    HtmlNode *node = root;
+    while (node) {
+        node->connected = add;
+        if (add) node->order = doc->next_order++;
+        html_index_node(doc, node, add);
+        
+        if (node->first_child) {
+            node = node->first_child;
+            continue;
+        }
+        while (node != root && !node->next_sibling) node = node->parent;
+        node = node == root ? NULL : node->next_sibling;
+    }
+}
+
+const HtmlNodeList *html_document_nodes_by_id(HtmlDocument *doc, const char *id, size_t id_len) {
+    if (!doc) return NULL;
+    HtmlIndexEntry *entry = html_index_find(&doc->ids, id, id_len);
+    return entry ? &entry->nodes : NULL;
+}
+
+HtmlNode *html_document_get_element_by_id(HtmlDocument *doc, const char *id, size_t id_len) {
+    const HtmlNodeList *list = html_document_nodes_by_id(doc, id, id_len);
+    return (list && list->count > 0) ? list->items[0] : NULL;
+}
+
+const HtmlNodeList *html_document_nodes_by_tag(HtmlDocument *doc, const char *tag_name) {
+    if (!doc || !tag_name) return NULL;
+    HtmlIndexEntry *entry = html_index_find(&doc->tags, tag_name, strlen(tag_name));
+    return entry ? &entry->nodes : NULL;
+}
+
+const HtmlNodeList *html_document_nodes_by_class(HtmlDocument *doc, const char *class_name,
+                                                 size_t class_len) {
+    if (!doc) return NULL;
+    HtmlIndexEntry *entry = html_index_find(&doc->classes, class_name, class_len);
+    return entry ? &entry->nodes : NULL;
+}
+
+/* ============================================================================
+ * Mutation
+ * ============================================================================ */
+
+bool html_node_contains(const HtmlNode *scope, const HtmlNode *node) {
+    for (; node; node = node->parent) {
+        if (node == scope) return true;
     }
+    return false;
+}
+
+static void html_node_unlink(HtmlDocument *doc, HtmlNode *node) {
+    HtmlNode *parent = node->parent;
+    if (node->prev_sibling) node->prev_sibling->next_sibling = node->next_sibling;
+    else if (parent) parent->first_child = node->next_sibling;
+    else if (doc->root == node) doc->root = node->next_sibling;
+    if (node->next_sibling) node->next_sibling->prev_sibling = node->prev_sibling;
+    else if (parent) parent->last_child = node->prev_sibling;
+    node->parent = node->prev_sibling = node->next_sibling = NULL;
+    
+    if (doc->head == node) doc->head = NULL;
+    if (doc->body == node) doc->body = NULL;
+}
+
+static void html_append_child(HtmlNode *parent, HtmlNode *child);
+
+bool html_node_append_child(HtmlDocument *doc, HtmlNode *parent, HtmlNode *child) {
+    if (!doc || !parent || !child || parent->type != HTML_NODE_ELEMENT) return false;
+    if (html_node_contains(child, parent)) return false;   /* Would create a cycle */
+    
+    if (child->connected) html_index_subtree(doc, child, false);
+    html_node_unlink(doc, child);
+    html_append_child(parent, child);
+    if (parent->connected) html_index_subtree(doc, child, true);
+    return true;
+}
+
+bool html_node_remove_child(HtmlDocument *doc, HtmlNode *parent, HtmlNode *child) {
+    if (!doc || !parent || !child || child->parent != parent) return false;
+    if (child->connected) html_index_subtree(doc, child, false);
+    html_node_unlink(doc, child);
+    return true;
+}
+
+bool html_node_set_attribute(HtmlDocument *doc, HtmlNode *node, const char *name,
+                             const char *value, size_t value_len) {
+    if (!doc || !node || !name || node->type != HTML_NODE_ELEMENT) return false;
     
-    p->pos++; /* skip < */
+    char *copy = job_arena_strndup(&doc->arena, value ? value : "", value ? value_len : 0);
+    if (!copy) return false;
     
-    /* Check for closing tag */
-    if (p->pos < p->html_len && p->html[p->pos] == '/') {
-        /* Closing tag - let caller handle */
-        p->pos--; /* back up */
-        return NULL;
+    HtmlAttribute *attr = html_node_get_attr(doc, node, name);
+    if (attr) {
+        if (node->connected) html_index_attr(doc, node, attr, false);
+    } else {
+        attr = job_arena_alloc(&doc->arena, sizeof(HtmlAttribute));
+        char *lower = job_arena_strndup(&doc->arena, name, strlen(name));
+        if (!attr || !lower) return false;
+        memset(attr, 0, sizeof(*attr));
+        html_tag_name_normalize(lower);
+        attr->name_cstr = lower;
+        
+        HtmlAttribute **tail = &node->attributes;
+        while (*tail) tail = &(*tail)->next;
+        *tail = attr;
     }
     
-    /* Read tag name */
-    char *tag_name = parser_read_tag_name(p);
-    if (!tag_name) {
-        /* Skip malformed tag */
-        while (p->pos < p->html_len && p->html[p->pos] != '>') p->pos++;
-        if (p->pos < p->html_len) p->pos++;
-        return NULL;
+    /* The copy is already decoded; route reads through value_cstr */
+    attr->value_cstr = copy;
+    attr->value_has_entity = true;
+    if (node->connected) html_index_attr(doc, node, attr, true);
+    return true;
+}
+
+bool html_node_remove_attribute(HtmlDocument *doc, HtmlNode *node, const char *name) {
+    if (!doc || !node || !name) return false;
+    for (HtmlAttribute **link = &node->attributes; *link; link = &(*link)->next) {
+        if (!html_attr_name_is(doc, *link, name)) continue;
+        if (node->connected) html_index_attr(doc, node, *link, false);
+        *link = (*link)->next;
+        return true;
     }
+    return false;
+}
+
+static void html_document_detach_js(HtmlDocument *doc);
+
+void html_document_free(HtmlDocument *doc) {
+    if (!doc) return;
     
-    /* Create element node */
-    HtmlNode *node = html_node_create(HTML_NODE_ELEMENT);
-    if (!node) return NULL;
+    /* Wrappers can outlive the document; cut them loose before the nodes go */
+    html_document_detach_js(doc);
     
-    strncpy(node->tag_name, tag_name, HTML_MAX_TAG_NAME_LEN - 1);
-    node->tag_name[HTML_MAX_TAG_NAME_LEN - 1] = '\0';
+    html_index_free(&doc->ids);
+    html_index_free(&doc->tags);
+    html_index_free(&doc->classes);
     
-    /* Parse attributes */
-    HtmlAttribute **attr_tail = &node->attributes;
-    while (1) {
-        parser_skip_whitespace(p);
-        
-        /* Check for self-closing or end of tag */
-        if (p->pos >= p->html_len) break;
-        
-        if (p->html[p->pos] == '>') {
-            p->pos++; /* skip > */
-            break;
-        }
-        
-        if (p->html[p->pos] == '/' && p->pos + 1 < p->html_len && p->html[p->pos + 1] == '>') {
-            p->pos += 2; /* skip /> */
-            node->type = HTML_NODE_ELEMENT; /* Self-closing */
-            return node;
-        }
-        
-        /* Parse attribute */
-        HtmlAttribute *attr = parser_read_attribute(p);
-        if (!attr) {
-            /* Skip unknown character */
-            if (p->pos < p->html_len && p->html[p->pos] != '>' && 
-                !(p->html[p->pos] == '/' && p->pos + 1 < p->html_len && p->html[p->pos + 1] == '>')) {
-                p->pos++;
-            } else {
-                break;
-            }
-            continue;
-        }
-        
-        *attr_tail = attr;
-        attr_tail = &attr->next;
-        
-        if (node->attributes && strcmp(attr->name, "id") == 0) {
-            /* Store ID for quick access */
-        }
-    }
+    /* Nodes, attributes and decoded strings all live in the arena.
+     * Note: We don't free js_object here - that's managed by QuickJS GC */
+    job_arena_free(&doc->arena);
     
-    /* Handle raw content tags (script, style, etc.) */
-    if (html_is_raw_content_tag(node->tag_name)) {
-        char end_tag[HTML_MAX_TAG_NAME_LEN + 4];
-        snprintf(end_tag, sizeof(end_tag), "</%s>", node->tag_name);
-        
-        char *content = parser_read_raw_content(p, node->tag_name);
-        if (content) {
-            node->text_content = content;
-            node->text_len = strlen(content);
-        }
-        
-        /* Skip the closing tag */
-        size_t end_tag_len = strlen(end_tag);
-        if (p->pos + end_tag_len <= p->html_len) {
-            if (strncasecmp(p->html + p->pos, end_tag, end_tag_len) == 0) {
-                p->pos += end_tag_len;
-            }
-        }
-        
-        return node;
+    if (doc->title) free(doc->title);
+    free(doc->owned_source);
+    free(doc);
+}
+
+/* ============================================================================
+ * Tree Builder
+ * ============================================================================ */
+
+static void html_append_child(HtmlNode *parent, HtmlNode *child) {
+    child->parent = parent;
+    if (parent->last_child) {
+        parent->last_child->next_sibling = child;
+        child->prev_sibling = parent->last_child;
+    } else {
+        parent->first_child = child;
+    }
+    parent->last_child = child;
+}
+
+static HtmlAttribute* html_attributes_from_token(HtmlDocument *doc, const HtmlTokenStream *tokens,
+                                                 const HtmlToken *tok) {
+    HtmlAttribute *head = NULL;
+    HtmlAttribute **tail = &head;
+    
+    for (uint32_t i = 0; i < tok->attr_count; i++) {
+        const HtmlTokenAttr *src = &tokens->attrs[tok->attr_start + i];
+        HtmlAttribute *attr = job_arena_alloc(&doc->arena, sizeof(HtmlAttribute));
+        if (!attr) break;
+        memset(attr, 0, sizeof(*attr));
+        attr->name = src->name;
+        attr->value = src->value;
+        attr->value_has_entity = src->value_has_entity;
+        *tail = attr;
+        tail = &attr->next;
     }
     
-    /* Parse children for non-self-closing tags */
-    if (!html_is_self_closing_tag(node->tag_name)) {
-        p->nesting_depth++;
+    return head;
+}
+
+/* Builds the node tree from the token stream. Open elements are kept on a
+ * stack; an end tag closes the nearest open element with the same name and
+ * stray end tags are ignored. */
+static void html_build_tree(HtmlDocument *doc, const HtmlTokenStream *tokens) {
+    HtmlNode *open[HTML_MAX_NESTING_DEPTH];
+    int depth = 0;
+    HtmlNode *root_tail = NULL;
+    
+    for (uint32_t i = 0; i < tokens->count; i++) {
+        const HtmlToken *tok = &tokens->tokens[i];
         
-        while (p->pos < p->html_len && p->nesting_depth < HTML_MAX_NESTING_DEPTH) {
-            parser_skip_whitespace(p);
-            
-            if (p->pos >= p->html_len) break;
-            
-            /* Check for closing tag */
-            if (p->html[p->pos] == '<' && p->pos + 1 < p->html_len && p->html[p->pos + 1] == '/') {
-                /* Check if it's our closing tag */
-                size_t check_pos = p->pos + 2;
-                size_t tag_len = strlen(node->tag_name);
+        switch (tok->type) {
+            case HTML_TOKEN_START_TAG: {
+                HtmlNode *node = html_node_create(doc, HTML_NODE_ELEMENT);
+                if (!node) return;
+                node->tag_name = tok->name;
+                node->attributes = html_attributes_from_token(doc, tokens, tok);
+                node->connected = true;
+                node->order = doc->next_order++;
+                html_index_node(doc, node, true);
                 
-                if (p->html_len - check_pos >= tag_len &&
-                    strncasecmp(p->html + check_pos, node->tag_name, tag_len) == 0) {
-                    /* It's our closing tag - skip it */
-                    p->pos = check_pos + tag_len;
-                    while (p->pos < p->html_len && p->html[p->pos] != '>') p->pos++;
-                    if (p->pos < p->html_len) p->pos++;
+                if (depth > 0) {
+                    html_append_child(open[depth - 1], node);
+                } else {
+                    if (root_tail) {
+                        root_tail->next_sibling = node;
+                        node->prev_sibling = root_tail;
+                    } else {
+                        doc->root = node;
+                    }
+                    root_tail = node;
+                }
+                
+                /* Track head and body */
+                if (!doc->head && strcmp(node->tag_name, "head") == 0) {
+                    doc->head = node;
+                } else if (!doc->body && strcmp(node->tag_name, "body") == 0) {
+                    doc->body = node;
+                }
+                
+                /* Raw content stays a view into the source until someone reads it */
+                if (i + 1 < tokens->count && tokens->tokens[i + 1].type == HTML_TOKEN_RAW_TEXT) {
+                    node->text = tokens->tokens[++i].span;
+                    node->text_is_raw = true;
                     break;
                 }
+                
+                if (!(tok->flags & HTML_TOKEN_SELF_CLOSING) &&
+                    !html_is_self_closing_tag(node->tag_name) &&
+                    depth < HTML_MAX_NESTING_DEPTH) {
+                    open[depth++] = node;
+                }
+                break;
             }
             
-            /* Parse child element or text */
-            if (p->html[p->pos] == '<') {
-                HtmlNode *child = parser_parse_element(p);
-                if (child) {
-                    child->parent = node;
-                    if (node->last_child) {
-                        node->last_child->next_sibling = child;
-                        child->prev_sibling = node->last_child;
-                    } else {
-                        node->first_child = child;
-                    }
-                    node->last_child = child;
-                } else {
-                    /* Try to recover from parsing error */
-                    p->pos++;
-                }
-            } else {
-                HtmlNode *text = parser_parse_text(p);
-                if (text) {
-                    text->parent = node;
-                    if (node->last_child) {
-                        node->last_child->next_sibling = text;
-                        text->prev_sibling = node->last_child;
-                    } else {
-                        node->first_child = text;
+            case HTML_TOKEN_END_TAG:
+                for (int d = depth - 1; d >= 0; d--) {
+                    if (strcmp(open[d]->tag_name, tok->name) == 0) {
+                        depth = d;
+                        break;
                     }
-                    node->last_child = text;
                 }
+                break;
+            
+            case HTML_TOKEN_TEXT: {
+                /* Text at root level is usually whitespace, skip it */
+                if (depth == 0) break;
+                HtmlNode *text = html_node_create(doc, HTML_NODE_TEXT);
+                if (!text) return;
+                text->connected = true;
+                text->order = doc->next_order++;
+                
+                /* Entities are decoded on first access, and only if there are any */
+                text->text = tok->span;
+                text->text_has_entity = memchr(html_span_ptr(tokens, tok->span), '&',
+                                               tok->span.len) != NULL;
+                html_append_child(open[depth - 1], text);
+                break;
             }
+            
+            default:
+                break;
         }
-        
-        p->nesting_depth--;
     }
-    
-    return node;
 }
 
-static HtmlNode* parser_parse_text(HtmlParser *p) {
-    if (p->pos >= p->html_len) return NULL;
+static HtmlDocument* html_document_create(const char *html, size_t html_len) {
+    HtmlDocument *doc = calloc(1, sizeof(HtmlDocument));
+    if (!doc) return NULL;
     
-    size_t start = p->pos;
+    doc->source = html;
+    doc->source_len = html_len;
+    job_arena_init(&doc->arena);
+    return doc;
+}
+
+HtmlDocument* html_parse_tokens(const HtmlTokenStream *tokens) {
+    if (!tokens || !tokens->source) return NULL;
     
-    while (p->pos < p->html_len && p->html[p->pos] != '<') {
-        p->pos++;
-    }
+    HtmlDocument *doc = html_document_create(tokens->source, tokens->source_len);
+    if (!doc) return NULL;
     
-    size_t len = p->pos - start;
-    if (len == 0) return NULL;
+    html_build_tree(doc, tokens);
     
-    /* Trim trailing whitespace but preserve leading for preformatted text */
-    while (len > 0 && isspace((unsigned char)p->html[start + len - 1])) {
-        len--;
-    }
+    LOG_INFO("Built HTML document: found %s, %s (%zu bytes of nodes)",
+             doc->head ? "<head>" : "no <head>",
+             doc->body ? "<body>" : "no <body>",
+             doc->arena.bytes_used);
     
-    if (len == 0) return NULL;
+    return doc;
+}
+
+HtmlDocument* html_parse(const char *html, size_t html_len) {
+    if (!html || html_len == 0) return NULL;
     
-    HtmlNode *node = html_node_create(HTML_NODE_TEXT);
-    if (!node) return NULL;
+    HtmlDocument *doc = html_document_create(html, html_len);
+    if (!doc) return NULL;
     
-    node->text_content = malloc(len + 1);
-    if (!node->text_content) {
-        free(node);
+    /* The token stream lives in the document arena alongside the nodes */
+    HtmlTokenStream tokens;
+    if (!html_tokenize(html, html_len, &doc->arena, &tokens)) {
+        LOG_ERROR("Failed to tokenize HTML");
+        html_document_free(doc);
         return NULL;
     }
     
-    memcpy(node->text_content, p->html + start, len);
-    node->text_content[len] = '\0';
-    node->text_len = len;
+    html_build_tree(doc, &tokens);
     
-    /* Decode entities */
-    html_decode_entities(node->text_content, len);
+    LOG_INFO("Parsed HTML document: found %s, %s (%zu bytes of nodes)",
+             doc->head ? "<head>" : "no <head>",
+             doc->body ? "<body>" : "no <body>",
+             doc->arena.bytes_used);
     
-    return node;
+    return doc;
 }
 
-HtmlDocument* html_parse(const char *html, size_t html_len) {
+HtmlDocument* html_parse_copy(const char *html, size_t html_len) {
     if (!html || html_len == 0) return NULL;
     
-    HtmlDocument *doc = calloc(1, sizeof(HtmlDocument));
-    if (!doc) return NULL;
-    
-    HtmlParser parser = {
-        .html = html,
-        .html_len = html_len,
-        .pos = 0,
-        .line = 1,
-        .column = 1,
-        .document = doc,
-        .nesting_depth = 0
-    };
-    
-    /* Skip DOCTYPE if present */
-    parser_skip_doctype(&parser);
-    
-    /* Skip any leading whitespace/comments */
-    while (parser.pos < parser.html_len) {
-        parser_skip_whitespace(&parser);
-        if (parser_match(&parser, "<!--")) {
-            parser_skip_comment(&parser);
-        } else {
-            break;
-        }
-    }
+    char *copy = malloc(html_len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, html, html_len);
+    copy[html_len] = '\0';
     
-    /* Parse root elements */
-    HtmlNode **root_tail = &doc->root;
-    
-    while (parser.pos < parser.html_len) {
-        parser_skip_whitespace(&parser);
-        
-        if (parser.pos >= parser.html_len) break;
-        
-        if (parser_match(&parser, "<!--")) {
-            parser_skip_comment(&parser);
-            continue;
-        }
-        
-        if (parser.html[parser.pos] == '<') {
-            HtmlNode *node = parser_parse_element(&parser);
-            if (node) {
-                *root_tail = node;
-                root_tail = &node->next_sibling;
-                
-                /* Track head and body */
-                if (strcasecmp(node->tag_name, "head") == 0) {
-                    doc->head = node;
-                } else if (strcasecmp(node->tag_name, "body") == 0) {
-                    doc->body = node;
-                } else if (strcasecmp(node->tag_name, "html") == 0) {
-                    /* Look for head and body in html element children */
-                    HtmlNode *child = node->first_child;
-                    while (child) {
-                        if (strcasecmp(child->tag_name, "head") == 0) {
-                            doc->head = child;
-                        } else if (strcasecmp(child->tag_name, "body") == 0) {
-                            doc->body = child;
-                        }
-                        child = child->next_sibling;
-                    }
-                }
-            } else {
-                /* Try to recover */
-                if (parser.pos < parser.html_len && parser.html[parser.pos] == '<') {
-                    parser.pos++;
-                }
-            }
-        } else {
-            /* Text node at root level - usually whitespace, skip it */
-            HtmlNode *text = parser_parse_text(&parser);
-            if (text) {
-                html_node_free(text);
-            }
-        }
+    HtmlDocument *doc = html_parse(copy, html_len);
+    if (!doc) {
+        free(copy);
+        return NULL;
     }
-    
-    LOG_INFO("Parsed HTML document: found %s, %s",
-             doc->head ? "<head>" : "no <head>",
-             doc->body ? "<body>" : "no <body>");
-    
+    doc->owned_source = copy;
     return doc;
 }
 
@@ -670,9 +624,11 @@ HtmlDocument* html_parse(const char *html, size_t html_len) {
 /* Forward declaration from js_quickjs.c */
 extern JSClassID js_video_class_id;
 extern GCValue js_video_constructor(JSContext *ctx, GCValue new_target, int argc, GCValue *argv);
+extern bool js_video_set_node_ref(GCValue obj, struct HtmlNodeRef *ref);
 
 /* Create a JavaScript element for a given tag */
-GCValue html_create_element_js(JSContext *ctx, const char *tag_name, HtmlAttribute *attrs) {
+GCValue html_create_element_js(JSContext *ctx, HtmlDocument *doc, const char *tag_name,
+                               HtmlAttribute *attrs) {
     if (!tag_name || !ctx) return JS_NULL;
     
     GCValue element;
@@ -697,16 +653,27 @@ GCValue html_create_element_js(JSContext *ctx, const char *tag_name, HtmlAttribu
     GCValue attr_map = JS_NewObject(ctx);
     
     /* Set id and className if present */
-    HtmlAttribute *attr = attrs;
+    HtmlAttribute *attr = doc ? attrs : NULL;
     while (attr) {
-        if (strcasecmp(attr->name, "id") == 0) {
-            JS_SetPropertyStr(ctx, element, "id", JS_NewString(ctx, attr->value));
-        } else if (strcasecmp(attr->name, "class") == 0) {
-            JS_SetPropertyStr(ctx, element, "className", JS_NewString(ctx, attr->value));
+        /* Names and values go straight from the source spans into JS strings */
+        size_t value_len = 0;
+        const char *value = html_attr_value(doc, attr, &value_len);
+        if (!value) value = "";
+        
+        if (html_attr_name_is(doc, attr, "id")) {
+            JS_SetPropertyStr(ctx, element, "id", JS_NewStringLen(ctx, value, value_len));
+        } else if (html_attr_name_is(doc, attr, "class")) {
+            JS_SetPropertyStr(ctx, element, "className", JS_NewStringLen(ctx, value, value_len));
         }
         
         /* Add to attributes map */
-        JS_SetPropertyStr(ctx, attr_map, attr->name, JS_NewString(ctx, attr->value));
+        size_t name_len = 0;
+        const char *name = html_attr_name(doc, attr, &name_len);
+        JSAtom name_atom = JS_NewAtomLen(ctx, name, name_len);
+        if (name_atom) {
+            JS_SetProperty(ctx, attr_map, name_atom, JS_NewStringLen(ctx, value, value_len));
+            JS_FreeAtom(ctx, name_atom);
+        }
         
         attr = attr->next;
     }
@@ -722,71 +689,736 @@ GCValue html_create_element_js(JSContext *ctx, const char *tag_name, HtmlAttribu
     return element;
 }
 
-/* Recursively create DOM nodes in JS with automatic GC memory management */
-static bool html_node_create_js_recursive(JSContext *ctx, HtmlNode *node, GCValue parent) {
-    if (!ctx || !node) return false;
+/* ============================================================================
+ * Native-backed Element wrappers
+ * ============================================================================ */
+
+/* Opaque of a wrapper. node and doc are cleared when the document is freed,
+ * after which every property reads as empty. */
+typedef struct HtmlNodeRef {
+    HtmlDocument *doc;
+    HtmlNode *node;
+    struct HtmlNodeRef *prev;
+    struct HtmlNodeRef *next;
+} HtmlNodeRef;
+
+static JSClassID js_html_node_class_id;
+
+static void html_node_ref_unlink(HtmlNodeRef *ref) {
+    if (!ref->doc) return;
+    if (ref->prev) ref->prev->next = ref->next;
+    else ref->doc->js_refs = ref->next;
+    if (ref->next) ref->next->prev = ref->prev;
+    ref->prev = ref->next = NULL;
+}
+
+static void html_document_detach_js(HtmlDocument *doc) {
+    HtmlNodeRef *ref = doc->js_refs;
+    while (ref) {
+        HtmlNodeRef *next = ref->next;
+        ref->doc = NULL;
+        ref->node = NULL;
+        ref->prev = ref->next = NULL;
+        ref = next;
+    }
+    doc->js_refs = NULL;
+}
+
+HtmlNodeRef *html_node_ref_new(HtmlDocument *doc, HtmlNode *node) {
+    HtmlNodeRef *ref = calloc(1, sizeof(HtmlNodeRef));
+    if (!ref) return NULL;
+    ref->doc = doc;
+    ref->node = node;
+    if (!doc) return ref;
+    ref->next = doc->js_refs;
+    if (doc->js_refs) doc->js_refs->prev = ref;
+    doc->js_refs = ref;
+    return ref;
+}
+
+void html_node_ref_release(HtmlNodeRef *ref) {
+    if (!ref) return;
+    if (ref->node) {
+        /* The next lookup of this node builds a fresh wrapper */
+        ref->node->js_object = JS_UNDEFINED;
+        ref->node->has_js_object = 0;
+    }
+    html_node_ref_unlink(ref);
+    free(ref);
+}
+
+static void js_html_node_finalizer(JSRuntime *rt, GCValue val) {
+    html_node_ref_release(JS_GetOpaque(val, js_html_node_class_id));
+}
+
+static HtmlNodeRef *js_html_node_ref(JSContext *ctx, GCValue this_val) {
+    HtmlNodeRef *ref = JS_GetOpaque2(ctx, this_val, js_html_node_class_id);
+    return (ref && ref->node) ? ref : NULL;
+}
+
+static GCValue js_html_attr_string(JSContext *ctx, HtmlNodeRef *ref, const char *name) {
+    HtmlAttribute *attr = ref ? html_node_get_attr(ref->doc, ref->node, name) : NULL;
+    if (!attr) return JS_NewString(ctx, "");
+    size_t len = 0;
+    const char *value = html_attr_value(ref->doc, attr, &len);
+    return JS_NewStringLen(ctx, value ? value : "", value ? len : 0);
+}
+
+static GCValue js_html_node_get_node_type(JSContext *ctx, GCValue this_val) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    return JS_NewInt32(ctx, ref ? (int)ref->node->type : HTML_NODE_ELEMENT);
+}
+
+static GCValue js_html_node_get_node_name(JSContext *ctx, GCValue this_val) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref) return JS_NewString(ctx, "");
+    if (ref->node->type == HTML_NODE_TEXT) return JS_NewString(ctx, "#text");
+    
+    char upper[HTML_MAX_TAG_NAME_LEN];
+    size_t len = 0;
+    for (const char *p = ref->node->tag_name; *p && len < sizeof(upper); p++) {
+        upper[len++] = (char)toupper((unsigned char)*p);
+    }
+    return JS_NewStringLen(ctx, upper, len);
+}
+
+static GCValue js_html_node_get_id(JSContext *ctx, GCValue this_val) {
+    return js_html_attr_string(ctx, js_html_node_ref(ctx, this_val), "id");
+}
+
+static GCValue js_html_node_get_class_name(JSContext *ctx, GCValue this_val) {
+    return js_html_attr_string(ctx, js_html_node_ref(ctx, this_val), "class");
+}
+
+static GCValue js_html_node_get_attributes(JSContext *ctx, GCValue this_val) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    GCValue attr_map = JS_NewObject(ctx);
+    if (!ref) return attr_map;
+    
+    for (HtmlAttribute *attr = ref->node->attributes; attr; attr = attr->next) {
+        size_t name_len = 0, value_len = 0;
+        const char *name = html_attr_name(ref->doc, attr, &name_len);
+        const char *value = html_attr_value(ref->doc, attr, &value_len);
+        JSAtom name_atom = JS_NewAtomLen(ctx, name, name_len);
+        if (name_atom) {
+            JS_SetProperty(ctx, attr_map, name_atom,
+                           JS_NewStringLen(ctx, value ? value : "", value ? value_len : 0));
+            JS_FreeAtom(ctx, name_atom);
+        }
+    }
+    return attr_map;
+}
+
+static GCValue js_html_node_children_array(JSContext *ctx, GCValue this_val, bool elements_only) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    GCValue array = JS_NewArray(ctx);
+    if (!ref) return array;
+    
+    uint32_t index = 0;
+    for (HtmlNode *child = ref->node->first_child; child; child = child->next_sibling) {
+        if (elements_only && child->type != HTML_NODE_ELEMENT) continue;
+        JS_SetPropertyUint32(ctx, array, index++, html_node_to_js(ctx, ref->doc, child));
+    }
+    return array;
+}
+
+static GCValue js_html_node_get_child_nodes(JSContext *ctx, GCValue this_val) {
+    return js_html_node_children_array(ctx, this_val, false);
+}
+
+static GCValue js_html_node_get_children(JSContext *ctx, GCValue this_val) {
+    return js_html_node_children_array(ctx, this_val, true);
+}
+
+#define DEFINE_HTML_NODE_LINK_GETTER(name, field) \
+    static GCValue js_html_node_get_##name(JSContext *ctx, GCValue this_val) { \
+        HtmlNodeRef *ref = js_html_node_ref(ctx, this_val); \
+        if (!ref) return JS_NULL; \
+        return html_node_to_js(ctx, ref->doc, ref->node->field); \
+    }
+
+DEFINE_HTML_NODE_LINK_GETTER(parent_node, parent)
+DEFINE_HTML_NODE_LINK_GETTER(first_child, first_child)
+DEFINE_HTML_NODE_LINK_GETTER(last_child, last_child)
+DEFINE_HTML_NODE_LINK_GETTER(next_sibling, next_sibling)
+DEFINE_HTML_NODE_LINK_GETTER(previous_sibling, prev_sibling)
+
+/* Appends the text of node and its descendants to a malloc'd buffer */
+static bool html_node_collect_text(HtmlDocument *doc, HtmlNode *node, char **buf,
+                                   size_t *len, size_t *cap) {
+    if (node->type == HTML_NODE_TEXT || node->text_is_raw) {
+        size_t text_len = 0;
+        const char *text = html_node_text(doc, node, &text_len);
+        if (text && text_len > 0) {
+            if (*len + text_len > *cap) {
+                size_t new_cap = *cap ? *cap * 2 : 256;
+                while (new_cap < *len + text_len) new_cap *= 2;
+                char *grown = realloc(*buf, new_cap);
+                if (!grown) return false;
+                *buf = grown;
+                *cap = new_cap;
+            }
+            memcpy(*buf + *len, text, text_len);
+            *len += text_len;
+        }
+    }
+    for (HtmlNode *child = node->first_child; child; child = child->next_sibling) {
+        if (!html_node_collect_text(doc, child, buf, len, cap)) return false;
+    }
+    return true;
+}
+
+static GCValue js_html_node_get_text_content(JSContext *ctx, GCValue this_val) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref) return JS_NewString(ctx, "");
+    
+    /* Text nodes and leaves don't need the scratch buffer */
+    if (ref->node->type == HTML_NODE_TEXT || !ref->node->first_child) {
+        size_t text_len = 0;
+        const char *text = (ref->node->type == HTML_NODE_TEXT || ref->node->text_is_raw)
+                           ? html_node_text(ref->doc, ref->node, &text_len) : NULL;
+        return JS_NewStringLen(ctx, text ? text : "", text ? text_len : 0);
+    }
     
-    GCValue js_node = JS_UNDEFINED;
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    if (!html_node_collect_text(ref->doc, ref->node, &buf, &len, &cap)) {
+        free(buf);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    GCValue result = JS_NewStringLen(ctx, buf ? buf : "", len);
+    free(buf);
+    return result;
+}
+
+static GCValue js_html_node_get_node_value(JSContext *ctx, GCValue this_val) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref || ref->node->type != HTML_NODE_TEXT) return JS_NULL;
+    return js_html_node_get_text_content(ctx, this_val);
+}
+
+static GCValue js_html_node_get_attribute(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref || argc < 1) return JS_NULL;
+    const char *name = JS_ToCString(ctx, argv[0]);
+    if (!name) return JS_EXCEPTION;
+    HtmlAttribute *attr = html_node_get_attr(ref->doc, ref->node, name);
+    JS_FreeCString(ctx, name);
+    if (!attr) return JS_NULL;
+    size_t len = 0;
+    const char *value = html_attr_value(ref->doc, attr, &len);
+    return JS_NewStringLen(ctx, value ? value : "", value ? len : 0);
+}
+
+static GCValue js_html_node_has_attribute(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref || argc < 1) return JS_FALSE;
+    const char *name = JS_ToCString(ctx, argv[0]);
+    if (!name) return JS_EXCEPTION;
+    bool found = html_node_get_attr(ref->doc, ref->node, name) != NULL;
+    JS_FreeCString(ctx, name);
+    return JS_NewBool(ctx, found);
+}
+
+/* querySelector(All) over the indexes. Selectors the matcher can't parse
+ * find nothing rather than throwing, so scripts probing for features keep
+ * running. */
+static GCValue js_html_query(JSContext *ctx, HtmlDocument *doc, HtmlNode *scope,
+                             const char *selector, bool all) {
+    HtmlSelector *sel = doc ? html_selector_parse(selector) : NULL;
+    HtmlNodeList found = {0};
+    if (sel) html_selector_query(doc, sel, scope, all ? 0 : 1, &found);
+    html_selector_free(sel);
+    
+    GCValue result;
+    if (all) {
+        result = JS_NewArray(ctx);
+        for (uint32_t i = 0; i < found.count; i++) {
+            JS_SetPropertyUint32(ctx, result, i, html_node_to_js(ctx, doc, found.items[i]));
+        }
+    } else {
+        result = found.count > 0 ? html_node_to_js(ctx, doc, found.items[0]) : JS_NULL;
+    }
+    html_node_list_free(&found);
+    return result;
+}
+
+static GCValue js_html_document_query(JSContext *ctx, HtmlDocument *doc, const char *selector,
+                                      bool all);
+
+/* scope == NULL queries the whole document, including attached elements;
+ * doc may then be NULL when only the stub DOM exists */
+static GCValue js_html_query_arg(JSContext *ctx, HtmlDocument *doc, HtmlNode *scope,
+                                 int argc, GCValue *argv, bool all) {
+    if ((!doc && scope) || argc < 1) return all ? JS_NewArray(ctx) : JS_NULL;
+    const char *selector = JS_ToCString(ctx, argv[0]);
+    if (!selector) return JS_EXCEPTION;
+    GCValue result = scope ? js_html_query(ctx, doc, scope, selector, all)
+                           : js_html_document_query(ctx, doc, selector, all);
+    JS_FreeCString(ctx, selector);
+    return result;
+}
+
+/* getElementsByClassName("a b") is the selector ".a.b" */
+static GCValue js_html_by_class_arg(JSContext *ctx, HtmlDocument *doc, HtmlNode *scope,
+                                    int argc, GCValue *argv) {
+    if ((!doc && scope) || argc < 1) return JS_NewArray(ctx);
+    const char *names = JS_ToCString(ctx, argv[0]);
+    if (!names) return JS_EXCEPTION;
+    
+    size_t len = strlen(names);
+    char *selector = malloc(len * 2 + 2);
+    size_t out = 0;
+    if (selector) {
+        const char *p = names;
+        while (*p) {
+            while (*p && isspace((unsigned char)*p)) p++;
+            if (!*p) break;
+            selector[out++] = '.';
+            while (*p && !isspace((unsigned char)*p)) selector[out++] = *p++;
+        }
+        selector[out] = '\0';
+    }
+    JS_FreeCString(ctx, names);
     
-    switch (node->type) {
-        case HTML_NODE_ELEMENT: {
-            js_node = html_create_element_js(ctx, node->tag_name, node->attributes);
-            
-            /* Process children */
-            if (!JS_IsNull(js_node)) {
-                HtmlNode *child = node->first_child;
-                while (child) {
-                    html_node_create_js_recursive(ctx, child, js_node);
-                    child = child->next_sibling;
-                }
-                
-                /* If we have a parent, append this element */
-                if (!JS_IsUndefined(parent) && !JS_IsNull(parent)) {
-                    /* Note: GCValue uses automatic garbage collection */
-                    GCValue appendChild = JS_GetPropertyStr(ctx, parent, "appendChild");
-                    
-                    if (!JS_IsUndefined(appendChild) && !JS_IsNull(appendChild)) {
-                        GCValue args[1] = { js_node };
-                        GCValue result = JS_Call(ctx, appendChild, parent, 1, args);
-                        
-                    }
-                    
-                }
-            }
-            break;
+    GCValue result = !(selector && out > 0) ? JS_NewArray(ctx)
+                   : scope ? js_html_query(ctx, doc, scope, selector, true)
+                           : js_html_document_query(ctx, doc, selector, true);
+    free(selector);
+    return result;
+}
+
+/* ============================================================================
+ * Elements attached at run time
+ * ============================================================================ */
+
+/* The stub DOM keeps no tree: createElement returns plain objects and
+ * appendChild hands its argument back. Elements attached that way are
+ * listed in document.__attached, and document lookups search them after the
+ * parsed page. id, className and tagName are read at lookup time, so changes
+ * made after attaching are seen. */
+#define JS_ATTACHED_PROP "__attached"
+
+static GCValue js_attached_list(JSContext *ctx, bool create) {
+    GCValue global = JS_GetGlobalObject(ctx);
+    GCValue document = JS_GetPropertyStr(ctx, global, "document");
+    if (!JS_IsObject(document)) return JS_UNDEFINED;
+    GCValue list = JS_GetPropertyStr(ctx, document, JS_ATTACHED_PROP);
+    if (!JS_IsArray(ctx, list)) {
+        if (!create) return JS_UNDEFINED;
+        list = JS_NewArray(ctx);
+        JS_SetPropertyStr(ctx, document, JS_ATTACHED_PROP, list);
+    }
+    return list;
+}
+
+static uint32_t js_array_length(JSContext *ctx, GCValue array) {
+    int32_t len = 0;
+    if (JS_ToInt32(ctx, &len, JS_GetPropertyStr(ctx, array, "length")) < 0 || len < 0) return 0;
+    return (uint32_t)len;
+}
+
+static int js_attached_index(JSContext *ctx, GCValue list, GCValue element, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        if (JS_StrictEq(ctx, JS_GetPropertyUint32(ctx, list, i), element)) return (int)i;
+    }
+    return -1;
+}
+
+void html_document_attach_element(JSContext *ctx, GCValue element) {
+    if (!ctx || !JS_IsObject(element)) return;
+    /* Parsed nodes are already indexed; appendChild moves them in the tree */
+    if (js_html_node_class_id && JS_GetOpaque(element, js_html_node_class_id)) return;
+    GCValue list = js_attached_list(ctx, true);
+    if (!JS_IsArray(ctx, list)) return;
+    uint32_t len = js_array_length(ctx, list);
+    if (js_attached_index(ctx, list, element, len) >= 0) return;
+    JS_SetPropertyUint32(ctx, list, len, element);
+}
+
+void html_document_detach_element(JSContext *ctx, GCValue element) {
+    if (!ctx || !JS_IsObject(element)) return;
+    GCValue list = js_attached_list(ctx, false);
+    if (!JS_IsArray(ctx, list)) return;
+    uint32_t len = js_array_length(ctx, list);
+    int at = js_attached_index(ctx, list, element, len);
+    if (at < 0) return;
+    /* Keep attach order, which stands in for document order */
+    for (uint32_t i = (uint32_t)at; i + 1 < len; i++) {
+        JS_SetPropertyUint32(ctx, list, i, JS_GetPropertyUint32(ctx, list, i + 1));
+    }
+    JS_SetPropertyStr(ctx, list, "length", JS_NewInt32(ctx, (int32_t)len - 1));
+}
+
+/* String property of element compared with [value, value + len) */
+static bool js_attached_prop_is(JSContext *ctx, GCValue element, const char *prop,
+                                const char *value, size_t len, bool ignore_case) {
+    GCValue v = JS_GetPropertyStr(ctx, element, prop);
+    if (!JS_IsString(v)) return false;
+    size_t v_len = 0;
+    const char *str = JS_ToCStringLen(ctx, &v_len, v);
+    if (!str) return false;
+    bool match = v_len == len &&
+                 (ignore_case ? strncasecmp(str, value, len) == 0 : memcmp(str, value, len) == 0);
+    JS_FreeCString(ctx, str);
+    return match;
+}
+
+static bool js_attached_has_class(JSContext *ctx, GCValue element, const char *name, size_t len) {
+    GCValue v = JS_GetPropertyStr(ctx, element, "className");
+    if (!JS_IsString(v)) return false;
+    const char *classes = JS_ToCString(ctx, v);
+    if (!classes) return false;
+    bool found = false;
+    for (const char *p = classes; *p && !found; ) {
+        while (*p && isspace((unsigned char)*p)) p++;
+        const char *start = p;
+        while (*p && !isspace((unsigned char)*p)) p++;
+        found = (size_t)(p - start) == len && memcmp(start, name, len) == 0;
+    }
+    JS_FreeCString(ctx, classes);
+    return found;
+}
+
+/* Matches one compound selector: an optional tag name or '*', then any
+ * number of #id and .class parts ("video", "#movie_player", "div.a.b").
+ * Anything richer (combinators, attributes, pseudo-classes, lists) never
+ * matches a run-time element. */
+static bool js_attached_matches(JSContext *ctx, GCValue element, const char *selector) {
+    const char *p = selector;
+    while (isspace((unsigned char)*p)) p++;
+    const char *end = p + strlen(p);
+    while (end > p && isspace((unsigned char)end[-1])) end--;
+    if (p == end) return false;
+    
+    const char *tag = p;
+    while (p < end && *p != '#' && *p != '.') {
+        if (!isalnum((unsigned char)*p) && *p != '-' && *p != '_' && *p != '*') return false;
+        p++;
+    }
+    size_t tag_len = p - tag;
+    if (tag_len > 0 && !(tag_len == 1 && *tag == '*') &&
+        !js_attached_prop_is(ctx, element, "tagName", tag, tag_len, true)) {
+        return false;
+    }
+    
+    while (p < end) {
+        char kind = *p++;
+        const char *name = p;
+        while (p < end && *p != '#' && *p != '.') {
+            if (isspace((unsigned char)*p) || strchr(">+~[]:,()", *p)) return false;
+            p++;
         }
-        
-        case HTML_NODE_TEXT: {
-            if (node->text_content && strlen(node->text_content) > 0) {
-                /* Create text node (as a simple string for now) */
-                js_node = JS_NewString(ctx, node->text_content);
-                
-                /* Add to parent's innerHTML or childNodes if needed */
-                if (!JS_IsUndefined(parent) && !JS_IsNull(parent)) {
-                    GCValue childNodes = JS_GetPropertyStr(ctx, parent, "childNodes");
-                    
-                    if (JS_IsArray(ctx, childNodes)) {
-                        GCValue push = JS_GetPropertyStr(ctx, childNodes, "push");
-                        GCValue args[1] = { js_node };
-                        GCValue result = JS_Call(ctx, push, childNodes, 1, args);
-                        
-                        
-                    }
-                    
-                }
-            }
-            break;
+        size_t name_len = p - name;
+        if (name_len == 0) return false;
+        bool ok = kind == '#' ? js_attached_prop_is(ctx, element, "id", name, name_len, false)
+                              : js_attached_has_class(ctx, element, name, name_len);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+/* First attached element matching selector, or appends every match to out */
+static GCValue js_attached_query(JSContext *ctx, const char *selector, GCValue out, bool all) {
+    GCValue list = js_attached_list(ctx, false);
+    uint32_t len = JS_IsArray(ctx, list) ? js_array_length(ctx, list) : 0;
+    uint32_t out_len = all ? js_array_length(ctx, out) : 0;
+    for (uint32_t i = 0; i < len; i++) {
+        GCValue element = JS_GetPropertyUint32(ctx, list, i);
+        if (!JS_IsObject(element) || !js_attached_matches(ctx, element, selector)) continue;
+        if (!all) return element;
+        JS_SetPropertyUint32(ctx, out, out_len++, element);
+    }
+    return all ? out : JS_NULL;
+}
+
+/* Document-wide query: the parsed page first, then attached elements */
+static GCValue js_html_document_query(JSContext *ctx, HtmlDocument *doc, const char *selector,
+                                      bool all) {
+    GCValue result = js_html_query(ctx, doc, NULL, selector, all);
+    if (JS_IsException(result) || (!all && !JS_IsNull(result))) return result;
+    return js_attached_query(ctx, selector, result, all);
+}
+
+static GCValue js_html_node_query_selector(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref) return JS_NULL;
+    return js_html_query_arg(ctx, ref->doc, ref->node, argc, argv, false);
+}
+
+static GCValue js_html_node_query_selector_all(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref) return JS_NewArray(ctx);
+    return js_html_query_arg(ctx, ref->doc, ref->node, argc, argv, true);
+}
+
+static GCValue js_html_node_get_elements_by_tag_name(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref) return JS_NewArray(ctx);
+    return js_html_query_arg(ctx, ref->doc, ref->node, argc, argv, true);
+}
+
+static GCValue js_html_node_get_elements_by_class_name(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref) return JS_NewArray(ctx);
+    return js_html_by_class_arg(ctx, ref->doc, ref->node, argc, argv);
+}
+
+/* Node of another wrapper from the same document, NULL for anything else */
+static HtmlNode *js_html_node_arg(HtmlNodeRef *ref, GCValue val) {
+    HtmlNodeRef *other = JS_GetOpaque(val, js_html_node_class_id);
+    return (other && other->node && other->doc == ref->doc) ? other->node : NULL;
+}
+
+/* Parsed nodes are moved in the tree; other children are attached the way
+ * the stub Node.prototype.appendChild attaches them */
+static GCValue js_html_node_append_child(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    if (argc < 1) return JS_NULL;
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    HtmlNode *child = ref ? js_html_node_arg(ref, argv[0]) : NULL;
+    if (child) html_node_append_child(ref->doc, ref->node, child);
+    else html_document_attach_element(ctx, argv[0]);
+    return argv[0];
+}
+
+static GCValue js_html_node_remove_child(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    if (argc < 1) return JS_NULL;
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    HtmlNode *child = ref ? js_html_node_arg(ref, argv[0]) : NULL;
+    if (child) html_node_remove_child(ref->doc, ref->node, child);
+    else html_document_detach_element(ctx, argv[0]);
+    return argv[0];
+}
+
+static GCValue js_html_node_set_attribute(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref || argc < 2) return JS_UNDEFINED;
+    const char *name = JS_ToCString(ctx, argv[0]);
+    if (!name) return JS_EXCEPTION;
+    size_t value_len = 0;
+    const char *value = JS_ToCStringLen(ctx, &value_len, argv[1]);
+    if (value) html_node_set_attribute(ref->doc, ref->node, name, value, value_len);
+    JS_FreeCString(ctx, value);
+    JS_FreeCString(ctx, name);
+    return value ? JS_UNDEFINED : JS_EXCEPTION;
+}
+
+static GCValue js_html_node_remove_attribute(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlNodeRef *ref = js_html_node_ref(ctx, this_val);
+    if (!ref || argc < 1) return JS_UNDEFINED;
+    const char *name = JS_ToCString(ctx, argv[0]);
+    if (!name) return JS_EXCEPTION;
+    html_node_remove_attribute(ref->doc, ref->node, name);
+    JS_FreeCString(ctx, name);
+    return JS_UNDEFINED;
+}
+
+static const JSCFunctionListEntry js_html_node_proto_funcs[] = {
+    JS_CFUNC_DEF("getAttribute", 1, js_html_node_get_attribute),
+    JS_CFUNC_DEF("hasAttribute", 1, js_html_node_has_attribute),
+    JS_CFUNC_DEF("setAttribute", 2, js_html_node_set_attribute),
+    JS_CFUNC_DEF("removeAttribute", 1, js_html_node_remove_attribute),
+    JS_CFUNC_DEF("appendChild", 1, js_html_node_append_child),
+    JS_CFUNC_DEF("removeChild", 1, js_html_node_remove_child),
+    JS_CFUNC_DEF("querySelector", 1, js_html_node_query_selector),
+    JS_CFUNC_DEF("querySelectorAll", 1, js_html_node_query_selector_all),
+    JS_CFUNC_DEF("getElementsByTagName", 1, js_html_node_get_elements_by_tag_name),
+    JS_CFUNC_DEF("getElementsByClassName", 1, js_html_node_get_elements_by_class_name),
+    JS_CGETSET_DEF("nodeType", js_html_node_get_node_type, NULL),
+    JS_CGETSET_DEF("nodeName", js_html_node_get_node_name, NULL),
+    JS_CGETSET_DEF("tagName", js_html_node_get_node_name, NULL),
+    JS_CGETSET_DEF("id", js_html_node_get_id, NULL),
+    JS_CGETSET_DEF("className", js_html_node_get_class_name, NULL),
+    JS_CGETSET_DEF("attributes", js_html_node_get_attributes, NULL),
+    JS_CGETSET_DEF("childNodes", js_html_node_get_child_nodes, NULL),
+    JS_CGETSET_DEF("children", js_html_node_get_children, NULL),
+    JS_CGETSET_DEF("parentNode", js_html_node_get_parent_node, NULL),
+    JS_CGETSET_DEF("parentElement", js_html_node_get_parent_node, NULL),
+    JS_CGETSET_DEF("firstChild", js_html_node_get_first_child, NULL),
+    JS_CGETSET_DEF("lastChild", js_html_node_get_last_child, NULL),
+    JS_CGETSET_DEF("nextSibling", js_html_node_get_next_sibling, NULL),
+    JS_CGETSET_DEF("previousSibling", js_html_node_get_previous_sibling, NULL),
+    JS_CGETSET_DEF("textContent", js_html_node_get_text_content, NULL),
+    JS_CGETSET_DEF("nodeValue", js_html_node_get_node_value, NULL),
+    JS_CGETSET_DEF("data", js_html_node_get_node_value, NULL),
+};
+
+/* Registers the wrapper class on first use in a runtime. The prototype
+ * inherits from HTMLElement.prototype when the browser stubs provide it. */
+static bool js_html_node_class_init(JSContext *ctx) {
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    if (js_html_node_class_id == 0) {
+        JS_NewClassID(&js_html_node_class_id);
+    }
+    if (JS_IsRegisteredClass(rt, js_html_node_class_id)) return true;
+    
+    JSClassDef def = {"HTMLParsedElement", .finalizer = js_html_node_finalizer};
+    if (JS_NewClass(rt, js_html_node_class_id, &def) < 0) {
+        LOG_ERROR("Failed to register parsed element class");
+        return false;
+    }
+    
+    GCValue parent_proto = JS_NULL;
+    GCValue global = JS_GetGlobalObject(ctx);
+    GCValue html_element = JS_GetPropertyStr(ctx, global, "HTMLElement");
+    if (JS_IsObject(html_element)) {
+        parent_proto = JS_GetPropertyStr(ctx, html_element, "prototype");
+        if (!JS_IsObject(parent_proto)) parent_proto = JS_NULL;
+    }
+    
+    GCValue proto = JS_IsNull(parent_proto) ? JS_NewObject(ctx)
+                                            : JS_NewObjectProto(ctx, parent_proto);
+    JS_SetPropertyFunctionList(ctx, proto, js_html_node_proto_funcs,
+                               sizeof(js_html_node_proto_funcs) / sizeof(js_html_node_proto_funcs[0]));
+    JS_SetClassProto(ctx, js_html_node_class_id, proto);
+    return true;
+}
+
+/* Object of class_id whose opaque is a ref linked into doc */
+static GCValue js_html_new_ref_object(JSContext *ctx, JSClassID class_id, HtmlDocument *doc,
+                                      HtmlNode *node) {
+    GCValue obj = JS_NewObjectClass(ctx, class_id);
+    if (JS_IsException(obj)) return obj;
+    
+    HtmlNodeRef *ref = html_node_ref_new(doc, node);
+    if (!ref) return JS_ThrowOutOfMemory(ctx);
+    JS_SetOpaque(obj, ref);
+    return obj;
+}
+
+GCValue html_node_to_js(JSContext *ctx, HtmlDocument *doc, HtmlNode *node) {
+    if (!ctx || !doc || !node) return JS_NULL;
+    if (node->has_js_object) return node->js_object;
+    
+    GCValue wrapper;
+    if (node->type == HTML_NODE_ELEMENT && strcmp(node->tag_name, "video") == 0) {
+        /* Video elements keep their native media class; the ref lets its
+         * finalizer clear the cache below */
+        wrapper = html_create_element_js(ctx, doc, node->tag_name, node->attributes);
+        if (JS_IsNull(wrapper)) return JS_NULL;
+        HtmlNodeRef *ref = html_node_ref_new(doc, node);
+        if (!ref) return JS_ThrowOutOfMemory(ctx);
+        if (!js_video_set_node_ref(wrapper, ref)) {
+            /* Nothing would clear the cache: hand out an uncached wrapper */
+            html_node_ref_release(ref);
+            return wrapper;
         }
-        
-        default:
-            break;
+    } else {
+        if (!js_html_node_class_init(ctx)) return JS_NULL;
+        wrapper = js_html_new_ref_object(ctx, js_html_node_class_id, doc, node);
+        if (JS_IsException(wrapper)) return wrapper;
     }
     
-    if (!JS_IsUndefined(js_node)) {
-        node->js_object = js_node;
-        node->has_js_object = 1;
+    node->js_object = wrapper;
+    node->has_js_object = 1;
+    return wrapper;
+}
+
+/* ============================================================================
+ * Document queries
+ * ============================================================================ */
+
+/* Document objects carry a ref with node == NULL */
+static JSClassID js_html_document_class_id;
+
+static void js_html_document_finalizer(JSRuntime *rt, GCValue val) {
+    HtmlNodeRef *ref = JS_GetOpaque(val, js_html_document_class_id);
+    if (!ref) return;
+    html_node_ref_unlink(ref);
+    free(ref);
+}
+
+static HtmlDocument *js_html_document(JSContext *ctx, GCValue this_val) {
+    HtmlNodeRef *ref = JS_GetOpaque2(ctx, this_val, js_html_document_class_id);
+    return ref ? ref->doc : NULL;
+}
+
+static GCValue js_html_document_get_element_by_id(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    HtmlDocument *doc = js_html_document(ctx, this_val);
+    if (argc < 1) return JS_NULL;
+    size_t id_len = 0;
+    const char *id = JS_ToCStringLen(ctx, &id_len, argv[0]);
+    if (!id) return JS_EXCEPTION;
+    HtmlNode *node = doc ? html_document_get_element_by_id(doc, id, id_len) : NULL;
+    GCValue result = node ? html_node_to_js(ctx, doc, node) : JS_NULL;
+    if (JS_IsNull(result)) {
+        GCValue list = js_attached_list(ctx, false);
+        uint32_t len = JS_IsArray(ctx, list) ? js_array_length(ctx, list) : 0;
+        for (uint32_t i = 0; i < len; i++) {
+            GCValue element = JS_GetPropertyUint32(ctx, list, i);
+            if (JS_IsObject(element) && js_attached_prop_is(ctx, element, "id", id, id_len, false)) {
+                result = element;
+                break;
+            }
+        }
+    }
+    JS_FreeCString(ctx, id);
+    return result;
+}
+
+static GCValue js_html_document_query_selector(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    return js_html_query_arg(ctx, js_html_document(ctx, this_val), NULL, argc, argv, false);
+}
+
+static GCValue js_html_document_query_selector_all(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    return js_html_query_arg(ctx, js_html_document(ctx, this_val), NULL, argc, argv, true);
+}
+
+static GCValue js_html_document_get_elements_by_class_name(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    return js_html_by_class_arg(ctx, js_html_document(ctx, this_val), NULL, argc, argv);
+}
+
+static const JSCFunctionListEntry js_html_document_proto_funcs[] = {
+    JS_CFUNC_DEF("getElementById", 1, js_html_document_get_element_by_id),
+    JS_CFUNC_DEF("querySelector", 1, js_html_document_query_selector),
+    JS_CFUNC_DEF("querySelectorAll", 1, js_html_document_query_selector_all),
+    JS_CFUNC_DEF("getElementsByTagName", 1, js_html_document_query_selector_all),
+    JS_CFUNC_DEF("getElementsByClassName", 1, js_html_document_get_elements_by_class_name),
+};
+
+#define JS_HTML_DOCUMENT_FUNC_COUNT \
+    (sizeof(js_html_document_proto_funcs) / sizeof(js_html_document_proto_funcs[0]))
+
+static bool js_html_document_class_init(JSContext *ctx) {
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    if (js_html_document_class_id == 0) {
+        JS_NewClassID(&js_html_document_class_id);
     }
+    if (JS_IsRegisteredClass(rt, js_html_document_class_id)) return true;
     
+    JSClassDef def = {"HTMLParsedDocument", .finalizer = js_html_document_finalizer};
+    if (JS_NewClass(rt, js_html_document_class_id, &def) < 0) {
+        LOG_ERROR("Failed to register parsed document class");
+        return false;
+    }
+    GCValue proto = JS_NewObject(ctx);
+    JS_SetPropertyFunctionList(ctx, proto, js_html_document_proto_funcs, JS_HTML_DOCUMENT_FUNC_COUNT);
+    JS_SetClassProto(ctx, js_html_document_class_id, proto);
+    return true;
+}
+
+static GCValue js_html_document_new(JSContext *ctx, HtmlDocument *doc) {
+    if (!js_html_document_class_init(ctx)) return JS_EXCEPTION;
+    return js_html_new_ref_object(ctx, js_html_document_class_id, doc, NULL);
+}
+
+/* Calls a document method with the bound document object as this */
+static GCValue js_html_document_forward(JSContext *ctx, GCValue this_val, int argc, GCValue *argv,
+                                        int magic, GCValue *func_data) {
+    return js_html_document_proto_funcs[magic].u.func.cfunc.generic(ctx, func_data[0], argc, argv);
+}
+
+bool html_bind_document_queries(JSContext *ctx, GCValue target, HtmlDocument *doc) {
+    if (!ctx) return false;
+    GCValue bound = js_html_document_new(ctx, doc);
+    if (JS_IsException(bound)) return false;
+    
+    for (int i = 0; i < (int)JS_HTML_DOCUMENT_FUNC_COUNT; i++) {
+        const JSCFunctionListEntry *entry = &js_html_document_proto_funcs[i];
+        GCValue fn = JS_NewCFunctionData(ctx, js_html_document_forward, entry->u.func.length,
+                                         i, 1, &bound);
+        JS_SetPropertyStr(ctx, target, entry->name, fn);
+    }
     return true;
 }
 
@@ -794,7 +1426,8 @@ static bool html_node_create_js_recursive(JSContext *ctx, HtmlNode *node, GCValu
 GCValue html_create_js_document(JSContext *ctx, HtmlDocument *doc) {
     if (!ctx || !doc) return JS_NULL;
     
-    GCValue js_doc = JS_NewObject(ctx);
+    GCValue js_doc = js_html_document_new(ctx, doc);
+    if (JS_IsException(js_doc)) return JS_NULL;
     
     /* Set document properties */
     JS_SetPropertyStr(ctx, js_doc, "nodeType", JS_NewInt32(ctx, 9)); /* DOCUMENT_NODE */
@@ -802,62 +1435,22 @@ GCValue html_create_js_document(JSContext *ctx, HtmlDocument *doc) {
     JS_SetPropertyStr(ctx, js_doc, "characterSet", JS_NewString(ctx, "UTF-8"));
     JS_SetPropertyStr(ctx, js_doc, "contentType", JS_NewString(ctx, "text/html"));
     
-    /* Create documentElement (html or first root element) */
-    GCValue doc_element = JS_NULL;
-    if (doc->root) {
-        doc_element = html_create_element_js(ctx, doc->root->tag_name, doc->root->attributes);
-        
-        /* Process children of root */
-        HtmlNode *child = doc->root->first_child;
-        while (child) {
-            html_node_create_js_recursive(ctx, child, doc_element);
-            child = child->next_sibling;
-        }
-    } else {
-        /* Create a minimal html element */
-        doc_element = html_create_element_js(ctx, "html", NULL);
-    }
-    
+    /* Only the entry points get wrappers now; the rest of the tree is
+     * wrapped as script code walks into it */
+    GCValue doc_element = doc->root ? html_node_to_js(ctx, doc, doc->root)
+                                    : html_create_element_js(ctx, doc, "html", NULL);
     JS_SetPropertyStr(ctx, js_doc, "documentElement", doc_element);
     
-    /* Create body element reference */
-    GCValue body_element = JS_NULL;
-    if (doc->body) {
-        body_element = html_create_element_js(ctx, "body", doc->body->attributes);
-        
-        /* Process body children */
-        HtmlNode *child = doc->body->first_child;
-        while (child) {
-            html_node_create_js_recursive(ctx, child, body_element);
-            child = child->next_sibling;
-        }
-    } else {
-        body_element = html_create_element_js(ctx, "body", NULL);
-    }
-    
+    GCValue body_element = doc->body ? html_node_to_js(ctx, doc, doc->body)
+                                     : html_create_element_js(ctx, doc, "body", NULL);
     JS_SetPropertyStr(ctx, js_doc, "body", body_element);
-    JS_SetPropertyStr(ctx, doc_element, "body", body_element);
-    
-    /* Create head element reference */
-    GCValue head_element = JS_NULL;
-    if (doc->head) {
-        head_element = html_create_element_js(ctx, "head", doc->head->attributes);
-        
-        /* Process head children */
-        HtmlNode *child = doc->head->first_child;
-        while (child) {
-            html_node_create_js_recursive(ctx, child, head_element);
-            child = child->next_sibling;
-        }
-    } else {
-        head_element = html_create_element_js(ctx, "head", NULL);
-    }
     
+    GCValue head_element = doc->head ? html_node_to_js(ctx, doc, doc->head)
+                                     : html_create_element_js(ctx, doc, "head", NULL);
     JS_SetPropertyStr(ctx, js_doc, "head", head_element);
-    JS_SetPropertyStr(ctx, doc_element, "head", head_element);
     
-    /* Add document methods */
-    /* Note: createElement is provided by js_quickjs.c */
+    /* Lookups come from the class prototype.
+     * Note: createElement is provided by js_quickjs.c */
     
     return js_doc;
 }
@@ -893,84 +1486,31 @@ bool html_create_dom_in_js(JSContext *ctx, HtmlDocument *doc) {
     return true;
 }
 
+/* Tag names are indexed lowercase */
+static const HtmlNodeList *html_nodes_by_tag_ci(HtmlDocument *doc, const char *tag_name) {
+    char lower[HTML_MAX_TAG_NAME_LEN];
+    size_t len = strlen(tag_name);
+    if (len >= sizeof(lower)) return NULL;
+    memcpy(lower, tag_name, len + 1);
+    html_tag_name_normalize(lower);
+    return html_document_nodes_by_tag(doc, lower);
+}
+
 /* Helper to get element by tag name from document */
 HtmlNode* html_document_get_element_by_tag(HtmlDocument *doc, const char *tag_name) {
     if (!doc || !tag_name) return NULL;
-    
-    /* Check head */
-    if (doc->head && strcasecmp(doc->head->tag_name, tag_name) == 0) {
-        return doc->head;
-    }
-    
-    /* Check body */
-    if (doc->body && strcasecmp(doc->body->tag_name, tag_name) == 0) {
-        return doc->body;
-    }
-    
-    /* Search in root */
-    HtmlNode *root = doc->root;
-    if (root && strcasecmp(root->tag_name, tag_name) == 0) {
-        return root;
-    }
-    
-    /* Search recursively in children */
-    /* Simple breadth-first search */
-    HtmlNode *queue[HTML_MAX_NESTING_DEPTH];
-    int head = 0, tail = 0;
-    
-    if (root) queue[tail++] = root;
-    
-    while (head < tail) {
-        HtmlNode *current = queue[head++];
-        
-        if (strcasecmp(current->tag_name, tag_name) == 0) {
-            return current;
-        }
-        
-        HtmlNode *child = current->first_child;
-        while (child && tail < HTML_MAX_NESTING_DEPTH) {
-            queue[tail++] = child;
-            child = child->next_sibling;
-        }
-    }
-    
-    return NULL;
+    const HtmlNodeList *list = html_nodes_by_tag_ci(doc, tag_name);
+    return (list && list->count > 0) ? list->items[0] : NULL;
 }
 
 /* Helper to get all elements by tag name */
 int html_document_get_elements_by_tag(HtmlDocument *doc, const char *tag_name,
                                        HtmlNode **out_nodes, int max_nodes) {
     if (!doc || !tag_name || !out_nodes || max_nodes <= 0) return 0;
+    const HtmlNodeList *list = html_nodes_by_tag_ci(doc, tag_name);
+    if (!list) return 0;
     
-    int count = 0;
-    
-    /* Search recursively using a stack */
-    HtmlNode *stack[HTML_MAX_NESTING_DEPTH];
-    int stack_top = 0;
-    
-    if (doc->root) stack[stack_top++] = doc->root;
-    
-    while (stack_top > 0 && count < max_nodes) {
-        HtmlNode *current = stack[--stack_top];
-        
-        if (strcasecmp(current->tag_name, tag_name) == 0) {
-            out_nodes[count++] = current;
-        }
-        
-        /* Add children to stack (in reverse order for correct order) */
-        HtmlNode *child = current->first_child;
-        HtmlNode *children[HTML_MAX_NESTING_DEPTH];
-        int child_count = 0;
-        
-        while (child && child_count < HTML_MAX_NESTING_DEPTH) {
-            children[child_count++] = child;
-            child = child->next_sibling;
-        }
-        
-        for (int i = child_count - 1; i >= 0 && stack_top < HTML_MAX_NESTING_DEPTH; i--) {
-            stack[stack_top++] = children[i];
-        }
-    }
-    
+    int count = list->count < (uint32_t)max_nodes ? (int)list->count : max_nodes;
+    memcpy(out_nodes, list->items, (size_t)count * sizeof(HtmlNode *));
     return count;
 }
@@ -10,6 +10,9 @@
 #include <quickjs.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "job_arena.h"
+#include "html_tokenizer.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,8 +20,6 @@ extern "C" {
 
 /* Maximum sizes for parsing */
 #define HTML_MAX_TAG_NAME_LEN 128
-#define HTML_MAX_ATTR_NAME_LEN 128
-#define HTML_MAX_ATTR_VALUE_LEN 4096
 #define HTML_MAX_ATTRS_PER_ELEMENT 64
 #define HTML_MAX_NESTING_DEPTH 256
 
@@ -36,19 +37,47 @@ typedef struct HtmlNode HtmlNode;
 typedef struct HtmlDocument HtmlDocument;
 typedef struct HtmlAttribute HtmlAttribute;
 
-/* HTML attribute structure */
+/* HTML attribute structure. Name and value point into the source HTML;
+ * use html_attr_value() to read the entity-decoded value. */
 typedef struct HtmlAttribute {
-    char name[HTML_MAX_ATTR_NAME_LEN];
-    char value[HTML_MAX_ATTR_VALUE_LEN];
+    HtmlSpan name;
+    HtmlSpan value;
+    bool value_has_entity;         /* Value contains '&' and may need decoding */
+    const char *value_cstr;        /* Decoded, NUL terminated; set on first use */
+    const char *name_cstr;         /* Set for attributes added by script, overrides name */
     struct HtmlAttribute *next;
 } HtmlAttribute;
 
+/* Growable list of nodes, kept in document order */
+typedef struct HtmlNodeList {
+    HtmlNode **items;
+    uint32_t count;
+    uint32_t capacity;
+} HtmlNodeList;
+
+typedef struct HtmlIndexEntry {
+    const char *key;               /* View into the source or the arena; NULL if free */
+    size_t key_len;
+    uint32_t hash;
+    HtmlNodeList nodes;
+} HtmlIndexEntry;
+
+/* Open-addressing map from a string to the connected nodes carrying it */
+typedef struct HtmlIndex {
+    HtmlIndexEntry *entries;
+    uint32_t capacity;
+    uint32_t count;
+} HtmlIndex;
+
 /* HTML node structure */
 struct HtmlNode {
     HtmlNodeType type;
-    char tag_name[HTML_MAX_TAG_NAME_LEN];  /* For element nodes */
-    char *text_content;                     /* For text/comment nodes */
-    size_t text_len;
+    const char *tag_name;          /* Lowercase, interned by the tokenizer; "" for text */
+    HtmlSpan text;                 /* Text, or raw content for script/style */
+    bool text_is_raw;              /* Raw content is never entity decoded */
+    bool text_has_entity;
+    const char *text_cstr;         /* Decoded, NUL terminated; set on first use */
+    size_t text_len;               /* Length of text_cstr */
     
     HtmlAttribute *attributes;
     HtmlNode *first_child;
@@ -57,13 +86,22 @@ struct HtmlNode {
     HtmlNode *prev_sibling;
     HtmlNode *parent;
     
-    /* QuickJS object reference (created when node is added to document) */
+    uint32_t order;                /* Document order; renumbered when moved */
+    bool connected;                /* Reachable from the document, and indexed */
+    
+    /* JS wrapper, created the first time script code reaches this node so
+     * every lookup of the same node returns the same object */
     GCValue js_object;
     int has_js_object;  /* Flag to track if js_object is valid */
 };
 
-/* HTML document structure */
+/* HTML document structure. Nodes, attributes and decoded strings live in
+ * the document arena; the source HTML must outlive the document. */
 struct HtmlDocument {
+    const char *source;
+    size_t source_len;
+    JobArena arena;
+    
     HtmlNode *root;           /* Document root (usually <html>) */
     HtmlNode *head;           /* Reference to <head> element */
     HtmlNode *body;           /* Reference to <body> element */
@@ -72,34 +110,108 @@ struct HtmlDocument {
     /* Parser state */
     int nesting_depth;
     HtmlNode *current_parent;
+    
+    /* Element lookup by id, tag name and class, kept current by the
+     * mutation functions below */
+    HtmlIndex ids;
+    HtmlIndex tags;
+    HtmlIndex classes;
+    uint32_t next_order;
+    
+    /* Live JS wrappers, detached when the document is freed */
+    struct HtmlNodeRef *js_refs;
+    
+    /* Source copy owned by the document (html_parse_copy), else NULL */
+    char *owned_source;
 };
 
-/* Parser state structure */
-typedef struct {
-    const char *html;
-    size_t html_len;
-    size_t pos;
-    int line;
-    int column;
-    int nesting_depth;
-    HtmlDocument *document;
-} HtmlParser;
-
 /* ============================================================================
  * HTML DOM Functions
  * ============================================================================ */
 
-/* Parse HTML string and create a document structure */
+/* Parse HTML string and create a document structure. The document keeps
+ * views into html, which must stay valid until html_document_free(). */
 HtmlDocument* html_parse(const char *html, size_t html_len);
 
-/* Free HTML document and all associated nodes */
+/* Like html_parse, on a private copy of html that the document frees, so
+ * the document can outlive the caller's buffer */
+HtmlDocument* html_parse_copy(const char *html, size_t html_len);
+
+/* Build a document from an existing token stream. The stream (and its
+ * source) must outlive the document. */
+HtmlDocument* html_parse_tokens(const HtmlTokenStream *tokens);
+
+/* Free HTML document and all associated nodes (one arena release) */
 void html_document_free(HtmlDocument *doc);
 
+/* Case-insensitive match of an attribute name, without allocating */
+bool html_attr_name_is(const HtmlDocument *doc, const HtmlAttribute *attr, const char *name);
+
+/* Attribute name as a view into the source (not NUL terminated) */
+const char *html_attr_name(const HtmlDocument *doc, const HtmlAttribute *attr, size_t *out_len);
+
+/* Entity-decoded attribute value. Without entities this is a view into the
+ * source and is NOT NUL terminated; use out_len. */
+const char *html_attr_value(HtmlDocument *doc, HtmlAttribute *attr, size_t *out_len);
+
+/* Entity-decoded, NUL-terminated attribute value (copied on first use) */
+const char *html_attr_value_cstr(HtmlDocument *doc, HtmlAttribute *attr);
+
+/* Find an attribute by name, NULL if absent */
+HtmlAttribute *html_node_get_attr(const HtmlDocument *doc, const HtmlNode *node, const char *name);
+
+/* Decoded, NUL-terminated text of a text node or raw content tag */
+const char *html_node_text(HtmlDocument *doc, HtmlNode *node, size_t *out_len);
+
+/* ============================================================================
+ * Indexed lookup and mutation
+ * ============================================================================ */
+
+/* First connected element with this id, NULL if none */
+HtmlNode *html_document_get_element_by_id(HtmlDocument *doc, const char *id, size_t id_len);
+const HtmlNodeList *html_document_nodes_by_id(HtmlDocument *doc, const char *id, size_t id_len);
+
+/* Connected elements carrying a tag name (lowercase) or class, in document
+ * order. The list belongs to the index and changes with the tree. */
+const HtmlNodeList *html_document_nodes_by_tag(HtmlDocument *doc, const char *tag_name);
+const HtmlNodeList *html_document_nodes_by_class(HtmlDocument *doc, const char *class_name,
+                                                 size_t class_len);
+
+/* Moves child (and its subtree) to the end of parent's children */
+bool html_node_append_child(HtmlDocument *doc, HtmlNode *parent, HtmlNode *child);
+
+/* Detaches child from parent; the subtree is dropped from the indexes */
+bool html_node_remove_child(HtmlDocument *doc, HtmlNode *parent, HtmlNode *child);
+
+/* Sets or replaces an attribute; name is lowercased, both are copied */
+bool html_node_set_attribute(HtmlDocument *doc, HtmlNode *node, const char *name,
+                             const char *value, size_t value_len);
+
+bool html_node_remove_attribute(HtmlDocument *doc, HtmlNode *node, const char *name);
+
+/* True if node is scope or one of its descendants */
+bool html_node_contains(const HtmlNode *scope, const HtmlNode *node);
+
+bool html_node_list_push(HtmlNodeList *list, HtmlNode *node);
+void html_node_list_free(HtmlNodeList *list);
+
 /* Create DOM nodes in QuickJS context from parsed HTML document */
 bool html_create_dom_in_js(JSContext *ctx, HtmlDocument *doc);
 
 /* Create a single HTML element in QuickJS */
-GCValue html_create_element_js(JSContext *ctx, const char *tag_name, HtmlAttribute *attrs);
+GCValue html_create_element_js(JSContext *ctx, HtmlDocument *doc, const char *tag_name,
+                               HtmlAttribute *attrs);
+
+/* JS wrapper for a parsed node, created on first use. Properties such as
+ * attributes, childNodes, parentNode and textContent are read from the node
+ * when accessed. Returns JS_NULL for a NULL node. */
+GCValue html_node_to_js(JSContext *ctx, HtmlDocument *doc, HtmlNode *node);
+
+/* Link between a node and a wrapper of another native class (such as
+ * <video>) that html_node_to_js cached on it. The wrapper's finalizer must
+ * call html_node_ref_release, which clears the node's cache. */
+struct HtmlNodeRef *html_node_ref_new(HtmlDocument *doc, HtmlNode *node);
+void html_node_ref_release(struct HtmlNodeRef *ref);
 
 /* Helper to get element by tag name from document */
 HtmlNode* html_document_get_element_by_tag(HtmlDocument *doc, const char *tag_name);
@@ -111,18 +223,24 @@ int html_document_get_elements_by_tag(HtmlDocument *doc, const char *tag_name,
 /* Create JavaScript document object with parsed HTML elements */
 GCValue html_create_js_document(JSContext *ctx, HtmlDocument *doc);
 
+/* Points getElementById, querySelector(All) and getElementsBy{TagName,ClassName}
+ * of an existing document object at doc, then at the elements attached at run
+ * time. doc may be NULL to search attached elements only. Once doc is freed
+ * only attached elements are found. */
+bool html_bind_document_queries(JSContext *ctx, GCValue target, HtmlDocument *doc);
+
+/* Elements the stub DOM appends or removes (stub appendChild, insertBefore,
+ * removeChild). Document lookups find attached elements after the parsed
+ * page, matching their current id, className and tagName. */
+void html_document_attach_element(JSContext *ctx, GCValue element);
+void html_document_detach_element(JSContext *ctx, GCValue element);
+
 /* ============================================================================
  * HTML Utility Functions
  * ============================================================================ */
 
-/* Decode HTML entities in place (modifies the string) */
-int html_decode_entities(char *str, size_t len);
-
-/* Check if a tag is self-closing */
-bool html_is_self_closing_tag(const char *tag_name);
-
-/* Check if a tag should have raw content (script, style, etc.) */
-bool html_is_raw_content_tag(const char *tag_name);
+/* html_decode_entities, html_is_self_closing_tag and html_is_raw_content_tag
+ * are declared in html_tokenizer.h */
 
 /* Convert tag name to lowercase */
 void html_tag_name_normalize(char *tag_name);
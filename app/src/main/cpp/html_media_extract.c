@@ -3,7 +3,6 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <pthread.h>
-#include <android/log.h>
 #include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -11,282 +10,18 @@
 #include "html_media_extract.h"
 #include "http_download.h"
 #include "js_quickjs.h"
-
-/* File logging for emulator testing */
-static void log_to_file(const char *tag, const char *fmt, ...) {
-    static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-    static int log_fd = -1;
-    
-    pthread_mutex_lock(&log_mutex);
-    
-    if (log_fd < 0) {
-        log_fd = open("/data/data/com.bgmdwldr.vulkan/extract_debug.log", 
-                      O_WRONLY | O_CREAT | O_APPEND, 0644);
-    }
-    
-    if (log_fd >= 0) {
-        char buf[2048];
-        int n = snprintf(buf, sizeof(buf), "[%s] ", tag);
-        
-        va_list args;
-        va_start(args, fmt);
-        n += vsnprintf(buf + n, sizeof(buf) - n, fmt, args);
-        va_end(args);
-        
-        if (n < sizeof(buf) - 1) {
-            buf[n++] = '\n';
-        }
-        
-        write(log_fd, buf, n);
-        fsync(log_fd);
-    }
-    
-    pthread_mutex_unlock(&log_mutex);
-}
-
-// HTML Entity decoding helper - converts HTML entities to actual characters
-// Handles: &lt; &gt; &amp; &quot; &apos; &#123; (decimal) &#x7B; (hex)
-static int decode_html_entity(const char *input, char *output, size_t output_len) {
-    if (!input || !output || output_len == 0) return 0;
-    
-    const char *p = input;
-    char *out = output;
-    size_t remaining = output_len - 1;  // Reserve space for null terminator
-    
-    while (*p && remaining > 0) {
-        if (*p == '&') {
-            const char *end = strchr(p, ';');
-            if (end && end - p < 20) {  // Reasonable entity length
-                size_t entity_len = end - p - 1;  // Length without '&' and ';'
-                const char *entity = p + 1;
-                char decoded = 0;
-                int valid_entity = 0;
-                
-                // Named entities
-                if (strncmp(entity, "lt", entity_len) == 0 && entity_len == 2) {
-                    decoded = '<';
-                    valid_entity = 1;
-                } else if (strncmp(entity, "gt", entity_len) == 0 && entity_len == 2) {
-                    decoded = '>';
-                    valid_entity = 1;
-                } else if (strncmp(entity, "amp", entity_len) == 0 && entity_len == 3) {
-                    decoded = '&';
-                    valid_entity = 1;
-                } else if (strncmp(entity, "quot", entity_len) == 0 && entity_len == 4) {
-                    decoded = '"';
-                    valid_entity = 1;
-                } else if (strncmp(entity, "apos", entity_len) == 0 && entity_len == 4) {
-                    decoded = '\'';
-                    valid_entity = 1;
-                } else if (strncmp(entity, "nbsp", entity_len) == 0 && entity_len == 4) {
-                    decoded = ' ';
-                    valid_entity = 1;
-                }
-                // Numeric entities: &#123; (decimal)
-                else if (*entity == '#' && entity_len > 1) {
-                    const char *num_start = entity + 1;
-                    if (*num_start == 'x' || *num_start == 'X') {
-                        // Hex entity: &#x3b; or &#x7B;
-                        long val = strtol(num_start + 1, NULL, 16);
-                        if (val > 0 && val <= 0xFF) {
-                            decoded = (char)val;
-                            valid_entity = 1;
-                        }
-                    } else {
-                        // Decimal entity: &#59;
-                        long val = strtol(num_start, NULL, 10);
-                        if (val > 0 && val <= 0xFF) {
-                            decoded = (char)val;
-                            valid_entity = 1;
-                        }
-                    }
-                }
-                
-                if (valid_entity) {
-                    *out++ = decoded;
-                    remaining--;
-                    p = end + 1;  // Skip past the entity
-                    continue;
-                }
-            }
-        }
-        
-        // Not an entity or entity too long, copy as-is
-        *out++ = *p++;
-        remaining--;
-    }
-    
-    *out = '\0';
-    return (int)(out - output);
-}
-
-// Decode hex-escaped content (\x3b -> ;)
-// Handles \xNN format escape sequences commonly found in YouTube's JSON
-static int decode_hex_escapes(const char *input, char *output, size_t output_len) {
-    if (!input || !output || output_len == 0) return 0;
-    
-    const char *p = input;
-    char *out = output;
-    size_t remaining = output_len - 1;
-    
-    while (*p && remaining > 0) {
-        // Check for \xNN pattern (hex escape sequence)
-        if (*p == '\\' && *(p + 1) == 'x' && 
-            isxdigit((unsigned char)*(p + 2)) && 
-            isxdigit((unsigned char)*(p + 3))) {
-            // Decode hex value
-            int val1 = tolower((unsigned char)*(p + 2));
-            int val2 = tolower((unsigned char)*(p + 3));
-            int hex_val = ((val1 >= 'a' ? val1 - 'a' + 10 : val1 - '0') << 4) |
-                          (val2 >= 'a' ? val2 - 'a' + 10 : val2 - '0');
-            
-            // Accept any valid byte value (0x00-0xFF) that's not null
-            // This includes all printable ASCII, common symbols like = ; & %, etc.
-            if (hex_val != 0) {
-                *out++ = (char)hex_val;
-                remaining--;
-                p += 4;  // Skip entire \xNN sequence
-                continue;
-            }
-        }
-        
-        // Regular character copy
-        *out++ = *p++;
-        remaining--;
-    }
-    
-    *out = '\0';
-    return (int)(out - output);
-}
-
-// Full HTML unescape - combines entity and hex decoding
-static char* html_unescape(const char *input, size_t input_len) {
-    if (!input || input_len == 0) return NULL;
-    
-    // Allocate output buffer (same size as input, will be smaller or equal)
-    char *output = malloc(input_len + 1);
-    if (!output) return NULL;
-    
-    // First pass: decode HTML entities
-    char *temp = malloc(input_len + 1);
-    if (!temp) {
-        free(output);
-        return NULL;
-    }
-    
-    decode_html_entity(input, temp, input_len + 1);
-    
-    // Second pass: decode hex escapes
-    decode_hex_escapes(temp, output, input_len + 1);
-    
-    free(temp);
-    return output;
-}
-
-// UTF-8 validation and repair
-// Fixes common UTF-8 encoding issues like truncated sequences or invalid bytes
-static char* repair_utf8(const char *input, size_t input_len) {
-    if (!input || input_len == 0) return NULL;
-    
-    char *output = malloc(input_len + 1);
-    if (!output) return NULL;
-    
-    const uint8_t *p = (const uint8_t *)input;
-    char *out = output;
-    size_t remaining = input_len;
-    
-    while (remaining > 0) {
-        uint8_t c = *p;
-        
-        // Single-byte ASCII (0x00-0x7F)
-        if ((c & 0x80) == 0) {
-            *out++ = c;
-            p++;
-            remaining--;
-        }
-        // Two-byte sequence (0xC2-0xDF, 0x80-0xBF)
-        else if ((c & 0xE0) == 0xC0) {
-            if (remaining >= 2 && (p[1] & 0xC0) == 0x80) {
-                // Valid 2-byte sequence
-                *out++ = c;
-                *out++ = p[1];
-                p += 2;
-                remaining -= 2;
-            } else {
-                // Truncated or invalid, skip
-                p++;
-                remaining--;
-            }
-        }
-        // Three-byte sequence (0xE0-0xEF, 0x80-0xBF, 0x80-0xBF)
-        else if ((c & 0xF0) == 0xE0) {
-            if (remaining >= 3 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80) {
-                // Valid 3-byte sequence
-                *out++ = c;
-                *out++ = p[1];
-                *out++ = p[2];
-                p += 3;
-                remaining -= 3;
-            } else {
-                // Truncated or invalid, skip
-                p++;
-                remaining--;
-            }
-        }
-        // Four-byte sequence (0xF0-0xF4, 0x80-0xBF, 0x80-0xBF, 0x80-0xBF)
-        else if ((c & 0xF8) == 0xF0) {
-            if (remaining >= 4 && (p[1] & 0xC0) == 0x80 && 
-                (p[2] & 0xC0) == 0x80 && (p[3] & 0xC0) == 0x80) {
-                // Valid 4-byte sequence
-                *out++ = c;
-                *out++ = p[1];
-                *out++ = p[2];
-                *out++ = p[3];
-                p += 4;
-                remaining -= 4;
-            } else {
-                // Truncated or invalid, skip
-                p++;
-                remaining--;
-            }
-        }
-        // Invalid byte (continuation byte without start, or invalid start byte)
-        else {
-            // Skip invalid byte
-            p++;
-            remaining--;
-        }
-    }
-    
-    *out = '\0';
-    return output;
-}
-
-// Clean and decode extracted JSON content
-// Handles all three issues: HTML entities, hex escapes, and UTF-8 issues
-static char* clean_json_content(const char *input, size_t input_len) {
-    if (!input || input_len == 0) return NULL;
-    
-    // Step 1: Decode HTML entities and hex escapes
-    char *decoded = html_unescape(input, input_len);
-    if (!decoded) return NULL;
-    
-    // Step 2: Repair UTF-8 sequences
-    size_t decoded_len = strlen(decoded);
-    char *repaired = repair_utf8(decoded, decoded_len);
-    free(decoded);
-    
-    return repaired;
-}
+#include "job_arena.h"
+#include "html_tokenizer.h"
+#include "trace_log.h"
+#include "byte_scan.h"
 
 #define LOG_TAG "html_extract"
-#define LOG_INFO(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOG_ERROR(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-#define LOG_WARN(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOG_INFO(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
+#define LOG_WARN(...) TLOG_WARN(LOG_TAG, __VA_ARGS__)
 
 #define MAX_SCRIPT_URLS 32
 #define SCRIPT_URL_MAX_LEN 512
-#define MAX_SCRIPTS 64  // Total scripts (external + inline)
 #define MAX_HTML_SIZE (20 * 1024 * 1024)  // 20MB max for large YouTube pages with big JSON payloads
 
 // Script types
@@ -295,15 +30,55 @@ typedef enum {
     SCRIPT_TYPE_INLINE
 } ScriptType;
 
-// Script info with parse order tracking
+// How much a script matters for stream URL discovery
+typedef enum {
+    SCRIPT_RELEVANCE_REQUIRED,   // ytcfg, ytInitialPlayerResponse, player base.js
+    SCRIPT_RELEVANCE_OPTIONAL,   // Unknown - executed normally
+    SCRIPT_RELEVANCE_SKIPPABLE   // Ads, analytics (dropped), data payloads (deferred)
+} ScriptRelevance;
+
+#define SCRIPT_PAYLOAD_MIN_SIZE (256 * 1024)  // Unknown data assignments above this are skipped
+
+// Script info with parse order tracking. Strings live in the job arena
+// except fetched external content, which is heap owned (owns_content).
 typedef struct {
     int parse_order;           // Order in which script appears in HTML (0 = first)
     ScriptType type;           // External or inline
-    char url[SCRIPT_URL_MAX_LEN];  // For external scripts: URL to fetch
+    ScriptRelevance relevance; // Set by classify_script()
+    char *url;                 // For external scripts: URL to fetch ("" = invalid)
     char *content;             // For inline scripts: content; for external: fetched content
     size_t content_len;        // Length of content
+    bool owns_content;         // content must be freed by free_script_infos()
+    const char *payload_name;  // Global a deferred data payload defines (NULL = drop)
+    size_t payload_name_len;
+    struct ScriptPrefetch *prefetch; // Fetch started while the page downloaded
 } ScriptInfo;
 
+// Growable script list backed by the job arena
+typedef struct {
+    ScriptInfo *items;
+    int count;
+    int capacity;
+    JobArena *arena;
+} ScriptVec;
+
+// Returns a zeroed slot past the end; count is bumped by the caller once
+// the script is accepted
+static ScriptInfo *script_vec_next(ScriptVec *vec) {
+    if (vec->count == vec->capacity) {
+        int capacity = vec->capacity ? vec->capacity * 2 : 32;
+        ScriptInfo *items = job_arena_grow(vec->arena, vec->items,
+                                           vec->capacity * sizeof(ScriptInfo),
+                                           capacity * sizeof(ScriptInfo));
+        if (!items) return NULL;
+        vec->items = items;
+        vec->capacity = capacity;
+    }
+    ScriptInfo *script = &vec->items[vec->count];
+    memset(script, 0, sizeof(ScriptInfo));
+    return script;
+}
+
 // Media stream structure
 typedef struct MediaStream {
     char url[2048];
@@ -447,454 +222,616 @@ static bool parse_signature_cipher(const char *cipher_text, char *out_url, size_
 
 
 
-// Find the true end of a script tag, handling strings and comments
-// This prevents premature termination when </script> appears inside JS strings
-static const char* find_script_end(const char *content_start) {
-    if (!content_start) return NULL;
-    
-    const char *p = content_start;
-    bool in_string = false;
-    char string_char = 0;
-    bool escape = false;
-    int comment_state = 0;  // 0=none, 1=maybe single-line, 2=single-line, 3=maybe multi, 4=multi
-    
-    while (*p) {
-        // Handle comments
-        if (!in_string) {
-            if (comment_state == 0) {
-                if (*p == '/') {
-                    comment_state = 1;  // Maybe starting comment
-                }
-            } else if (comment_state == 1) {
-                if (*p == '/') {
-                    comment_state = 2;  // Single-line comment started
-                } else if (*p == '*') {
-                    comment_state = 4;  // Multi-line comment started
-                } else {
-                    comment_state = 0;  // Not a comment
-                }
-            } else if (comment_state == 2) {
-                if (*p == '\n') {
-                    comment_state = 0;  // End single-line comment
-                }
-            } else if (comment_state == 4) {
-                if (*p == '*') {
-                    comment_state = 3;  // Maybe ending multi-line
-                }
-            } else if (comment_state == 3) {
-                if (*p == '/') {
-                    comment_state = 0;  // End multi-line comment
-                } else if (*p != '*') {
-                    comment_state = 4;  // Still in multi-line comment
-                }
-            }
-            
-            // Check for </script> when not in string and not in comment
-            if (comment_state == 0 && *p == '<') {
-                if (strncasecmp(p, "</script>", 9) == 0) {
-                    return p;  // Found actual script end
-                }
-            }
-        }
-        
-        // Handle strings
-        if (comment_state == 0) {
-            if (escape) {
-                escape = false;
-            } else if (*p == '\\') {
-                escape = true;
-            } else if (!in_string) {
-                if (*p == '"' || *p == '\'' || *p == '`') {
-                    in_string = true;
-                    string_char = *p;
-                }
-            } else {
-                if (*p == string_char) {
-                    in_string = false;
-                    string_char = 0;
-                }
-            }
+// Free heap-owned script content; everything else goes with the job arena
+static void free_script_infos(ScriptInfo *scripts, int count) {
+    for (int i = 0; i < count; i++) {
+        if (scripts[i].owns_content && scripts[i].content) {
+            free(scripts[i].content);
         }
-        
-        p++;
+        scripts[i].content = NULL;
+        scripts[i].owns_content = false;
     }
-    
-    return NULL;  // No closing tag found
 }
 
-// Extract inline scripts from HTML (scripts without src attribute)
-// These contain initialization code like ytcfg, ytInitialData, etc.
-// NOTE: This function is kept for backward compatibility but not used by the new parse-order system.
-// Use extract_scripts_in_order() instead for proper script execution order.
-static int extract_inline_scripts(const char *html, char **out_scripts, int max_scripts) {
-    if (!html || !out_scripts || max_scripts <= 0) return 0;
+// Comparison function for qsort - sort by parse_order
+static int compare_script_info(const void *a, const void *b) {
+    const ScriptInfo *sa = (const ScriptInfo *)a;
+    const ScriptInfo *sb = (const ScriptInfo *)b;
+    return sa->parse_order - sb->parse_order;
+}
+
+// True if a script type attribute names JavaScript (an empty type does)
+static bool is_js_script_type(const HtmlTokenStream *tokens, const HtmlTokenAttr *type) {
+    static const char *const js_types[] = {
+        "text/javascript", "application/javascript", "module", NULL
+    };
+    if (!type || type->value.len == 0) return true;
     
-    int count = 0;
-    const char *p = html;
-    
-    while ((p = strstr(p, "<script")) != NULL && count < max_scripts) {
-        // Find end of opening tag properly (handling quotes)
-        const char *tag_start = p;
-        const char *tag_end = tag_start + 7; // Skip "<script"
-        bool in_quote = false;
-        char quote_char = 0;
-        
-        while (*tag_end) {
-            if (!in_quote) {
-                if (*tag_end == '"' || *tag_end == '\'') {
-                    in_quote = true;
-                    quote_char = *tag_end;
-                } else if (*tag_end == '>') {
-                    break;
-                }
-            } else {
-                if (*tag_end == quote_char) {
-                    in_quote = false;
-                }
-            }
-            tag_end++;
+    const char *value = html_span_ptr(tokens, type->value);
+    for (int i = 0; js_types[i]; i++) {
+        size_t len = strlen(js_types[i]);
+        if (type->value.len >= len && strncasecmp(value, js_types[i], len) == 0) {
+            return true;
         }
-        
-        if (*tag_end != '>') break; // No closing bracket found
-        
-        // Check for src= in the tag (must be outside quotes)
-        bool has_src = false;
-        const char *check = tag_start;
-        in_quote = false;
-        quote_char = 0;
-        
-        while (check < tag_end) {
-            if (!in_quote) {
-                if (*check == '"' || *check == '\'') {
-                    in_quote = true;
-                    quote_char = *check;
-                } else if (strncmp(check, "src=", 4) == 0) {
-                    has_src = true;
-                    break;
-                }
-            } else {
-                if (*check == quote_char) {
-                    in_quote = false;
-                }
+    }
+    return false;
+}
+
+// External script URLs that are needed to resolve stream URLs
+static const char *const g_required_script_urls[] = {
+    "/base.js",
+    "/player/",
+    "player_ias",
+    "www-player",
+    NULL
+};
+
+// External script URLs for ads, analytics and logging
+static const char *const g_skippable_script_urls[] = {
+    "googletagmanager.com",
+    "google-analytics.com",
+    "doubleclick.net",
+    "googlesyndication.com",
+    "googleadservices.com",
+    "/pagead/",
+    "adsbygoogle",
+    NULL
+};
+
+// Inline markers of scripts the player depends on
+static const char *const g_required_inline_markers[] = {
+    "ytcfg.set",
+    "var ytcfg",
+    "window.ytcfg",
+    "ytInitialPlayerResponse",
+    NULL
+};
+
+// Inline markers of ad and analytics bootstrap code
+static const char *const g_skippable_inline_markers[] = {
+    "googletag.cmd",
+    "(adsbygoogle",
+    "gtag('config'",
+    NULL
+};
+
+// Global data payloads that never contain stream information
+static const char *const g_data_payload_names[] = {
+    "ytInitialData",
+    "ytInitialGuideData",
+    "ytInitialReelWatchSequenceResponse",
+    NULL
+};
+
+// Inline scripts announce what they are near the top; marker checks look
+// no further, so multi-MB scripts cost one bounded pass
+#define SCRIPT_MARKER_SCAN_LEN (8 * 1024)
+
+// One pass over the script prefix for every inline marker. A required
+// marker anywhere in the prefix wins over a skippable one.
+static ScriptRelevance classify_inline_markers(const char *content, size_t len) {
+    static const char first_bytes[] = "yvwg(";
+    const char *end = content + (len < SCRIPT_MARKER_SCAN_LEN ? len : SCRIPT_MARKER_SCAN_LEN);
+    ScriptRelevance relevance = SCRIPT_RELEVANCE_OPTIONAL;
+    for (const char *p = content;
+         (p = byte_scan_any(p, end, first_bytes, sizeof(first_bytes) - 1)) < end; p++) {
+        for (int i = 0; g_required_inline_markers[i]; i++) {
+            size_t n = strlen(g_required_inline_markers[i]);
+            if ((size_t)(end - p) >= n && memcmp(p, g_required_inline_markers[i], n) == 0) {
+                return SCRIPT_RELEVANCE_REQUIRED;
             }
-            check++;
         }
-        
-        if (has_src) {
-            // This is an external script, skip
-            p = tag_end + 1;
-            continue;
-        }
-        
-        // Check for type="text/javascript" or no type (default)
-        bool is_js = true;
-        const char *type_attr = tag_start;
-        while ((type_attr = strstr(type_attr, "type=")) != NULL && type_attr < tag_end) {
-            // Check if this type= is inside quotes
-            bool type_in_quote = false;
-            char type_quote_char = 0;
-            for (const char *c = tag_start; c < type_attr; c++) {
-                if (!type_in_quote) {
-                    if (*c == '"' || *c == '\'') {
-                        type_in_quote = true;
-                        type_quote_char = *c;
-                    }
-                } else {
-                    if (*c == type_quote_char) {
-                        type_in_quote = false;
-                    }
-                }
+        for (int i = 0; relevance == SCRIPT_RELEVANCE_OPTIONAL && g_skippable_inline_markers[i]; i++) {
+            size_t n = strlen(g_skippable_inline_markers[i]);
+            if ((size_t)(end - p) >= n && memcmp(p, g_skippable_inline_markers[i], n) == 0) {
+                relevance = SCRIPT_RELEVANCE_SKIPPABLE;
             }
-            
-            if (!type_in_quote) {
-                // Check if it's JavaScript type
-                const char *type_val = type_attr + 5;
-                while (*type_val && isspace((unsigned char)*type_val)) type_val++;
-                char quote = *type_val;
-                if (quote == '"' || quote == '\'') {
-                    type_val++;
-                    if (strncmp(type_val, "text/javascript", 15) != 0 &&
-                        strncmp(type_val, "application/javascript", 22) != 0 &&
-                        strncmp(type_val, "module", 6) != 0) {
-                        // Not JavaScript, skip
-                        is_js = false;
-                        break;
-                    }
-                }
+        }
+    }
+    return relevance;
+}
+
+static bool contains_any(const char *haystack, const char *const *needles) {
+    for (int i = 0; needles[i]; i++) {
+        if (strstr(haystack, needles[i])) return true;
+    }
+    return false;
+}
+
+// Returns the position just past the object literal opening at s, or NULL if
+// it is not closed before end. Braces inside string literals don't count.
+static const char *skip_object_literal(const char *s, const char *end) {
+    int depth = 0;
+    while (s < end) {
+        char c = *s++;
+        if (c == '"' || c == '\'' || c == '`') {
+            while (s < end && *s != c) {
+                if (*s == '\\') s++;
+                s++;
             }
-            type_attr++;
+            if (s >= end) return NULL;
+            s++;
+        } else if (c == '{') {
+            depth++;
+        } else if (c == '}' && --depth == 0) {
+            return s;
         }
-        
-        if (!is_js) {
-            p = tag_end + 1;
-            continue;
+    }
+    return NULL;
+}
+
+// Parse a "var NAME =" or "window["NAME"] =" assignment of an object literal
+// that is the whole script, give or take a semicolon. Returns the name
+// length, 0 for any other script: one with more code after the literal must
+// run as it is.
+static size_t parse_payload_assignment(const char *s, const char *end, const char **name_out) {
+    while (isspace((unsigned char)*s)) s++;
+
+    const char *name = NULL;
+    size_t len = 0;
+    if (strncmp(s, "var ", 4) == 0) {
+        s += 4;
+        while (isspace((unsigned char)*s)) s++;
+        name = s;
+        while (isalnum((unsigned char)*s) || *s == '_' || *s == '$') s++;
+        len = s - name;
+    } else if (strncmp(s, "window[\"", 8) == 0 || strncmp(s, "window['", 8) == 0) {
+        char quote = s[7];
+        s += 8;
+        name = s;
+        while (*s && *s != quote) s++;
+        len = s - name;
+        if (*s != quote || s[1] != ']') return 0;
+        s += 2;
+    } else {
+        return 0;
+    }
+
+    while (isspace((unsigned char)*s)) s++;
+    if (*s != '=') return 0;
+    s++;
+    while (isspace((unsigned char)*s)) s++;
+    if (*s != '{') return 0;
+
+    s = skip_object_literal(s, end);
+    if (!s) return 0;
+    while (s < end && (isspace((unsigned char)*s) || *s == ';')) s++;
+    if (s != end) return 0;
+
+    *name_out = name;
+    return len;
+}
+
+static bool name_in_list(const char *name, size_t len, const char *const *list) {
+    for (int i = 0; list[i]; i++) {
+        if (strlen(list[i]) == len && strncmp(name, list[i], len) == 0) return true;
+    }
+    return false;
+}
+
+// Classify a script by URL (external) or content and size (inline).
+// External scripts are classified before they are fetched so skippable
+// ones never hit the network.
+static void classify_script(ScriptInfo *script) {
+    script->relevance = SCRIPT_RELEVANCE_OPTIONAL;
+    script->payload_name = NULL;
+    script->payload_name_len = 0;
+
+    if (script->type == SCRIPT_TYPE_EXTERNAL) {
+        if (contains_any(script->url, g_required_script_urls)) {
+            script->relevance = SCRIPT_RELEVANCE_REQUIRED;
+        } else if (contains_any(script->url, g_skippable_script_urls)) {
+            script->relevance = SCRIPT_RELEVANCE_SKIPPABLE;
         }
-        
-        // Find the closing </script> tag using robust parser (handles strings)
-        const char *content_start = tag_end + 1;
-        const char *script_end = find_script_end(content_start);
-        
-        if (!script_end) {
-            LOG_WARN("No closing </script> tag found");
-            break;
+        return;
+    }
+
+    if (!script->content) return;
+
+    const char *name = NULL;
+    size_t name_len = parse_payload_assignment(script->content,
+                                               script->content + script->content_len, &name);
+    if (name_len > 0) {
+        if (name_len == 23 && strncmp(name, "ytInitialPlayerResponse", 23) == 0) {
+            script->relevance = SCRIPT_RELEVANCE_REQUIRED;
+            return;
         }
-        
-        size_t content_len = script_end - content_start;
-        
-        // Skip empty scripts or very short ones
-        if (content_len < 50) {
-            p = script_end + 9;
-            continue;
+        if (name_in_list(name, name_len, g_data_payload_names) ||
+            script->content_len >= SCRIPT_PAYLOAD_MIN_SIZE) {
+            // Deferred rather than dropped: the global is defined and the
+            // script runs if anything reads it
+            script->relevance = SCRIPT_RELEVANCE_SKIPPABLE;
+            script->payload_name = name;
+            script->payload_name_len = name_len;
+            return;
         }
-        
-        // Extract the script content with proper handling for large scripts
-        char *script = malloc(content_len + 1);
-        if (script) {
-            memcpy(script, content_start, content_len);
-            script[content_len] = '\0';
-            
-            // Only keep script if it has meaningful content
-            if (content_len > 50) {
-                out_scripts[count] = script;
-                LOG_INFO("Extracted inline script %d: %zu bytes", count, content_len);
-                count++;
-            } else {
-                free(script);
-            }
-        } else {
-            LOG_ERROR("Failed to allocate %zu bytes for script", content_len + 1);
+    }
+
+    script->relevance = classify_inline_markers(script->content, script->content_len);
+}
+
+// External scripts fetched during a batch, reused by later pages that load
+// the same URL (player base.js, polymer bundles). Only touched from the
+// worker thread running the batch.
+#define SCRIPT_CACHE_MAX 8
+
+typedef struct {
+    char url[SCRIPT_URL_MAX_LEN];
+    char *content;
+    size_t content_len;
+} CachedScript;
+
+static CachedScript g_script_cache[SCRIPT_CACHE_MAX];
+static int g_script_cache_count = 0;
+static bool g_script_cache_enabled = false;
+
+void html_extract_batch_begin(void) {
+    g_script_cache_enabled = true;
+}
+
+void html_extract_batch_end(void) {
+    for (int i = 0; i < g_script_cache_count; i++) {
+        free(g_script_cache[i].content);
+        g_script_cache[i].content = NULL;
+    }
+    g_script_cache_count = 0;
+    g_script_cache_enabled = false;
+}
+
+static bool script_cache_get(ScriptInfo *script) {
+    if (!g_script_cache_enabled) return false;
+    for (int i = 0; i < g_script_cache_count; i++) {
+        if (strcmp(g_script_cache[i].url, script->url) == 0) {
+            // Shared with the cache, which outlives the job
+            script->content = g_script_cache[i].content;
+            script->owns_content = false;
+            script->content_len = g_script_cache[i].content_len;
+            LOG_INFO("Reusing cached script [%d]: %zu bytes",
+                     script->parse_order, script->content_len);
+            return true;
         }
-        
-        p = script_end + 9;
     }
-    
-    LOG_INFO("Extracted %d inline initialization scripts", count);
-    return count;
+    return false;
 }
 
-// Free script info array
-static void free_script_infos(ScriptInfo *scripts, int count) {
+static void script_cache_put(const ScriptInfo *script) {
+    if (!g_script_cache_enabled || g_script_cache_count >= SCRIPT_CACHE_MAX) return;
+    if (strlen(script->url) >= SCRIPT_URL_MAX_LEN) return;
+    char *copy = malloc(script->content_len + 1);
+    if (!copy) return;
+    memcpy(copy, script->content, script->content_len);
+    copy[script->content_len] = '\0';
+
+    CachedScript *entry = &g_script_cache[g_script_cache_count++];
+    snprintf(entry->url, sizeof(entry->url), "%s", script->url);
+    entry->content = copy;
+    entry->content_len = script->content_len;
+}
+
+// External scripts fetched on helper threads while the rest of the page is
+// still downloading. The thread only touches its own slot; the result is
+// validated and cached by fetch_external_script() on the extracting thread.
+#define SCRIPT_PREFETCH_MAX 8
+
+typedef struct ScriptPrefetch {
+    pthread_t thread;
+    const char *url;
+    HttpBuffer buffer;
+    bool ok;
+    char error[256];
+} ScriptPrefetch;
+
+static void *script_prefetch_main(void *arg) {
+    ScriptPrefetch *prefetch = arg;
+    prefetch->ok = http_get_to_memory(prefetch->url, &prefetch->buffer,
+                                      prefetch->error, sizeof(prefetch->error));
+    return NULL;
+}
+
+static void script_prefetch_start(ScriptInfo *script, JobArena *arena) {
+    ScriptPrefetch *prefetch = job_arena_alloc(arena, sizeof(ScriptPrefetch));
+    if (!prefetch) return;
+    memset(prefetch, 0, sizeof(ScriptPrefetch));
+    prefetch->url = script->url;
+    if (pthread_create(&prefetch->thread, NULL, script_prefetch_main, prefetch) != 0) {
+        LOG_WARN("Could not start prefetch for script [%d]", script->parse_order);
+        return;
+    }
+    script->prefetch = prefetch;
+    LOG_INFO("Prefetching external script [%d]: %.80s", script->parse_order, script->url);
+}
+
+// Waits for a prefetch and hands its response over; false if none was started
+static bool script_prefetch_take(ScriptInfo *script, HttpBuffer *buffer,
+                                 char *error, size_t error_len) {
+    ScriptPrefetch *prefetch = script->prefetch;
+    if (!prefetch) return false;
+    pthread_join(prefetch->thread, NULL);
+    script->prefetch = NULL;
+    *buffer = prefetch->buffer;
+    snprintf(error, error_len, "%s", prefetch->error);
+    if (!prefetch->ok && buffer->data) http_free_buffer(buffer);
+    return true;
+}
+
+// Joins prefetches nobody consumed (the page failed before execution)
+static void script_prefetch_join_all(ScriptInfo *scripts, int count) {
     for (int i = 0; i < count; i++) {
-        if (scripts[i].content) {
-            free(scripts[i].content);
-            scripts[i].content = NULL;
+        HttpBuffer buffer;
+        char error[256];
+        if (script_prefetch_take(&scripts[i], &buffer, error, sizeof(error)) && buffer.data) {
+            http_free_buffer(&buffer);
         }
     }
 }
 
-// Comparison function for qsort - sort by parse_order
-static int compare_script_info(const void *a, const void *b) {
-    const ScriptInfo *sa = (const ScriptInfo *)a;
-    const ScriptInfo *sb = (const ScriptInfo *)b;
-    return sa->parse_order - sb->parse_order;
+// Fetch an external script's content. On failure or when the response is an
+// HTML page, the script's URL is cleared to mark it invalid.
+static void fetch_external_script(ScriptInfo *script) {
+    if (script->content) return;  // Cache hit at extraction time
+    if (script_cache_get(script)) return;
+
+    HttpBuffer buffer;
+    memset(&buffer, 0, sizeof(HttpBuffer));
+
+    char error[256];
+    error[0] = '\0';
+
+    bool result;
+    if (script->prefetch) {
+        script_prefetch_take(script, &buffer, error, sizeof(error));
+        result = buffer.data != NULL;
+    } else {
+        LOG_INFO("Fetching external script [%d]: %.80s",
+                 script->parse_order, script->url);
+        result = http_get_to_memory(script->url, &buffer, error, sizeof(error));
+    }
+    if (result && buffer.data && buffer.size > 0) {
+        // Validate it's actually JavaScript, not HTML
+        const char *content = buffer.data;
+        while (*content && (isspace((unsigned char)*content) ||
+               (unsigned char)*content == 0xEF ||
+               (unsigned char)*content == 0xBB ||
+               (unsigned char)*content == 0xBF)) {
+            content++;
+        }
+
+        bool is_html = (strncasecmp(content, "<!doctype", 9) == 0 ||
+                       strncasecmp(content, "<html", 5) == 0 ||
+                       strncasecmp(content, "<?xml", 5) == 0);
+
+        if (is_html) {
+            LOG_WARN("Script [%d] is HTML not JS, skipping", script->parse_order);
+            http_free_buffer(&buffer);
+            script->url[0] = '\0';  // Mark as invalid
+        } else {
+            script->content = buffer.data;
+            script->content_len = buffer.size;
+            script->owns_content = true;
+            LOG_INFO("Loaded external script [%d]: %zu bytes",
+                     script->parse_order, buffer.size);
+            script_cache_put(script);
+        }
+    } else {
+        LOG_WARN("Failed to fetch script [%d]: %s", script->parse_order, error);
+        if (buffer.data) http_free_buffer(&buffer);
+        script->url[0] = '\0';  // Mark as invalid
+    }
 }
 
-// Extract all scripts (both external and inline) in parse order
-// Returns number of scripts found, fills the scripts array
-static int extract_scripts_in_order(const char *html, ScriptInfo *scripts, int max_scripts) {
-    if (!html || !scripts || max_scripts <= 0) return 0;
+// Turns script tokens into ScriptInfo entries in parse order. Fed one token
+// at a time, so it works the same on a finished stream and on one that is
+// still being tokenized from the network. Every script is classified as soon
+// as it is complete; with prefetch set, external scripts worth running start
+// downloading the moment their tag is seen.
+typedef struct {
+    ScriptVec *scripts;
+    int parse_order;
+    bool expect_body;   // Last token was an inline <script> start tag
+    bool stopped;       // Unterminated inline script, nothing after it counts
+    bool prefetch;
+    int prefetch_count;
+} ScriptExtractor;
+
+static void script_extractor_init(ScriptExtractor *ex, ScriptVec *scripts, bool prefetch) {
+    memset(ex, 0, sizeof(ScriptExtractor));
+    ex->scripts = scripts;
+    ex->prefetch = prefetch;
+}
+
+static void add_external_script(ScriptExtractor *ex, const char *src_start, size_t src_len) {
+    ScriptVec *scripts = ex->scripts;
+    
+    // External script - convert relative to absolute URL
+    char url[SCRIPT_URL_MAX_LEN + 32];
+    if (src_len >= 2 && strncmp(src_start, "//", 2) == 0) {
+        snprintf(url, sizeof(url), "https:%.*s", (int)src_len, src_start);
+    } else if (src_start[0] == '/') {
+        snprintf(url, sizeof(url), "https://www.youtube.com%.*s", (int)src_len, src_start);
+    } else if (src_len >= 4 && strncmp(src_start, "http", 4) == 0) {
+        snprintf(url, sizeof(url), "%.*s", (int)src_len, src_start);
+    } else {
+        // Skip non-HTTP URLs
+        return;
+    }
     
-    int count = 0;
-    int parse_order = 0;
-    const char *p = html;
+    ScriptInfo *script = script_vec_next(scripts);
+    if (!script) {
+        LOG_ERROR("Out of memory growing script list");
+        ex->stopped = true;
+        return;
+    }
+    script->url = job_arena_strndup(scripts->arena, url, strlen(url));
+    if (!script->url) {
+        LOG_ERROR("Out of memory copying script URL");
+        ex->stopped = true;
+        return;
+    }
+    script->parse_order = ex->parse_order++;
+    script->type = SCRIPT_TYPE_EXTERNAL;
+    classify_script(script);
+    
+    LOG_INFO("Found external script [%d]: %.80s...", 
+             script->parse_order, script->url);
+    scripts->count++;
+    
+    if (ex->prefetch && script->relevance != SCRIPT_RELEVANCE_SKIPPABLE &&
+        ex->prefetch_count < SCRIPT_PREFETCH_MAX && !script_cache_get(script)) {
+        script_prefetch_start(script, scripts->arena);
+        if (script->prefetch) ex->prefetch_count++;
+    }
+}
+
+static void add_inline_script(ScriptExtractor *ex, const HtmlTokenStream *tokens,
+                              const HtmlToken *body) {
+    ScriptVec *scripts = ex->scripts;
+    
+    // The tokenizer already found the closing </script>, skipping any that
+    // appear inside JS strings or comments
+    if (body->flags & HTML_TOKEN_UNTERMINATED) {
+        LOG_WARN("No closing </script> tag found");
+        ex->stopped = true;
+        return;
+    }
     
-    while ((p = strstr(p, "<script")) != NULL && count < max_scripts) {
-        const char *tag_start = p;
-        const char *tag_end = tag_start + 7; // Skip "<script"
-        
-        // Find end of opening tag properly (handling quotes)
-        bool in_quote = false;
-        char quote_char = 0;
-        while (*tag_end) {
-            if (!in_quote) {
-                if (*tag_end == '"' || *tag_end == '\'') {
-                    in_quote = true;
-                    quote_char = *tag_end;
-                } else if (*tag_end == '>') {
-                    break;
-                }
-            } else {
-                if (*tag_end == quote_char) {
-                    in_quote = false;
-                }
-            }
-            tag_end++;
+    size_t content_len = body->span.len;
+    
+    // Skip empty scripts or very short ones
+    if (content_len < 50) {
+        return;
+    }
+    
+    // Warn about very large scripts but still process them
+    if (content_len > 500000) {
+        LOG_INFO("Found large inline script: %zu bytes (may be data payload)", content_len);
+    }
+    
+    ScriptInfo *script = script_vec_next(scripts);
+    if (!script) {
+        LOG_ERROR("Out of memory growing script list");
+        ex->stopped = true;
+        return;
+    }
+    
+    // Copy into the job arena (JS_Eval needs a NUL-terminated buffer, and a
+    // streaming tokenizer's source moves as it grows); large payloads get a
+    // block of their own
+    char *script_content = job_arena_strndup(scripts->arena,
+                                             html_span_ptr(tokens, body->span),
+                                             content_len);
+    if (!script_content) {
+        LOG_ERROR("Failed to allocate %zu bytes for script content", content_len + 1);
+        return;
+    }
+    
+    script->url = "";
+    script->parse_order = ex->parse_order++;
+    script->type = SCRIPT_TYPE_INLINE;
+    script->content = script_content;
+    script->content_len = content_len;
+    classify_script(script);
+    
+    LOG_INFO("Found inline script [%d]: %zu bytes", 
+             script->parse_order, content_len);
+    scripts->count++;
+}
+
+static void script_extractor_token(ScriptExtractor *ex, const HtmlTokenStream *tokens,
+                                   uint32_t index) {
+    if (ex->stopped) return;
+    const HtmlToken *tok = &tokens->tokens[index];
+    
+    if (ex->expect_body) {
+        // The tokenizer always emits the script body right after the tag
+        ex->expect_body = false;
+        if (tok->type == HTML_TOKEN_RAW_TEXT) {
+            add_inline_script(ex, tokens, tok);
+            return;
         }
-        
-        if (*tag_end != '>') break; // No closing bracket found
-        
-        // Check for type attribute - must be JavaScript or module
-        bool is_js = true;
-        bool has_src = false;
-        const char *src_start = NULL;
-        size_t src_len = 0;
-        
-        // Parse attributes within the tag
-        const char *attr = tag_start + 7;  // After "<script"
-        while (attr < tag_end) {
-            // Skip whitespace
-            while (attr < tag_end && isspace((unsigned char)*attr)) attr++;
-            if (attr >= tag_end) break;
-            
-            // Check for src attribute
-            if (strncasecmp(attr, "src=", 4) == 0) {
-                has_src = true;
-                attr += 4;
-                while (attr < tag_end && isspace((unsigned char)*attr)) attr++;
-                if (attr < tag_end) {
-                    char quote = *attr;
-                    if (quote == '"' || quote == '\'') {
-                        attr++;  // Skip quote
-                        src_start = attr;
-                        const char *end = strchr(attr, quote);
-                        if (end && end < tag_end) {
-                            src_len = end - attr;
-                            attr = end + 1;
-                        }
-                    } else {
-                        // Unquoted src
-                        src_start = attr;
-                        while (attr < tag_end && !isspace((unsigned char)*attr)) attr++;
-                        src_len = attr - src_start;
-                    }
-                }
-                continue;
-            }
-            
-            // Check for type attribute
-            if (strncasecmp(attr, "type=", 5) == 0) {
-                attr += 5;
-                while (attr < tag_end && isspace((unsigned char)*attr)) attr++;
-                if (attr < tag_end) {
-                    char quote = *attr;
-                    if (quote == '"' || quote == '\'') {
-                        attr++;
-                        const char *type_val = attr;
-                        const char *end = strchr(attr, quote);
-                        if (end && end < tag_end) {
-                            size_t type_len = end - type_val;
-                            // Check if it's a valid JS type
-                            if (type_len > 0 &&
-                                strncasecmp(type_val, "text/javascript", 15) != 0 &&
-                                strncasecmp(type_val, "application/javascript", 22) != 0 &&
-                                strncasecmp(type_val, "module", 6) != 0) {
-                                is_js = false;
-                            }
-                            attr = end + 1;
-                        }
-                    }
-                }
-                continue;
+    }
+    if (tok->type != HTML_TOKEN_START_TAG || strcmp(tok->name, "script") != 0) return;
+    
+    // Check for type attribute - must be JavaScript or module
+    if (!is_js_script_type(tokens, html_token_find_attr(tokens, tok, "type"))) {
+        return;
+    }
+    
+    const HtmlTokenAttr *src = html_token_find_attr(tokens, tok, "src");
+    size_t src_len = src ? src->value.len : 0;
+    if (src_len > 0 && src_len < SCRIPT_URL_MAX_LEN) {
+        add_external_script(ex, html_span_ptr(tokens, src->value), src_len);
+    } else {
+        ex->expect_body = true;
+    }
+}
+
+// Extract all scripts (both external and inline) in parse order from the
+// page's token stream. Returns number of scripts found, appends to the script vector
+static int extract_scripts_in_order(const HtmlTokenStream *tokens, ScriptVec *scripts) {
+    if (!tokens || !scripts || !scripts->arena) return 0;
+    
+    ScriptExtractor ex;
+    script_extractor_init(&ex, scripts, false);
+    for (uint32_t i = 0; i < tokens->count && !ex.stopped; i++) {
+        script_extractor_token(&ex, tokens, i);
+    }
+    
+    LOG_INFO("Extracted %d scripts in parse order", scripts->count);
+    return scripts->count;
+}
+
+// Build execution arrays in parse order (scripts are stored in parse order,
+// the arrays must hold script_count entries). With filter set, skippable
+// scripts are left out; data payloads among them are deferred on the
+// runtime instead. Returns the number of entries and stores how many
+// scripts were filtered out in skipped_out.
+static int build_exec_list(const ScriptInfo *scripts, int script_count, bool filter,
+                           const char **exec_scripts, size_t *exec_script_lens,
+                           int *skipped_out) {
+    int exec_count = 0;
+    int skipped = 0;
+
+    for (int i = 0; i < script_count; i++) {
+        const ScriptInfo *script = &scripts[i];
+        if (filter && script->relevance == SCRIPT_RELEVANCE_SKIPPABLE) {
+            skipped++;
+            if (script->payload_name &&
+                !js_quickjs_defer_payload(script->payload_name, script->payload_name_len,
+                                          script->content, script->content_len)) {
+                LOG_WARN("Could not defer payload %.*s", (int)script->payload_name_len,
+                         script->payload_name);
             }
-            
-            // Skip to next attribute
-            attr++;
+            continue;
         }
-        
-        if (!is_js) {
-            p = tag_end + 1;
+        // Skip invalid or not yet fetched external scripts
+        if (script->type == SCRIPT_TYPE_EXTERNAL &&
+            (script->url[0] == '\0' || !script->content)) {
             continue;
         }
-        
-        if (has_src && src_start && src_len > 0 && src_len < SCRIPT_URL_MAX_LEN) {
-            // External script
-            strncpy(scripts[count].url, src_start, src_len);
-            scripts[count].url[src_len] = '\0';
-            
-            // Convert relative to absolute URL
-            if (strncmp(scripts[count].url, "//", 2) == 0) {
-                char temp[SCRIPT_URL_MAX_LEN];
-                snprintf(temp, sizeof(temp), "https:%s", scripts[count].url);
-                strcpy(scripts[count].url, temp);
-            } else if (scripts[count].url[0] == '/') {
-                char temp[SCRIPT_URL_MAX_LEN];
-                snprintf(temp, sizeof(temp), "https://www.youtube.com%s", scripts[count].url);
-                strcpy(scripts[count].url, temp);
-            } else if (strncmp(scripts[count].url, "http", 4) != 0) {
-                // Skip non-HTTP URLs
-                p = tag_end + 1;
-                continue;
-            }
-            
-            scripts[count].parse_order = parse_order++;
-            scripts[count].type = SCRIPT_TYPE_EXTERNAL;
-            scripts[count].content = NULL;
-            scripts[count].content_len = 0;
-            
-            LOG_INFO("Found external script [%d]: %.80s...", 
-                     scripts[count].parse_order, scripts[count].url);
-            count++;
-            p = tag_end + 1;
-            
-        } else {
-            // Inline script - find the closing </script> tag
-            const char *content_start = tag_end + 1;
-            
-            // Use robust script end finder that handles strings with </script>
-            const char *script_end = find_script_end(content_start);
-            
-            if (!script_end) {
-                LOG_WARN("No closing </script> tag found");
-                break;
-            }
-            
-            size_t content_len = script_end - content_start;
-            
-            // Skip empty scripts or very short ones
-            if (content_len < 50) {
-                p = script_end + 9;
-                continue;
-            }
-            
-            // Warn about very large scripts but still process them
-            if (content_len > 500000) {
-                LOG_INFO("Found large inline script: %zu bytes (may be data payload)", content_len);
-            }
-            
-            // Extract the script content with proper size handling for large payloads
-            char *script_content = NULL;
-            
-            // For very large scripts, verify we can allocate the memory
-            if (content_len > 1000000) {
-                // Try to allocate, if it fails, skip this script
-                script_content = malloc(content_len + 1);
-                if (!script_content) {
-                    LOG_ERROR("Failed to allocate %zu bytes for script content", content_len + 1);
-                    p = script_end + 9;
-                    continue;
-                }
-            } else {
-                script_content = malloc(content_len + 1);
-                if (!script_content) {
-                    LOG_ERROR("Failed to allocate %zu bytes for script content", content_len + 1);
-                    p = script_end + 9;
-                    continue;
-                }
-            }
-            
-            memcpy(script_content, content_start, content_len);
-            script_content[content_len] = '\0';
-            
-            scripts[count].url[0] = '\0';
-            scripts[count].parse_order = parse_order++;
-            scripts[count].type = SCRIPT_TYPE_INLINE;
-            scripts[count].content = script_content;
-            scripts[count].content_len = content_len;
-            
-            LOG_INFO("Found inline script [%d]: %zu bytes", 
-                     scripts[count].parse_order, content_len);
-            count++;
-            
-            p = script_end + 9;
+        // Skip empty inline scripts
+        if (script->type == SCRIPT_TYPE_INLINE &&
+            (!script->content || script->content_len == 0)) {
+            continue;
         }
+        exec_scripts[exec_count] = script->content;
+        exec_script_lens[exec_count] = script->content_len;
+        exec_count++;
+    }
+
+    if (skipped_out) *skipped_out = skipped;
+    return exec_count;
+}
+
+static int count_media_urls(const JsExecResult *js_result) {
+    int count = 0;
+    for (int i = 0; i < js_result->captured_url_count; i++) {
+        if (strstr(js_result->captured_urls[i].ptr, "googlevideo.com")) count++;
     }
-    
-    LOG_INFO("Extracted %d scripts in parse order", count);
     return count;
 }
 
 // Extract YouTube video ID from URL
-static bool extract_yt_video_id(const char *url, char *out_id, size_t out_len) {
+bool html_extract_yt_video_id(const char *url, char *out_id, size_t out_len) {
     if (!url || !out_id || out_len == 0) return false;
     
     const char *patterns[] = {
@@ -925,119 +862,85 @@ static bool extract_yt_video_id(const char *url, char *out_id, size_t out_len) {
     return false;
 }
 
-// Execute player scripts and get captured URLs
-// Returns number of URLs captured, fills urls array
-static int execute_scripts_and_get_urls(const char *html, char urls[][2048], int max_urls) {
-    if (!html || !urls || max_urls <= 0) return 0;
+// Run a page's extracted and classified scripts and get captured URLs.
+// Returns number of media URLs captured. *out_urls is allocated from the job
+// arena and views the capture arena; both stay valid until the next page.
+static int run_scripts_and_get_urls(HtmlTokenStream *tokens, ScriptVec *script_vec,
+                                    JobArena *arena, const StrView **out_urls) {
+    *out_urls = NULL;
     
     LOG_INFO("Executing player scripts to capture URLs...");
     
-    // Extract all scripts in parse order
-    ScriptInfo scripts[MAX_SCRIPTS];
-    memset(scripts, 0, sizeof(scripts));
-    int script_count = extract_scripts_in_order(html, scripts, MAX_SCRIPTS);
+    int script_count = script_vec->count;
+    ScriptInfo *scripts = script_vec->items;
     
     if (script_count == 0) {
         LOG_ERROR("No scripts found in HTML");
         return 0;
     }
     
+    // The runtime may be warm from a previous page: give this one clean
+    // globals, or at least only count its URLs
+    if (js_quickjs_context_used()) {
+        if (!js_quickjs_reset_context()) {
+            LOG_ERROR("No fresh context for this page");
+            free_script_infos(scripts, script_count);
+            return 0;
+        }
+    } else {
+        js_quickjs_clear_captured_urls();
+    }
+    
     LOG_INFO("Found %d scripts to execute", script_count);
     
-    // Fetch external scripts
+    int relevance_counts[3] = {0, 0, 0};
     for (int i = 0; i < script_count; i++) {
-        if (scripts[i].type == SCRIPT_TYPE_EXTERNAL) {
-            HttpBuffer buffer;
-            memset(&buffer, 0, sizeof(HttpBuffer));
-            
-            char error[256];
-            LOG_INFO("Fetching external script [%d]: %.80s", 
-                     scripts[i].parse_order, scripts[i].url);
-            
-            bool result = http_get_to_memory(scripts[i].url, &buffer, error, sizeof(error));
-            if (result && buffer.data && buffer.size > 0) {
-                // Validate it's actually JavaScript, not HTML
-                const char *content = buffer.data;
-                while (*content && (isspace((unsigned char)*content) || 
-                       (unsigned char)*content == 0xEF || 
-                       (unsigned char)*content == 0xBB || 
-                       (unsigned char)*content == 0xBF)) {
-                    content++;
-                }
-                
-                bool is_html = (strncasecmp(content, "<!doctype", 9) == 0 ||
-                               strncasecmp(content, "<html", 5) == 0 ||
-                               strncasecmp(content, "<?xml", 5) == 0);
-                
-                if (is_html) {
-                    LOG_WARN("Script [%d] is HTML not JS, skipping", scripts[i].parse_order);
-                    http_free_buffer(&buffer);
-                    scripts[i].url[0] = '\0';  // Mark as invalid
-                } else {
-                    scripts[i].content = buffer.data;
-                    scripts[i].content_len = buffer.size;
-                    LOG_INFO("Loaded external script [%d]: %zu bytes", 
-                             scripts[i].parse_order, buffer.size);
-                }
-            } else {
-                LOG_WARN("Failed to fetch script [%d]: %s", scripts[i].parse_order, error);
-                if (buffer.data) http_free_buffer(&buffer);
-                scripts[i].url[0] = '\0';  // Mark as invalid
-            }
+        relevance_counts[scripts[i].relevance]++;
+    }
+    LOG_INFO("Script relevance: %d required, %d optional, %d skippable",
+             relevance_counts[SCRIPT_RELEVANCE_REQUIRED],
+             relevance_counts[SCRIPT_RELEVANCE_OPTIONAL],
+             relevance_counts[SCRIPT_RELEVANCE_SKIPPABLE]);
+    
+    // Fetch external scripts (skippable ones only if we fall back)
+    for (int i = 0; i < script_count; i++) {
+        if (scripts[i].type == SCRIPT_TYPE_EXTERNAL &&
+            scripts[i].relevance != SCRIPT_RELEVANCE_SKIPPABLE) {
+            fetch_external_script(&scripts[i]);
         }
     }
     
     // Build execution arrays
-    const char *exec_scripts[MAX_SCRIPTS];
-    size_t exec_script_lens[MAX_SCRIPTS];
-    int exec_count = 0;
-    
-    for (int i = 0; i < script_count && exec_count < MAX_SCRIPTS; i++) {
-        for (int j = 0; j < script_count; j++) {
-            if (scripts[j].parse_order == i) {
-                // Skip invalid external scripts
-                if (scripts[j].type == SCRIPT_TYPE_EXTERNAL && scripts[j].url[0] == '\0') {
-                    break;
-                }
-                // Skip empty inline scripts
-                if (scripts[j].type == SCRIPT_TYPE_INLINE && 
-                    (!scripts[j].content || scripts[j].content_len == 0)) {
-                    break;
-                }
-                exec_scripts[exec_count] = scripts[j].content;
-                exec_script_lens[exec_count] = scripts[j].content_len;
-                exec_count++;
-                break;
-            }
-        }
+    const char **exec_scripts = job_arena_alloc(arena, script_count * sizeof(const char *));
+    size_t *exec_script_lens = job_arena_alloc(arena, script_count * sizeof(size_t));
+    if (!exec_scripts || !exec_script_lens) {
+        LOG_ERROR("Out of memory building execution list");
+        free_script_infos(scripts, script_count);
+        return 0;
     }
+    int skipped_count = 0;
+    int exec_count = build_exec_list(scripts, script_count, true,
+                                     exec_scripts, exec_script_lens, &skipped_count);
     
-    if (exec_count == 0) {
+    if (exec_count == 0 && skipped_count == 0) {
         LOG_ERROR("No valid scripts to execute");
         free_script_infos(scripts, script_count);
         return 0;
     }
     
-    LOG_INFO("Executing %d scripts...", exec_count);
-    log_to_file("html_media", "Executing %d scripts...", exec_count);
+    LOG_INFO("Executing %d scripts (%d skipped)...", exec_count, skipped_count);
     
-    // Check for ytcfg usage patterns in each script
-    for (int i = 0; i < exec_count; i++) {
-        if (exec_scripts[i] && exec_script_lens[i] > 0) {
-            if (strstr(exec_scripts[i], "ytcfg.set") || strstr(exec_scripts[i], "ytcfg.get")) {
-                LOG_INFO("Script %d uses ytcfg (len=%zu)", i, exec_script_lens[i]);
-            }
+    // Which scripts touch ytcfg, and the first 100 chars of each. The
+    // strstr calls walk every script, so only when debug logging is on.
+    if (TLOG_ENABLED(TLOG_LEVEL_DEBUG)) {
+        for (int i = 0; i < exec_count; i++) {
+            if (!exec_scripts[i] || exec_script_lens[i] == 0) continue;
             if (strstr(exec_scripts[i], "var ytcfg=") || strstr(exec_scripts[i], "window.ytcfg=")) {
-                LOG_INFO("Script %d DEFINES ytcfg (len=%zu)", i, exec_script_lens[i]);
-                // Log the full ytcfg definition script for debugging
-                LOG_INFO("Script %d FULL CONTENT:\n%.*s", i, (int)exec_script_lens[i], exec_scripts[i]);
+                TLOG_DEBUG(LOG_TAG, "Script %d DEFINES ytcfg (len=%zu)", i, exec_script_lens[i]);
+            } else if (strstr(exec_scripts[i], "ytcfg.set") || strstr(exec_scripts[i], "ytcfg.get")) {
+                TLOG_DEBUG(LOG_TAG, "Script %d uses ytcfg (len=%zu)", i, exec_script_lens[i]);
             }
-        }
-    }
-    
-    // Log first 100 chars of each script for debugging
-    for (int i = 0; i < exec_count; i++) {
-        if (exec_scripts[i] && exec_script_lens[i] > 0) {
+            
             char preview[101];
             size_t len = exec_script_lens[i] < 100 ? exec_script_lens[i] : 100;
             memcpy(preview, exec_scripts[i], len);
@@ -1046,59 +949,171 @@ static int execute_scripts_and_get_urls(const char *html, char urls[][2048], int
             for (size_t j = 0; j < len; j++) {
                 if (preview[j] == '\n' || preview[j] == '\r') preview[j] = ' ';
             }
-            LOG_INFO("Script %d preview: %.100s%s", i, preview, exec_script_lens[i] > 100 ? "..." : "");
+            TLOG_DEBUG(LOG_TAG, "Script %d preview: %.100s%s", i, preview,
+                       exec_script_lens[i] > 100 ? "..." : "");
         }
     }
     
     JsExecResult js_result;
     memset(&js_result, 0, sizeof(JsExecResult));
     
-    log_to_file("html_media", "About to call js_quickjs_exec_scripts...");
     LOG_INFO("About to call js_quickjs_exec_scripts...");
     
     bool js_success = js_quickjs_exec_scripts(
         exec_scripts, exec_script_lens, exec_count,
-        html, NULL, &js_result
+        tokens, NULL, &js_result
     );
     
-    log_to_file("html_media", "js_quickjs_exec_scripts returned, success=%d", js_success);
     LOG_INFO("js_quickjs_exec_scripts returned, success=%d", js_success);
     
+    // Filtering was too aggressive for this page: fetch what was skipped and
+    // run the full script set on a fresh context, since the filtered set has
+    // already declared its globals and queued its timers on this one. Not
+    // after a timeout: more scripts would only take longer.
+    if (skipped_count > 0 && js_result.status != JS_EXEC_TIMEOUT &&
+        (!js_success || count_media_urls(&js_result) == 0)) {
+        LOG_WARN("No media URLs with %d scripts skipped, falling back to full execution",
+                 skipped_count);
+        if (!js_quickjs_reset_context()) {
+            LOG_ERROR("No fresh context for full execution");
+            free_script_infos(scripts, script_count);
+            return 0;
+        }
+        for (int i = 0; i < script_count; i++) {
+            if (scripts[i].type == SCRIPT_TYPE_EXTERNAL &&
+                scripts[i].relevance == SCRIPT_RELEVANCE_SKIPPABLE) {
+                fetch_external_script(&scripts[i]);
+            }
+        }
+        exec_count = build_exec_list(scripts, script_count, false,
+                                     exec_scripts, exec_script_lens, NULL);
+        memset(&js_result, 0, sizeof(JsExecResult));
+        js_success = exec_count > 0 && js_quickjs_exec_scripts(
+            exec_scripts, exec_script_lens, exec_count,
+            tokens, NULL, &js_result
+        );
+        LOG_INFO("Full execution returned, success=%d", js_success);
+    }
+    
     free_script_infos(scripts, script_count);
     
-    if (!js_success) {
-        LOG_ERROR("JavaScript execution failed");
+    // A timed-out run still reports whatever it captured before the cutoff
+    if (js_result.status == JS_EXEC_TIMEOUT && js_result.captured_url_count > 0) {
+        LOG_WARN("JavaScript execution timed out, using %d URLs captured so far",
+                 js_result.captured_url_count);
+    } else if (!js_success) {
+        LOG_ERROR("JavaScript execution %s",
+                  js_result.status == JS_EXEC_TIMEOUT ? "timed out" : "failed");
         return 0;
     }
     
     LOG_INFO("JavaScript execution successful, captured %d URLs", js_result.captured_url_count);
-    log_to_file("html_media", "JS execution complete, captured %d URLs", js_result.captured_url_count);
     
-    // Copy captured URLs to output array
+    // Keep views of the media URLs
+    StrView *urls = js_result.captured_url_count > 0 ?
+        job_arena_alloc(arena, js_result.captured_url_count * sizeof(StrView)) : NULL;
     int count = 0;
     int encrypted_count = 0;
     int decrypted_count = 0;
-    for (int i = 0; i < js_result.captured_url_count && count < max_urls; i++) {
-        log_to_file("html_media", "URL %d: %s", i, js_result.captured_urls[i]);
+    for (int i = 0; urls && i < js_result.captured_url_count; i++) {
+        const char *url = js_result.captured_urls[i].ptr;
+        TLOG_DEBUG(LOG_TAG, "URL %d: %s", i, url);
         // Only keep googlevideo.com URLs (the actual media URLs)
-        if (strstr(js_result.captured_urls[i], "googlevideo.com")) {
-            strncpy(urls[count], js_result.captured_urls[i], 2047);
-            urls[count][2047] = '\0';
+        if (strstr(url, "googlevideo.com")) {
+            urls[count] = js_result.captured_urls[i];
             // Check if URL has signature (decrypted) or needs decryption
-            if (strstr(urls[count], "sig=") || strstr(urls[count], "signature=")) {
-                LOG_INFO("Captured DECRYPTED media URL %d: %.100s...", count, urls[count]);
+            if (strstr(url, "sig=") || strstr(url, "signature=")) {
+                LOG_INFO("Captured DECRYPTED media URL %d: %.100s...", count, url);
                 decrypted_count++;
-            } else if (strstr(urls[count], "signatureCipher=") || strstr(urls[count], "sc=")) {
-                LOG_INFO("Captured ENCRYPTED media URL %d: %.100s...", count, urls[count]);
+            } else if (strstr(url, "signatureCipher=") || strstr(url, "sc=")) {
+                LOG_INFO("Captured ENCRYPTED media URL %d: %.100s...", count, url);
                 encrypted_count++;
             } else {
-                LOG_INFO("Captured media URL %d (no sig): %.100s...", count, urls[count]);
+                LOG_INFO("Captured media URL %d (no sig): %.100s...", count, url);
             }
             count++;
         }
     }
     
     LOG_INFO("Found %d googlevideo.com URLs (%d decrypted, %d encrypted)", count, decrypted_count, encrypted_count);
+    *out_urls = urls;
+    return count;
+}
+
+// Execute player scripts of a downloaded page and get captured URLs
+static int execute_scripts_and_get_urls(const char *html, JobArena *arena,
+                                        const StrView **out_urls) {
+    if (!html || !arena || !out_urls) return 0;
+    *out_urls = NULL;
+    
+    // Read the page once; scripts and <video> elements both come from the tokens
+    HtmlTokenStream tokens;
+    if (!html_tokenize(html, strlen(html), arena, &tokens)) {
+        LOG_ERROR("Failed to tokenize HTML");
+        return 0;
+    }
+    
+    // Extract all scripts in parse order
+    ScriptVec script_vec = { NULL, 0, 0, arena };
+    extract_scripts_in_order(&tokens, &script_vec);
+    return run_scripts_and_get_urls(&tokens, &script_vec, arena, out_urls);
+}
+
+// A page being tokenized straight off the HTTP body sink
+typedef struct {
+    HtmlTokenizer tokenizer;
+    ScriptVec scripts;
+    ScriptExtractor extractor;
+    bool failed;
+} PageStream;
+
+static void page_stream_on_token(HtmlTokenStream *tokens, uint32_t index, void *user) {
+    PageStream *page = user;
+    script_extractor_token(&page->extractor, tokens, index);
+}
+
+static bool page_stream_sink(const char *data, size_t len, void *user) {
+    PageStream *page = user;
+    if (!html_tokenizer_feed(&page->tokenizer, data, len)) {
+        LOG_ERROR("Failed to tokenize streamed HTML");
+        page->failed = true;
+        return false;
+    }
+    return true;
+}
+
+// Download a page and execute its scripts, tokenizing the HTML as it arrives
+// so external scripts are fetched while the rest of the page downloads
+static int stream_page_and_get_urls(const char *url, JobArena *arena,
+                                    const StrView **out_urls, char *err, size_t errLen) {
+    *out_urls = NULL;
+    
+    PageStream page;
+    memset(&page, 0, sizeof(PageStream));
+    page.scripts.arena = arena;
+    html_tokenizer_init(&page.tokenizer, arena, page_stream_on_token, &page);
+    script_extractor_init(&page.extractor, &page.scripts, true);
+    
+    LOG_INFO("Streaming HTML from: %s", url);
+    HttpBuffer response = {0};
+    bool ok = http_get_streaming(url, &response, page_stream_sink, &page, err, errLen);
+    http_free_buffer(&response);
+    
+    int count = 0;
+    if (!ok || page.failed || !html_tokenizer_finish(&page.tokenizer)) {
+        LOG_ERROR("HTML download failed: %s", err);
+        if (page.failed) snprintf(err, errLen, "Failed to parse HTML");
+    } else {
+        LOG_INFO("Streamed %zu bytes of HTML, %d scripts (%d prefetched)",
+                 page.tokenizer.stream.source_len, page.scripts.count,
+                 page.extractor.prefetch_count);
+        count = run_scripts_and_get_urls(&page.tokenizer.stream, &page.scripts, arena, out_urls);
+        if (count == 0) snprintf(err, errLen, "No media URLs found");
+    }
+    
+    script_prefetch_join_all(page.scripts.items, page.scripts.count);
+    free_script_infos(page.scripts.items, page.scripts.count);
+    html_tokenizer_free(&page.tokenizer);
     return count;
 }
 
@@ -1113,7 +1128,7 @@ int html_extract_media_streams(const char *html_url, MediaStream *streams, int m
     
     // Extract video ID
     char video_id[32] = {0};
-    if (!extract_yt_video_id(html_url, video_id, sizeof(video_id))) {
+    if (!html_extract_yt_video_id(html_url, video_id, sizeof(video_id))) {
         LOG_ERROR("Could not extract video ID from URL");
         return -1;
     }
@@ -1152,13 +1167,16 @@ int html_extract_media_streams(const char *html_url, MediaStream *streams, int m
     LOG_INFO("Downloaded %zu bytes of HTML", html_buffer.size);
     
     // Execute scripts and capture URLs
-    char urls[32][2048];
-    int url_count = execute_scripts_and_get_urls(html_buffer.data, urls, 32);
+    JobArena arena;
+    job_arena_init(&arena);
+    const StrView *urls = NULL;
+    int url_count = execute_scripts_and_get_urls(html_buffer.data, &arena, &urls);
     
     http_free_buffer(&html_buffer);
     
     if (url_count == 0) {
         LOG_ERROR("No URLs captured from script execution");
+        job_arena_free(&arena);
         return -1;
     }
     
@@ -1166,19 +1184,19 @@ int html_extract_media_streams(const char *html_url, MediaStream *streams, int m
     int stream_count = 0;
     for (int i = 0; i < url_count && stream_count < max_streams; i++) {
         memset(&streams[stream_count], 0, sizeof(MediaStream));
-        strncpy(streams[stream_count].url, urls[i], sizeof(streams[stream_count].url) - 1);
-        streams[stream_count].url[sizeof(streams[stream_count].url) - 1] = '\0';
+        snprintf(streams[stream_count].url, sizeof(streams[stream_count].url), "%.*s",
+                 (int)urls[i].len, urls[i].ptr);
         
         // Try to extract itag from URL
-        const char *itag = strstr(urls[i], "itag=");
+        const char *itag = strstr(urls[i].ptr, "itag=");
         if (itag) {
             streams[stream_count].itag = atoi(itag + 5);
         }
         
         // Check if it's audio or video based on URL patterns
-        if (strstr(urls[i], "mime=audio")) {
+        if (strstr(urls[i].ptr, "mime=audio")) {
             strncpy(streams[stream_count].mime_type, "audio/mp4", sizeof(streams[stream_count].mime_type) - 1);
-        } else if (strstr(urls[i], "mime=video")) {
+        } else if (strstr(urls[i].ptr, "mime=video")) {
             strncpy(streams[stream_count].mime_type, "video/mp4", sizeof(streams[stream_count].mime_type) - 1);
         }
         
@@ -1187,48 +1205,104 @@ int html_extract_media_streams(const char *html_url, MediaStream *streams, int m
         stream_count++;
     }
     
+    job_arena_free(&arena);
     LOG_INFO("Found %d streams from captured URLs", stream_count);
     return stream_count;
 }
 
-// Backward compatibility wrapper for html_extract_media_url
-bool html_extract_media_url(const char *html, HtmlMediaCandidate *outCandidate,
-                            char *err, size_t errLen) {
-    if (!html || !outCandidate) {
+// Guess MIME type from a googlevideo URL
+static void guess_media_mime(const char *url, char *mime, size_t mime_len) {
+    if (strstr(url, "mime=audio")) {
+        strncpy(mime, "audio/mp4", mime_len - 1);
+    } else {
+        strncpy(mime, "video/mp4", mime_len - 1);
+    }
+    mime[mime_len - 1] = '\0';
+}
+
+int html_extract_media_candidates(const char *html, HtmlMediaCandidate *outCandidates,
+                                  int maxCandidates, char *err, size_t errLen) {
+    if (!html || !outCandidates || maxCandidates <= 0) {
         if (err && errLen > 0) {
             strncpy(err, "Invalid arguments", errLen - 1);
             err[errLen - 1] = '\0';
         }
-        return false;
+        return 0;
     }
     
-    // Clear output
-    memset(outCandidate, 0, sizeof(HtmlMediaCandidate));
-    
     // Execute scripts and capture URLs
-    char urls[32][2048];
-    int url_count = execute_scripts_and_get_urls(html, urls, 32);
+    JobArena arena;
+    job_arena_init(&arena);
+    const StrView *urls = NULL;
+    int url_count = execute_scripts_and_get_urls(html, &arena, &urls);
     
     if (url_count == 0) {
+        job_arena_free(&arena);
         LOG_WARN("No URLs captured from script execution");
         if (err && errLen > 0) {
             strncpy(err, "No media URLs found", errLen - 1);
             err[errLen - 1] = '\0';
         }
+        return 0;
+    }
+    
+    if (url_count > maxCandidates) url_count = maxCandidates;
+    for (int i = 0; i < url_count; i++) {
+        memset(&outCandidates[i], 0, sizeof(HtmlMediaCandidate));
+        snprintf(outCandidates[i].url, sizeof(outCandidates[i].url), "%.*s",
+                 (int)urls[i].len, urls[i].ptr);
+        guess_media_mime(urls[i].ptr, outCandidates[i].mime, sizeof(outCandidates[i].mime));
+    }
+    
+    job_arena_free(&arena);
+    return url_count;
+}
+
+int html_extract_media_candidates_from_url(const char *url, HtmlMediaCandidate *outCandidates,
+                                           int maxCandidates, char *err, size_t errLen) {
+    if (!url || !outCandidates || maxCandidates <= 0) {
+        if (err && errLen > 0) {
+            strncpy(err, "Invalid arguments", errLen - 1);
+            err[errLen - 1] = '\0';
+        }
+        return 0;
+    }
+    
+    JobArena arena;
+    job_arena_init(&arena);
+    const StrView *urls = NULL;
+    int url_count = stream_page_and_get_urls(url, &arena, &urls, err, errLen);
+    
+    if (url_count > maxCandidates) url_count = maxCandidates;
+    for (int i = 0; i < url_count; i++) {
+        memset(&outCandidates[i], 0, sizeof(HtmlMediaCandidate));
+        snprintf(outCandidates[i].url, sizeof(outCandidates[i].url), "%.*s",
+                 (int)urls[i].len, urls[i].ptr);
+        guess_media_mime(urls[i].ptr, outCandidates[i].mime, sizeof(outCandidates[i].mime));
+    }
+    
+    job_arena_free(&arena);
+    return url_count;
+}
+
+// Backward compatibility wrapper: first captured URL only
+bool html_extract_media_url(const char *html, HtmlMediaCandidate *outCandidate,
+                            char *err, size_t errLen) {
+    if (!html || !outCandidate) {
+        if (err && errLen > 0) {
+            strncpy(err, "Invalid arguments", errLen - 1);
+            err[errLen - 1] = '\0';
+        }
         return false;
     }
     
-    // Use the first captured URL
-    strncpy(outCandidate->url, urls[0], sizeof(outCandidate->url) - 1);
-    outCandidate->url[sizeof(outCandidate->url) - 1] = '\0';
+    // Clear output
+    memset(outCandidate, 0, sizeof(HtmlMediaCandidate));
     
-    // Guess MIME type from URL
-    if (strstr(urls[0], "mime=audio")) {
-        strncpy(outCandidate->mime, "audio/mp4", sizeof(outCandidate->mime) - 1);
-    } else {
-        strncpy(outCandidate->mime, "video/mp4", sizeof(outCandidate->mime) - 1);
+    // Use the first captured URL
+    if (html_extract_media_candidates(html, outCandidate, 1, err, errLen) == 0) {
+        return false;
     }
-    outCandidate->mime[sizeof(outCandidate->mime) - 1] = '\0';
     
     LOG_INFO("Selected URL: %.50s...", outCandidate->url);
     
@@ -8,6 +8,8 @@
 extern "C" {
 #endif
 
+#define HTML_VIDEO_ID_MAX 32
+
 typedef struct HtmlMediaCandidate {
     char url[2048];
     char mime[64];
@@ -16,6 +18,24 @@ typedef struct HtmlMediaCandidate {
 bool html_extract_media_url(const char *html, HtmlMediaCandidate *outCandidate,
                             char *err, size_t errLen);
 
+/* Fills up to maxCandidates captured media URLs in capture order.
+ * Returns the number found, 0 on failure. */
+int html_extract_media_candidates(const char *html, HtmlMediaCandidate *outCandidates,
+                                  int maxCandidates, char *err, size_t errLen);
+
+/* Downloads the page at url and extracts candidates like
+ * html_extract_media_candidates, tokenizing the HTML as it arrives and
+ * fetching its external scripts while the rest of the page downloads. */
+int html_extract_media_candidates_from_url(const char *url, HtmlMediaCandidate *outCandidates,
+                                           int maxCandidates, char *err, size_t errLen);
+
+bool html_extract_yt_video_id(const char *url, char *out_id, size_t out_len);
+
+/* Between begin and end, fetched external scripts are kept and reused by
+ * later pages that reference the same URL. */
+void html_extract_batch_begin(void);
+void html_extract_batch_end(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,301 @@
+#include "html_selector.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * Parsing
+ * ============================================================================ */
+
+static bool is_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '-' || c == '_' || (unsigned char)c >= 0x80;
+}
+
+static const char *skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\f') p++;
+    return p;
+}
+
+static const char *read_ident(const char *p, const char **out, size_t *out_len) {
+    const char *start = p;
+    while (is_ident_char(*p)) p++;
+    *out = start;
+    *out_len = (size_t)(p - start);
+    return p;
+}
+
+/* [name] or [name=value], value bare or quoted. p is just past '[' */
+static const char *read_attr(const char *p, HtmlSelectorAttr *attr) {
+    p = read_ident(skip_ws(p), &attr->name, &attr->name_len);
+    if (attr->name_len == 0) return NULL;
+    p = skip_ws(p);
+    attr->value = NULL;
+    attr->value_len = 0;
+    if (*p == '=') {
+        p = skip_ws(p + 1);
+        if (*p == '"' || *p == '\'') {
+            char quote = *p++;
+            const char *end = strchr(p, quote);
+            if (!end) return NULL;
+            attr->value = p;
+            attr->value_len = (size_t)(end - p);
+            p = end + 1;
+        } else {
+            p = read_ident(p, &attr->value, &attr->value_len);
+            if (attr->value_len == 0) return NULL;
+        }
+        p = skip_ws(p);
+    }
+    return *p == ']' ? p + 1 : NULL;
+}
+
+static const char *read_part(const char *p, HtmlSelectorPart *part) {
+    memset(part, 0, sizeof(*part));
+    bool any = false;
+
+    if (*p == '*') {
+        p++;
+        any = true;
+    } else if (is_ident_char(*p)) {
+        const char *tag;
+        size_t tag_len;
+        p = read_ident(p, &tag, &tag_len);
+        if (tag_len >= sizeof(part->tag)) return NULL;
+        for (size_t i = 0; i < tag_len; i++) part->tag[i] = (char)tolower((unsigned char)tag[i]);
+        any = true;
+    }
+
+    for (;;) {
+        if (*p == '#') {
+            p = read_ident(p + 1, &part->id, &part->id_len);
+            if (part->id_len == 0) return NULL;
+        } else if (*p == '.') {
+            if (part->class_count == HTML_SELECTOR_MAX_CLASSES) return NULL;
+            int i = part->class_count++;
+            p = read_ident(p + 1, &part->classes[i], &part->class_lens[i]);
+            if (part->class_lens[i] == 0) return NULL;
+        } else if (*p == '[') {
+            if (part->attr_count == HTML_SELECTOR_MAX_ATTRS) return NULL;
+            p = read_attr(p + 1, &part->attrs[part->attr_count++]);
+            if (!p) return NULL;
+        } else {
+            break;
+        }
+        any = true;
+    }
+    return any ? p : NULL;
+}
+
+HtmlSelector *html_selector_parse(const char *text) {
+    if (!text) return NULL;
+    HtmlSelector *sel = calloc(1, sizeof(HtmlSelector));
+    if (!sel) return NULL;
+
+    const char *p = skip_ws(text);
+    for (;;) {
+        if (sel->count == HTML_SELECTOR_MAX_GROUPS) goto fail;
+        HtmlSelectorChain *chain = &sel->groups[sel->count++];
+        char combinator = 0;
+
+        for (;;) {
+            if (chain->count == HTML_SELECTOR_MAX_PARTS) goto fail;
+            HtmlSelectorPart *part = &chain->parts[chain->count++];
+            p = read_part(p, part);
+            if (!p) goto fail;
+            part->combinator = combinator;
+
+            const char *after = skip_ws(p);
+            if (*after == '>') {
+                combinator = '>';
+                p = skip_ws(after + 1);
+            } else if (*after == ',' || *after == '\0') {
+                p = after;
+                break;
+            } else if (after != p) {
+                combinator = ' ';
+                p = after;
+            } else {
+                goto fail;
+            }
+        }
+
+        if (*p == '\0') return sel;
+        p = skip_ws(p + 1);
+    }
+
+fail:
+    free(sel);
+    return NULL;
+}
+
+void html_selector_free(HtmlSelector *sel) {
+    free(sel);
+}
+
+/* ============================================================================
+ * Matching
+ * ============================================================================ */
+
+static bool attr_value_is(HtmlDocument *doc, HtmlAttribute *attr, const char *value, size_t len) {
+    size_t actual_len = 0;
+    const char *actual = html_attr_value(doc, attr, &actual_len);
+    return actual && actual_len == len && memcmp(actual, value, len) == 0;
+}
+
+static bool has_class_token(HtmlDocument *doc, HtmlAttribute *attr, const char *name, size_t len) {
+    size_t value_len = 0;
+    const char *value = html_attr_value(doc, attr, &value_len);
+    if (!value) return false;
+
+    const char *end = value + value_len;
+    const char *p = value;
+    while (p < end) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        const char *start = p;
+        while (p < end && !isspace((unsigned char)*p)) p++;
+        if ((size_t)(p - start) == len && memcmp(start, name, len) == 0) return true;
+    }
+    return false;
+}
+
+static HtmlAttribute *find_attr_n(HtmlDocument *doc, HtmlNode *node, const char *name, size_t len) {
+    char buf[HTML_MAX_TAG_NAME_LEN];
+    if (len >= sizeof(buf)) return NULL;
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+    return html_node_get_attr(doc, node, buf);
+}
+
+static bool part_matches(HtmlDocument *doc, const HtmlSelectorPart *part, HtmlNode *node) {
+    if (node->type != HTML_NODE_ELEMENT) return false;
+    if (part->tag[0] && strcmp(node->tag_name, part->tag) != 0) return false;
+
+    if (part->id) {
+        HtmlAttribute *id = html_node_get_attr(doc, node, "id");
+        if (!id || !attr_value_is(doc, id, part->id, part->id_len)) return false;
+    }
+
+    if (part->class_count > 0) {
+        HtmlAttribute *cls = html_node_get_attr(doc, node, "class");
+        if (!cls) return false;
+        for (int i = 0; i < part->class_count; i++) {
+            if (!has_class_token(doc, cls, part->classes[i], part->class_lens[i])) return false;
+        }
+    }
+
+    for (int i = 0; i < part->attr_count; i++) {
+        const HtmlSelectorAttr *want = &part->attrs[i];
+        HtmlAttribute *attr = find_attr_n(doc, node, want->name, want->name_len);
+        if (!attr) return false;
+        if (want->value && !attr_value_is(doc, attr, want->value, want->value_len)) return false;
+    }
+    return true;
+}
+
+static bool chain_matches_at(HtmlDocument *doc, const HtmlSelectorChain *chain, int index,
+                             HtmlNode *node) {
+    if (!part_matches(doc, &chain->parts[index], node)) return false;
+    if (index == 0) return true;
+
+    if (chain->parts[index].combinator == '>') {
+        return node->parent && chain_matches_at(doc, chain, index - 1, node->parent);
+    }
+    for (HtmlNode *anc = node->parent; anc; anc = anc->parent) {
+        if (chain_matches_at(doc, chain, index - 1, anc)) return true;
+    }
+    return false;
+}
+
+bool html_selector_matches(HtmlDocument *doc, const HtmlSelectorChain *chain, HtmlNode *node) {
+    if (!doc || !chain || !node || chain->count == 0) return false;
+    return chain_matches_at(doc, chain, chain->count - 1, node);
+}
+
+/* ============================================================================
+ * Querying
+ * ============================================================================ */
+
+/* Next element after node in document order, staying inside scope */
+static HtmlNode *next_in_tree(HtmlNode *node, const HtmlNode *scope) {
+    if (node->first_child) return node->first_child;
+    while (node && node != scope) {
+        if (node->next_sibling) return node->next_sibling;
+        node = node->parent;
+    }
+    return NULL;
+}
+
+static bool in_scope(const HtmlNode *scope, HtmlNode *node) {
+    if (!node->connected) return false;
+    return !scope || (node != scope && html_node_contains(scope, node));
+}
+
+static int compare_order(const void *a, const void *b) {
+    uint32_t oa = (*(HtmlNode *const *)a)->order;
+    uint32_t ob = (*(HtmlNode *const *)b)->order;
+    return (oa > ob) - (oa < ob);
+}
+
+static bool query_chain(HtmlDocument *doc, const HtmlSelectorChain *chain, const HtmlNode *scope,
+                        uint32_t limit, HtmlNodeList *out) {
+    const HtmlSelectorPart *last = &chain->parts[chain->count - 1];
+    const HtmlNodeList *candidates = NULL;
+    bool indexed = last->id || last->class_count > 0 || last->tag[0];
+
+    if (!indexed || (scope && !scope->connected)) {
+        /* Nothing indexed to start from, or a detached subtree the indexes
+         * don't cover: walk the scope */
+        HtmlNode *node = scope ? scope->first_child : doc->root;
+        while (node) {
+            if (node->type == HTML_NODE_ELEMENT && html_selector_matches(doc, chain, node)) {
+                if (!html_node_list_push(out, node)) return false;
+                if (limit && out->count >= limit) return true;
+            }
+            node = next_in_tree(node, scope);
+        }
+        return true;
+    }
+
+    if (last->id) {
+        candidates = html_document_nodes_by_id(doc, last->id, last->id_len);
+    } else if (last->class_count > 0) {
+        candidates = html_document_nodes_by_class(doc, last->classes[0], last->class_lens[0]);
+    } else {
+        candidates = html_document_nodes_by_tag(doc, last->tag);
+    }
+
+    if (!candidates) return true;
+    for (uint32_t i = 0; i < candidates->count; i++) {
+        HtmlNode *node = candidates->items[i];
+        if (!in_scope(scope, node) || !html_selector_matches(doc, chain, node)) continue;
+        if (!html_node_list_push(out, node)) return false;
+        if (limit && out->count >= limit) break;
+    }
+    return true;
+}
+
+bool html_selector_query(HtmlDocument *doc, const HtmlSelector *sel, const HtmlNode *scope,
+                         uint32_t limit, HtmlNodeList *out) {
+    if (!doc || !sel || !out) return false;
+    if (sel->count == 1) return query_chain(doc, &sel->groups[0], scope, limit, out);
+
+    /* Groups are collected in full, then merged into document order */
+    uint32_t base = out->count;
+    for (int g = 0; g < sel->count; g++) {
+        if (!query_chain(doc, &sel->groups[g], scope, 0, out)) return false;
+    }
+
+    HtmlNode **items = out->items + base;
+    uint32_t n = out->count - base;
+    if (n > 1) qsort(items, n, sizeof(HtmlNode *), compare_order);
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (kept > 0 && items[kept - 1] == items[i]) continue;
+        items[kept++] = items[i];
+    }
+    if (limit && kept > limit) kept = limit;
+    out->count = base + kept;
+    return true;
+}
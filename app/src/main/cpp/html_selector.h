@@ -0,0 +1,74 @@
+#ifndef HTML_SELECTOR_H
+#define HTML_SELECTOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "html_dom.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Simple CSS selectors as player code uses them: type, '*', #id, .class,
+ * [attr], [attr=value], the descendant and '>' combinators, and comma
+ * lists. Anything else (pseudo-classes, '+', '~', other attribute
+ * operators) fails to parse and matches nothing. */
+
+#define HTML_SELECTOR_MAX_CLASSES 4
+#define HTML_SELECTOR_MAX_ATTRS 4
+#define HTML_SELECTOR_MAX_PARTS 8
+#define HTML_SELECTOR_MAX_GROUPS 8
+
+typedef struct HtmlSelectorAttr {
+    const char *name;
+    size_t name_len;
+    const char *value;          /* NULL for [attr] */
+    size_t value_len;
+} HtmlSelectorAttr;
+
+/* One compound selector; strings are views into the selector text */
+typedef struct HtmlSelectorPart {
+    char tag[HTML_MAX_TAG_NAME_LEN];    /* Lowercase, "" for any */
+    const char *id;
+    size_t id_len;
+    const char *classes[HTML_SELECTOR_MAX_CLASSES];
+    size_t class_lens[HTML_SELECTOR_MAX_CLASSES];
+    int class_count;
+    HtmlSelectorAttr attrs[HTML_SELECTOR_MAX_ATTRS];
+    int attr_count;
+    char combinator;            /* Relation to the part before: ' ', '>' or 0 */
+} HtmlSelectorPart;
+
+typedef struct HtmlSelectorChain {
+    HtmlSelectorPart parts[HTML_SELECTOR_MAX_PARTS];
+    int count;
+} HtmlSelectorChain;
+
+typedef struct HtmlSelector {
+    HtmlSelectorChain groups[HTML_SELECTOR_MAX_GROUPS];
+    int count;
+} HtmlSelector;
+
+/* Parses text, which must outlive the result. Returns NULL on syntax the
+ * matcher doesn't support or on allocation failure. */
+HtmlSelector *html_selector_parse(const char *text);
+
+void html_selector_free(HtmlSelector *sel);
+
+/* Does node match the chain? As in the DOM, ancestors named by the chain
+ * may lie outside the element a query was scoped to. */
+bool html_selector_matches(HtmlDocument *doc, const HtmlSelectorChain *chain, HtmlNode *node);
+
+/* Appends up to limit (0 for no limit) matching descendants of scope, or of
+ * the document when scope is NULL, to out in document order. Candidates
+ * come from the id, class or tag index of the rightmost part, so the cost
+ * follows the size of that index entry rather than the tree. */
+bool html_selector_query(HtmlDocument *doc, const HtmlSelector *sel, const HtmlNode *scope,
+                         uint32_t limit, HtmlNodeList *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
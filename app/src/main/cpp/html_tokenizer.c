@@ -0,0 +1,645 @@
+/*
+ * HTML Tokenizer
+ *
+ * Reads a page once and records start tags (with attribute spans), end tags,
+ * text and raw script/style bodies. Script extraction, the DOM builder and
+ * media element discovery all work from this stream instead of rescanning
+ * the HTML.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "html_tokenizer.h"
+#include "byte_scan.h"
+#include "trace_log.h"
+
+#define LOG_TAG "html_tokenizer"
+#define LOG_INFO(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOG_ERROR(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
+
+#define TOKEN_NAME_MAX 128
+#define TOKEN_INITIAL_CAPACITY 256
+
+/* List of self-closing HTML tags (void elements) */
+static const char *SELF_CLOSING_TAGS[] = {
+    "area", "base", "br", "col", "embed", "hr", "img", "input",
+    "link", "meta", "param", "source", "track", "wbr", NULL
+};
+
+/* List of tags that contain raw text content */
+static const char *RAW_CONTENT_TAGS[] = {
+    "script", "style", "textarea", "title", NULL
+};
+
+bool html_is_self_closing_tag(const char *tag_name) {
+    if (!tag_name) return false;
+    for (int i = 0; SELF_CLOSING_TAGS[i]; i++) {
+        if (strcasecmp(tag_name, SELF_CLOSING_TAGS[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool html_is_raw_content_tag(const char *tag_name) {
+    if (!tag_name) return false;
+    for (int i = 0; RAW_CONTENT_TAGS[i]; i++) {
+        if (strcasecmp(tag_name, RAW_CONTENT_TAGS[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Decode common HTML entities */
+int html_decode_entities(char *str, size_t len) {
+    if (!str || len == 0) return 0;
+
+    char *dest = str;
+    const char *src = str;
+    const char *end = str + len;
+
+    while (*src && src < end) {
+        if (*src == '&') {
+            if (strncmp(src, "&lt;", 4) == 0) {
+                *dest++ = '<';
+                src += 4;
+            } else if (strncmp(src, "&gt;", 4) == 0) {
+                *dest++ = '>';
+                src += 4;
+            } else if (strncmp(src, "&amp;", 5) == 0) {
+                *dest++ = '&';
+                src += 5;
+            } else if (strncmp(src, "&quot;", 6) == 0) {
+                *dest++ = '"';
+                src += 6;
+            } else if (strncmp(src, "&apos;", 6) == 0) {
+                *dest++ = '\'';
+                src += 6;
+            } else if (strncmp(src, "&nbsp;", 6) == 0) {
+                *dest++ = ' ';
+                src += 6;
+            } else if (src[1] == '#' && isdigit((unsigned char)src[2])) {
+                /* Numeric entity: &#123; */
+                src += 2;
+                int val = 0;
+                while (isdigit((unsigned char)*src)) {
+                    val = val * 10 + (*src - '0');
+                    src++;
+                }
+                if (*src == ';') src++;
+                *dest++ = (char)(val > 0 && val < 256 ? val : '?');
+            } else {
+                *dest++ = *src++;
+            }
+        } else {
+            *dest++ = *src++;
+        }
+    }
+    *dest = '\0';
+    return (int)(dest - str);
+}
+
+/* ============================================================================
+ * Stream storage
+ * ============================================================================ */
+
+static HtmlToken *stream_push_token(HtmlTokenStream *s, HtmlTokenType type) {
+    if (s->count == s->capacity) {
+        uint32_t cap = s->capacity ? s->capacity * 2 : TOKEN_INITIAL_CAPACITY;
+        HtmlToken *tokens = job_arena_grow(s->arena, s->tokens,
+                                           s->capacity * sizeof(HtmlToken),
+                                           cap * sizeof(HtmlToken));
+        if (!tokens) return NULL;
+        s->tokens = tokens;
+        s->capacity = cap;
+    }
+    HtmlToken *tok = &s->tokens[s->count++];
+    memset(tok, 0, sizeof(*tok));
+    tok->type = (uint8_t)type;
+    tok->attr_start = s->attr_count;
+    return tok;
+}
+
+static HtmlTokenAttr *stream_push_attr(HtmlTokenStream *s) {
+    if (s->attr_count == s->attr_capacity) {
+        uint32_t cap = s->attr_capacity ? s->attr_capacity * 2 : TOKEN_INITIAL_CAPACITY;
+        HtmlTokenAttr *attrs = job_arena_grow(s->arena, s->attrs,
+                                              s->attr_capacity * sizeof(HtmlTokenAttr),
+                                              cap * sizeof(HtmlTokenAttr));
+        if (!attrs) return NULL;
+        s->attrs = attrs;
+        s->attr_capacity = cap;
+    }
+    HtmlTokenAttr *attr = &s->attrs[s->attr_count++];
+    memset(attr, 0, sizeof(*attr));
+    return attr;
+}
+
+static HtmlSpan span_of(const char *base, const char *start, const char *end) {
+    HtmlSpan span = { (uint32_t)(start - base), (uint32_t)(end - start) };
+    return span;
+}
+
+/* ============================================================================
+ * Scanning
+ * ============================================================================ */
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static const char *skip_space(const char *p, const char *end) {
+    while (p < end && is_space(*p)) p++;
+    return p;
+}
+
+enum {
+    SCRIPT_SCAN_CODE,
+    SCRIPT_SCAN_STRING,
+    SCRIPT_SCAN_LINE_COMMENT,
+    SCRIPT_SCAN_BLOCK_COMMENT
+};
+
+/* Find the true end of a script, handling strings and comments.
+ * This prevents premature termination when </script> appears inside JS
+ * strings. Only quotes, '/', '<' and '\\' can change the lexer state, so
+ * the runs in between are skipped with the SIMD scanner.
+ *
+ * Scanning starts at base + st->resume. Without more input to come (final)
+ * it returns NULL if the script never closes; otherwise NULL means "not yet"
+ * and st records where to carry on once more of the script has arrived. */
+static const char *find_script_end(HtmlScriptScan *st, const char *base, const char *end, bool final) {
+    const char *p = base + st->resume;
+
+    while (p < end) {
+        switch (st->mode) {
+        case SCRIPT_SCAN_LINE_COMMENT:
+            /* Single-line comment runs to the newline */
+            p = memchr(p, '\n', end - p);
+            if (!p) {
+                p = end;
+                goto suspend;
+            }
+            p++;
+            st->mode = SCRIPT_SCAN_CODE;
+            continue;
+        case SCRIPT_SCAN_BLOCK_COMMENT: {
+            /* Multi-line comment: skip past its terminator */
+            const char *close = byte_scan_find_ci(p, end, "*/", 2);
+            if (close >= end) {
+                /* A '*' at the very end may pair with the next chunk */
+                if (end - p >= 1) p = end - 1;
+                goto suspend;
+            }
+            p = close + 2;
+            st->mode = SCRIPT_SCAN_CODE;
+            continue;
+        }
+        case SCRIPT_SCAN_STRING: {
+            /* String literal: only the quote and escapes matter inside it */
+            const char stops[2] = { st->quote, '\\' };
+            while ((p = byte_scan_any(p, end, stops, 2)) < end && *p == '\\') {
+                if (end - p < 2 && !final) goto suspend;
+                p += 2;
+            }
+            if (p >= end) {
+                p = end;
+                goto suspend;
+            }
+            p++;
+            st->mode = SCRIPT_SCAN_CODE;
+            continue;
+        }
+        default:
+            break;
+        }
+
+        p = byte_scan_js_special(p, end);
+        if (p >= end) break;
+
+        switch (*p) {
+        case '<':
+            if (end - p >= 9 && strncasecmp(p, "</script>", 9) == 0) {
+                return p;  /* Found actual script end */
+            }
+            if (end - p < 9 && !final && strncasecmp(p, "</script>", (size_t)(end - p)) == 0) {
+                goto suspend;
+            }
+            p++;
+            break;
+        case '\\':
+            /* Outside strings an escape only keeps a quote from opening one */
+            if (end - p < 2 && !final) goto suspend;
+            p += (end - p >= 2 && (p[1] == '"' || p[1] == '\'' || p[1] == '`' || p[1] == '\\')) ? 2 : 1;
+            break;
+        case '/':
+            if (end - p < 2 && !final) goto suspend;
+            if (end - p >= 2 && p[1] == '/') {
+                st->mode = SCRIPT_SCAN_LINE_COMMENT;
+                p += 2;
+            } else if (end - p >= 2 && p[1] == '*') {
+                st->mode = SCRIPT_SCAN_BLOCK_COMMENT;
+                p += 2;
+            } else {
+                p++;
+            }
+            break;
+        default:
+            st->mode = SCRIPT_SCAN_STRING;
+            st->quote = *p;
+            p++;
+            break;
+        }
+    }
+
+suspend:
+    if (p > end) p = end;
+    st->resume = (size_t)(p - base);
+    return NULL;  /* No closing tag found */
+}
+
+/* Reads a tag name at p, lowercases and interns it */
+static const char *read_tag_name(HtmlTokenStream *s, const char **pp, const char *end) {
+    char name[TOKEN_NAME_MAX];
+    size_t len = 0;
+    const char *p = *pp;
+
+    while (p < end && *p != '>' && *p != '/' && !is_space(*p)) {
+        if (len < TOKEN_NAME_MAX - 1) {
+            name[len++] = (char)tolower((unsigned char)*p);
+        }
+        p++;
+    }
+    *pp = p;
+
+    if (len == 0) return NULL;
+    const ArenaStr *str = str_set_intern(&s->names, name, len, NULL);
+    return str ? str->data : NULL;
+}
+
+/* Reads attributes up to and including '>'; closed reports whether the
+ * '>' was actually reached before end */
+static bool read_attributes(HtmlTokenStream *s, HtmlToken *tok, const char **pp, const char *end,
+                            bool *closed) {
+    const char *base = s->source;
+    const char *p = *pp;
+
+    *closed = false;
+    while (p < end) {
+        p = skip_space(p, end);
+        if (p >= end) break;
+
+        if (*p == '>') {
+            p++;
+            *closed = true;
+            break;
+        }
+        if (*p == '/') {
+            if (p + 1 < end && p[1] == '>') {
+                tok->flags |= HTML_TOKEN_SELF_CLOSING;
+                p += 2;
+                *closed = true;
+                break;
+            }
+            p++;  /* Stray slash */
+            continue;
+        }
+
+        /* Attribute name */
+        const char *name_start = p;
+        while (p < end && *p != '=' && *p != '>' && *p != '/' && !is_space(*p)) p++;
+        if (p == name_start) {
+            p++;
+            continue;
+        }
+
+        HtmlTokenAttr *attr = stream_push_attr(s);
+        if (!attr) return false;
+        attr->name = span_of(base, name_start, p);
+        attr->value = span_of(base, p, p);
+        tok->attr_count++;
+
+        p = skip_space(p, end);
+        if (p >= end || *p != '=') continue;
+        p = skip_space(p + 1, end);
+        if (p >= end) break;
+
+        /* Attribute value */
+        if (*p == '"' || *p == '\'') {
+            const char *close = memchr(p + 1, *p, end - (p + 1));
+            if (!close) close = end;
+            attr->value = span_of(base, p + 1, close);
+            p = close < end ? close + 1 : end;
+        } else {
+            const char *value_start = p;
+            while (p < end && *p != '>' && !is_space(*p)) {
+                if (*p == '/' && p + 1 < end && p[1] == '>') break;
+                p++;
+            }
+            attr->value = span_of(base, value_start, p);
+        }
+        attr->value_has_entity = attr->value.len > 0 &&
+            memchr(base + attr->value.offset, '&', attr->value.len) != NULL;
+    }
+
+    *pp = p;
+    return true;
+}
+
+/* Emits the raw body of the open script/style/textarea/title once its end
+ * tag is in the buffer, or as unterminated when final. done stays false
+ * while the body is still arriving. */
+static bool read_raw_text(HtmlTokenizer *tz, bool final, bool *done) {
+    HtmlTokenStream *s = &tz->stream;
+    const char *base = s->source;
+    const char *end = base + s->source_len;
+    const char *close;
+
+    *done = false;
+    if (strcmp(tz->raw_name, "script") == 0) {
+        close = find_script_end(&tz->script, base, end, final);
+    } else {
+        char needle[TOKEN_NAME_MAX + 2];
+        int needle_len = snprintf(needle, sizeof(needle), "</%s", tz->raw_name);
+        close = byte_scan_find_ci(base + tz->raw_resume, end, needle, (size_t)needle_len);
+        if (close >= end) {
+            close = NULL;
+            /* Only the last needle_len - 1 bytes can start a match later */
+            if (s->source_len >= tz->raw_start + (size_t)needle_len) {
+                tz->raw_resume = s->source_len - (size_t)needle_len + 1;
+            }
+        }
+    }
+    if (!close && !final) return true;
+
+    HtmlToken *tok = stream_push_token(s, HTML_TOKEN_RAW_TEXT);
+    if (!tok) return false;
+    if (!close) {
+        tok->flags |= HTML_TOKEN_UNTERMINATED;
+        close = end;
+    }
+    tok->span = span_of(base, base + tz->raw_start, close);
+    tz->pos = (size_t)(close - base);
+    tz->text_start = tz->pos;
+    tz->raw_name = NULL;
+    *done = true;
+    return true;
+}
+
+static bool emit_text(HtmlTokenStream *s, const char *start, const char *stop) {
+    while (start < stop && is_space(*start)) start++;
+    while (stop > start && is_space(stop[-1])) stop--;
+    if (start == stop) return true;
+
+    HtmlToken *tok = stream_push_token(s, HTML_TOKEN_TEXT);
+    if (!tok) return false;
+    tok->span = span_of(s->source, start, stop);
+    return true;
+}
+
+/* Tokenizes from tz->pos to the end of the buffered input. Unless final, a
+ * tag, comment or raw text body that runs off the end is left for the next
+ * call: its partial tokens are dropped and scanning resumes at its '<'. */
+static bool tokenize_step(HtmlTokenizer *tz, bool final) {
+    HtmlTokenStream *s = &tz->stream;
+
+    if (tz->raw_name) {
+        bool done;
+        if (!read_raw_text(tz, final, &done)) return false;
+        if (!done) return true;
+    }
+
+    const char *base = s->source;
+    const char *end = base + s->source_len;
+    const char *p = base + tz->pos;
+
+    while (p < end) {
+        const char *lt = byte_scan_any(p, end, "<", 1);
+        if (lt >= end) {
+            p = end;
+            break;
+        }
+        if (lt + 1 >= end) {
+            if (final) {
+                p = end;
+                break;
+            }
+            tz->pos = (size_t)(lt - base);
+            return true;
+        }
+
+        char next = lt[1];
+        bool is_end_tag = next == '/';
+        bool is_markup = is_end_tag || isalpha((unsigned char)next) || next == '!' || next == '?';
+        if (!is_markup) {
+            /* A bare '<' is text */
+            p = lt + 1;
+            continue;
+        }
+
+        if (!emit_text(s, base + tz->text_start, lt)) return false;
+        tz->text_start = (size_t)(lt - base);
+
+        uint32_t saved_count = s->count;
+        uint32_t saved_attr_count = s->attr_count;
+
+        if (next == '!' || next == '?') {
+            const char *close;
+            if (end - lt < 4 && !final) goto incomplete;
+            if (end - lt >= 4 && memcmp(lt, "<!--", 4) == 0) {
+                close = byte_scan_find_ci(lt + 4, end, "-->", 3);
+                if (close >= end && !final) goto incomplete;
+                p = close < end ? close + 3 : end;
+            } else {
+                close = memchr(lt, '>', end - lt);
+                if (!close && !final) goto incomplete;
+                p = close ? close + 1 : end;
+            }
+            tz->text_start = (size_t)(p - base);
+            continue;
+        }
+
+        p = lt + (is_end_tag ? 2 : 1);
+        const char *name = read_tag_name(s, &p, end);
+        if (p >= end && !final) goto incomplete;
+        if (!name) {
+            /* "</>" or similar: skip the tag */
+            const char *close = memchr(p, '>', end - p);
+            if (!close && !final) goto incomplete;
+            p = close ? close + 1 : end;
+            tz->text_start = (size_t)(p - base);
+            continue;
+        }
+
+        HtmlToken *tok = stream_push_token(s, is_end_tag ? HTML_TOKEN_END_TAG : HTML_TOKEN_START_TAG);
+        if (!tok) return false;
+        tok->name = name;
+
+        if (is_end_tag) {
+            const char *close = memchr(p, '>', end - p);
+            if (!close && !final) goto incomplete;
+            p = close ? close + 1 : end;
+        } else {
+            bool closed;
+            if (!read_attributes(s, tok, &p, end, &closed)) return false;
+            if (!closed && !final) goto incomplete;
+        }
+        tok->span = span_of(base, lt, p);
+        tz->text_start = (size_t)(p - base);
+
+        /* Raw text tags ignore "/>" just like browsers do */
+        if (!is_end_tag && html_is_raw_content_tag(name)) {
+            bool done;
+            tz->raw_name = name;
+            tz->raw_start = (size_t)(p - base);
+            tz->raw_resume = tz->raw_start;
+            memset(&tz->script, 0, sizeof(tz->script));
+            tz->script.resume = tz->raw_start;
+            if (!read_raw_text(tz, final, &done)) return false;
+            if (!done) return true;
+            p = base + tz->pos;
+        }
+        continue;
+
+incomplete:
+        s->count = saved_count;
+        s->attr_count = saved_attr_count;
+        tz->pos = (size_t)(lt - base);
+        return true;
+    }
+
+    tz->pos = (size_t)(p - base);
+    if (final) {
+        if (!emit_text(s, base + tz->text_start, end)) return false;
+        tz->text_start = s->source_len;
+    }
+    return true;
+}
+
+static void tokenizer_setup(HtmlTokenizer *tz, JobArena *arena, HtmlTokenCallback on_token, void *user) {
+    memset(tz, 0, sizeof(*tz));
+    tz->stream.arena = arena;
+    str_set_init(&tz->stream.names, arena);
+    tz->on_token = on_token;
+    tz->user = user;
+}
+
+static void tokenizer_deliver(HtmlTokenizer *tz) {
+    while (tz->delivered < tz->stream.count) {
+        uint32_t index = tz->delivered++;
+        if (tz->on_token) tz->on_token(&tz->stream, index, tz->user);
+    }
+}
+
+bool html_tokenize(const char *html, size_t html_len, JobArena *arena, HtmlTokenStream *out) {
+    if (!out) return false;
+    memset(out, 0, sizeof(*out));
+    if (!html || !arena || html_len > UINT32_MAX) return false;
+
+    HtmlTokenizer tz;
+    tokenizer_setup(&tz, arena, NULL, NULL);
+    tz.stream.source = html;
+    tz.stream.source_len = html_len;
+    if (!tokenize_step(&tz, true)) return false;
+    *out = tz.stream;
+
+    LOG_INFO("Tokenized %zu bytes: %u tokens, %u attributes", html_len, out->count, out->attr_count);
+    return true;
+}
+
+void html_tokenizer_init(HtmlTokenizer *tz, JobArena *arena, HtmlTokenCallback on_token, void *user) {
+    if (!tz) return;
+    tokenizer_setup(tz, arena, on_token, user);
+}
+
+bool html_tokenizer_feed(HtmlTokenizer *tz, const char *data, size_t len) {
+    if (!tz || !tz->stream.arena) return false;
+    if (len == 0) return true;
+    if (!data || tz->stream.source_len + len > UINT32_MAX) return false;
+
+    size_t needed = tz->stream.source_len + len + 1;
+    if (needed > tz->buffer_capacity) {
+        size_t cap = tz->buffer_capacity ? tz->buffer_capacity : 64 * 1024;
+        while (cap < needed) cap *= 2;
+        char *buffer = realloc(tz->buffer, cap);
+        if (!buffer) {
+            LOG_ERROR("Failed to grow tokenizer buffer to %zu bytes", cap);
+            return false;
+        }
+        tz->buffer = buffer;
+        tz->buffer_capacity = cap;
+    }
+    memcpy(tz->buffer + tz->stream.source_len, data, len);
+    tz->stream.source = tz->buffer;
+    tz->stream.source_len += len;
+
+    if (!tokenize_step(tz, false)) return false;
+    tokenizer_deliver(tz);
+    return true;
+}
+
+bool html_tokenizer_finish(HtmlTokenizer *tz) {
+    if (!tz || !tz->stream.arena) return false;
+    if (!tz->buffer) {
+        /* Empty document: still hand out a terminated source */
+        tz->buffer = malloc(1);
+        if (!tz->buffer) return false;
+        tz->buffer_capacity = 1;
+        tz->stream.source = tz->buffer;
+    }
+    tz->buffer[tz->stream.source_len] = '\0';
+
+    if (!tokenize_step(tz, true)) return false;
+    tokenizer_deliver(tz);
+
+    LOG_INFO("Tokenized %zu streamed bytes: %u tokens, %u attributes",
+             tz->stream.source_len, tz->stream.count, tz->stream.attr_count);
+    return true;
+}
+
+void html_tokenizer_free(HtmlTokenizer *tz) {
+    if (!tz) return;
+    free(tz->buffer);
+    tz->buffer = NULL;
+    tz->buffer_capacity = 0;
+    tz->stream.source = NULL;
+    tz->stream.source_len = 0;
+}
+
+/* ============================================================================
+ * Attribute access
+ * ============================================================================ */
+
+bool html_token_attr_name_is(const HtmlTokenStream *stream, const HtmlTokenAttr *attr,
+                             const char *name) {
+    if (!stream || !attr || !name) return false;
+    size_t len = strlen(name);
+    return attr->name.len == len &&
+           strncasecmp(html_span_ptr(stream, attr->name), name, len) == 0;
+}
+
+const HtmlTokenAttr *html_token_find_attr(const HtmlTokenStream *stream, const HtmlToken *token,
+                                          const char *name) {
+    if (!stream || !token) return NULL;
+    for (uint32_t i = 0; i < token->attr_count; i++) {
+        const HtmlTokenAttr *attr = &stream->attrs[token->attr_start + i];
+        if (html_token_attr_name_is(stream, attr, name)) return attr;
+    }
+    return NULL;
+}
+
+const char *html_token_attr_cstr(HtmlTokenStream *stream, const HtmlTokenAttr *attr,
+                                 size_t *out_len) {
+    if (!stream || !attr) return NULL;
+    char *copy = job_arena_strndup(stream->arena, html_span_ptr(stream, attr->value),
+                                   attr->value.len);
+    if (!copy) return NULL;
+    size_t len = attr->value.len;
+    if (attr->value_has_entity) len = (size_t)html_decode_entities(copy, len);
+    if (out_len) *out_len = len;
+    return copy;
+}
@@ -0,0 +1,137 @@
+#ifndef HTML_TOKENIZER_H
+#define HTML_TOKENIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "job_arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Byte range in the source HTML */
+typedef struct HtmlSpan {
+    uint32_t offset;
+    uint32_t len;
+} HtmlSpan;
+
+typedef enum {
+    HTML_TOKEN_START_TAG,
+    HTML_TOKEN_END_TAG,
+    HTML_TOKEN_TEXT,        /* Trimmed; whitespace-only text is dropped */
+    HTML_TOKEN_RAW_TEXT     /* Body of script/style/textarea/title, never decoded */
+} HtmlTokenType;
+
+#define HTML_TOKEN_SELF_CLOSING 0x01
+#define HTML_TOKEN_UNTERMINATED 0x02  /* Raw text ran to the end of the input */
+
+typedef struct HtmlTokenAttr {
+    HtmlSpan name;
+    HtmlSpan value;
+    bool value_has_entity;
+} HtmlTokenAttr;
+
+typedef struct HtmlToken {
+    uint8_t type;
+    uint8_t flags;
+    const char *name;       /* Lowercase, interned; start and end tags only */
+    HtmlSpan span;          /* Text or raw text; the whole tag otherwise */
+    uint32_t attr_start;    /* Index into HtmlTokenStream.attrs */
+    uint32_t attr_count;
+} HtmlToken;
+
+/* One pass over a page. Tokens, attributes and names live in the arena and
+ * point into source, which must outlive the stream. */
+typedef struct HtmlTokenStream {
+    const char *source;
+    size_t source_len;
+    JobArena *arena;
+    StrSet names;
+    HtmlToken *tokens;
+    uint32_t count;
+    uint32_t capacity;
+    HtmlTokenAttr *attrs;
+    uint32_t attr_count;
+    uint32_t attr_capacity;
+} HtmlTokenStream;
+
+/* Tokenizes html into out. Returns false on allocation failure or input
+ * larger than 4GB. Comments, doctypes and processing instructions are skipped. */
+bool html_tokenize(const char *html, size_t html_len, JobArena *arena, HtmlTokenStream *out);
+
+/* ============================================================================
+ * Incremental tokenizing
+ * ============================================================================ */
+
+/* Called once per token, in order, as soon as the token is complete */
+typedef void (*HtmlTokenCallback)(HtmlTokenStream *stream, uint32_t index, void *user);
+
+/* Where the script-end lexer stopped, so a script split across chunks is
+ * scanned once in total */
+typedef struct HtmlScriptScan {
+    uint8_t mode;
+    char quote;
+    size_t resume;
+} HtmlScriptScan;
+
+/* Tokenizes a page as it arrives. Input is copied into a growing buffer
+ * that becomes stream.source; spans are offsets, so tokens already handed
+ * out stay valid when it moves. A construct cut off by the end of a chunk
+ * is held back until the chunk that completes it. */
+typedef struct HtmlTokenizer {
+    HtmlTokenStream stream;
+    char *buffer;
+    size_t buffer_capacity;
+    size_t pos;             /* Next byte to scan */
+    size_t text_start;      /* Start of the pending text run */
+    const char *raw_name;   /* Set while inside a raw text element */
+    size_t raw_start;
+    size_t raw_resume;
+    HtmlScriptScan script;
+    uint32_t delivered;
+    HtmlTokenCallback on_token;
+    void *user;
+} HtmlTokenizer;
+
+void html_tokenizer_init(HtmlTokenizer *tz, JobArena *arena, HtmlTokenCallback on_token, void *user);
+
+/* Appends a chunk and emits every token it completes. Returns false on
+ * allocation failure or input larger than 4GB. */
+bool html_tokenizer_feed(HtmlTokenizer *tz, const char *data, size_t len);
+
+/* Flushes trailing text and unterminated raw text. Afterwards stream.source
+ * is NUL-terminated and stream holds the same tokens html_tokenize would
+ * have produced for the whole input. */
+bool html_tokenizer_finish(HtmlTokenizer *tz);
+
+/* Frees the input buffer; the stream's arena data is left to its arena */
+void html_tokenizer_free(HtmlTokenizer *tz);
+
+static inline const char *html_span_ptr(const HtmlTokenStream *stream, HtmlSpan span) {
+    return stream->source + span.offset;
+}
+
+/* Case-insensitive attribute name match */
+bool html_token_attr_name_is(const HtmlTokenStream *stream, const HtmlTokenAttr *attr,
+                             const char *name);
+
+/* Attribute of a start tag by name, NULL if absent */
+const HtmlTokenAttr *html_token_find_attr(const HtmlTokenStream *stream, const HtmlToken *token,
+                                          const char *name);
+
+/* Entity-decoded, NUL-terminated copy of an attribute value in the arena */
+const char *html_token_attr_cstr(HtmlTokenStream *stream, const HtmlTokenAttr *attr,
+                                 size_t *out_len);
+
+/* Decode HTML entities in place; returns the new length */
+int html_decode_entities(char *str, size_t len);
+
+bool html_is_self_closing_tag(const char *tag_name);
+bool html_is_raw_content_tag(const char *tag_name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,19 +1,20 @@
 #include "http_download.h"
 #include "tls_client.h"
 #include "url_analyzer.h"
+#include "trace_log.h"
 
 #include <jni.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <android/log.h>
 #include <sys/time.h>
 #include <sys/socket.h>
 #include <time.h>
 
 #define LOG_TAG "http_download"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
 
 #define CHUNK_SIZE 8192
 #define MAX_REDIRECTS 5
@@ -28,11 +29,37 @@ typedef struct HttpResponse {
     char cookies[4096];  /* Store cookies from response */
 } HttpResponse;
 
+/* Incremental decoder for chunked bodies that are streamed to a sink */
+enum {
+    CHUNK_STATE_SIZE,
+    CHUNK_STATE_EXTENSION,
+    CHUNK_STATE_DATA,
+    CHUNK_STATE_DATA_END,
+    CHUNK_STATE_DONE
+};
+
+typedef struct ChunkDecoder {
+    int state;
+    size_t remaining;
+} ChunkDecoder;
+
+/* Body delivery while the response is still being read */
+typedef struct BodyStream {
+    HttpBodySink sink;
+    void *user;
+    bool headers_done;
+    bool active;            /* 2xx response: body goes to the sink */
+    bool chunked;
+    size_t consumed;        /* Raw response bytes already handled */
+    ChunkDecoder chunks;
+} BodyStream;
+
 /* Forward declarations */
 static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
-                                      char *err, size_t errLen, const char *cookies);
+                                      char *err, size_t errLen, const char *cookies,
+                                      HttpBodySink sink, void *user);
 static bool http_request(const char *url, HttpBuffer *outBuffer,
-                         char *err, size_t errLen);
+                         char *err, size_t errLen, HttpBodySink sink, void *user);
 
 static bool parse_url(const char *url, char *host, size_t host_len,
                       char *path, size_t path_len, char *port, size_t port_len) {
@@ -68,14 +95,18 @@ static bool parse_url(const char *url, char *host, size_t host_len,
     return true;
 }
 
-/* Global context to pass cookies between requests */
+/* Global context to pass cookies between requests. Script prefetches run
+ * alongside the page download, so every access goes through the lock. */
 static char g_youtube_cookies[4096] = {0};
+static pthread_mutex_t g_cookie_lock = PTHREAD_MUTEX_INITIALIZER;
 
 void http_set_youtube_cookies(const char *cookies) {
     if (cookies) {
+        pthread_mutex_lock(&g_cookie_lock);
         strncpy(g_youtube_cookies, cookies, sizeof(g_youtube_cookies) - 1);
         g_youtube_cookies[sizeof(g_youtube_cookies) - 1] = '\0';
         LOGI("Set YouTube cookies: %.100s...", g_youtube_cookies);
+        pthread_mutex_unlock(&g_cookie_lock);
     }
 }
 
@@ -84,11 +115,117 @@ const char* http_get_youtube_cookies(void) {
 }
 
 void http_clear_youtube_cookies(void) {
+    pthread_mutex_lock(&g_cookie_lock);
     g_youtube_cookies[0] = '\0';
+    pthread_mutex_unlock(&g_cookie_lock);
+}
+
+/* Finds the blank line ending the headers; *delimiter_len is 4 for
+ * \r\n\r\n and 2 for a bare \n\n. data must be NUL-terminated. */
+static char *find_header_end(char *data, size_t *delimiter_len) {
+    char *header_end = strstr(data, "\r\n\r\n");
+    *delimiter_len = 4;
+    if (!header_end) {
+        /* Try to find just \n\n as some servers use that */
+        header_end = strstr(data, "\n\n");
+        *delimiter_len = 2;
+    }
+    return header_end;
+}
+
+static bool is_chunked_response(const char *data, const char *header_end, size_t delimiter_len) {
+    const char *te_header = strstr(data, "Transfer-Encoding:");
+    if (!te_header || te_header >= header_end + delimiter_len) return false;
+    te_header += 18; /* Skip "Transfer-Encoding:" */
+    while (*te_header == ' ') te_header++;
+    return strncasecmp(te_header, "chunked", 7) == 0;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Decodes as much of a chunked body as p..p+len holds, handing chunk data
+ * to the sink. State carries over between calls, so chunk boundaries and
+ * size lines may be split across reads. */
+static bool chunk_decoder_feed(ChunkDecoder *d, const char *p, size_t len,
+                               HttpBodySink sink, void *user) {
+    const char *end = p + len;
+
+    while (p < end && d->state != CHUNK_STATE_DONE) {
+        switch (d->state) {
+        case CHUNK_STATE_SIZE: {
+            char c = *p++;
+            int digit = hex_digit(c);
+            if (digit >= 0) {
+                d->remaining = d->remaining * 16 + (size_t)digit;
+            } else if (c == '\n') {
+                d->state = d->remaining ? CHUNK_STATE_DATA : CHUNK_STATE_DONE;
+            } else {
+                d->state = CHUNK_STATE_EXTENSION;  /* ";ext" or \r up to the newline */
+            }
+            break;
+        }
+        case CHUNK_STATE_EXTENSION:
+            if (*p++ == '\n') {
+                d->state = d->remaining ? CHUNK_STATE_DATA : CHUNK_STATE_DONE;
+            }
+            break;
+        case CHUNK_STATE_DATA: {
+            size_t n = (size_t)(end - p) < d->remaining ? (size_t)(end - p) : d->remaining;
+            if (!sink(p, n, user)) return false;
+            p += n;
+            d->remaining -= n;
+            if (d->remaining == 0) d->state = CHUNK_STATE_DATA_END;
+            break;
+        }
+        case CHUNK_STATE_DATA_END:
+            /* Trailing \r\n after chunk data */
+            if (*p == '\r') {
+                p++;
+            } else {
+                if (*p == '\n') p++;
+                d->state = CHUNK_STATE_SIZE;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+/* Hands newly read body bytes to the sink. Nothing is delivered until the
+ * headers are complete, and only for 2xx responses; redirects and errors
+ * are left to the normal response handling. */
+static bool body_stream_advance(BodyStream *bs, char *data, size_t size) {
+    if (!bs->headers_done) {
+        size_t delimiter_len;
+        char *header_end = find_header_end(data, &delimiter_len);
+        if (!header_end) return true;
+
+        int status = 0;
+        sscanf(data, "HTTP/%*s %d", &status);
+        bs->headers_done = true;
+        bs->active = status >= 200 && status < 300;
+        bs->chunked = is_chunked_response(data, header_end, delimiter_len);
+        bs->consumed = (size_t)(header_end - data) + delimiter_len;
+    }
+    if (!bs->active || bs->consumed >= size) return true;
+
+    const char *p = data + bs->consumed;
+    size_t len = size - bs->consumed;
+    bs->consumed = size;
+    if (bs->chunked) {
+        return chunk_decoder_feed(&bs->chunks, p, len, bs->sink, bs->user);
+    }
+    return bs->sink(p, len, bs->user);
 }
 
 static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
-                         char *err, size_t errLen, const char *cookies) {
+                         char *err, size_t errLen, const char *cookies,
+                         HttpBodySink sink, void *user) {
     char host[256] = {0};
     char path[2048] = {0};
     char port[8] = {0};
@@ -169,6 +306,9 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
     
     size_t capacity = CHUNK_SIZE;
     unsigned char buf[CHUNK_SIZE];
+    BodyStream stream = {0};
+    stream.sink = sink;
+    stream.user = user;
     ssize_t n;
     size_t total_received = 0;
     time_t start_time = time(NULL);
@@ -190,7 +330,8 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
             continue;
         }
         zero_reads = 0;  // Reset counter on successful read
-        if (outBuffer->size + (size_t)n > capacity) {
+        /* Keep room for a terminator so headers can be searched mid-read */
+        while (outBuffer->size + (size_t)n + 1 > capacity) {
             capacity *= 2;
             char *new_data = realloc(outBuffer->data, capacity);
             if (!new_data) {
@@ -204,7 +345,17 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
         }
         memcpy(outBuffer->data + outBuffer->size, buf, (size_t)n);
         outBuffer->size += (size_t)n;
+        outBuffer->data[outBuffer->size] = '\0';
         total_received += (size_t)n;
+
+        if (sink && !body_stream_advance(&stream, outBuffer->data, outBuffer->size)) {
+            LOGI("Body sink stopped the transfer after %zu bytes", total_received);
+            snprintf(err, errLen, "Download cancelled");
+            free(outBuffer->data);
+            outBuffer->data = NULL;
+            tls_client_close(&client);
+            return false;
+        }
         
         // Check for timeout
         if (time(NULL) - start_time > max_read_time) {
@@ -238,11 +389,9 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
         LOGI("Response start: [%s]", debug_buf);
     }
     
-    char *header_end = strstr(outBuffer->data, "\r\n\r\n");
-    if (!header_end) {
-        /* Try to find just \n\n as some servers use that */
-        header_end = strstr(outBuffer->data, "\n\n");
-    }
+    outBuffer->data[outBuffer->size] = '\0';
+    size_t delimiter_len;
+    char *header_end = find_header_end(outBuffer->data, &delimiter_len);
     if (!header_end) {
         snprintf(err, errLen, "Invalid HTTP response (received %zu bytes)", outBuffer->size);
         free(outBuffer->data);
@@ -264,6 +413,7 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
     /* Extract cookies from response headers */
     /* Format: Set-Cookie: NAME=VALUE; Domain=...; Path=...; Expires=... */
     /* We only want NAME=VALUE pairs */
+    pthread_mutex_lock(&g_cookie_lock);
     char *set_cookie = strstr(outBuffer->data, "Set-Cookie:");
     while (set_cookie) {
         set_cookie += 11; /* Skip "Set-Cookie:" */
@@ -348,6 +498,7 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
         /* Look for next Set-Cookie */
         set_cookie = strstr(line_end, "Set-Cookie:");
     }
+    pthread_mutex_unlock(&g_cookie_lock);
     
     /* Handle redirects - but don't follow cross-domain redirects for script/resource downloads */
     if (status >= 300 && status < 400) {
@@ -398,7 +549,7 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
             
             free(outBuffer->data);
             outBuffer->data = NULL;
-            return http_request_with_cookies(redirect_url, outBuffer, err, errLen, NULL);
+            return http_request_with_cookies(redirect_url, outBuffer, err, errLen, NULL, sink, user);
         }
     }
     
@@ -410,26 +561,13 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
     }
     
     /* Move body to start of buffer */
-    /* Check which delimiter was found to calculate correct header length */
-    size_t delimiter_len = 4;  /* Default \r\n\r\n */
-    if (header_end >= outBuffer->data + 1 && 
-        header_end[-1] == '\n' && 
-        (header_end == outBuffer->data || header_end[-2] != '\r')) {
-        delimiter_len = 2;  /* Found \n\n */
-    }
     size_t header_len = (size_t)(header_end - outBuffer->data) + delimiter_len;
     size_t body_len = outBuffer->size - header_len;
     
     /* Check for Transfer-Encoding: chunked */
-    char *te_header = strstr(outBuffer->data, "Transfer-Encoding:");
-    bool is_chunked = false;
-    if (te_header && te_header < header_end + delimiter_len) {
-        te_header += 18; /* Skip "Transfer-Encoding:" */
-        while (*te_header == ' ') te_header++;
-        if (strncasecmp(te_header, "chunked", 7) == 0) {
-            is_chunked = true;
-            LOGI("Detected chunked transfer encoding");
-        }
+    bool is_chunked = is_chunked_response(outBuffer->data, header_end, delimiter_len);
+    if (is_chunked) {
+        LOGI("Detected chunked transfer encoding");
     }
     
     if (is_chunked) {
@@ -498,17 +636,27 @@ static bool http_request_with_cookies(const char *url, HttpBuffer *outBuffer,
 }
 
 static bool http_request(const char *url, HttpBuffer *outBuffer,
-                         char *err, size_t errLen) {
+                         char *err, size_t errLen, HttpBodySink sink, void *user) {
     /* For googlevideo.com URLs, use the saved cookies */
     if (strstr(url, "googlevideo.com")) {
-        return http_request_with_cookies(url, outBuffer, err, errLen, g_youtube_cookies);
+        char cookies[sizeof(g_youtube_cookies)];
+        pthread_mutex_lock(&g_cookie_lock);
+        memcpy(cookies, g_youtube_cookies, sizeof(cookies));
+        pthread_mutex_unlock(&g_cookie_lock);
+        return http_request_with_cookies(url, outBuffer, err, errLen, cookies, sink, user);
     }
-    return http_request_with_cookies(url, outBuffer, err, errLen, NULL);
+    return http_request_with_cookies(url, outBuffer, err, errLen, NULL, sink, user);
 }
 
 bool http_get_to_memory(const char *url, HttpBuffer *outBuffer,
                         char *err, size_t errLen) {
-    return http_request(url, outBuffer, err, errLen);
+    return http_request(url, outBuffer, err, errLen, NULL, NULL);
+}
+
+bool http_get_streaming(const char *url, HttpBuffer *outBuffer,
+                        HttpBodySink sink, void *user,
+                        char *err, size_t errLen) {
+    return http_request(url, outBuffer, err, errLen, sink, user);
 }
 
 void http_free_buffer(HttpBuffer *buffer) {
@@ -527,7 +675,7 @@ bool http_download_to_file(const char *url, const char *filePath,
     (void)user;
     
     HttpBuffer buffer = {0};
-    if (!http_request(url, &buffer, err, errLen)) {
+    if (!http_request(url, &buffer, err, errLen, NULL, NULL)) {
         return false;
     }
     
@@ -19,6 +19,16 @@ typedef struct HttpBuffer {
 bool http_get_to_memory(const char *url, HttpBuffer *outBuffer,
                         char *err, size_t errLen);
 
+/* Receives decoded body bytes of a 2xx response while it is still being
+ * read. Returning false cancels the transfer. */
+typedef bool (*HttpBodySink)(const char *data, size_t len, void *user);
+
+/* Like http_get_to_memory, but the body is also handed to sink chunk by
+ * chunk as it arrives; redirects are followed with the same sink. */
+bool http_get_streaming(const char *url, HttpBuffer *outBuffer,
+                        HttpBodySink sink, void *user,
+                        char *err, size_t errLen);
+
 void http_free_buffer(HttpBuffer *buffer);
 
 // WebView-based downloading
@@ -0,0 +1,151 @@
+#include "job_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN 16
+#define STR_SET_INITIAL_CAPACITY 64
+
+struct JobArenaBlock {
+    JobArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void job_arena_init(JobArena *arena) {
+    arena->head = NULL;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+}
+
+void job_arena_free(JobArena *arena) {
+    JobArenaBlock *block = arena->head;
+    while (block) {
+        JobArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    job_arena_init(arena);
+}
+
+void *job_arena_alloc(JobArena *arena, size_t size) {
+    size = align_up(size ? size : 1);
+
+    JobArenaBlock *block = arena->head;
+    if (!block || block->capacity - block->used < size) {
+        /* Oversized requests get a block of their own */
+        size_t capacity = size > JOB_ARENA_BLOCK_SIZE ? size : JOB_ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(JobArenaBlock) + capacity);
+        if (!block) return NULL;
+        block->used = 0;
+        block->capacity = capacity;
+        if (arena->head && size > JOB_ARENA_BLOCK_SIZE) {
+            /* Keep the partly used block at the head for small allocations */
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+        arena->bytes_reserved += capacity;
+    }
+
+    void *p = block->data + block->used;
+    block->used += size;
+    arena->bytes_used += size;
+    return p;
+}
+
+char *job_arena_strndup(JobArena *arena, const char *s, size_t len) {
+    char *p = job_arena_alloc(arena, len + 1);
+    if (!p) return NULL;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+void *job_arena_grow(JobArena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (new_size <= old_size) return ptr;
+    void *p = job_arena_alloc(arena, new_size);
+    if (!p) return NULL;
+    if (ptr && old_size) memcpy(p, ptr, old_size);
+    return p;
+}
+
+/* FNV-1a */
+static uint32_t str_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void str_set_init(StrSet *set, JobArena *arena) {
+    memset(set, 0, sizeof(*set));
+    set->arena = arena;
+}
+
+static bool str_set_rehash(StrSet *set, uint32_t capacity) {
+    ArenaStr **slots = job_arena_alloc(set->arena, capacity * sizeof(ArenaStr *));
+    if (!slots) return false;
+    memset(slots, 0, capacity * sizeof(ArenaStr *));
+
+    for (uint32_t i = 0; i < set->count; i++) {
+        uint32_t j = set->order[i]->hash & (capacity - 1);
+        while (slots[j]) j = (j + 1) & (capacity - 1);
+        slots[j] = set->order[i];
+    }
+    set->slots = slots;
+    set->capacity = capacity;
+    return true;
+}
+
+const ArenaStr *str_set_intern(StrSet *set, const char *s, size_t len, bool *inserted) {
+    if (inserted) *inserted = false;
+    if (!s || len > UINT32_MAX) return NULL;
+
+    /* Keep the load factor at or below 1/2 */
+    if ((set->count + 1) * 2 > set->capacity &&
+        !str_set_rehash(set, set->capacity ? set->capacity * 2 : STR_SET_INITIAL_CAPACITY)) {
+        return NULL;
+    }
+
+    uint32_t hash = str_hash(s, len);
+    uint32_t j = hash & (set->capacity - 1);
+    while (set->slots[j]) {
+        ArenaStr *cur = set->slots[j];
+        if (cur->hash == hash && cur->len == len && memcmp(cur->data, s, len) == 0) {
+            return cur;
+        }
+        j = (j + 1) & (set->capacity - 1);
+    }
+
+    if (set->count == set->order_capacity) {
+        uint32_t cap = set->order_capacity ? set->order_capacity * 2 : STR_SET_INITIAL_CAPACITY;
+        ArenaStr **order = job_arena_grow(set->arena, set->order,
+                                          set->order_capacity * sizeof(ArenaStr *),
+                                          cap * sizeof(ArenaStr *));
+        if (!order) return NULL;
+        set->order = order;
+        set->order_capacity = cap;
+    }
+
+    ArenaStr *str = job_arena_alloc(set->arena, sizeof(ArenaStr) + len + 1);
+    if (!str) return NULL;
+    str->len = (uint32_t)len;
+    str->hash = hash;
+    memcpy(str->data, s, len);
+    str->data[len] = '\0';
+
+    set->slots[j] = str;
+    set->order[set->count++] = str;
+    if (inserted) *inserted = true;
+    return str;
+}
@@ -0,0 +1,73 @@
+#ifndef JOB_ARENA_H
+#define JOB_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JOB_ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Bump allocator for data that lives exactly as long as one extraction job.
+ * Nothing is freed individually; job_arena_free releases every block at once. */
+typedef struct JobArenaBlock JobArenaBlock;
+
+typedef struct JobArena {
+    JobArenaBlock *head;
+    size_t bytes_used;
+    size_t bytes_reserved;
+} JobArena;
+
+/* Length-prefixed string stored in an arena, always NUL terminated */
+typedef struct ArenaStr {
+    uint32_t len;
+    uint32_t hash;
+    char data[];
+} ArenaStr;
+
+/* Non-owning view of a string in an arena */
+typedef struct StrView {
+    const char *ptr;
+    size_t len;
+} StrView;
+
+void job_arena_init(JobArena *arena);
+void job_arena_free(JobArena *arena);
+void *job_arena_alloc(JobArena *arena, size_t size);
+
+/* Copies len bytes plus a terminating NUL */
+char *job_arena_strndup(JobArena *arena, const char *s, size_t len);
+
+/* Grows an array allocated from the arena to new_size bytes; the old copy is
+ * left behind until the arena is freed. */
+void *job_arena_grow(JobArena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/* Set of interned strings, kept in insertion order */
+typedef struct StrSet {
+    JobArena *arena;
+    ArenaStr **slots;      /* Open addressing, power-of-two capacity */
+    uint32_t capacity;
+    ArenaStr **order;      /* Insertion order */
+    uint32_t count;
+    uint32_t order_capacity;
+} StrSet;
+
+void str_set_init(StrSet *set, JobArena *arena);
+
+/* Interns s. Returns the stored string, or NULL on allocation failure.
+ * inserted (optional) is set to false if s was already present. */
+const ArenaStr *str_set_intern(StrSet *set, const char *s, size_t len, bool *inserted);
+
+static inline StrView str_set_view(const StrSet *set, uint32_t index) {
+    StrView v = { set->order[index]->data, set->order[index]->len };
+    return v;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,400 @@
+#include "js_event_loop.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace_log.h"
+
+#define LOG_TAG "js_event_loop"
+
+#define TIMER_MAX_ARGS 16
+
+/* Pending timers are keyed by id on a non-enumerable global object, so the
+ * GC sees their callbacks and arguments through the global; the heap only
+ * orders them. clearTimeout deletes the key and the heap entry is skipped
+ * when it comes up. */
+#define CALLBACKS_PROP "__bgmdwnldr_timers"
+
+typedef struct JsTimer {
+    double due;
+    uint32_t seq;               /* Keeps timers due at the same time in FIFO order */
+    int32_t id;
+    double interval;            /* < 0 for one-shot timers */
+    int nesting;
+    bool frame;                 /* requestAnimationFrame: called with the frame time */
+} JsTimer;
+
+typedef struct JsEventLoop {
+    JsTimer *heap;              /* Min-heap on (due, seq) */
+    uint32_t count;
+    uint32_t capacity;
+    double now;
+    uint32_t next_seq;
+    int32_t next_id;
+    int nesting;                /* Nesting level of the timer running, 0 outside */
+    bool interrupted;           /* The last callback was interrupted */
+    GCValue callbacks;
+} JsEventLoop;
+
+/* Clock for contexts without a loop, so performance.now still moves */
+static double g_detached_clock = 0.0;
+
+static JsEventLoop *loop_of(JSContext *ctx) {
+    return ctx ? (JsEventLoop *)JS_GetContextOpaque(ctx) : NULL;
+}
+
+/* Logs and clears the pending exception. Returns false when it was an
+ * interrupt, after which nothing more should run. */
+static bool log_exception(JSContext *ctx, const char *what) {
+    bool interrupted = JS_IsUncatchableException(ctx);
+    GCValue exception = JS_GetException(ctx);
+    const char *error = JS_ToCString(ctx, exception);
+    TLOG_WARN(LOG_TAG, "%s threw exception: %s", what, error ? error : "(null)");
+    JS_FreeCString(ctx, error);
+    return !interrupted;
+}
+
+/* ============================================================================
+ * Timer heap
+ * ============================================================================ */
+
+static bool timer_before(const JsTimer *a, const JsTimer *b) {
+    if (a->due != b->due) return a->due < b->due;
+    return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static bool heap_push(JsEventLoop *loop, JsTimer timer) {
+    if (loop->count == loop->capacity) {
+        uint32_t capacity = loop->capacity ? loop->capacity * 2 : 32;
+        JsTimer *heap = realloc(loop->heap, capacity * sizeof(JsTimer));
+        if (!heap) return false;
+        loop->heap = heap;
+        loop->capacity = capacity;
+    }
+
+    timer.seq = loop->next_seq++;
+    uint32_t i = loop->count++;
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!timer_before(&timer, &loop->heap[parent])) break;
+        loop->heap[i] = loop->heap[parent];
+        i = parent;
+    }
+    loop->heap[i] = timer;
+    return true;
+}
+
+static JsTimer heap_pop(JsEventLoop *loop) {
+    JsTimer top = loop->heap[0];
+    JsTimer last = loop->heap[--loop->count];
+    uint32_t i = 0;
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= loop->count) break;
+        if (child + 1 < loop->count && timer_before(&loop->heap[child + 1], &loop->heap[child])) {
+            child++;
+        }
+        if (!timer_before(&loop->heap[child], &last)) break;
+        loop->heap[i] = loop->heap[child];
+        i = child;
+    }
+    if (loop->count > 0) loop->heap[i] = last;
+    return top;
+}
+
+/* ============================================================================
+ * Callback table
+ * ============================================================================ */
+
+static GCValue callback_entry(JSContext *ctx, JsEventLoop *loop, int32_t id) {
+    return JS_GetPropertyUint32(ctx, loop->callbacks, (uint32_t)id);
+}
+
+static void callback_remove(JSContext *ctx, JsEventLoop *loop, int32_t id) {
+    JSAtom atom = JS_NewAtomUInt32(ctx, (uint32_t)id);
+    JS_DeleteProperty(ctx, loop->callbacks, atom, 0);
+    JS_FreeAtom(ctx, atom);
+}
+
+/* Stores [callback, args...] under a new id and queues the timer */
+static GCValue schedule(JSContext *ctx, int argc, GCValue *argv, int first_arg, JsTimer timer) {
+    JsEventLoop *loop = loop_of(ctx);
+    if (!loop) return JS_NewInt32(ctx, 0);
+
+    GCValue entry = JS_NewArray(ctx);
+    if (JS_IsException(entry)) return entry;
+    JS_SetPropertyUint32(ctx, entry, 0, argc > 0 ? argv[0] : JS_UNDEFINED);
+    for (int i = first_arg; i < argc && i - first_arg < TIMER_MAX_ARGS; i++) {
+        JS_SetPropertyUint32(ctx, entry, (uint32_t)(i - first_arg + 1), argv[i]);
+    }
+
+    timer.id = loop->next_id++;
+    timer.nesting = loop->nesting + 1;
+    if (!heap_push(loop, timer)) return JS_ThrowOutOfMemory(ctx);
+    JS_SetPropertyUint32(ctx, loop->callbacks, (uint32_t)timer.id, entry);
+    return JS_NewInt32(ctx, timer.id);
+}
+
+static double delay_arg(JSContext *ctx, JsEventLoop *loop, int argc, GCValue *argv) {
+    double delay = 0.0;
+    if (argc > 1 && JS_ToFloat64(ctx, &delay, argv[1]) < 0) {
+        JS_GetException(ctx);   /* Clear it; bad delays count as 0 */
+        delay = 0.0;
+    }
+    if (!(delay > 0.0)) delay = 0.0;    /* Also catches NaN */
+    if (loop->nesting + 1 > JS_LOOP_NESTING_CLAMP && delay < JS_LOOP_MIN_NESTED_DELAY_MS) {
+        delay = JS_LOOP_MIN_NESTED_DELAY_MS;
+    }
+    return delay;
+}
+
+/* ============================================================================
+ * JS bindings
+ * ============================================================================ */
+
+static GCValue js_set_timeout(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    (void)this_val;
+    JsEventLoop *loop = loop_of(ctx);
+    if (!loop) return JS_NewInt32(ctx, 0);
+    JsTimer timer = { .interval = -1.0 };
+    timer.due = loop->now + delay_arg(ctx, loop, argc, argv);
+    return schedule(ctx, argc, argv, 2, timer);
+}
+
+static GCValue js_set_interval(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    (void)this_val;
+    JsEventLoop *loop = loop_of(ctx);
+    if (!loop) return JS_NewInt32(ctx, 0);
+    double delay = delay_arg(ctx, loop, argc, argv);
+    JsTimer timer = { .interval = delay };
+    timer.due = loop->now + delay;
+    return schedule(ctx, argc, argv, 2, timer);
+}
+
+static GCValue js_request_animation_frame(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    (void)this_val;
+    JsEventLoop *loop = loop_of(ctx);
+    if (!loop) return JS_NewInt32(ctx, 0);
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0])) {
+        return JS_ThrowTypeError(ctx, "requestAnimationFrame: callback is not a function");
+    }
+    JsTimer timer = { .interval = -1.0, .frame = true };
+    timer.due = (floor(loop->now / JS_LOOP_FRAME_MS) + 1.0) * JS_LOOP_FRAME_MS;
+    return schedule(ctx, 1, argv, 1, timer);
+}
+
+/* clearTimeout, clearInterval and cancelAnimationFrame share one id space */
+static GCValue js_clear_timer(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    (void)this_val;
+    JsEventLoop *loop = loop_of(ctx);
+    int32_t id = 0;
+    if (loop && argc > 0 && JS_IsNumber(argv[0]) && JS_ToInt32(ctx, &id, argv[0]) == 0 && id > 0) {
+        callback_remove(ctx, loop, id);
+    }
+    return JS_UNDEFINED;
+}
+
+static GCValue js_microtask_job(JSContext *ctx, int argc, GCValue *argv) {
+    (void)argc;
+    return JS_Call(ctx, argv[0], JS_UNDEFINED, 0, NULL);
+}
+
+static GCValue js_queue_microtask(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
+    (void)this_val;
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0])) {
+        return JS_ThrowTypeError(ctx, "queueMicrotask: callback is not a function");
+    }
+    if (JS_EnqueueJob(ctx, js_microtask_job, 1, argv) < 0) return JS_ThrowOutOfMemory(ctx);
+    return JS_UNDEFINED;
+}
+
+/* ============================================================================
+ * Running
+ * ============================================================================ */
+
+/* Runs the timer's callback. Returns false when it had been cleared. */
+static bool fire_timer(JSContext *ctx, JsEventLoop *loop, const JsTimer *timer, JsLoopStats *stats) {
+    GCValue entry = callback_entry(ctx, loop, timer->id);
+    if (!JS_IsObject(entry)) return false;
+    if (timer->interval < 0) callback_remove(ctx, loop, timer->id);
+
+    GCValue callback = JS_GetPropertyUint32(ctx, entry, 0);
+    GCValue args[TIMER_MAX_ARGS];
+    int argc = 0;
+    if (timer->frame) {
+        args[argc++] = JS_NewFloat64(ctx, timer->due);
+    } else {
+        int32_t length = 0;
+        JS_ToInt32(ctx, &length, JS_GetPropertyStr(ctx, entry, "length"));
+        for (int i = 1; i < length && argc < TIMER_MAX_ARGS; i++) {
+            args[argc++] = JS_GetPropertyUint32(ctx, entry, (uint32_t)i);
+        }
+    }
+
+    loop->nesting = timer->nesting;
+    GCValue result;
+    if (JS_IsFunction(ctx, callback)) {
+        result = JS_Call(ctx, callback, JS_UNDEFINED, argc, args);
+    } else {
+        /* setTimeout("code", delay) */
+        size_t len = 0;
+        const char *code = JS_ToCStringLen(ctx, &len, callback);
+        result = code ? JS_Eval(ctx, code, len, "<timer>", JS_EVAL_TYPE_GLOBAL) : JS_EXCEPTION;
+        JS_FreeCString(ctx, code);
+    }
+    loop->nesting = 0;
+
+    stats->timers_run++;
+    if (JS_IsException(result)) {
+        stats->exceptions++;
+        if (!log_exception(ctx, timer->frame ? "Animation frame callback" : "Timer callback")) {
+            loop->interrupted = true;
+        }
+    }
+
+    /* An interval is re-armed unless its callback cleared it */
+    if (timer->interval >= 0 && JS_IsObject(callback_entry(ctx, loop, timer->id))) {
+        JsTimer next = *timer;
+        next.due = loop->now + timer->interval;
+        if (++next.nesting > JS_LOOP_NESTING_CLAMP && next.due < loop->now + JS_LOOP_MIN_NESTED_DELAY_MS) {
+            next.due = loop->now + JS_LOOP_MIN_NESTED_DELAY_MS;
+        }
+        if (!heap_push(loop, next)) callback_remove(ctx, loop, timer->id);
+    }
+    return true;
+}
+
+uint32_t js_event_loop_drain_microtasks(JSContext *ctx, uint32_t max_jobs, JsLoopStats *stats) {
+    if (!ctx) return 0;
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    uint32_t ran = 0;
+    while (max_jobs == 0 || ran < max_jobs) {
+        JSContext *job_ctx = NULL;
+        int ret = JS_ExecutePendingJob(rt, &job_ctx);
+        if (ret == 0) break;
+        ran++;
+        if (ret < 0) {
+            if (stats) stats->exceptions++;
+            if (!log_exception(job_ctx ? job_ctx : ctx, "Microtask")) {
+                JsEventLoop *loop = loop_of(ctx);
+                if (loop) loop->interrupted = true;
+                break;
+            }
+        }
+    }
+    if (stats) stats->jobs_run += ran;
+    return ran;
+}
+
+JsLoopStatus js_event_loop_run(JSContext *ctx, double max_virtual_ms, uint32_t max_steps,
+                               JsLoopStats *stats) {
+    JsLoopStats local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+
+    JsEventLoop *loop = loop_of(ctx);
+    if (!loop) return JS_LOOP_NOT_INSTALLED;
+
+    stats->start_ms = loop->now;
+    double deadline = loop->now + max_virtual_ms;
+    uint32_t steps = 0;
+    JsLoopStatus status;
+
+    loop->interrupted = false;
+    for (;;) {
+        steps += js_event_loop_drain_microtasks(ctx, max_steps ? max_steps - steps : 0, stats);
+        if (loop->interrupted) {
+            status = JS_LOOP_INTERRUPTED;
+            break;
+        }
+        if (max_steps && steps >= max_steps) {
+            status = JS_LOOP_STEP_BUDGET;
+            break;
+        }
+
+        /* Drop cleared timers first so they don't hold off idleness */
+        while (loop->count > 0 && !JS_IsObject(callback_entry(ctx, loop, loop->heap[0].id))) {
+            heap_pop(loop);
+        }
+        if (loop->count == 0) {
+            status = JS_LOOP_IDLE;
+            break;
+        }
+        if (loop->heap[0].due > deadline) {
+            status = JS_LOOP_TIME_BUDGET;
+            break;
+        }
+
+        /* Fast-forward instead of waiting */
+        JsTimer timer = heap_pop(loop);
+        if (timer.due > loop->now) loop->now = timer.due;
+        if (fire_timer(ctx, loop, &timer, stats)) steps++;
+        if (loop->interrupted) {
+            status = JS_LOOP_INTERRUPTED;
+            break;
+        }
+    }
+
+    stats->end_ms = loop->now;
+    TLOG_DEBUG(LOG_TAG, "Loop stopped (status %d): %u timers, %u jobs, %u exceptions, "
+               "virtual %.1f -> %.1f ms, %u timers pending",
+               status, stats->timers_run, stats->jobs_run, stats->exceptions,
+               stats->start_ms, stats->end_ms, loop->count);
+    return status;
+}
+
+/* ============================================================================
+ * Setup
+ * ============================================================================ */
+
+double js_event_loop_now(JSContext *ctx) {
+    JsEventLoop *loop = loop_of(ctx);
+    return loop ? loop->now : g_detached_clock;
+}
+
+double js_event_loop_advance(JSContext *ctx, double ms) {
+    JsEventLoop *loop = loop_of(ctx);
+    double *clock = loop ? &loop->now : &g_detached_clock;
+    if (ms > 0.0) *clock += ms;
+    return *clock;
+}
+
+bool js_event_loop_install(JSContext *ctx, GCValue global) {
+    if (!ctx || loop_of(ctx)) return false;
+
+    JsEventLoop *loop = calloc(1, sizeof(JsEventLoop));
+    if (!loop) return false;
+    loop->next_id = 1;
+    loop->callbacks = JS_NewObject(ctx);
+    if (JS_IsException(loop->callbacks) ||
+        JS_DefinePropertyValueStr(ctx, global, CALLBACKS_PROP, loop->callbacks, 0) < 0) {
+        TLOG_ERROR(LOG_TAG, "Failed to create the timer callback table");
+        free(loop);
+        return false;
+    }
+    JS_SetContextOpaque(ctx, loop);
+
+    JS_SetPropertyStr(ctx, global, "setTimeout",
+        JS_NewCFunction(ctx, js_set_timeout, "setTimeout", 2));
+    JS_SetPropertyStr(ctx, global, "setInterval",
+        JS_NewCFunction(ctx, js_set_interval, "setInterval", 2));
+    JS_SetPropertyStr(ctx, global, "clearTimeout",
+        JS_NewCFunction(ctx, js_clear_timer, "clearTimeout", 1));
+    JS_SetPropertyStr(ctx, global, "clearInterval",
+        JS_NewCFunction(ctx, js_clear_timer, "clearInterval", 1));
+    JS_SetPropertyStr(ctx, global, "requestAnimationFrame",
+        JS_NewCFunction(ctx, js_request_animation_frame, "requestAnimationFrame", 1));
+    JS_SetPropertyStr(ctx, global, "cancelAnimationFrame",
+        JS_NewCFunction(ctx, js_clear_timer, "cancelAnimationFrame", 1));
+    JS_SetPropertyStr(ctx, global, "queueMicrotask",
+        JS_NewCFunction(ctx, js_queue_microtask, "queueMicrotask", 1));
+    return true;
+}
+
+void js_event_loop_free(JSContext *ctx) {
+    JsEventLoop *loop = loop_of(ctx);
+    if (!loop) return;
+    JS_SetContextOpaque(ctx, NULL);
+    free(loop->heap);
+    free(loop);
+}
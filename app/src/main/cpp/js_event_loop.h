@@ -0,0 +1,72 @@
+#ifndef JS_EVENT_LOOP_H
+#define JS_EVENT_LOOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "quickjs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Event loop for the browser environment: setTimeout, setInterval,
+ * requestAnimationFrame and queueMicrotask on a virtual clock.
+ *
+ * Nothing ever sleeps. When only timers are left, the clock jumps to the
+ * earliest one, so a page that waits 2 seconds before starting its player
+ * costs the CPU time of its callbacks and nothing more, and runs the same
+ * way every time. Microtasks (promise reactions and queueMicrotask) are
+ * drained after every timer callback, as in a browser. */
+
+/* Frame period requestAnimationFrame callbacks are aligned to */
+#define JS_LOOP_FRAME_MS (1000.0 / 60.0)
+
+/* As in HTML, timers nested deeper than this are clamped to 4 ms */
+#define JS_LOOP_NESTING_CLAMP 5
+#define JS_LOOP_MIN_NESTED_DELAY_MS 4.0
+
+typedef enum {
+    JS_LOOP_IDLE = 0,           /* No timers or microtasks left */
+    JS_LOOP_TIME_BUDGET,        /* Timers left, but due after the time budget */
+    JS_LOOP_STEP_BUDGET,        /* Callback budget used up */
+    JS_LOOP_INTERRUPTED,        /* A callback was interrupted, see JS_SetInterruptHandler */
+    JS_LOOP_NOT_INSTALLED
+} JsLoopStatus;
+
+typedef struct JsLoopStats {
+    uint32_t timers_run;
+    uint32_t jobs_run;
+    uint32_t exceptions;
+    double start_ms;            /* Virtual clock before and after the run */
+    double end_ms;
+} JsLoopStats;
+
+/* Binds the timer functions and queueMicrotask onto global and attaches
+ * the loop to ctx. Call once per context. */
+bool js_event_loop_install(JSContext *ctx, GCValue global);
+
+/* Detaches and frees the loop; pending timers are dropped. Call before
+ * JS_FreeContext. */
+void js_event_loop_free(JSContext *ctx);
+
+/* Current virtual time in milliseconds */
+double js_event_loop_now(JSContext *ctx);
+
+/* Moves the virtual clock forward by ms and returns the new time */
+double js_event_loop_advance(JSContext *ctx, double ms);
+
+/* Runs pending microtasks, at most max_jobs of them (0 for no limit), and
+ * stops early if one is interrupted. Returns the number run. */
+uint32_t js_event_loop_drain_microtasks(JSContext *ctx, uint32_t max_jobs, JsLoopStats *stats);
+
+/* Runs timers and microtasks until nothing is left, the next timer is due
+ * more than max_virtual_ms after the current time, or max_steps callbacks
+ * have run. stats may be NULL. */
+JsLoopStatus js_event_loop_run(JSContext *ctx, double max_virtual_ms, uint32_t max_steps,
+                               JsLoopStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
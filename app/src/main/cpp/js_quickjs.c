@@ -3,8 +3,8 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <ctype.h>
-#include <android/log.h>
 #include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 #include "js_quickjs.h"
 #include "cutils.h"
@@ -13,46 +13,9 @@
 #include "browser_stubs.h"
 #include "html_dom.h"
 #include "gc_value_helpers.h"
-
-/* File logging for emulator testing */
-static void log_to_file(const char *tag, const char *fmt, ...) {
-    static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
-    static int log_fd = -1;
-    
-    pthread_mutex_lock(&log_mutex);
-    
-    if (log_fd < 0) {
-        log_fd = open("/data/data/com.bgmdwldr.vulkan/js_debug.log", 
-                      O_WRONLY | O_CREAT | O_APPEND, 0644);
-    }
-    
-    if (log_fd >= 0) {
-        char buf[2048];
-        int n = snprintf(buf, sizeof(buf), "[%s] ", tag);
-        
-        va_list args;
-        va_start(args, fmt);
-        n += vsnprintf(buf + n, sizeof(buf) - n, fmt, args);
-        va_end(args);
-        
-        if (n < sizeof(buf) - 1) {
-            buf[n++] = '\n';
-        }
-        
-        write(log_fd, buf, n);
-        fsync(log_fd);
-    }
-    
-    pthread_mutex_unlock(&log_mutex);
-    
-    // Also log to logcat
-    va_list args2;
-    va_start(args2, fmt);
-    __android_log_vprint(ANDROID_LOG_INFO, tag, fmt, args2);
-    va_end(args2);
-}
-
-#define MAX_CAPTURED_URLS 64
+#include "job_arena.h"
+#include "js_event_loop.h"
+#include "trace_log.h"
 
 // Global asset manager for loading browser stubs
 static AAssetManager *g_asset_mgr = NULL;
@@ -63,6 +26,11 @@ void js_quickjs_set_asset_manager(AAssetManager *mgr) {
 }
 #define URL_MAX_LEN 2048
 
+/* Deferred work run after the page's scripts: virtual time the page may
+ * wait for, and the most timer callbacks and microtasks to run */
+#define JS_EXEC_LOOP_VIRTUAL_MS 30000.0
+#define JS_EXEC_LOOP_MAX_STEPS 20000
+
 // Forward declarations
 static GCValue js_dummy_function(JSContext *ctx, GCValue this_val, int argc, GCValue *argv);
 
@@ -70,15 +38,23 @@ static JSClassID js_http_response_class_id;
 JSClassID js_xhr_class_id = 0;
 JSClassID js_video_class_id = 0;
 
-// Global state for URL capture
-static char g_captured_urls[MAX_CAPTURED_URLS][URL_MAX_LEN];
-static int g_captured_url_count = 0;
+// Global state for URL capture: URLs are interned into a per-job arena and
+// released together by js_quickjs_clear_captured_urls()
+static JobArena g_capture_arena = {0};
+static StrSet g_captured_urls = {0};
 static pthread_mutex_t g_url_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* Global QuickJS runtime and context - initialized once in android_main */
 JSRuntime *g_js_runtime = NULL;
 JSContext *g_js_context = NULL;
 
+/* Parsed page answering the document lookups; lives as long as the runtime,
+ * since timers and callbacks keep calling the bound functions */
+static HtmlDocument *g_page_doc = NULL;
+
+// Set once page scripts have run in g_js_context
+static bool g_context_used = false;
+
 // Record a captured URL
 // BUG FIX #1: Fixed buffer overflow using memcpy with explicit length validation
 void record_captured_url(const char *url) {
@@ -89,32 +65,21 @@ void record_captured_url(const char *url) {
         return;
     }
     
-    /* Log captured URL for debugging decryption */
-    /* Check if URL has signature (decrypted) or needs decryption */
-    bool has_sig = strstr(url, "sig=") != NULL || strstr(url, "signature=") != NULL;
-    bool has_cipher = strstr(url, "signatureCipher=") != NULL || strstr(url, "sc=") != NULL;
-    const char *url_type = has_sig ? "[DECRYPTED]" : (has_cipher ? "[ENCRYPTED]" : "[PLAIN]");
-    
-    log_to_file("js_quickjs", "[URL_CAPTURED] %s %s", url_type, url);
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "[URL_CAPTURED] %s %s", url_type, url);
-    
-    pthread_mutex_lock(&g_url_mutex);
-    
-    // Check for duplicates
-    for (int i = 0; i < g_captured_url_count; i++) {
-        if (strcmp(g_captured_urls[i], url) == 0) {
-            pthread_mutex_unlock(&g_url_mutex);
-            return;
-        }
+    /* Log captured URL for debugging decryption. The classification is
+     * only worth computing when the record is going to be written. */
+    if (TLOG_ENABLED(TLOG_LEVEL_INFO)) {
+        bool has_sig = strstr(url, "sig=") != NULL || strstr(url, "signature=") != NULL;
+        bool has_cipher = strstr(url, "signatureCipher=") != NULL || strstr(url, "sc=") != NULL;
+        const char *url_type = has_sig ? "[DECRYPTED]" : (has_cipher ? "[ENCRYPTED]" : "[PLAIN]");
+        TLOG_INFO("js_quickjs", "[URL_CAPTURED] %s %s", url_type, url);
     }
     
-    // Add new URL using memcpy for safe copy
-    if (g_captured_url_count < MAX_CAPTURED_URLS) {
-        memcpy(g_captured_urls[g_captured_url_count], url, url_len);
-        g_captured_urls[g_captured_url_count][url_len] = '\0';
-        g_captured_url_count++;
+    pthread_mutex_lock(&g_url_mutex);
+    if (!g_captured_urls.arena) {
+        str_set_init(&g_captured_urls, &g_capture_arena);
     }
-    
+    // Duplicates are dropped by the set
+    str_set_intern(&g_captured_urls, url, url_len, NULL);
     pthread_mutex_unlock(&g_url_mutex);
 }
 
@@ -141,6 +106,16 @@ static void js_xhr_finalizer(JSRuntime *rt, GCValue val) {
     }
 }
 
+static void js_xhr_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    XMLHttpRequest *xhr = JS_GetOpaque(val, js_xhr_class_id);
+    if (xhr) {
+        JS_MarkValue(rt, xhr->onload, mark_func);
+        JS_MarkValue(rt, xhr->onerror, mark_func);
+        JS_MarkValue(rt, xhr->onreadystatechange, mark_func);
+        JS_MarkValue(rt, xhr->headers, mark_func);
+    }
+}
+
 GCValue js_xhr_constructor(JSContext *ctx, GCValue new_target, int argc, GCValue *argv) {
     XMLHttpRequest *xhr = calloc(1, sizeof(XMLHttpRequest));
     if (!xhr) return JS_EXCEPTION;
@@ -263,16 +238,37 @@ typedef struct {
     GCValue onplaying;
     GCValue onerror;
     JSContext *ctx;
+    struct HtmlNodeRef *node_ref;  // Parsed <video> node caching this wrapper
 } HTMLVideoElement;
 
 static void js_video_finalizer(JSRuntime *rt, GCValue val) {
     HTMLVideoElement *vid = JS_GetOpaque(val, js_video_class_id);
     if (vid) {
         // Note: GCValue fields are automatically garbage collected, no cleanup needed
+        html_node_ref_release(vid->node_ref);
         free(vid);
     }
 }
 
+static void js_video_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func) {
+    HTMLVideoElement *vid = JS_GetOpaque(val, js_video_class_id);
+    if (vid) {
+        JS_MarkValue(rt, vid->onloadstart, mark_func);
+        JS_MarkValue(rt, vid->onloadedmetadata, mark_func);
+        JS_MarkValue(rt, vid->oncanplay, mark_func);
+        JS_MarkValue(rt, vid->onplay, mark_func);
+        JS_MarkValue(rt, vid->onplaying, mark_func);
+        JS_MarkValue(rt, vid->onerror, mark_func);
+    }
+}
+
+bool js_video_set_node_ref(GCValue obj, struct HtmlNodeRef *ref) {
+    HTMLVideoElement *vid = JS_GetOpaque(obj, js_video_class_id);
+    if (!vid) return false;
+    vid->node_ref = ref;
+    return true;
+}
+
 GCValue js_video_constructor(JSContext *ctx, GCValue new_target, int argc, GCValue *argv) {
     HTMLVideoElement *vid = calloc(1, sizeof(HTMLVideoElement));
     if (!vid) return JS_EXCEPTION;
@@ -501,43 +497,20 @@ GCValue js_document_create_element(JSContext *ctx, GCValue this_val, int argc, G
             // Generic element
             elem = JS_NewObject(ctx);
         }
+        // Document lookups match attached elements by tagName
+        if (!JS_IsException(elem)) {
+            char upper[64];
+            size_t n = 0;
+            for (; tag[n] && n < sizeof(upper) - 1; n++) upper[n] = (char)toupper((unsigned char)tag[n]);
+            upper[n] = '\0';
+            JS_SetPropertyStr(ctx, elem, "tagName", JS_NewString(ctx, upper));
+        }
     }
     
     JS_FreeCString(ctx, tag);
     return elem;
 }
 
-static GCValue js_document_get_element_by_id(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
-    // Return null - YouTube will create its own elements
-    return JS_NULL;
-}
-
-static GCValue js_document_query_selector(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
-    return JS_NULL;
-}
-
-static GCValue js_document_query_selector_all(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
-    return JS_NewArray(ctx);
-}
-
-static GCValue js_document_get_head(JSContext *ctx, GCValue this_val) {
-    GCValue head = JS_NewObject(ctx);
-    JS_SetPropertyStr(ctx, head, "appendChild", JS_NewCFunction(ctx, js_dummy_function, "appendChild", 1));
-    return head;
-}
-
-static GCValue js_document_get_body(JSContext *ctx, GCValue this_val) {
-    GCValue body = JS_NewObject(ctx);
-    JS_SetPropertyStr(ctx, body, "appendChild", JS_NewCFunction(ctx, js_dummy_function, "appendChild", 1));
-    return body;
-}
-
-static GCValue js_document_get_document_element(JSContext *ctx, GCValue this_val) {
-    GCValue html = JS_NewObject(ctx);
-    JS_SetPropertyStr(ctx, html, "getAttribute", JS_NewCFunction(ctx, js_dummy_function, "getAttribute", 1));
-    return html;
-}
-
 static GCValue js_element_set_attribute(JSContext *ctx, GCValue this_val, int argc, GCValue *argv) {
     return JS_UNDEFINED;
 }
@@ -575,7 +548,7 @@ static GCValue js_bgmdwnldr_log(JSContext *ctx, GCValue this_val, int argc, GCVa
     for (int i = 0; i < argc; i++) {
         const char *str = JS_ToCString(ctx, argv[i]);
         if (str) {
-            __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "[JS] %s", str);
+            TLOG_INFO("js_quickjs", "[JS] %s", str);
             JS_FreeCString(ctx, str);
         }
     }
@@ -655,25 +628,25 @@ void js_quickjs_on_global_var_defined(JSContext *ctx, JSAtom var_name)
 
 // Initialize browser environment
 static void init_browser_environment(JSContext *ctx, AAssetManager *asset_mgr) {
-    log_to_file("js_quickjs", "init_browser_environment starting...");
+    TLOG_DEBUG("js_quickjs", "init_browser_environment starting...");
     
-    log_to_file("js_quickjs", "Getting global object...");
+    TLOG_DEBUG("js_quickjs", "Getting global object...");
     GCValue global = JS_GetGlobalObject(ctx);
     
     // Register native logging function
-    log_to_file("js_quickjs", "Registering __bgmdwnldr_log...");
+    TLOG_DEBUG("js_quickjs", "Registering __bgmdwnldr_log...");
     GCValue log_func = JS_NewCFunction(ctx, js_bgmdwnldr_log, "__bgmdwnldr_log", 1);
-    log_to_file("js_quickjs", "Created C function, setting property...");
+    TLOG_DEBUG("js_quickjs", "Created C function, setting property...");
     JS_SetPropertyStr(ctx, global, "__bgmdwnldr_log", log_func);
-    log_to_file("js_quickjs", "Property set");
+    TLOG_DEBUG("js_quickjs", "Property set");
     
     // Initialize all browser stubs (DOM, window, document, XMLHttpRequest, etc.)
     // This sets up constructors, prototype chains, and document.body
-    log_to_file("js_quickjs", "Calling init_browser_stubs...");
+    TLOG_DEBUG("js_quickjs", "Calling init_browser_stubs...");
     init_browser_stubs(ctx, global);
-    log_to_file("js_quickjs", "init_browser_stubs complete");
+    TLOG_DEBUG("js_quickjs", "init_browser_stubs complete");
     
-    log_to_file("js_quickjs", "init_browser_environment complete");
+    TLOG_DEBUG("js_quickjs", "init_browser_environment complete");
     
     // Note: This QuickJS uses garbage collection, no need to free values explicitly
     (void)global;  // Suppress unused warning
@@ -703,71 +676,108 @@ void js_quickjs_reset_class_ids(void) {
     js_quickjs_init_class_ids();
 }
 
+/* Embedder state that a full GC reset would leave dangling */
+static void js_quickjs_gc_reset(void) {
+    browser_stubs_reset();
+    js_quickjs_reset_class_ids();
+}
+
 bool js_quickjs_init(void) {
     // Initialize unified GC first - all memory comes from here
     if (!gc_is_initialized()) {
         if (!gc_init()) {
             return false;
         }
+        gc_set_reset_hook(js_quickjs_gc_reset);
     }
     return true;
 }
 
 bool js_quickjs_create_runtime(void) {
     if (!gc_is_initialized()) {
-        __android_log_print(ANDROID_LOG_ERROR, "js_quickjs", 
+        TLOG_ERROR("js_quickjs", 
             "GC not initialized, call js_quickjs_init first");
         return false;
     }
     
     // Create runtime using unified GC allocator
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "Creating global runtime...");
+    TLOG_INFO("js_quickjs", "Creating global runtime...");
     g_js_runtime = JS_NewRuntime();
     if (!g_js_runtime) {
-        __android_log_print(ANDROID_LOG_ERROR, "js_quickjs", "Runtime creation failed");
+        TLOG_ERROR("js_quickjs", "Runtime creation failed");
         return false;
     }
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "Global runtime created: %p", g_js_runtime);
+    TLOG_INFO("js_quickjs", "Global runtime created: %p", g_js_runtime);
     
     // Set limits after successful runtime creation
     JS_SetMemoryLimit(g_js_runtime, 256 * 1024 * 1024); // 256MB
     JS_SetMaxStackSize(g_js_runtime, 8 * 1024 * 1024);  // 8MB
     
     // Create context - this initializes built-in objects
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "Creating global context...");
+    TLOG_INFO("js_quickjs", "Creating global context...");
     g_js_context = JS_NewContext(g_js_runtime);
     
     if (!g_js_context) {
-        __android_log_print(ANDROID_LOG_ERROR, "js_quickjs", "Context creation failed");
+        TLOG_ERROR("js_quickjs", "Context creation failed");
         return false;
     }
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "Global context created: %p", g_js_context);
+    TLOG_INFO("js_quickjs", "Global context created: %p", g_js_context);
     
     // Register custom classes
-    JSClassDef xhr_def = {"XMLHttpRequest", .finalizer = js_xhr_finalizer};
-    JSClassDef video_def = {"HTMLVideoElement", .finalizer = js_video_finalizer};
+    JSClassDef xhr_def = {"XMLHttpRequest", .finalizer = js_xhr_finalizer, .gc_mark = js_xhr_mark};
+    JSClassDef video_def = {"HTMLVideoElement", .finalizer = js_video_finalizer, .gc_mark = js_video_mark};
     if (JS_NewClass(g_js_runtime, js_xhr_class_id, &xhr_def) < 0) {
-        __android_log_print(ANDROID_LOG_WARN, "js_quickjs", "Failed to register XMLHttpRequest class");
+        TLOG_WARN("js_quickjs", "Failed to register XMLHttpRequest class");
     }
     if (JS_NewClass(g_js_runtime, js_video_class_id, &video_def) < 0) {
-        __android_log_print(ANDROID_LOG_WARN, "js_quickjs", "Failed to register HTMLVideoElement class");
+        TLOG_WARN("js_quickjs", "Failed to register HTMLVideoElement class");
     }
     
     // Initialize full browser environment with all necessary APIs
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "Initializing browser environment...");
+    TLOG_INFO("js_quickjs", "Initializing browser environment...");
     init_browser_environment(g_js_context, g_asset_mgr);
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", "Browser environment initialized");
+    TLOG_INFO("js_quickjs", "Browser environment initialized");
     
     return true;
 }
 
+bool js_quickjs_reset_context(void) {
+    if (!g_js_runtime || !g_js_context) {
+        TLOG_ERROR("js_quickjs", "Cannot reset context: runtime not created");
+        return false;
+    }
+    js_quickjs_clear_captured_urls();
+
+    /* Timers, globals and DOM belong to the context; the runtime keeps its
+     * heap, atoms, shapes and class registrations */
+    js_event_loop_free(g_js_context);
+    JS_FreeContext(g_js_context);
+    html_document_free(g_page_doc);
+    g_page_doc = NULL;
+    g_context_used = false;
+
+    g_js_context = JS_NewContext(g_js_runtime);
+    if (!g_js_context) {
+        TLOG_ERROR("js_quickjs", "Context creation failed");
+        return false;
+    }
+    init_browser_environment(g_js_context, g_asset_mgr);
+    js_quickjs_setup_initial_dom();
+    TLOG_DEBUG("js_quickjs", "Context reset: %p", g_js_context);
+    return true;
+}
+
+bool js_quickjs_context_used(void) {
+    return g_context_used;
+}
+
 /* Set up initial DOM state - called once during app initialization.
  * This creates the default video element and other basic DOM structure
  * that should persist across script executions.
  */
 void js_quickjs_setup_initial_dom(void) {
     if (!g_js_context) {
-        log_to_file("js_quickjs", "Cannot setup DOM: context not initialized");
+        TLOG_DEBUG("js_quickjs", "Cannot setup DOM: context not initialized");
         return;
     }
     
@@ -796,62 +806,43 @@ void js_quickjs_setup_initial_dom(void) {
     if (JS_IsException(result)) {
         GCValue exception = JS_GetException(ctx);
         const char *error = JS_ToCString(ctx, exception);
-        __android_log_print(ANDROID_LOG_WARN, "js_quickjs", 
+        TLOG_WARN("js_quickjs", 
             "Default video script threw exception: %s", error ? error : "(null)");
         JS_FreeCString(ctx, error);
     }
     
-    log_to_file("js_quickjs", "Initial DOM setup complete");
+    TLOG_DEBUG("js_quickjs", "Initial DOM setup complete");
 }
 
-void js_quickjs_cleanup(void) {
+void js_quickjs_clear_captured_urls(void) {
     pthread_mutex_lock(&g_url_mutex);
-    g_captured_url_count = 0;
-    /* Clear all captured URLs */
-    memset(g_captured_urls, 0, sizeof(g_captured_urls));
+    /* Releases every captured URL and result view in one step */
+    job_arena_free(&g_capture_arena);
+    str_set_init(&g_captured_urls, &g_capture_arena);
     pthread_mutex_unlock(&g_url_mutex);
+}
+
+void js_quickjs_cleanup(void) {
+    js_quickjs_clear_captured_urls();
     
     /* Free the runtime and context */
     if (g_js_context) {
+        js_event_loop_free(g_js_context);
         JS_FreeContext(g_js_context);
         g_js_context = NULL;
     }
+    g_context_used = false;
     if (g_js_runtime) {
         JS_FreeRuntime(g_js_runtime);
         g_js_runtime = NULL;
     }
+    html_document_free(g_page_doc);
+    g_page_doc = NULL;
     
     // Cleanup unified GC
     gc_cleanup();
 }
 
-// Helper to extract attribute value from HTML tag
-static char* extract_attr(const char *html, const char *tag_end, const char *attr_name) {
-    const char *attr = strstr(html, attr_name);
-    if (!attr || attr > tag_end) return NULL;
-    
-    attr += strlen(attr_name);
-    while (*attr && isspace((unsigned char)*attr)) attr++;
-    if (*attr != '=') return NULL;
-    attr++;
-    while (*attr && isspace((unsigned char)*attr)) attr++;
-    
-    char quote = *attr;
-    if (quote != '"' && quote != '\'') return NULL;
-    
-    attr++;
-    const char *end = strchr(attr, quote);
-    if (!end || end > tag_end) return NULL;
-    
-    size_t len = end - attr;
-    char *value = (char *)malloc(len + 1);
-    if (value) {
-        strncpy(value, attr, len);
-        value[len] = '\0';
-    }
-    return value;
-}
-
 // Create DOM nodes from parsed HTML document
 // Using automatic GC memory management
 static int create_dom_nodes_from_parsed_html(JSContext *ctx, HtmlDocument *doc) {
@@ -866,7 +857,7 @@ static int create_dom_nodes_from_parsed_html(JSContext *ctx, HtmlDocument *doc)
         while (node) {
             if (node->type == HTML_NODE_ELEMENT) {
                 /* Create the element */
-                GCValue elem = html_create_element_js(ctx, node->tag_name, node->attributes);
+                GCValue elem = html_create_element_js(ctx, doc, node->tag_name, node->attributes);
                 
                 if (!JS_IsNull(elem) && !JS_IsException(elem)) {
                     /* Check for video elements specifically */
@@ -875,14 +866,16 @@ static int create_dom_nodes_from_parsed_html(JSContext *ctx, HtmlDocument *doc)
                         /* Extract src attribute if present */
                         HtmlAttribute *attr = node->attributes;
                         while (attr) {
-                            if (strcasecmp(attr->name, "src") == 0 && attr->value[0]) {
-                                GCValue src_val = JS_NewString(ctx, attr->value);
+                            size_t value_len = 0;
+                            const char *value = html_attr_value(doc, attr, &value_len);
+                            if (value_len > 0 && html_attr_name_is(doc, attr, "src")) {
+                                GCValue src_val = JS_NewStringLen(ctx, value, value_len);
                                 JS_SetPropertyStr(ctx, elem, "src", src_val);
                                 
-                                record_captured_url(attr->value);
+                                record_captured_url(html_attr_value_cstr(doc, attr));
                             }
-                            if (strcasecmp(attr->name, "id") == 0 && attr->value[0]) {
-                                GCValue id_val = JS_NewString(ctx, attr->value);
+                            if (value_len > 0 && html_attr_name_is(doc, attr, "id")) {
+                                GCValue id_val = JS_NewStringLen(ctx, value, value_len);
                                 JS_SetPropertyStr(ctx, elem, "id", id_val);
                                 
                             }
@@ -923,50 +916,46 @@ static int create_dom_nodes_from_parsed_html(JSContext *ctx, HtmlDocument *doc)
     return count;
 }
 
-// Parse HTML and create elements from <video> tags using the proper DOM parser
+// Create elements from the page's <video> tags, straight from the token
+// stream the script extractor already produced
 // Using automatic GC memory management
-static int create_video_elements_from_html(JSContext *ctx, const char *html) {
-    if (!html) return 0;
+static int create_video_elements_from_tokens(JSContext *ctx, HtmlTokenStream *tokens) {
+    if (!tokens) return 0;
     
-    
-    /* Parse the HTML document */
-    HtmlDocument *doc = html_parse(html, strlen(html));
-    if (!doc) {
-        return 0;
-    }
-    
-    /* Get the count of video elements in the parsed document */
-    HtmlNode *video_nodes[64];
-    int video_count = html_document_get_elements_by_tag(doc, "video", video_nodes, 64);
-    
-    
-    /* Create video elements from the parsed DOM */
     int created = 0;
-    for (int i = 0; i < video_count; i++) {
-        HtmlNode *node = video_nodes[i];
+    int video_index = 0;
+    for (uint32_t t = 0; t < tokens->count; t++) {
+        const HtmlToken *tok = &tokens->tokens[t];
+        if (tok->type != HTML_TOKEN_START_TAG || strcmp(tok->name, "video") != 0) continue;
+        int i = video_index++;
         
         /* Create video element */
         GCValue video = js_video_constructor(ctx, JS_NULL, 0, NULL);
         
         if (!JS_IsException(video)) {
             /* Extract and set attributes */
-            HtmlAttribute *attr = node->attributes;
-            while (attr) {
-                if (strcasecmp(attr->name, "id") == 0 && attr->value[0]) {
-                    GCValue id_val = JS_NewString(ctx, attr->value);
+            for (uint32_t a = 0; a < tok->attr_count; a++) {
+                const HtmlTokenAttr *attr = &tokens->attrs[tok->attr_start + a];
+                if (attr->value.len == 0) continue;
+                
+                size_t value_len = 0;
+                if (html_token_attr_name_is(tokens, attr, "id")) {
+                    const char *value = html_token_attr_cstr(tokens, attr, &value_len);
+                    GCValue id_val = JS_NewStringLen(ctx, value ? value : "", value_len);
                     JS_SetPropertyStr(ctx, video, "id", id_val);
                     
-                } else if (strcasecmp(attr->name, "src") == 0 && attr->value[0]) {
-                    GCValue src_val = JS_NewString(ctx, attr->value);
+                } else if (html_token_attr_name_is(tokens, attr, "src")) {
+                    const char *value = html_token_attr_cstr(tokens, attr, &value_len);
+                    GCValue src_val = JS_NewStringLen(ctx, value ? value : "", value_len);
                     JS_SetPropertyStr(ctx, video, "src", src_val);
                     
-                    record_captured_url(attr->value);
-                } else if (strcasecmp(attr->name, "class") == 0 && attr->value[0]) {
-                    GCValue class_val = JS_NewString(ctx, attr->value);
+                    record_captured_url(value);
+                } else if (html_token_attr_name_is(tokens, attr, "class")) {
+                    const char *value = html_token_attr_cstr(tokens, attr, &value_len);
+                    GCValue class_val = JS_NewStringLen(ctx, value ? value : "", value_len);
                     JS_SetPropertyStr(ctx, video, "className", class_val);
                     
                 }
-                attr = attr->next;
             }
             
             /* If no ID set but one exists in JS, use a default */
@@ -1000,27 +989,122 @@ static int create_video_elements_from_html(JSContext *ctx, const char *html) {
                 
             }
             
-            
-            
         }
         
     }
     
-    
-    /* Free the parsed document */
-    html_document_free(doc);
-    
     return created;
 }
 
+/* Deadlines checked from the interpreter's interrupt poll. A step is one
+ * script, the discovery script or the event loop run. */
+typedef struct ExecBudget {
+    uint64_t job_deadline_ns;
+    uint64_t deadline_ns;       /* Earlier of the step and job deadlines */
+    uint64_t step_start_ns;
+    bool expired;
+} ExecBudget;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int js_exec_interrupt(JSRuntime *rt, void *opaque) {
+    (void)rt;
+    ExecBudget *budget = opaque;
+    if (monotonic_ns() < budget->deadline_ns) return 0;
+    budget->expired = true;
+    return 1;
+}
+
+static void exec_budget_start_step(ExecBudget *budget) {
+    budget->step_start_ns = monotonic_ns();
+    uint64_t step_deadline = budget->step_start_ns + JS_EXEC_SCRIPT_BUDGET_MS * 1000000ull;
+    budget->deadline_ns = step_deadline < budget->job_deadline_ns ?
+        step_deadline : budget->job_deadline_ns;
+    budget->expired = false;
+}
+
+static uint32_t exec_budget_step_ms(const ExecBudget *budget) {
+    return (uint32_t)((monotonic_ns() - budget->step_start_ns) / 1000000ull);
+}
+
+static bool exec_budget_job_expired(const ExecBudget *budget) {
+    return monotonic_ns() >= budget->job_deadline_ns;
+}
+
+/* Getter of a deferred payload global. func_data holds the name and the
+ * script; the accessor goes first so the script's assignment lands in a
+ * plain data property, which is then read back. */
+static GCValue js_deferred_payload_get(JSContext *ctx, GCValue this_val, int argc,
+                                       GCValue *argv, int magic, GCValue *func_data) {
+    size_t name_len, script_len;
+    const char *name = JS_ToCStringLen(ctx, &name_len, func_data[0]);
+    const char *script = JS_ToCStringLen(ctx, &script_len, func_data[1]);
+    if (!name || !script) {
+        JS_FreeCString(ctx, name);
+        JS_FreeCString(ctx, script);
+        return JS_EXCEPTION;
+    }
+    GCValue global = JS_GetGlobalObject(ctx);
+    JSAtom atom = JS_NewAtomLen(ctx, name, name_len);
+    JS_DeleteProperty(ctx, global, atom, 0);
+    TLOG_DEBUG("js_quickjs", "Running deferred payload %s (%zu bytes)", name, script_len);
+    GCValue result = JS_Eval(ctx, script, script_len, "<payload>", JS_EVAL_TYPE_GLOBAL);
+    JS_FreeCString(ctx, name);
+    JS_FreeCString(ctx, script);
+    if (JS_IsException(result)) {
+        JS_FreeAtom(ctx, atom);
+        return result;
+    }
+    GCValue value = JS_GetProperty(ctx, global, atom);
+    JS_FreeAtom(ctx, atom);
+    return value;
+}
+
+/* Assigning the global before reading it drops the payload */
+static GCValue js_deferred_payload_set(JSContext *ctx, GCValue this_val, int argc,
+                                       GCValue *argv, int magic, GCValue *func_data) {
+    size_t name_len;
+    const char *name = JS_ToCStringLen(ctx, &name_len, func_data[0]);
+    if (!name) return JS_EXCEPTION;
+    JSAtom atom = JS_NewAtomLen(ctx, name, name_len);
+    JS_FreeCString(ctx, name);
+    JS_DefinePropertyValue(ctx, JS_GetGlobalObject(ctx), atom,
+                           argc > 0 ? argv[0] : JS_UNDEFINED, JS_PROP_C_W_E);
+    JS_FreeAtom(ctx, atom);
+    return JS_UNDEFINED;
+}
+
+bool js_quickjs_defer_payload(const char *name, size_t name_len,
+                              const char *script, size_t script_len) {
+    JSContext *ctx = g_js_context;
+    if (!ctx || !name || name_len == 0 || !script) return false;
+
+    GCValue data[2];
+    data[0] = JS_NewStringLen(ctx, name, name_len);
+    data[1] = JS_NewStringLen(ctx, script, script_len);
+    if (JS_IsException(data[0]) || JS_IsException(data[1])) return false;
+    GCValue getter = JS_NewCFunctionData(ctx, js_deferred_payload_get, 0, 0, 2, data);
+    GCValue setter = JS_NewCFunctionData(ctx, js_deferred_payload_set, 1, 0, 2, data);
+    if (JS_IsException(getter) || JS_IsException(setter)) return false;
+    JSAtom atom = JS_NewAtomLen(ctx, name, name_len);
+    int ret = JS_DefinePropertyGetSet(ctx, JS_GetGlobalObject(ctx), atom, getter, setter,
+                                      JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE);
+    JS_FreeAtom(ctx, atom);
+    return ret >= 0;
+}
+
 bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens, 
-                             int script_count, const char *html, 
+                             int script_count, HtmlTokenStream *html_tokens, 
                              AAssetManager *asset_mgr,
                              JsExecResult *out_result) {
-    log_to_file("js_quickjs", "js_quickjs_exec_scripts called, script_count=%d", script_count);
+    TLOG_DEBUG("js_quickjs", "js_quickjs_exec_scripts called, script_count=%d", script_count);
     
     if (!scripts || script_count <= 0 || !out_result) {
-        log_to_file("js_quickjs", "Invalid arguments");
+        TLOG_DEBUG("js_quickjs", "Invalid arguments");
         return false;
     }
     
@@ -1035,20 +1119,50 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
     
     // Use global runtime and context (initialized once in android_main)
     if (!g_js_runtime || !g_js_context) {
-        log_to_file("js_quickjs", "Global runtime/context not initialized");
+        TLOG_DEBUG("js_quickjs", "Global runtime/context not initialized");
         return false;
     }
     
     JSContext *ctx = g_js_context;
+    g_context_used = true;
     
-    log_to_file("js_quickjs", "Using global runtime=%p, context=%p", g_js_runtime, g_js_context);
+    TLOG_DEBUG("js_quickjs", "Using global runtime=%p, context=%p", g_js_runtime, g_js_context);
 
-    // Parse HTML and create video elements from <video> tags.
+    // Everything below runs under the budget; a script over it is
+    // interrupted with an uncatchable error
+    ExecBudget budget = {0};
+    budget.job_deadline_ns = monotonic_ns() + JS_EXEC_JOB_BUDGET_MS * 1000000ull;
+    bool timed_out = false;
+    JS_SetInterruptHandler(g_js_runtime, js_exec_interrupt, &budget);
+
+    pthread_mutex_lock(&g_url_mutex);
+    uint32_t *script_ms = job_arena_alloc(&g_capture_arena, script_count * sizeof(uint32_t));
+    pthread_mutex_unlock(&g_url_mutex);
+    if (script_ms) memset(script_ms, 0, script_count * sizeof(uint32_t));
+    out_result->script_ms = script_ms;
+    out_result->script_count = script_ms ? script_count : 0;
+
+    // Create video elements from <video> tags in the page's token stream.
     // This handles HTML that contains video elements directly (Scenario B).
     // Note: The basic DOM (window, document, body) and default video element
     // are set up once during app initialization in js_quickjs_setup_initial_dom().
-    if (html && strlen(html) > 0) {
-        int video_count = create_video_elements_from_html(ctx, html);
+    if (html_tokens) {
+        int video_count = create_video_elements_from_tokens(ctx, html_tokens);
+    }
+
+    // Answer document lookups from the parsed page, then from elements the
+    // scripts attach. The document owns a copy of the HTML so it can stay
+    // bound until the runtime is torn down.
+    HtmlDocument *page_doc = html_tokens ?
+        html_parse_copy(html_tokens->source, html_tokens->source_len) : NULL;
+    if (page_doc) {
+        GCValue global = JS_GetGlobalObject(ctx);
+        GCValue document = JS_GetPropertyStr(ctx, global, "document");
+        if (JS_IsObject(document)) {
+            html_bind_document_queries(ctx, document, page_doc);
+        }
+        html_document_free(g_page_doc);
+        g_page_doc = page_doc;
     }
 
     // Note: Data payload scripts (ytInitialPlayerResponse, ytInitialData, etc.)
@@ -1057,21 +1171,28 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
     
     // Execute all scripts
     int success_count = 0;
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", 
+    TLOG_INFO("js_quickjs", 
         "[EXEC] Starting execution of %d scripts", script_count);
     
     for (int i = 0; i < script_count; i++) {
         if (!scripts[i] || script_lens[i] == 0) {
-            __android_log_print(ANDROID_LOG_WARN, "js_quickjs", 
+            TLOG_WARN("js_quickjs", 
                 "[EXEC] Script %d is empty or NULL, skipping", i);
             continue;
         }
+        if (exec_budget_job_expired(&budget)) {
+            TLOG_WARN("js_quickjs",
+                "[EXEC] Job budget of %d ms used up, skipping scripts %d-%d",
+                JS_EXEC_JOB_BUDGET_MS, i, script_count - 1);
+            timed_out = true;
+            break;
+        }
+        exec_budget_start_step(&budget);
         
         char filename[64];
         snprintf(filename, sizeof(filename), "<script_%d>", i);
         
-        log_to_file("js_quickjs", "Executing script %d: %zu bytes", i, script_lens[i]);
-        __android_log_print(ANDROID_LOG_INFO, "js_quickjs", 
+        TLOG_INFO("js_quickjs", 
             "[EXEC] Executing script %d: %zu bytes", i, script_lens[i]);
         
         // Wrap scripts that tend to fail in try-catch so they don't crash the whole execution
@@ -1090,6 +1211,7 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
                 int footer_len = snprintf(wrapped + header_len + script_lens[i], wrapped_size - header_len - script_lens[i], "}catch(e){}");
                 size_t total_len = header_len + script_lens[i] + footer_len;
                 result = JS_Eval(ctx, wrapped, total_len, filename, JS_EVAL_TYPE_GLOBAL);
+                gc_free(wrapped_handle);
             } else {
                 result = JS_Eval(ctx, scripts[i], script_lens[i], filename, JS_EVAL_TYPE_GLOBAL);
             }
@@ -1107,7 +1229,7 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
             (void)stack; /* Silence unused warning when debugging disabled */
             
             // Dump script content around error position for Script 2
-            if (i == 2 && error) {
+            if (i == 2 && error && TLOG_ENABLED(TLOG_LEVEL_TRACE)) {
                 // Search for .prototype in the script
                 char *proto_ptr = strstr(scripts[i], ".prototype");
                 int count = 0;
@@ -1122,6 +1244,7 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
                     for (size_t j = 0; j < len; j++) {
                         if (context[j] == '\n' || context[j] == '\r') context[j] = ' ';
                     }
+                    TLOG_TRACE("js_quickjs", "[EXEC] .prototype at %zu: %s", offset, context);
                     
                     // Find next occurrence
                     proto_ptr = strstr(proto_ptr + 1, ".prototype");
@@ -1129,7 +1252,7 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
                 }
             }
             
-            __android_log_print(ANDROID_LOG_WARN, "js_quickjs", 
+            TLOG_WARN("js_quickjs", 
                 "[EXEC] Script %d threw exception: %s", i, error ? error : "(null)");
             
             JS_FreeCString(ctx, stack);
@@ -1137,7 +1260,7 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
 
         } else {
             success_count++;
-            __android_log_print(ANDROID_LOG_INFO, "js_quickjs", 
+            TLOG_INFO("js_quickjs", 
                 "[EXEC] Script %d executed successfully", i);
             
             // After base.js (script 0) executes, check what it created
@@ -1159,9 +1282,23 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
             }
         }
 
+        // Microtask checkpoint after each script, as in a browser
+        if (!budget.expired) {
+            js_event_loop_drain_microtasks(ctx, JS_EXEC_LOOP_MAX_STEPS, NULL);
+        }
+
+        uint32_t elapsed_ms = exec_budget_step_ms(&budget);
+        if (script_ms) script_ms[i] = elapsed_ms;
+        if (budget.expired) {
+            timed_out = true;
+            TLOG_WARN("js_quickjs",
+                "[EXEC] Script %d cut off after %u ms", i, elapsed_ms);
+        } else {
+            TLOG_INFO("js_quickjs", "[EXEC] Script %d took %u ms", i, elapsed_ms);
+        }
     }
     
-    log_to_file("js_quickjs", "All %d scripts executed, running discovery...", script_count);
+    TLOG_DEBUG("js_quickjs", "All %d scripts executed, running discovery...", script_count);
     
     // After scripts load, dispatch DOMContentLoaded to trigger player initialization
     // The video element and ytInitialPlayerResponse were already set up before scripts loaded
@@ -1274,36 +1411,82 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
         "_log('[JS_DISCOVERY] === END DISCOVERY ===');\n"
     ;
     
-    GCValue init_result = JS_Eval(ctx, init_player_js, strlen(init_player_js), "<init_player>", 0);
-    if (JS_IsException(init_result)) {
-        GCValue exception = JS_GetException(ctx);
-        const char *error = JS_ToCString(ctx, exception);
-        __android_log_print(ANDROID_LOG_WARN, "js_quickjs", 
-            "Init player script threw exception: %s", error ? error : "(null)");
-        JS_FreeCString(ctx, error);
+    uint64_t deferred_start_ns = monotonic_ns();
+    if (!exec_budget_job_expired(&budget)) {
+        exec_budget_start_step(&budget);
+        GCValue init_result = JS_Eval(ctx, init_player_js, strlen(init_player_js), "<init_player>", 0);
+        if (JS_IsException(init_result)) {
+            GCValue exception = JS_GetException(ctx);
+            const char *error = JS_ToCString(ctx, exception);
+            TLOG_WARN("js_quickjs", 
+                "Init player script threw exception: %s", error ? error : "(null)");
+            JS_FreeCString(ctx, error);
+        }
+        timed_out |= budget.expired;
     }
 
-    // Get captured URLs
+    // Let deferred player setup run: timers fire in virtual time, so this
+    // takes only as long as the callbacks themselves
+    if (!exec_budget_job_expired(&budget)) {
+        exec_budget_start_step(&budget);
+        JsLoopStats loop_stats;
+        JsLoopStatus loop_status = js_event_loop_run(ctx, JS_EXEC_LOOP_VIRTUAL_MS,
+                                                     JS_EXEC_LOOP_MAX_STEPS, &loop_stats);
+        TLOG_INFO("js_quickjs",
+            "[EXEC] Event loop status %d: %u timers, %u microtasks, %u exceptions, %.0f ms virtual",
+            loop_status, loop_stats.timers_run, loop_stats.jobs_run, loop_stats.exceptions,
+            loop_stats.end_ms - loop_stats.start_ms);
+        timed_out |= budget.expired;
+    } else {
+        timed_out = true;
+    }
+    out_result->deferred_ms = (uint32_t)((monotonic_ns() - deferred_start_ns) / 1000000ull);
+    JS_SetInterruptHandler(g_js_runtime, NULL, NULL);
+
+    GCStats gc_stats;
+    gc_get_stats(&gc_stats);
+    TLOG_INFO("js_quickjs",
+        "[GC] %u collections, pause %.1f ms total / %.1f ms max, mutator %.1f ms, "
+        "live %zu KB, next after %zu KB, handles %u/%u, roots %u/%u",
+        gc_stats.collections, gc_stats.total_pause_ns / 1e6, gc_stats.max_pause_ns / 1e6,
+        gc_stats.mutator_ns / 1e6, gc_stats.live_bytes / 1024,
+        gc_stats.next_collection_bytes / 1024,
+        gc_stats.handles_used, gc_stats.handle_capacity,
+        gc_stats.roots_used, gc_stats.root_capacity);
+    TLOG_INFO("js_quickjs", "[GC] heap used %zu KB, committed %zu KB, resident %zu KB, "
+        "%u large objects in %zu KB, marking %.1f ms (last on %u threads)",
+        gc_stats.heap_used_bytes / 1024, gc_stats.heap_committed_bytes / 1024,
+        gc_resident_bytes() / 1024, gc_stats.large_objects,
+        gc_stats.large_object_bytes / 1024, gc_stats.mark_ns / 1e6,
+        gc_stats.last_mark_threads);
+
+    // Get captured URLs as views into the capture arena
     pthread_mutex_lock(&g_url_mutex);
-    // BUG FIX #5: Safe string copy using memcpy with proper length validation
-    out_result->captured_url_count = g_captured_url_count;
-    __android_log_print(ANDROID_LOG_INFO, "js_quickjs", 
-        "[URL_CAPTURE_SUMMARY] Total URLs captured: %d", g_captured_url_count);
-    for (int i = 0; i < g_captured_url_count && i < JS_MAX_CAPTURED_URLS; i++) {
-        size_t len = strlen(g_captured_urls[i]);
-        if (len >= JS_MAX_URL_LEN) {
-            len = JS_MAX_URL_LEN - 1;
+    int captured = (int)g_captured_urls.count;
+    TLOG_INFO("js_quickjs", 
+        "[URL_CAPTURE_SUMMARY] Total URLs captured: %d", captured);
+    StrView *views = captured > 0 ?
+        job_arena_alloc(&g_capture_arena, captured * sizeof(StrView)) : NULL;
+    if (views) {
+        for (int i = 0; i < captured; i++) {
+            views[i] = str_set_view(&g_captured_urls, i);
+            TLOG_INFO("js_quickjs", 
+                "[URL_CAPTURED_%d] %s", i, views[i].ptr);
         }
-        memcpy(out_result->captured_urls[i], g_captured_urls[i], len);
-        out_result->captured_urls[i][len] = '\0';
-        __android_log_print(ANDROID_LOG_INFO, "js_quickjs", 
-            "[URL_CAPTURED_%d] %s", i, out_result->captured_urls[i]);
+        out_result->captured_urls = views;
+        out_result->captured_url_count = captured;
     }
     pthread_mutex_unlock(&g_url_mutex);
     
-    out_result->status = (success_count > 0) ? JS_EXEC_SUCCESS : JS_EXEC_ERROR;
+    if (timed_out) {
+        out_result->status = JS_EXEC_TIMEOUT;
+        TLOG_WARN("js_quickjs", "[EXEC] Timed out; deferred work took %u ms",
+                  out_result->deferred_ms);
+    } else {
+        out_result->status = (success_count > 0) ? JS_EXEC_SUCCESS : JS_EXEC_ERROR;
+    }
     
-    log_to_file("js_quickjs", "Finished, captured %d URLs, status=%d", 
+    TLOG_DEBUG("js_quickjs", "Finished, captured %d URLs, status=%d", 
                 out_result->captured_url_count, out_result->status);
     
     // NOTE: We do NOT free the context or runtime here.
@@ -1311,8 +1494,8 @@ bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens,
     // prototypes, global variables, etc.) and should execute in the same context.
     // 
     // The runtime is cleaned up after each download submission via js_quickjs_cleanup().
-    
-    log_to_file("js_quickjs", "Execution complete, returning");
+
+    TLOG_DEBUG("js_quickjs", "Execution complete, returning");
     
     return out_result->status == JS_EXEC_SUCCESS;
 }
@@ -1325,9 +1508,9 @@ int js_quickjs_get_captured_urls(char urls[][JS_MAX_URL_LEN], int max_urls) {
     
     pthread_mutex_lock(&g_url_mutex);
     int count = 0;
-    for (int i = 0; i < g_captured_url_count && i < max_urls && i < MAX_CAPTURED_URLS; i++) {
-        strncpy(urls[i], g_captured_urls[i], JS_MAX_URL_LEN - 1);
-        urls[i][JS_MAX_URL_LEN - 1] = '\0';
+    for (uint32_t i = 0; i < g_captured_urls.count && count < max_urls; i++) {
+        StrView v = str_set_view(&g_captured_urls, i);
+        snprintf(urls[count], JS_MAX_URL_LEN, "%.*s", (int)v.len, v.ptr);
         count++;
     }
     pthread_mutex_unlock(&g_url_mutex);
@@ -6,6 +6,8 @@
 
 /* QuickJS headers */
 #include "quickjs.h"
+#include "job_arena.h"
+#include "html_tokenizer.h"
 
 /* Forward declaration for Android AssetManager */
 struct AAssetManager;
@@ -19,8 +21,7 @@ extern "C" {
 extern JSRuntime *g_js_runtime;
 extern JSContext *g_js_context;
 
-/* Maximum number of captured URLs */
-#define JS_MAX_CAPTURED_URLS 64
+/* Longest URL that is captured */
 #define JS_MAX_URL_LEN 2048
 
 typedef enum {
@@ -29,20 +30,43 @@ typedef enum {
     JS_EXEC_TIMEOUT = -2
 } JsExecStatus;
 
-/* Result of JS execution with captured URLs */
+/* Wall-clock budgets for js_quickjs_exec_scripts. Each script, and each of
+ * the discovery script and the deferred-work phase after it, gets
+ * JS_EXEC_SCRIPT_BUDGET_MS; the whole call gets JS_EXEC_JOB_BUDGET_MS.
+ * Code over budget is interrupted and the status is JS_EXEC_TIMEOUT. */
+#define JS_EXEC_SCRIPT_BUDGET_MS 20000
+#define JS_EXEC_JOB_BUDGET_MS 60000
+
+/* Result of JS execution with captured URLs. The views and script_ms point
+ * into the capture arena and stay valid until js_quickjs_clear_captured_urls()
+ * or js_quickjs_cleanup(). */
 typedef struct JsExecResult {
     JsExecStatus status;
     int captured_url_count;
-    char captured_urls[JS_MAX_CAPTURED_URLS][JS_MAX_URL_LEN];
+    const StrView *captured_urls;
+    /* Time each script ran before finishing or being cut off, with its
+     * microtasks; one entry per script passed in, 0 for skipped ones */
+    const uint32_t *script_ms;
+    int script_count;
+    uint32_t deferred_ms;       /* Discovery script and event loop */
 } JsExecResult;
 
-/* Initialize QuickJS runtime (called once in android_main) */
+/* Initialize the GC heap (called by the runtime pool when preparing a runtime) */
 bool js_quickjs_init(void);
 
-/* Create global QuickJS runtime and context (called once in android_main after js_quickjs_init) */
+/* Create global QuickJS runtime and context (runtime pool, after js_quickjs_init) */
 bool js_quickjs_create_runtime(void);
 
-/* Set up initial DOM state (called once in android_main after js_quickjs_create_runtime) */
+/* Replaces the global context with a fresh one on the same runtime, so the
+ * next page starts from clean globals, timers and DOM without rebuilding
+ * the engine. Captured URLs are cleared. Returns false, with no usable
+ * context, if the new one could not be created. */
+bool js_quickjs_reset_context(void);
+
+/* Whether page scripts have run in the current context since it was created */
+bool js_quickjs_context_used(void);
+
+/* Set up initial DOM state (runtime pool, after js_quickjs_create_runtime) */
 void js_quickjs_setup_initial_dom(void);
 
 /* Reset class IDs (called during GC full reset) */
@@ -51,9 +75,15 @@ void js_quickjs_reset_class_ids(void);
 /* Set the Android asset manager for loading browser stubs */
 void js_quickjs_set_asset_manager(AAssetManager *mgr);
 
-/* Cleanup QuickJS runtime (not needed - runtime lives for app lifetime) */
+/* Free the runtime, context and GC heap (runtime pool, after each job) */
 void js_quickjs_cleanup(void);
 
+/* Defines global `name` for a data payload script ("var NAME = {...};")
+ * without running it: the script runs the first time the global is read,
+ * and assigning the global first replaces it. The script text is copied. */
+bool js_quickjs_defer_payload(const char *name, size_t name_len,
+                              const char *script, size_t script_len);
+
 /* Execute multiple JS scripts in a browser-like environment
  * Data payload scripts (ytInitialPlayerResponse, ytInitialData, etc.) will
  * execute naturally and define global variables, just like in a real browser.
@@ -61,15 +91,18 @@ void js_quickjs_cleanup(void);
  * scripts: array of JS code strings
  * script_lens: array of script lengths  
  * script_count: number of scripts
- * html: original HTML content for parsing video elements (can be NULL)
+ * html_tokens: token stream of the page, used to create its <video> elements (can be NULL)
  * asset_mgr: Android asset manager for loading browser stubs (can be NULL)
  * out_result: output structure for captured URLs
  */
 bool js_quickjs_exec_scripts(const char **scripts, const size_t *script_lens, 
-                             int script_count, const char *html, 
+                             int script_count, HtmlTokenStream *html_tokens, 
                              AAssetManager *asset_mgr,
                              JsExecResult *out_result);
 
+/* Forget URLs captured so far, e.g. before resolving the next page on a warm runtime */
+void js_quickjs_clear_captured_urls(void);
+
 /* Get captured URLs from global storage (for backward compatibility) */
 int js_quickjs_get_captured_urls(char urls[][JS_MAX_URL_LEN], int max_urls);
 
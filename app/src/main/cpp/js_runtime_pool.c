@@ -0,0 +1,173 @@
+#include "js_runtime_pool.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include "js_quickjs.h"
+#include "quickjs.h"
+#include "quickjs_gc_unified.h"
+#include "trace_log.h"
+
+#define LOG_TAG "js_runtime_pool"
+
+typedef enum {
+    POOL_EMPTY,                 /* No runtime; the thread prepares one */
+    POOL_READY,                 /* Warm runtime waiting for a job */
+    POOL_IN_USE,
+    POOL_RETIRED                /* Released; the thread tears it down */
+} PoolState;
+
+static pthread_mutex_t g_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_pool_changed = PTHREAD_COND_INITIALIZER;
+static PoolState g_state = POOL_EMPTY;
+static bool g_thread_running = false;
+static bool g_stop = false;
+static bool g_prepare_failed = false;   /* Not retried until someone acquires */
+
+static uint32_t elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((now.tv_sec - start->tv_sec) * 1000 +
+                      (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+/* Brings up the whole engine, as worker_thread used to at the start of each job */
+static bool prepare_runtime(void) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!js_quickjs_init()) {
+        TLOG_ERROR(LOG_TAG, "QuickJS initialization failed");
+        return false;
+    }
+    if (!js_quickjs_create_runtime()) {
+        TLOG_ERROR(LOG_TAG, "QuickJS runtime creation failed");
+        js_quickjs_cleanup();
+        return false;
+    }
+    js_quickjs_setup_initial_dom();
+
+    TLOG_INFO(LOG_TAG, "Runtime ready in %u ms", elapsed_ms(&start));
+    return true;
+}
+
+static void discard_runtime(void) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    js_quickjs_cleanup();
+    TLOG_DEBUG(LOG_TAG, "Runtime discarded in %u ms", elapsed_ms(&start));
+}
+
+static void *pool_thread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_pool_lock);
+    for (;;) {
+        if (g_state == POOL_RETIRED || (g_stop && g_state == POOL_READY)) {
+            pthread_mutex_unlock(&g_pool_lock);
+            discard_runtime();
+            pthread_mutex_lock(&g_pool_lock);
+            g_state = POOL_EMPTY;
+            pthread_cond_broadcast(&g_pool_changed);
+            continue;
+        }
+        if (g_stop) break;
+
+        if (g_state == POOL_EMPTY && !g_prepare_failed) {
+            pthread_mutex_unlock(&g_pool_lock);
+            bool ok = prepare_runtime();
+            pthread_mutex_lock(&g_pool_lock);
+            if (ok) {
+                g_state = POOL_READY;
+            } else {
+                g_prepare_failed = true;
+            }
+            pthread_cond_broadcast(&g_pool_changed);
+            continue;
+        }
+        pthread_cond_wait(&g_pool_changed, &g_pool_lock);
+    }
+    g_thread_running = false;
+    pthread_cond_broadcast(&g_pool_changed);
+    pthread_mutex_unlock(&g_pool_lock);
+    return NULL;
+}
+
+bool js_runtime_pool_start(void) {
+    pthread_mutex_lock(&g_pool_lock);
+    if (g_thread_running) {
+        pthread_mutex_unlock(&g_pool_lock);
+        return true;
+    }
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    g_stop = false;
+    g_thread_running = pthread_create(&thread, &attr, pool_thread, NULL) == 0;
+    pthread_attr_destroy(&attr);
+    bool started = g_thread_running;
+    pthread_mutex_unlock(&g_pool_lock);
+
+    if (!started) TLOG_WARN(LOG_TAG, "Pool thread failed to start, runtimes will be prepared per job");
+    return started;
+}
+
+bool js_runtime_pool_acquire(void) {
+    pthread_mutex_lock(&g_pool_lock);
+
+    if (!g_thread_running) {
+        /* No background thread: bring the engine up here */
+        bool ok = g_state == POOL_READY || prepare_runtime();
+        g_state = ok ? POOL_IN_USE : POOL_EMPTY;
+        pthread_mutex_unlock(&g_pool_lock);
+        return ok;
+    }
+
+    if (g_prepare_failed) {
+        /* Give the last failure one more try on behalf of this job */
+        g_prepare_failed = false;
+        pthread_cond_broadcast(&g_pool_changed);
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (g_state != POOL_READY && !g_prepare_failed && g_thread_running) {
+        pthread_cond_wait(&g_pool_changed, &g_pool_lock);
+    }
+    bool ok = g_state == POOL_READY;
+    if (ok) g_state = POOL_IN_USE;
+    pthread_mutex_unlock(&g_pool_lock);
+
+    if (ok) {
+        /* The runtime was created on the pool thread; this also makes its
+         * GC heap current here */
+        JS_UpdateStackTop(g_js_runtime);
+        TLOG_INFO(LOG_TAG, "Runtime acquired after %u ms", elapsed_ms(&start));
+    }
+    return ok;
+}
+
+void js_runtime_pool_release(void) {
+    pthread_mutex_lock(&g_pool_lock);
+    if (g_state != POOL_IN_USE) {
+        pthread_mutex_unlock(&g_pool_lock);
+        return;
+    }
+    if (g_thread_running) {
+        /* The pool thread frees the heap; this thread must not keep it */
+        gc_set_current_heap(NULL);
+        g_state = POOL_RETIRED;
+        pthread_cond_broadcast(&g_pool_changed);
+    } else {
+        discard_runtime();
+        g_state = POOL_EMPTY;
+    }
+    pthread_mutex_unlock(&g_pool_lock);
+}
+
+void js_runtime_pool_stop(void) {
+    pthread_mutex_lock(&g_pool_lock);
+    g_stop = true;
+    pthread_cond_broadcast(&g_pool_changed);
+    pthread_mutex_unlock(&g_pool_lock);
+}
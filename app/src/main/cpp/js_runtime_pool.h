@@ -0,0 +1,40 @@
+#ifndef JS_RUNTIME_POOL_H
+#define JS_RUNTIME_POOL_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Keeps a fully initialized browser runtime (GC heap, runtime, context,
+ * browser stubs and initial DOM) ready for the next job, so a job starts
+ * without waiting for engine bring-up. A background thread prepares the
+ * runtime, and after a job releases it, tears it down and prepares a fresh
+ * one.
+ *
+ * Each runtime has its own GC heap, made current on whichever thread holds
+ * it. The browser environment (g_js_runtime / g_js_context and the stub
+ * globals) is still process-wide, though, so there is one runtime at a
+ * time: a job that starts while the previous one's runtime is still being
+ * recycled waits for it. */
+
+/* Starts the background thread and the first preparation */
+bool js_runtime_pool_start(void);
+
+/* Blocks until a warm runtime is ready and makes it current on the calling
+ * thread. Without the background thread, prepares one synchronously.
+ * Returns false if preparation failed. */
+bool js_runtime_pool_acquire(void);
+
+/* Hands the runtime back after a job; it is recycled in the background */
+void js_runtime_pool_release(void);
+
+/* Asks the background thread to discard the idle runtime and exit */
+void js_runtime_pool_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
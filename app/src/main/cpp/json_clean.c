@@ -0,0 +1,177 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "json_clean.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define JSON_CLEAN_BLOCK 16
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define JSON_CLEAN_BLOCK 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define JSON_CLEAN_BLOCK 16
+#endif
+
+#ifdef JSON_CLEAN_BLOCK
+// True if the block holds only ASCII bytes that need no decoding:
+// no '&', no '\\', no NUL and nothing >= 0x80.
+static inline bool json_block_is_plain(const uint8_t *p) {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint8x16_t v = vld1q_u8(p);
+    uint8x16_t m = vcgeq_u8(v, vdupq_n_u8(0x80));
+    m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('&')));
+    m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8('\\')));
+    m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8(0)));
+    return vmaxvq_u8(m) == 0;
+#elif defined(__AVX2__)
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    // High bit of v itself flags non-ASCII bytes
+    return _mm256_movemask_epi8(_mm256_or_si256(m, v)) == 0;
+#else
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return _mm_movemask_epi8(_mm_or_si128(m, v)) == 0;
+#endif
+}
+#endif
+
+static int hex_digit_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Decode the HTML entity at p ('&' ... ';'). Handles &lt; &gt; &amp; &quot;
+// &apos; &nbsp; &#123; (decimal) and &#x7B; (hex) that fit in one byte.
+// Returns the number of input bytes consumed, 0 if p is not a valid entity.
+static size_t decode_html_entity_at(const uint8_t *p, const uint8_t *end, uint8_t *decoded) {
+    const uint8_t *semi = NULL;
+    for (const uint8_t *q = p + 1; q < end && q - p < 20 && *q; q++) {
+        if (*q == ';') {
+            semi = q;
+            break;
+        }
+    }
+    if (!semi) return 0;
+
+    const char *entity = (const char *)p + 1;
+    size_t entity_len = semi - p - 1;
+
+    if (entity_len == 2 && memcmp(entity, "lt", 2) == 0) *decoded = '<';
+    else if (entity_len == 2 && memcmp(entity, "gt", 2) == 0) *decoded = '>';
+    else if (entity_len == 3 && memcmp(entity, "amp", 3) == 0) *decoded = '&';
+    else if (entity_len == 4 && memcmp(entity, "quot", 4) == 0) *decoded = '"';
+    else if (entity_len == 4 && memcmp(entity, "apos", 4) == 0) *decoded = '\'';
+    else if (entity_len == 4 && memcmp(entity, "nbsp", 4) == 0) *decoded = ' ';
+    else if (entity_len > 1 && entity[0] == '#') {
+        const uint8_t *d = (const uint8_t *)entity + 1;
+        int base = 10;
+        if (*d == 'x' || *d == 'X') {
+            base = 16;
+            d++;
+        }
+        long val = 0;
+        for (; d < semi; d++) {
+            int digit = base == 16 ? hex_digit_value(*d) :
+                        (*d >= '0' && *d <= '9' ? *d - '0' : -1);
+            if (digit < 0) break;
+            val = val * base + digit;
+            if (val > 0xFF) return 0;
+        }
+        if (val <= 0) return 0;
+        *decoded = (uint8_t)val;
+    } else {
+        return 0;
+    }
+
+    return semi - p + 1;
+}
+
+size_t json_clean_into(const char *input, size_t input_len, char *out, size_t out_cap) {
+    if (!out || out_cap == 0) return 0;
+    if (!input) {
+        out[0] = '\0';
+        return 0;
+    }
+
+    const uint8_t *p = (const uint8_t *)input;
+    const uint8_t *end = p + input_len;
+    uint8_t *o = (uint8_t *)out;
+    uint8_t *o_end = o + out_cap - 1;  // Reserve space for null terminator
+
+    // Pending multi-byte UTF-8 sequence: where it starts and how many
+    // continuation bytes are still expected
+    uint8_t *seq_start = o;
+    int need = 0;
+
+    while (p < end && o < o_end) {
+#ifdef JSON_CLEAN_BLOCK
+        if (need == 0) {
+            while (end - p >= JSON_CLEAN_BLOCK && o_end - o >= JSON_CLEAN_BLOCK &&
+                   json_block_is_plain(p)) {
+                memcpy(o, p, JSON_CLEAN_BLOCK);
+                p += JSON_CLEAN_BLOCK;
+                o += JSON_CLEAN_BLOCK;
+            }
+            if (p >= end || o >= o_end) break;
+        }
+#endif
+        uint8_t c = *p;
+        if (c == 0) break;
+
+        if (c == '&') {
+            size_t used = decode_html_entity_at(p, end, &c);
+            p += used ? used : 1;
+        } else if (c == '\\' && end - p >= 4 && p[1] == 'x' &&
+                   hex_digit_value(p[2]) >= 0 && hex_digit_value(p[3]) >= 0 &&
+                   (hex_digit_value(p[2]) | hex_digit_value(p[3])) != 0) {
+            c = (uint8_t)((hex_digit_value(p[2]) << 4) | hex_digit_value(p[3]));
+            p += 4;
+        } else {
+            p++;
+        }
+
+        // UTF-8 validation on the decoded byte stream
+        if (need > 0) {
+            if ((c & 0xC0) == 0x80) {
+                *o++ = c;
+                need--;
+                continue;
+            }
+            // Broken sequence: drop the lead byte and its continuations
+            o = seq_start;
+            need = 0;
+        }
+
+        if ((c & 0x80) == 0) {
+            *o++ = c;
+        } else if ((c & 0xE0) == 0xC0) {
+            need = 1;
+        } else if ((c & 0xF0) == 0xE0) {
+            need = 2;
+        } else if ((c & 0xF8) == 0xF0) {
+            need = 3;
+        } else {
+            continue;  // Stray continuation or invalid lead byte
+        }
+
+        if (need > 0) {
+            seq_start = o;
+            *o++ = c;
+        }
+    }
+
+    // Truncated sequence at the end
+    if (need > 0) o = seq_start;
+
+    *o = '\0';
+    return o - (uint8_t *)out;
+}
@@ -0,0 +1,22 @@
+#ifndef JSON_CLEAN_H
+#define JSON_CLEAN_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Fused cleanup of JSON text extracted from HTML, in a single pass: decodes
+ * HTML entities and \xNN escapes and drops malformed UTF-8 sequences
+ * (including ones produced by decoding). Plain ASCII runs are copied in
+ * NEON/AVX2/SSE2 blocks. out never needs more than input_len + 1 bytes.
+ * Stops at the first NUL. Returns the output length; out is always NUL
+ * terminated. */
+size_t json_clean_into(const char *input, size_t input_len, char *out, size_t out_cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
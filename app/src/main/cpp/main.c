@@ -1,6 +1,5 @@
 #define VK_USE_PLATFORM_ANDROID_KHR
 
-#include <android/log.h>
 #include <android_native_app_glue.h>
 #include <android/input.h>
 #include <android/configuration.h>
@@ -21,33 +20,15 @@
 
 #include "http_download.h"
 #include "url_analyzer.h"
+#include "media_cache.h"
 #include "js_quickjs.h"
+#include "js_runtime_pool.h"
 #include "quickjs.h"
+#include "trace_log.h"
 
 #define LOG_TAG "minimalvulkan"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-
-/* File logging for debugging */
-#include <fcntl.h>
-static void file_log(const char *fmt, ...) {
-    static int log_fd = -1;
-    if (log_fd < 0) {
-        log_fd = open("/data/data/com.bgmdwldr.vulkan/main_debug.log", 
-                      O_WRONLY | O_CREAT | O_APPEND, 0644);
-    }
-    if (log_fd >= 0) {
-        char buf[1024];
-        va_list args;
-        va_start(args, fmt);
-        int n = vsnprintf(buf, sizeof(buf), fmt, args);
-        va_end(args);
-        if (n > 0 && n < sizeof(buf) - 1) {
-            buf[n++] = '\n';
-            write(log_fd, buf, n);
-        }
-    }
-}
+#define LOGI(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
 
 typedef struct ShaderBlob {
     uint8_t *data;
@@ -1144,13 +1125,112 @@ static void download_progress(size_t downloaded, size_t total, void *user) {
     }
 }
 
+/* Splits the input into batch items: a playlist URL expands to its videos,
+ * otherwise URLs are separated by whitespace or commas. Returns the count. */
+static int collect_batch_items(const char *input, UrlBatchItem *items, int maxItems) {
+    int count = 0;
+    if (strstr(input, "list=") && !strstr(input, "v=")) {
+        char (*urls)[MEDIA_URL_MAX] = calloc(maxItems, MEDIA_URL_MAX);
+        char err[256] = {0};
+        if (urls) {
+            count = url_expand_playlist(input, urls, maxItems, err, sizeof(err));
+            for (int i = 0; i < count; i++) {
+                snprintf(items[i].input, sizeof(items[i].input), "%s", urls[i]);
+            }
+            free(urls);
+        }
+        if (count == 0) {
+            LOGE("Playlist expansion failed: %s", err);
+        }
+        return count;
+    }
+
+    const char *p = input;
+    while (*p && count < maxItems) {
+        p += strspn(p, " \t\r\n,");
+        size_t len = strcspn(p, " \t\r\n,");
+        if (len == 0) {
+            break;
+        }
+        if (len < sizeof(items[count].input)) {
+            snprintf(items[count].input, sizeof(items[count].input), "%.*s", (int)len, p);
+            count++;
+        }
+        p += len;
+    }
+    return count;
+}
+
+/* Logs every item that failed analysis and appends "#n: error" for each to
+ * msg, as many as fit */
+static void append_item_errors(char *msg, size_t msgLen, const UrlBatchItem *items, int count) {
+    size_t used = strlen(msg);
+    const char *sep = "";
+    for (int i = 0; i < count; i++) {
+        if (items[i].ok) {
+            continue;
+        }
+        LOGE("Item %d failed analysis: %s", i + 1, items[i].err);
+        if (used + 1 < msgLen) {
+            int n = snprintf(msg + used, msgLen - used, "%s#%d: %s", sep, i + 1, items[i].err);
+            used = n < 0 ? msgLen : used + (size_t)n;
+        }
+        sep = "; ";
+    }
+}
+
+/* Resolves all items, then downloads them in order */
+static void run_batch(VulkanApp *app, UrlBatchItem *items, int count) {
+    char status_msg[280];
+    snprintf(status_msg, sizeof(status_msg), "Analyzing %d URLs...", count);
+    ui_set_status(app, status_msg);
+
+    UrlBatchStats stats;
+    if (!url_analyze_batch(items, count, &stats)) {
+        snprintf(status_msg, sizeof(status_msg), "Analysis failed: ");
+        append_item_errors(status_msg, sizeof(status_msg), items, count);
+        ui_set_status(app, status_msg);
+        return;
+    }
+
+    int downloaded = 0;
+    for (int i = 0; i < count; i++) {
+        if (!items[i].ok) {
+            continue;
+        }
+        snprintf(status_msg, sizeof(status_msg), "Downloading %d/%d...", i + 1, count);
+        ui_set_status(app, status_msg);
+        ui_set_progress(app, (float)i / (float)count);
+
+        HttpBuffer buffer = {0};
+        char err[512] = {0};
+        if (!http_get_to_memory(items[i].media.url, &buffer, err, sizeof(err))) {
+            LOGE("Download %d failed: %s", i + 1, err);
+            if (strstr(err, "HTTP error 403")) {
+                media_cache_invalidate_url(items[i].media.url);
+            }
+            continue;
+        }
+        LOGI("Downloaded item %d: %zu bytes", i + 1, buffer.size);
+        http_free_buffer(&buffer);
+        downloaded++;
+    }
+
+    ui_set_progress(app, 1.0f);
+    snprintf(status_msg, sizeof(status_msg), "Downloaded %d/%d", downloaded, count);
+    if (stats.succeeded < count) {
+        strncat(status_msg, ", failed ", sizeof(status_msg) - strlen(status_msg) - 1);
+        append_item_errors(status_msg, sizeof(status_msg), items, count);
+    }
+    ui_set_status(app, status_msg);
+}
+
 static void *worker_thread(void *arg) {
     WorkerArgs *args = (WorkerArgs *)arg;
     VulkanApp *app = args->app;
     ui_set_progress(app, 0.0f);
     
     LOGI("Processing URL: %s", args->url);
-    file_log("Processing URL: %s", args->url);
     ui_set_status(app, "Initializing...");
     
     time_t start_time = time(NULL);
@@ -1159,44 +1239,37 @@ static void *worker_thread(void *arg) {
     /* Clear any previous session cookies */
     http_clear_youtube_cookies();
 
-    /* Initialize QuickJS runtime for this download session */
-    LOGI("Initializing QuickJS...");
-    file_log("Initializing QuickJS...");
-    if (!js_quickjs_init()) {
-        LOGE("QuickJS initialization failed!");
-        file_log("QuickJS initialization failed!");
-        ui_set_status(app, "JS init failed");
-        app->workerRunning = false;
-        free(args);
-        return NULL;
-    }
-    
-    LOGI("Creating QuickJS runtime...");
-    file_log("Creating QuickJS runtime...");
-    if (!js_quickjs_create_runtime()) {
-        LOGE("QuickJS runtime creation failed!");
-        file_log("QuickJS runtime creation failed!");
+    /* Take the warm QuickJS runtime prepared in the background */
+    LOGI("Acquiring QuickJS runtime...");
+    if (!js_runtime_pool_acquire()) {
+        LOGE("QuickJS runtime preparation failed!");
         ui_set_status(app, "JS runtime failed");
-        js_quickjs_cleanup();
         app->workerRunning = false;
         free(args);
         return NULL;
     }
     
-    LOGI("Setting up DOM...");
-    file_log("Setting up DOM...");
-    js_quickjs_setup_initial_dom();
-    
     ui_set_status(app, "Analyzing URL...");
 
     /* Step 1: Analyze URL and extract media info */
     char err[512] = {0};
     MediaUrl media = {0};
+    HttpBuffer buffer = {0};
+    bool buffer_allocated = false;
     
-    file_log("Calling url_analyze...");
+    /* Several URLs or a playlist: resolve them all on this runtime */
+    UrlBatchItem *batch = calloc(URL_BATCH_MAX_ITEMS, sizeof(UrlBatchItem));
+    int batchCount = batch ? collect_batch_items(args->url, batch, URL_BATCH_MAX_ITEMS) : 0;
+    if (batchCount > 1) {
+        run_batch(app, batch, batchCount);
+        free(batch);
+        goto cleanup;
+    }
+    free(batch);
+    
+    TLOG_DEBUG(LOG_TAG, "Calling url_analyze...");
     if (!url_analyze(args->url, &media, err, sizeof(err))) {
         LOGE("URL analysis failed: %s", err);
-        file_log("URL analysis failed: %s", err);
         char status_msg[280];
         snprintf(status_msg, sizeof(status_msg), "Analysis failed: %.200s", err);
         ui_set_status(app, status_msg);
@@ -1204,7 +1277,6 @@ static void *worker_thread(void *arg) {
     }
 
     LOGI("Media URL found: %.300s", media.url);
-    file_log("Media URL found: %.300s", media.url);
     
     // Check for overall timeout
     if (time(NULL) - start_time > max_total_time) {
@@ -1229,11 +1301,12 @@ static void *worker_thread(void *arg) {
     ui_set_progress(app, 0.1f);
 
     /* Step 2: Download the media file */
-    HttpBuffer buffer = {0};
-    bool buffer_allocated = false;
-    
     if (!http_get_to_memory(media.url, &buffer, err, sizeof(err))) {
         LOGE("Download failed: %s", err);
+        /* Stream URL was revoked before its expire= time */
+        if (strstr(err, "HTTP error 403")) {
+            media_cache_invalidate_url(media.url);
+        }
         char status_msg[280];
         snprintf(status_msg, sizeof(status_msg), "Download failed: %.200s", err);
         ui_set_status(app, status_msg);
@@ -1258,9 +1331,9 @@ cleanup:
         http_free_buffer(&buffer);
     }
     
-    LOGI("Cleaning up QuickJS...");
-    file_log("Cleaning up QuickJS...");
-    js_quickjs_cleanup();
+    /* Recycled in the background while the UI goes idle */
+    LOGI("Releasing QuickJS runtime...");
+    js_runtime_pool_release();
     
     app->workerRunning = false;
     free(args);
@@ -1269,10 +1342,8 @@ cleanup:
 
 static void start_worker(VulkanApp *app) {
     LOGI("start_worker called, workerRunning=%d", app->workerRunning ? 1 : 0);
-    file_log("start_worker called, workerRunning=%d", app->workerRunning ? 1 : 0);
     if (app->workerRunning) {
         LOGI("start_worker: worker already running, returning");
-        file_log("start_worker: worker already running, returning");
         return;
     }
     WorkerArgs *args = (WorkerArgs *)malloc(sizeof(WorkerArgs));
@@ -2055,6 +2126,9 @@ void android_main(struct android_app *app) {
     update_density_scale(app, &vk);
     app->userData = &vk;
     
+    // Bring the JS engine up ahead of the first download
+    js_runtime_pool_start();
+    
     // Normal Vulkan rendering loop
     while (true) {
         int events;
@@ -2067,6 +2141,8 @@ void android_main(struct android_app *app) {
                 pthread_mutex_destroy(&vk.uiMutex);
                 g_app = NULL;
                 cleanup_device(&vk);
+                js_runtime_pool_stop();
+                tlog_flush();
                 return;
             }
         }
@@ -2243,7 +2319,6 @@ static void handle_character_input(char c) {
     g_input.textBuffer[g_input.textLength] = '\0';
     
     LOGI("Input: '%c' -> buffer: '%s'", c, g_input.textBuffer);
-    file_log("Input: '%c' -> buffer: '%s'", c, g_input.textBuffer);
 }
 
 /**
@@ -2289,7 +2364,6 @@ static void handle_cursor_right(void) {
  */
 static void handle_submit(void) {
     LOGI("Submit triggered, URL: '%s'", g_input.textBuffer);
-    file_log("Submit triggered, URL: '%s'", g_input.textBuffer);
     
     if (!g_app) {
         LOGE("handle_submit: g_app is NULL!");
@@ -0,0 +1,231 @@
+#include "media_cache.h"
+#include "trace_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#define LOG_TAG "media_cache"
+#define LOGI(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
+
+#define MEDIA_CACHE_PATH "/data/data/com.bgmdwldr.vulkan/media_cache.bin"
+#define MEDIA_CACHE_MAGIC 0x4d434331u  /* "MCC1" */
+#define MEDIA_CACHE_VERSION 1
+
+typedef struct MediaCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t count;
+} MediaCacheFileHeader;
+
+static pthread_mutex_t g_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static MediaCacheEntry g_entries[MEDIA_CACHE_MAX_ENTRIES];
+static int g_entry_count = 0;
+static bool g_loaded = false;
+
+/* Parse the expire= query parameter of a googlevideo URL, 0 if absent */
+static long long url_expire_param(const char *url) {
+    const char *p = url;
+    while ((p = strstr(p, "expire=")) != NULL) {
+        if (p != url && (p[-1] == '?' || p[-1] == '&')) {
+            return strtoll(p + 7, NULL, 10);
+        }
+        p += 7;
+    }
+    return 0;
+}
+
+static bool entry_is_valid(const MediaCacheEntry *entry, long long now) {
+    return entry->video_id[0] && entry->expires_at - MEDIA_CACHE_EXPIRY_MARGIN > now;
+}
+
+static void cache_load_locked(void) {
+    if (g_loaded) return;
+    g_loaded = true;
+    g_entry_count = 0;
+
+    FILE *f = fopen(MEDIA_CACHE_PATH, "rb");
+    if (!f) return;
+
+    MediaCacheFileHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) == 1 &&
+        hdr.magic == MEDIA_CACHE_MAGIC &&
+        hdr.version == MEDIA_CACHE_VERSION &&
+        hdr.entry_size == sizeof(MediaCacheEntry) &&
+        hdr.count <= MEDIA_CACHE_MAX_ENTRIES) {
+        g_entry_count = (int)fread(g_entries, sizeof(MediaCacheEntry), hdr.count, f);
+    }
+    fclose(f);
+
+    /* Drop whatever expired while the app was not running */
+    long long now = (long long)time(NULL);
+    int kept = 0;
+    for (int i = 0; i < g_entry_count; i++) {
+        g_entries[i].video_id[sizeof(g_entries[i].video_id) - 1] = '\0';
+        g_entries[i].policy[sizeof(g_entries[i].policy) - 1] = '\0';
+        if (entry_is_valid(&g_entries[i], now)) {
+            g_entries[kept++] = g_entries[i];
+        }
+    }
+    g_entry_count = kept;
+    LOGI("Loaded %d cached resolutions", g_entry_count);
+}
+
+static void cache_save_locked(void) {
+    char tmp_path[sizeof(MEDIA_CACHE_PATH) + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", MEDIA_CACHE_PATH);
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        LOGE("Cannot write %s", tmp_path);
+        return;
+    }
+
+    MediaCacheFileHeader hdr = {
+        MEDIA_CACHE_MAGIC, MEDIA_CACHE_VERSION,
+        (uint32_t)sizeof(MediaCacheEntry), (uint32_t)g_entry_count
+    };
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+              fwrite(g_entries, sizeof(MediaCacheEntry), g_entry_count, f) == (size_t)g_entry_count;
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(tmp_path, MEDIA_CACHE_PATH) != 0) {
+        LOGE("Failed to save media cache");
+        remove(tmp_path);
+    }
+}
+
+static int find_entry_locked(const char *videoId, const char *policy) {
+    for (int i = 0; i < g_entry_count; i++) {
+        if (strcmp(g_entries[i].video_id, videoId) == 0 &&
+            strcmp(g_entries[i].policy, policy) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void remove_entry_locked(int index) {
+    g_entries[index] = g_entries[g_entry_count - 1];
+    g_entry_count--;
+}
+
+bool media_cache_lookup(const char *videoId, const char *policy, MediaCacheEntry *outEntry) {
+    if (!videoId || !videoId[0] || !policy || !outEntry) return false;
+
+    pthread_mutex_lock(&g_cache_mutex);
+    cache_load_locked();
+
+    bool hit = false;
+    int index = find_entry_locked(videoId, policy);
+    if (index >= 0) {
+        if (entry_is_valid(&g_entries[index], (long long)time(NULL))) {
+            *outEntry = g_entries[index];
+            hit = true;
+        } else {
+            LOGI("Cached resolution for %s expired", videoId);
+            remove_entry_locked(index);
+            cache_save_locked();
+        }
+    }
+
+    pthread_mutex_unlock(&g_cache_mutex);
+    return hit;
+}
+
+void media_cache_store(const char *videoId, const char *policy, const MediaUrl *chosen,
+                       const MediaUrl *streams, int streamCount) {
+    if (!videoId || !videoId[0] || !policy || !chosen) return;
+    if (strlen(videoId) >= MEDIA_CACHE_KEY_MAX || strlen(policy) >= MEDIA_CACHE_KEY_MAX) return;
+
+    /* The entry is only as fresh as its earliest expiring URL */
+    long long expires_at = url_expire_param(chosen->url);
+    if (streamCount > MEDIA_CACHE_MAX_STREAMS) streamCount = MEDIA_CACHE_MAX_STREAMS;
+    for (int i = 0; streams && i < streamCount; i++) {
+        long long e = url_expire_param(streams[i].url);
+        if (e > 0 && (expires_at == 0 || e < expires_at)) expires_at = e;
+    }
+    long long now = (long long)time(NULL);
+    if (expires_at - MEDIA_CACHE_EXPIRY_MARGIN <= now) {
+        LOGI("Not caching %s: no usable expire= parameter", videoId);
+        return;
+    }
+
+    pthread_mutex_lock(&g_cache_mutex);
+    cache_load_locked();
+
+    int index = find_entry_locked(videoId, policy);
+    if (index < 0) {
+        if (g_entry_count < MEDIA_CACHE_MAX_ENTRIES) {
+            index = g_entry_count++;
+        } else {
+            /* Evict the entry that expires soonest */
+            index = 0;
+            for (int i = 1; i < g_entry_count; i++) {
+                if (g_entries[i].expires_at < g_entries[index].expires_at) index = i;
+            }
+        }
+    }
+
+    MediaCacheEntry *entry = &g_entries[index];
+    memset(entry, 0, sizeof(*entry));
+    snprintf(entry->video_id, sizeof(entry->video_id), "%s", videoId);
+    snprintf(entry->policy, sizeof(entry->policy), "%s", policy);
+    entry->expires_at = expires_at;
+    entry->chosen = *chosen;
+    entry->stream_count = streams ? streamCount : 0;
+    for (int i = 0; i < entry->stream_count; i++) {
+        entry->streams[i] = streams[i];
+    }
+
+    LOGI("Cached %d streams for %s (valid for %llds)", entry->stream_count, videoId,
+         expires_at - now);
+    cache_save_locked();
+    pthread_mutex_unlock(&g_cache_mutex);
+}
+
+void media_cache_invalidate_url(const char *mediaUrl) {
+    if (!mediaUrl || !mediaUrl[0]) return;
+
+    pthread_mutex_lock(&g_cache_mutex);
+    cache_load_locked();
+
+    bool changed = false;
+    for (int i = g_entry_count - 1; i >= 0; i--) {
+        bool match = strcmp(g_entries[i].chosen.url, mediaUrl) == 0;
+        for (int j = 0; !match && j < g_entries[i].stream_count; j++) {
+            match = strcmp(g_entries[i].streams[j].url, mediaUrl) == 0;
+        }
+        if (match) {
+            LOGI("Invalidating cached resolution for %s", g_entries[i].video_id);
+            remove_entry_locked(i);
+            changed = true;
+        }
+    }
+    if (changed) cache_save_locked();
+
+    pthread_mutex_unlock(&g_cache_mutex);
+}
+
+void media_cache_invalidate(const char *videoId) {
+    if (!videoId || !videoId[0]) return;
+
+    pthread_mutex_lock(&g_cache_mutex);
+    cache_load_locked();
+
+    bool changed = false;
+    for (int i = g_entry_count - 1; i >= 0; i--) {
+        if (strcmp(g_entries[i].video_id, videoId) == 0) {
+            remove_entry_locked(i);
+            changed = true;
+        }
+    }
+    if (changed) cache_save_locked();
+
+    pthread_mutex_unlock(&g_cache_mutex);
+}
@@ -0,0 +1,45 @@
+#ifndef MEDIA_CACHE_H
+#define MEDIA_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "url_analyzer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIA_CACHE_MAX_ENTRIES 16
+#define MEDIA_CACHE_MAX_STREAMS 8
+#define MEDIA_CACHE_KEY_MAX 32
+#define MEDIA_CACHE_EXPIRY_MARGIN 60  /* Seconds before expire= to stop serving */
+
+/* Stream selection policy, part of the cache key */
+#define MEDIA_CACHE_POLICY_FIRST "first"
+
+typedef struct MediaCacheEntry {
+    char video_id[MEDIA_CACHE_KEY_MAX];
+    char policy[MEDIA_CACHE_KEY_MAX];
+    long long expires_at;            /* Unix time, from the earliest expire= */
+    MediaUrl chosen;
+    int stream_count;
+    MediaUrl streams[MEDIA_CACHE_MAX_STREAMS];
+} MediaCacheEntry;
+
+/* Returns true and fills outEntry if a still valid entry exists. */
+bool media_cache_lookup(const char *videoId, const char *policy, MediaCacheEntry *outEntry);
+
+/* Stores a resolution result. Entries whose URLs carry no expire= are not cached. */
+void media_cache_store(const char *videoId, const char *policy, const MediaUrl *chosen,
+                       const MediaUrl *streams, int streamCount);
+
+/* Drops every entry that handed out mediaUrl, e.g. after a 403 on download. */
+void media_cache_invalidate_url(const char *mediaUrl);
+
+void media_cache_invalidate(const char *videoId);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,263 @@
+// Standalone test and benchmark for the byte_scan kernels
+// Build on the host, e.g.:
+//   cc -O2 [-mavx2 | -DBYTE_SCAN_SCALAR] -I. test_byte_scan.c byte_scan.c -o test_byte_scan
+//   ./test_byte_scan                 compare every kernel with a naive scan
+//   ./test_byte_scan bench [page]    time them on a saved watch page (or a
+//                                    synthetic one) against byte loops
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "byte_scan.h"
+
+static int failures = 0;
+
+// ---------------------------------------------------------------------------
+// Naive references: one byte at a time, the way the scanners used to work
+// ---------------------------------------------------------------------------
+
+static const char *naive_any(const char *p, const char *end, const char *set, size_t set_len) {
+    for (; p < end; p++) {
+        if (memchr(set, *p, set_len)) return p;
+    }
+    return end;
+}
+
+static const char *naive_find_ci(const char *p, const char *end, const char *needle, size_t needle_len) {
+    for (; p < end && (size_t)(end - p) >= needle_len; p++) {
+        size_t i = 0;
+        while (i < needle_len && tolower((unsigned char)p[i]) == tolower((unsigned char)needle[i])) i++;
+        if (i == needle_len) return p;
+    }
+    return end;
+}
+
+static const char g_js_set[] = { '"', '\'', '`', '/', '<', '\\' };
+
+// ---------------------------------------------------------------------------
+
+static unsigned rng_state = 1;
+static unsigned rng(void) {
+    rng_state = rng_state * 1103515245u + 12345u;
+    return rng_state >> 8;
+}
+
+// Buffer that ends right before an inaccessible page, so any read past end
+// faults instead of passing silently
+static char *g_guard_base;
+static size_t g_page;
+
+static char *guarded_tail(size_t len) {
+    return g_guard_base + g_page - len;
+}
+
+static void setup_guard(void) {
+    g_page = (size_t)sysconf(_SC_PAGESIZE);
+    g_guard_base = mmap(NULL, g_page * 2, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (g_guard_base == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    mprotect(g_guard_base + g_page, g_page, PROT_NONE);
+}
+
+static void check(const char *what, const char *buf, const char *got, const char *want, size_t len) {
+    if (got != want) {
+        printf("FAIL %s (len %zu): got offset %td, want %td\n", what, len, got - buf, want - buf);
+        failures++;
+    }
+}
+
+// Alphabet is small so every set member and needle byte shows up often,
+// in both cases, at every lane position
+static void fill(char *buf, size_t len) {
+    static const char alphabet[] = "aAsScCrRiIpPtT<>/\"'`\\ \n=x";
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = alphabet[rng() % (sizeof(alphabet) - 1)];
+        if (rng() % 4) buf[i] = 'q';
+    }
+}
+
+static void test_any(void) {
+    static const char *sets[] = { "<", "<>", "\"'", "<&\n", "\"'`/<\\", "aAsScCrR" };
+    for (size_t len = 0; len <= 200; len++) {
+        for (int iter = 0; iter < 40; iter++) {
+            char *buf = guarded_tail(len);
+            fill(buf, len);
+            for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+                size_t n = strlen(sets[s]);
+                for (size_t start = 0; start <= len && start < 40; start += 7) {
+                    check("byte_scan_any", buf,
+                          byte_scan_any(buf + start, buf + len, sets[s], n),
+                          naive_any(buf + start, buf + len, sets[s], n), len);
+                }
+            }
+            check("byte_scan_js_special", buf, byte_scan_js_special(buf, buf + len),
+                  naive_any(buf, buf + len, g_js_set, sizeof(g_js_set)), len);
+        }
+    }
+}
+
+static void test_find_ci(void) {
+    static const char *needles[] = { "<", "<s", "</script", "<script", "src=", "\"'" };
+    for (size_t len = 0; len <= 200; len++) {
+        for (int iter = 0; iter < 40; iter++) {
+            char *buf = guarded_tail(len);
+            fill(buf, len);
+            // Plant a match (random case) at a random spot, sometimes
+            // straddling the end so only a prefix fits
+            const char *plant = needles[rng() % (sizeof(needles) / sizeof(needles[0]))];
+            size_t plant_len = strlen(plant);
+            if (len > 0) {
+                size_t at = rng() % len;
+                for (size_t i = 0; i < plant_len && at + i < len; i++) {
+                    char c = plant[i];
+                    buf[at + i] = (rng() & 1) ? (char)toupper((unsigned char)c) : c;
+                }
+            }
+            for (size_t nd = 0; nd < sizeof(needles) / sizeof(needles[0]); nd++) {
+                size_t n = strlen(needles[nd]);
+                check("byte_scan_find_ci", buf,
+                      byte_scan_find_ci(buf, buf + len, needles[nd], n),
+                      naive_find_ci(buf, buf + len, needles[nd], n), len);
+            }
+        }
+    }
+}
+
+static void test_edges(void) {
+    const char *s = "abc";
+    if (byte_scan_any(NULL, s + 3, "a", 1) != s + 3) { printf("FAIL any NULL\n"); failures++; }
+    if (byte_scan_any(s, s + 3, "a", 0) != s + 3) { printf("FAIL any empty set\n"); failures++; }
+    if (byte_scan_find_ci(s, s + 3, "abcd", 4) != s + 3) { printf("FAIL find_ci long needle\n"); failures++; }
+    if (byte_scan_find_ci(s, s + 3, "", 0) != s + 3) { printf("FAIL find_ci empty needle\n"); failures++; }
+    // NUL bytes are ordinary data
+    const char z[] = "x\0y\0<";
+    if (byte_scan_any(z, z + 5, "<", 1) != z + 4) { printf("FAIL any past NUL\n"); failures++; }
+    if (byte_scan_find_ci(z, z + 5, "Y\0<", 3) != z + 2) { printf("FAIL find_ci past NUL\n"); failures++; }
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *load_page(const char *path, size_t *out_len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = malloc((size_t)size + 1);
+    if (buf && fread(buf, 1, (size_t)size, f) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    if (buf) {
+        buf[size] = '\0';
+        *out_len = (size_t)size;
+    }
+    return buf;
+}
+
+// Roughly the shape of a watch page: markup, then a few large inline
+// scripts full of string literals
+static char *synth_page(size_t size, size_t *out_len) {
+    char *buf = malloc(size + 1);
+    size_t n = 0;
+    static const char markup[] = "<div class=\"ytd-item\" id=\"x\"><span>Title text here</span></div>\n";
+    static const char script_open[] = "<script nonce=\"abc\">";
+    static const char script_close[] = "</script>\n";
+    static const char js[] = "var a=\"some string value\",b=function(c){return c.split(\"\").reverse()};";
+    while (n + 4096 < size) {
+        for (int i = 0; i < 20 && n + 4096 < size; i++) {
+            memcpy(buf + n, markup, sizeof(markup) - 1);
+            n += sizeof(markup) - 1;
+        }
+        memcpy(buf + n, script_open, sizeof(script_open) - 1);
+        n += sizeof(script_open) - 1;
+        for (int i = 0; i < 200 && n + 4096 < size; i++) {
+            memcpy(buf + n, js, sizeof(js) - 1);
+            n += sizeof(js) - 1;
+        }
+        memcpy(buf + n, script_close, sizeof(script_close) - 1);
+        n += sizeof(script_close) - 1;
+    }
+    buf[n] = '\0';
+    *out_len = n;
+    return buf;
+}
+
+typedef const char *(*scan_fn)(const char *p, const char *end, const char *arg, size_t arg_len);
+
+// Walks the whole page hit by hit, like the scanners do
+static double time_walk(scan_fn fn, const char *buf, size_t len, const char *arg, size_t arg_len,
+                        size_t *hits) {
+    const char *end = buf + len;
+    int reps = 10;
+    double t0 = now_sec();
+    for (int r = 0; r < reps; r++) {
+        size_t count = 0;
+        for (const char *p = buf; (p = fn(p, end, arg, arg_len)) < end; p++) count++;
+        *hits = count;
+    }
+    return (now_sec() - t0) / reps;
+}
+
+static const char *js_special_fn(const char *p, const char *end, const char *arg, size_t arg_len) {
+    (void)arg;
+    (void)arg_len;
+    return byte_scan_js_special(p, end);
+}
+
+static void bench_row(const char *name, scan_fn fast, scan_fn slow, const char *buf, size_t len,
+                      const char *arg, size_t arg_len) {
+    size_t fast_hits, slow_hits;
+    double t_fast = time_walk(fast, buf, len, arg, arg_len, &fast_hits);
+    double t_slow = time_walk(slow, buf, len, arg, arg_len, &slow_hits);
+    printf("  %-22s %8.1f MB/s  byte loop %8.1f MB/s  %5.1fx  %zu hits%s\n", name,
+           len / t_fast / 1e6, len / t_slow / 1e6, t_slow / t_fast, fast_hits,
+           fast_hits == slow_hits ? "" : "  MISMATCH");
+}
+
+static void bench(const char *path) {
+    size_t len = 0;
+    char *buf = path ? load_page(path, &len) : synth_page(4u << 20, &len);
+    if (!buf) {
+        printf("Cannot read %s\n", path);
+        return;
+    }
+    printf("%s: %zu bytes\n", path ? path : "synthetic page", len);
+    bench_row("find_ci <script", byte_scan_find_ci, naive_find_ci, buf, len, "<script", 7);
+    bench_row("find_ci </script", byte_scan_find_ci, naive_find_ci, buf, len, "</script", 8);
+    bench_row("any '<'", byte_scan_any, naive_any, buf, len, "<", 1);
+    bench_row("any '\"' '\\''", byte_scan_any, naive_any, buf, len, "\"'", 2);
+    bench_row("js_special", js_special_fn, naive_any, buf, len, g_js_set, sizeof(g_js_set));
+    free(buf);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench(argc > 2 ? argv[2] : NULL);
+        return 0;
+    }
+
+    setup_guard();
+    test_any();
+    test_find_ci();
+    test_edges();
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All byte_scan tests passed\n");
+    return 0;
+}
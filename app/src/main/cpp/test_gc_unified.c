@@ -0,0 +1,595 @@
+// Standalone test and benchmark for the unified GC heap
+// Build on the host, e.g.:
+//   cc -O2 -pthread -Ithird_party/quickjs test_gc_unified.c third_party/quickjs/quickjs_gc_unified.c -o test_gc_unified
+//   ./test_gc_unified          run the heap and handle table tests
+//   ./test_gc_unified bench    handle allocation throughput against the
+//                              number of live handles, the heap footprint
+//                              of the 16-byte header, and mark pauses
+//                              against the number of mark helpers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "quickjs_gc_unified.h"
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t handles_used(void) {
+    GCStats stats;
+    gc_get_stats(&stats);
+    return stats.handles_used;
+}
+
+// ---------------------------------------------------------------------------
+// Handle table
+// ---------------------------------------------------------------------------
+
+static void test_handles(void) {
+    gc_reset();
+    enum { N = 10000 };
+    static GCHandle h[N];
+    for (int i = 0; i < N; i++) {
+        h[i] = gc_alloc(16 + i % 64, JS_GC_OBJ_TYPE_DATA);
+        CHECK(h[i] != GC_HANDLE_NULL);
+        *(int*)gc_deref(h[i]) = i;
+    }
+    CHECK(handles_used() == N);
+
+    // Freed handles come back before the table grows
+    for (int i = 0; i < N; i += 2) gc_free(h[i]);
+    CHECK(handles_used() == N / 2);
+    uint32_t count = gc_current_heap()->handles.count;
+    for (int i = 0; i < N; i += 2) {
+        h[i] = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+        *(int*)gc_deref(h[i]) = i;
+    }
+    CHECK(gc_current_heap()->handles.count == count);
+    for (int i = 0; i < N; i++) CHECK(*(int*)gc_deref(h[i]) == i);
+
+    // Releasing twice must not hand the same slot out twice
+    GCHandle a = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    gc_free(a);
+    gc_free(a);
+    GCHandle b = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    GCHandle c = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    CHECK(b != c);
+    CHECK(!gc_handle_is_valid(GC_HANDLE_NULL));
+
+    // A handle into the middle of an object goes on its own
+    GCHandle inner = gc_alloc_handle_for_ptr((char*)gc_deref(b) + 16);
+    CHECK(inner != b && gc_deref(inner) == (char*)gc_deref(b) + 16);
+    gc_free(inner);
+    CHECK(gc_deref(inner) == NULL);
+    CHECK(gc_handle_is_valid(b));
+
+    gc_reset();
+    CHECK(handles_used() == 0);
+    CHECK(!gc_handle_is_valid(h[0]));
+}
+
+// ---------------------------------------------------------------------------
+// Header and side tables
+// ---------------------------------------------------------------------------
+
+static int g_finalized;
+static int g_destroyed;
+
+static void count_finalizer(JSRuntime *rt, GCHandle handle, void *user_ptr) {
+    (void)rt;
+    (void)user_ptr;
+    CHECK(gc_handle_is_valid(handle));
+    g_finalized++;
+}
+
+static bool destroy_all(JSRuntime *rt, void *user_ptr) {
+    (void)rt;
+    (void)user_ptr;
+    g_destroyed++;
+    return true;
+}
+
+static bool destroy_none(JSRuntime *rt, void *user_ptr) {
+    (void)rt;
+    (void)user_ptr;
+    return false;
+}
+
+static void test_header(void) {
+    static char runtime;                    // Only passed through
+    JSRuntime *rt = (JSRuntime*)&runtime;
+
+    CHECK(sizeof(GCHeader) == 16);
+    gc_reset();
+    for (size_t size = 1; size < 300; size += 7) {
+        GCHandle h = gc_alloc(size, JS_GC_OBJ_TYPE_DATA);
+        CHECK(((uintptr_t)gc_deref(h) & 15) == 0);
+        CHECK(gc_usable_size(h) >= size);
+    }
+
+    // Finalizers live in the side table and run once from the sweep,
+    // for heap and large objects alike, even when the object is kept
+    gc_reset();
+    GCHandle small = gc_alloc(64, JS_GC_OBJ_TYPE_SHAPE);
+    GCHandle large = gc_alloc(GC_LARGE_OBJECT_SIZE * 2, JS_GC_OBJ_TYPE_SHAPE);
+    GCHandle live = gc_alloc(64, JS_GC_OBJ_TYPE_SHAPE);
+    gc_set_handle_finalizer(small, count_finalizer);
+    gc_set_handle_finalizer(large, count_finalizer);
+    gc_set_handle_finalizer(live, count_finalizer);
+    CHECK(gc_get_handle_finalizer(small) == count_finalizer);
+    g_finalized = 0;
+    gc_clear_marks();
+    gc_mark_object(gc_deref(live));
+    gc_sweep_unmarked(rt, destroy_none);
+    CHECK(g_finalized == 2);
+    CHECK(gc_handle_is_valid(small) && gc_handle_is_valid(large));
+    CHECK(gc_get_handle_finalizer(small) == NULL);
+    CHECK(gc_get_handle_finalizer(live) == count_finalizer);
+
+    g_destroyed = 0;
+    gc_clear_marks();
+    gc_mark_object(gc_deref(live));
+    size_t live_bytes = gc_sweep_unmarked(rt, destroy_all);
+    CHECK(g_finalized == 2 && g_destroyed == 2);
+    CHECK(!gc_handle_is_valid(small) && !gc_handle_is_valid(large));
+    CHECK(gc_handle_is_valid(live));
+    CHECK(live_bytes == gc_allocated_bytes());
+    CHECK(gc_current_heap()->large.count == 0);
+    CHECK(gc_current_heap()->finalizers.count == 1);
+}
+
+// ---------------------------------------------------------------------------
+// Large-object space
+// ---------------------------------------------------------------------------
+
+#define LARGE_COUNT 64
+
+static bool large_sorted(void) {
+    GCState *heap = gc_current_heap();
+    for (uint32_t i = 1; i < heap->large.count; i++) {
+        if (heap->large.objects[i - 1] >= heap->large.objects[i]) return false;
+    }
+    return true;
+}
+
+// Lookups find the object holding any interior pointer, and a sweep
+// releases the handles made for pointers into dead objects
+static void test_large_objects(void) {
+    static char runtime;
+    JSRuntime *rt = (JSRuntime*)&runtime;
+    GCHandle objs[LARGE_COUNT], inner[LARGE_COUNT];
+
+    gc_reset();
+    for (int i = 0; i < LARGE_COUNT; i++) {
+        objs[i] = gc_alloc(GC_LARGE_OBJECT_SIZE + i * 4096, JS_GC_OBJ_TYPE_DATA);
+        inner[i] = gc_alloc_handle_for_ptr((char*)gc_deref(objs[i]) + GC_LARGE_OBJECT_SIZE / 2);
+    }
+    CHECK(large_sorted());
+    for (int i = 0; i < LARGE_COUNT; i++) {
+        char *p = gc_deref(objs[i]);
+        CHECK(gc_ptr_is_valid(p) && gc_ptr_is_valid(p + GC_LARGE_OBJECT_SIZE - 1));
+    }
+    int x;
+    CHECK(!gc_ptr_is_valid(&x));
+
+    // Growing may move a mapping; it keeps its place in address order
+    for (int i = 0; i < LARGE_COUNT; i += 7) {
+        objs[i] = gc_realloc(objs[i], GC_LARGE_OBJECT_SIZE * 8);
+        CHECK(gc_ptr_is_valid((char*)gc_deref(objs[i]) + GC_LARGE_OBJECT_SIZE * 8 - 1));
+    }
+    CHECK(large_sorted());
+
+    gc_clear_marks();
+    // Keep the even ones and the grown ones, whose inner aliases are stale
+    for (int i = 0; i < LARGE_COUNT; i++) {
+        if (i % 2 == 0 || i % 7 == 0) gc_mark_object(gc_deref(objs[i]));
+    }
+    gc_sweep_unmarked(rt, destroy_all);
+    CHECK(large_sorted());
+    int live = 0;
+    for (int i = 0; i < LARGE_COUNT; i++) {
+        bool kept = i % 2 == 0 || i % 7 == 0;
+        live += kept;
+        CHECK(gc_handle_is_valid(objs[i]) == kept);
+        if (!kept) CHECK(gc_current_heap()->handles.ptrs[inner[i]] == NULL);
+        else if (i % 7 != 0) CHECK(gc_deref(inner[i]) == (char*)gc_deref(objs[i]) + GC_LARGE_OBJECT_SIZE / 2);
+    }
+    CHECK(gc_current_heap()->large.count == (uint32_t)live);
+}
+
+// ---------------------------------------------------------------------------
+// Native roots
+// ---------------------------------------------------------------------------
+
+// Kept out of the stack, so only what the test puts there is found
+static GCHandle g_blocks[64];
+static GCHandle g_rooted;
+
+static void trace_none(JSRuntime *rt, void *user_ptr) {
+    (void)rt;
+    (void)user_ptr;
+}
+
+static bool marked(GCHandle handle) {
+    return gc_header(gc_deref(handle))->mark != 0;
+}
+
+// Fills the heap with reused and split blocks, so block starts come from
+// every path that makes one
+__attribute__((noinline)) static void fill_blocks(void) {
+    static char runtime;
+    gc_reset();
+    // Small numbers fill every stack; keep them off the handles under test
+    for (int i = 0; i < 100000; i++) gc_alloc(16, JS_GC_OBJ_TYPE_JS_STRING);
+    for (int i = 0; i < 64; i++) g_blocks[i] = gc_alloc(64 + i * 16, JS_GC_OBJ_TYPE_DATA);
+    gc_clear_marks();
+    for (int i = 0; i < 64; i += 2) gc_mark_object(gc_deref(g_blocks[i]));
+    gc_sweep_unmarked((JSRuntime*)&runtime, destroy_all);
+    for (int i = 1; i < 64; i += 2) g_blocks[i] = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    g_blocks[63] = gc_alloc(GC_LARGE_OBJECT_SIZE, JS_GC_OBJ_TYPE_DATA);
+    g_rooted = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    gc_add_root(g_rooted);
+}
+
+// Overwrites the dead frames below the caller, so stale locals of the
+// allocator are not mistaken for references
+__attribute__((noinline)) static void clobber_stack(void) {
+    volatile char junk[16384];
+    memset((char*)junk, 0, sizeof(junk));
+}
+
+__attribute__((noinline)) static void mark_native(void) {
+    gc_clear_marks();
+    gc_mark_begin(NULL, trace_none);
+    gc_mark_native_roots();
+    gc_mark_end();
+}
+
+static void test_native_roots(void) {
+    fill_blocks();
+    // A pointer into the middle of a block, one to a large object's last
+    // byte, and a bare handle, all held in locals only
+    char *volatile inner = (char*)gc_deref(g_blocks[10]) + 40;
+    char *volatile split = (char*)gc_deref(g_blocks[11]) + 16;
+    char *volatile last = (char*)gc_deref(g_blocks[63]) + GC_LARGE_OBJECT_SIZE - 1;
+    volatile GCHandle bare = g_blocks[20];
+    clobber_stack();
+    mark_native();
+    CHECK(marked(g_blocks[10]) && marked(g_blocks[11]) && marked(g_blocks[63]));
+    CHECK(marked(g_blocks[20]) && marked(g_rooted));
+    int others = 0;
+    for (int i = 0; i < 63; i++) others += i != 10 && i != 11 && i != 20 && marked(g_blocks[i]);
+    CHECK(others == 0);
+    (void)inner;
+    (void)split;
+    (void)last;
+    (void)bare;
+    gc_remove_root(g_rooted);
+}
+
+static uint32_t g_word_seen;
+
+static void note_word(JSRuntime *rt, uint32_t word) {
+    (void)rt;
+    g_word_seen = word;
+}
+
+// Marked blocks are scanned like the stack, except strings and blocks
+// set precise
+static void test_block_scan(void) {
+    gc_reset();
+    GCHandle data = gc_alloc(64, JS_GC_OBJ_TYPE_DATA);
+    GCHandle named = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    GCHandle pointed = gc_alloc(96, JS_GC_OBJ_TYPE_DATA);
+    GCHandle precise = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    GCHandle weak = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    GCHandle string = gc_alloc(32, JS_GC_OBJ_TYPE_JS_STRING);
+    GCHandle chars = gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    uint32_t *words = gc_deref(data);
+    words[1] = named;
+    words[3] = 1500;
+    *(char**)&words[4] = (char*)gc_deref(pointed) + 50;
+    *(GCHandle*)gc_deref(precise) = weak;
+    *(GCHandle*)gc_deref(string) = chars;
+    gc_set_precise(precise);
+
+    g_word_seen = 0;
+    gc_clear_marks();
+    gc_mark_begin(NULL, trace_none);
+    gc_mark_words(1000, 2000, note_word);
+    gc_mark_object(gc_deref(data));
+    gc_mark_object(gc_deref(precise));
+    gc_mark_object(gc_deref(string));
+    gc_mark_end();
+    CHECK(marked(named) && marked(pointed));
+    CHECK(!marked(weak) && !marked(chars));
+    CHECK(g_word_seen == 1500);
+
+    // A block moved by gc_realloc stays precise
+    precise = gc_realloc(precise, 4096);
+    gc_clear_marks();
+    gc_mark_begin(NULL, trace_none);
+    gc_mark_object(gc_deref(precise));
+    gc_mark_end();
+    CHECK(!marked(weak));
+}
+
+static int g_exhausted;
+static JSRuntime *g_exhausted_rt;
+
+static void note_exhausted(JSRuntime *rt) {
+    g_exhausted++;
+    g_exhausted_rt = rt;
+    // A failing allocation in here does not call back again
+    CHECK(gc_alloc((size_t)UINT32_MAX + 1, JS_GC_OBJ_TYPE_DATA) == GC_HANDLE_NULL);
+}
+
+// An allocation that finds no room asks the hook once, then retries
+static void test_exhausted_hook(void) {
+    static int fake_rt;
+    gc_reset();
+    gc_set_exhausted_hook(note_exhausted);
+    gc_set_runtime((JSRuntime*)&fake_rt);
+    g_exhausted = 0;
+    CHECK(gc_alloc(64, JS_GC_OBJ_TYPE_DATA) != GC_HANDLE_NULL);
+    CHECK(g_exhausted == 0);
+    CHECK(gc_alloc((size_t)UINT32_MAX + 1, JS_GC_OBJ_TYPE_DATA) == GC_HANDLE_NULL);
+    CHECK(g_exhausted == 1 && g_exhausted_rt == (JSRuntime*)&fake_rt);
+
+    // Without a runtime there is nothing to collect with
+    gc_set_runtime(NULL);
+    CHECK(gc_alloc((size_t)UINT32_MAX + 1, JS_GC_OBJ_TYPE_DATA) == GC_HANDLE_NULL);
+    CHECK(g_exhausted == 1);
+    gc_set_exhausted_hook(NULL);
+}
+
+// ---------------------------------------------------------------------------
+// Parallel marking
+// ---------------------------------------------------------------------------
+
+// A synthetic object graph: each node names up to NODE_KIDS others
+#define NODE_KIDS 4
+
+typedef struct Node {
+    uint32_t count;
+    GCHandle kids[NODE_KIDS];
+} Node;
+
+static __thread GCHandle *g_nodes;
+
+// Like mark_children, reads the heap and reports children only
+static void trace_node(JSRuntime *rt, void *user_ptr) {
+    (void)rt;
+    Node *node = user_ptr;
+    for (uint32_t i = 0; i < node->count; i++) gc_mark_object(gc_deref(node->kids[i]));
+}
+
+// A tree over the first nine tenths plus random cross edges; the rest is
+// garbage. Returns the number of reachable nodes.
+static int build_graph(int count) {
+    gc_reset();
+    srand(7);
+    g_nodes = realloc(g_nodes, count * sizeof(GCHandle));
+    for (int i = 0; i < count; i++) g_nodes[i] = gc_alloc(sizeof(Node), JS_GC_OBJ_TYPE_DATA);
+    int live = count / 10 * 9;
+    for (int i = 1; i < live; i++) {
+        Node *parent = gc_deref(g_nodes[(i - 1) / 3]);
+        parent->kids[parent->count++] = g_nodes[i];
+    }
+    for (int i = 0; i < live; i++) {
+        Node *node = gc_deref(g_nodes[i]);
+        if (node->count < NODE_KIDS) node->kids[node->count++] = g_nodes[rand() % live];
+    }
+    return live;
+}
+
+// Marks from the root the way gc_mark_reachable does; returns the pause
+static double mark_graph(void) {
+    gc_clear_marks();
+    double t0 = now_sec();
+    gc_mark_begin(NULL, trace_node);
+    gc_mark_object(gc_deref(g_nodes[0]));
+    gc_mark_end();
+    return now_sec() - t0;
+}
+
+static int count_marked(int count) {
+    int marked = 0;
+    for (int i = 0; i < count; i++) marked += gc_header(gc_deref(g_nodes[i]))->mark != 0;
+    return marked;
+}
+
+static void test_parallel_mark(void) {
+    int count = 100000;
+    int live = build_graph(count);
+    for (uint32_t helpers = 0; helpers <= 3; helpers += 3) {
+        gc_set_mark_helpers(helpers);
+        mark_graph();
+        CHECK(count_marked(count) == live);
+        CHECK(!gc_header(gc_deref(g_nodes[count - 1]))->mark);
+    }
+    gc_set_mark_helpers(0);
+}
+
+// Each thread marks its own heap; both run while the other is marking
+static void *mark_own_heap(void *arg) {
+    int *wrong = arg;
+    GCState *main_heap = gc_current_heap();
+    if (!gc_init()) {
+        (*wrong)++;
+        return NULL;
+    }
+    int count = 100000;
+    for (int round = 0; round < 20; round++) {
+        int live = build_graph(count);
+        mark_graph();
+        if (count_marked(count) != live) (*wrong)++;
+    }
+    free(g_nodes);
+    g_nodes = NULL;
+    gc_cleanup();
+    if (gc_current_heap() != main_heap) (*wrong)++;
+    return NULL;
+}
+
+static void test_concurrent_heaps(void) {
+    gc_set_mark_helpers(3);
+    pthread_t threads[2];
+    int wrong[2] = { 0, 0 };
+    for (int i = 0; i < 2; i++) pthread_create(&threads[i], NULL, mark_own_heap, &wrong[i]);
+    for (int i = 0; i < 2; i++) pthread_join(threads[i], NULL);
+    CHECK(wrong[0] == 0 && wrong[1] == 0);
+    gc_set_mark_helpers(0);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmark
+// ---------------------------------------------------------------------------
+
+// The table allocate_handle used to scan from index 1 for a free slot
+static void **g_scan_ptrs;
+
+static uint32_t scan_alloc(uint32_t count, void *ptr) {
+    for (uint32_t i = 1; i < count; i++) {
+        if (!g_scan_ptrs[i]) {
+            g_scan_ptrs[i] = ptr;
+            return i;
+        }
+    }
+    return 0;
+}
+
+// Alloc/free pairs with `live` other handles held, in millions per second
+static double time_gc_pairs(int live, int pairs) {
+    gc_reset();
+    for (int i = 0; i < live; i++) gc_alloc(32, JS_GC_OBJ_TYPE_DATA);
+    double t0 = now_sec();
+    for (int i = 0; i < pairs; i++) gc_free(gc_alloc(32, JS_GC_OBJ_TYPE_DATA));
+    return pairs / (now_sec() - t0) / 1e6;
+}
+
+static double time_scan_pairs(int live, int pairs) {
+    uint32_t count = (uint32_t)live + 2;
+    g_scan_ptrs = calloc(count, sizeof(void*));
+    for (int i = 1; i <= live; i++) g_scan_ptrs[i] = &g_scan_ptrs;
+    double t0 = now_sec();
+    for (int i = 0; i < pairs; i++) g_scan_ptrs[scan_alloc(count, &g_scan_ptrs)] = NULL;
+    double rate = pairs / (now_sec() - t0) / 1e6;
+    free(g_scan_ptrs);
+    return rate;
+}
+
+// The header before the compact one: ref count, list links, handle, size,
+// flags and a finalizer pointer, with the payload 16-byte aligned after it
+#define OLD_HEADER_SIZE 48
+
+static size_t align16(size_t size) {
+    return (size + 15) & ~(size_t)15;
+}
+
+// A size mix like a QuickJS heap: strings and atoms, objects and shapes,
+// property arrays and bytecode, a few buffers; one in a thousand has a
+// finalizer
+static void bench_footprint(void) {
+    gc_reset();
+    srand(1);
+    int count = 300000;
+    size_t payload = 0;
+    size_t old_heap = 0;
+    for (int i = 0; i < count; i++) {
+        int r = rand() % 100;
+        size_t size;
+        if (r < 40) size = 16 + rand() % 24;
+        else if (r < 75) size = 48 + rand() % 40;
+        else if (r < 95) size = 96 + rand() % 160;
+        else size = 256 + rand() % 1800;
+        GCHandle h = gc_alloc(size, JS_GC_OBJ_TYPE_DATA);
+        if (i % 1000 == 0) gc_set_handle_finalizer(h, count_finalizer);
+        payload += size;
+        old_heap += OLD_HEADER_SIZE + align16(size);
+    }
+    GCState *heap = gc_current_heap();
+    size_t side = heap->finalizers.capacity * sizeof(GCFinalizerEntry);
+    size_t used = gc_used_bytes();
+    printf("footprint of %d objects, %zu KB payload\n", count, payload / 1024);
+    printf("  %2zu-byte header  heap %6zu KB + side table %3zu KB  (%4.1f%% over payload)\n",
+           sizeof(GCHeader), used / 1024, side / 1024, 100.0 * (used + side - payload) / payload);
+    printf("  %2d-byte header  heap %6zu KB                     (%4.1f%% over payload)\n",
+           OLD_HEADER_SIZE, old_heap / 1024, 100.0 * (old_heap - payload) / payload);
+}
+
+static void bench_mark(void) {
+    static const uint32_t helpers[] = { 0, 1, 3, 7 };
+    int count = 1000000;
+    int live = build_graph(count);
+    printf("mark pause, %d of %d nodes reachable, %ld CPUs\n", live, count,
+           sysconf(_SC_NPROCESSORS_ONLN));
+    double base = 0;
+    for (size_t i = 0; i < sizeof(helpers) / sizeof(helpers[0]); i++) {
+        gc_set_mark_helpers(helpers[i]);
+        double best = 1e9;
+        for (int r = 0; r < 5; r++) {
+            double pause = mark_graph();
+            if (pause < best) best = pause;
+        }
+        if (i == 0) base = best;
+        printf("  %u helpers (%u threads)  %7.1f ms  %4.2fx%s\n", helpers[i],
+               gc_current_heap()->stats.last_mark_threads, best * 1e3, base / best,
+               count_marked(count) == live ? "" : "  WRONG MARKS");
+    }
+}
+
+static void bench(void) {
+    static const int lives[] = { 1000, 10000, 50000, 100000, 500000 };
+    printf("handle alloc+free pairs, M/s\n");
+    for (size_t i = 0; i < sizeof(lives) / sizeof(lives[0]); i++) {
+        int live = lives[i];
+        double free_list = time_gc_pairs(live, 1000000);
+        double scan = time_scan_pairs(live, 2000);
+        printf("  live %7d  gc_alloc/gc_free %7.2f  linear scan %7.3f  %6.0fx\n",
+               live, free_list, scan, free_list / scan);
+    }
+    bench_footprint();
+    bench_mark();
+}
+
+int main(int argc, char **argv) {
+    if (!gc_init()) {
+        printf("gc_init failed\n");
+        return 1;
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench();
+        return 0;
+    }
+
+    test_handles();
+    test_header();
+    test_large_objects();
+    test_native_roots();
+    test_block_scan();
+    test_exhausted_hook();
+    test_parallel_mark();
+    test_concurrent_heaps();
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All unified GC tests passed\n");
+    return 0;
+}
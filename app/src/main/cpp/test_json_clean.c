@@ -0,0 +1,480 @@
+// Standalone test and benchmark for json_clean_into
+// Build on the host, e.g.:
+//   cc -O2 [-mavx2] -I. test_json_clean.c json_clean.c -o test_json_clean
+//   ./test_json_clean          run the edge-case and equivalence tests
+//   ./test_json_clean bench    compare against the old multi-pass cleaner
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include "json_clean.h"
+
+// ---------------------------------------------------------------------------
+// Reference: the three-pass cleaner json_clean_into replaced, kept verbatim
+// (entity decode, then \xNN decode, then UTF-8 repair, each allocating)
+// ---------------------------------------------------------------------------
+
+// HTML Entity decoding helper - converts HTML entities to actual characters
+// Handles: &lt; &gt; &amp; &quot; &apos; &#123; (decimal) &#x7B; (hex)
+static int decode_html_entity(const char *input, char *output, size_t output_len) {
+    if (!input || !output || output_len == 0) return 0;
+    
+    const char *p = input;
+    char *out = output;
+    size_t remaining = output_len - 1;  // Reserve space for null terminator
+    
+    while (*p && remaining > 0) {
+        if (*p == '&') {
+            const char *end = strchr(p, ';');
+            if (end && end - p < 20) {  // Reasonable entity length
+                size_t entity_len = end - p - 1;  // Length without '&' and ';'
+                const char *entity = p + 1;
+                char decoded = 0;
+                int valid_entity = 0;
+                
+                // Named entities
+                if (strncmp(entity, "lt", entity_len) == 0 && entity_len == 2) {
+                    decoded = '<';
+                    valid_entity = 1;
+                } else if (strncmp(entity, "gt", entity_len) == 0 && entity_len == 2) {
+                    decoded = '>';
+                    valid_entity = 1;
+                } else if (strncmp(entity, "amp", entity_len) == 0 && entity_len == 3) {
+                    decoded = '&';
+                    valid_entity = 1;
+                } else if (strncmp(entity, "quot", entity_len) == 0 && entity_len == 4) {
+                    decoded = '"';
+                    valid_entity = 1;
+                } else if (strncmp(entity, "apos", entity_len) == 0 && entity_len == 4) {
+                    decoded = '\'';
+                    valid_entity = 1;
+                } else if (strncmp(entity, "nbsp", entity_len) == 0 && entity_len == 4) {
+                    decoded = ' ';
+                    valid_entity = 1;
+                }
+                // Numeric entities: &#123; (decimal)
+                else if (*entity == '#' && entity_len > 1) {
+                    const char *num_start = entity + 1;
+                    if (*num_start == 'x' || *num_start == 'X') {
+                        // Hex entity: &#x3b; or &#x7B;
+                        long val = strtol(num_start + 1, NULL, 16);
+                        if (val > 0 && val <= 0xFF) {
+                            decoded = (char)val;
+                            valid_entity = 1;
+                        }
+                    } else {
+                        // Decimal entity: &#59;
+                        long val = strtol(num_start, NULL, 10);
+                        if (val > 0 && val <= 0xFF) {
+                            decoded = (char)val;
+                            valid_entity = 1;
+                        }
+                    }
+                }
+                
+                if (valid_entity) {
+                    *out++ = decoded;
+                    remaining--;
+                    p = end + 1;  // Skip past the entity
+                    continue;
+                }
+            }
+        }
+        
+        // Not an entity or entity too long, copy as-is
+        *out++ = *p++;
+        remaining--;
+    }
+    
+    *out = '\0';
+    return (int)(out - output);
+}
+
+// Decode hex-escaped content (\x3b -> ;)
+// Handles \xNN format escape sequences commonly found in YouTube's JSON
+static int decode_hex_escapes(const char *input, char *output, size_t output_len) {
+    if (!input || !output || output_len == 0) return 0;
+    
+    const char *p = input;
+    char *out = output;
+    size_t remaining = output_len - 1;
+    
+    while (*p && remaining > 0) {
+        // Check for \xNN pattern (hex escape sequence)
+        if (*p == '\\' && *(p + 1) == 'x' && 
+            isxdigit((unsigned char)*(p + 2)) && 
+            isxdigit((unsigned char)*(p + 3))) {
+            // Decode hex value
+            int val1 = tolower((unsigned char)*(p + 2));
+            int val2 = tolower((unsigned char)*(p + 3));
+            int hex_val = ((val1 >= 'a' ? val1 - 'a' + 10 : val1 - '0') << 4) |
+                          (val2 >= 'a' ? val2 - 'a' + 10 : val2 - '0');
+            
+            // Accept any valid byte value (0x00-0xFF) that's not null
+            // This includes all printable ASCII, common symbols like = ; & %, etc.
+            if (hex_val != 0) {
+                *out++ = (char)hex_val;
+                remaining--;
+                p += 4;  // Skip entire \xNN sequence
+                continue;
+            }
+        }
+        
+        // Regular character copy
+        *out++ = *p++;
+        remaining--;
+    }
+    
+    *out = '\0';
+    return (int)(out - output);
+}
+
+// Full HTML unescape - combines entity and hex decoding
+static char* html_unescape(const char *input, size_t input_len) {
+    if (!input || input_len == 0) return NULL;
+    
+    // Allocate output buffer (same size as input, will be smaller or equal)
+    char *output = malloc(input_len + 1);
+    if (!output) return NULL;
+    
+    // First pass: decode HTML entities
+    char *temp = malloc(input_len + 1);
+    if (!temp) {
+        free(output);
+        return NULL;
+    }
+    
+    decode_html_entity(input, temp, input_len + 1);
+    
+    // Second pass: decode hex escapes
+    decode_hex_escapes(temp, output, input_len + 1);
+    
+    free(temp);
+    return output;
+}
+
+// UTF-8 validation and repair
+// Fixes common UTF-8 encoding issues like truncated sequences or invalid bytes
+static char* repair_utf8(const char *input, size_t input_len) {
+    if (!input || input_len == 0) return NULL;
+    
+    char *output = malloc(input_len + 1);
+    if (!output) return NULL;
+    
+    const uint8_t *p = (const uint8_t *)input;
+    char *out = output;
+    size_t remaining = input_len;
+    
+    while (remaining > 0) {
+        uint8_t c = *p;
+        
+        // Single-byte ASCII (0x00-0x7F)
+        if ((c & 0x80) == 0) {
+            *out++ = c;
+            p++;
+            remaining--;
+        }
+        // Two-byte sequence (0xC2-0xDF, 0x80-0xBF)
+        else if ((c & 0xE0) == 0xC0) {
+            if (remaining >= 2 && (p[1] & 0xC0) == 0x80) {
+                // Valid 2-byte sequence
+                *out++ = c;
+                *out++ = p[1];
+                p += 2;
+                remaining -= 2;
+            } else {
+                // Truncated or invalid, skip
+                p++;
+                remaining--;
+            }
+        }
+        // Three-byte sequence (0xE0-0xEF, 0x80-0xBF, 0x80-0xBF)
+        else if ((c & 0xF0) == 0xE0) {
+            if (remaining >= 3 && (p[1] & 0xC0) == 0x80 && (p[2] & 0xC0) == 0x80) {
+                // Valid 3-byte sequence
+                *out++ = c;
+                *out++ = p[1];
+                *out++ = p[2];
+                p += 3;
+                remaining -= 3;
+            } else {
+                // Truncated or invalid, skip
+                p++;
+                remaining--;
+            }
+        }
+        // Four-byte sequence (0xF0-0xF4, 0x80-0xBF, 0x80-0xBF, 0x80-0xBF)
+        else if ((c & 0xF8) == 0xF0) {
+            if (remaining >= 4 && (p[1] & 0xC0) == 0x80 && 
+                (p[2] & 0xC0) == 0x80 && (p[3] & 0xC0) == 0x80) {
+                // Valid 4-byte sequence
+                *out++ = c;
+                *out++ = p[1];
+                *out++ = p[2];
+                *out++ = p[3];
+                p += 4;
+                remaining -= 4;
+            } else {
+                // Truncated or invalid, skip
+                p++;
+                remaining--;
+            }
+        }
+        // Invalid byte (continuation byte without start, or invalid start byte)
+        else {
+            // Skip invalid byte
+            p++;
+            remaining--;
+        }
+    }
+    
+    *out = '\0';
+    return output;
+}
+
+// Clean and decode extracted JSON content
+// Handles all three issues: HTML entities, hex escapes, and UTF-8 issues
+static char* multipass_clean(const char *input, size_t input_len) {
+    if (!input || input_len == 0) return NULL;
+    
+    // Step 1: Decode HTML entities and hex escapes
+    char *decoded = html_unescape(input, input_len);
+    if (!decoded) return NULL;
+    
+    // Step 2: Repair UTF-8 sequences
+    size_t decoded_len = strlen(decoded);
+    char *repaired = repair_utf8(decoded, decoded_len);
+    free(decoded);
+    
+    return repaired;
+}
+
+// ---------------------------------------------------------------------------
+
+static int failures = 0;
+
+static size_t run_clean(const char *in, size_t len, char *out) {
+    return json_clean_into(in, len, out, len + 1);
+}
+
+static void expect(const char *name, const char *in, size_t len, const char *want, size_t want_len) {
+    char *out = malloc(len + 1);
+    size_t n = run_clean(in, len, out);
+    if (n != want_len || memcmp(out, want, want_len) != 0 || out[n] != '\0') {
+        printf("FAIL %s: got %zu bytes, want %zu\n", name, n, want_len);
+        failures++;
+    }
+    free(out);
+}
+
+// Place each token at every offset around the 16 and 32 byte block
+// boundaries, surrounded by plain ASCII so the SIMD path runs on both sides
+static void test_block_boundaries(void) {
+    static const struct { const char *in; const char *out; } tokens[] = {
+        { "&amp;", "&" },
+        { "&lt;&gt;", "<>" },
+        { "&quot;&apos;&nbsp;", "\"' " },
+        { "&#65;", "A" },
+        { "&#x41;", "A" },
+        { "&#X7a;", "z" },
+        { "&#0;", "&#0;" },
+        { "&#256;", "&#256;" },
+        { "&bogus;", "&bogus;" },
+        { "&amp", "&amp" },
+        { "\\x41", "A" },
+        { "\\x3d\\x26", "=&" },
+        { "\\x00", "\\x00" },
+        { "\\xg1", "\\xg1" },
+        { "\\x4", "\\x4" },
+        { "\xc3\xa9", "\xc3\xa9" },
+        { "\xe2\x82\xac", "\xe2\x82\xac" },
+        { "\xf0\x9f\x8e\xb5", "\xf0\x9f\x8e\xb5" },
+        { "\\xc3\\xa9", "\xc3\xa9" },
+        { "&#xc3;&#xa9;", "\xc3\xa9" },
+        { "\xc3\\xa9", "\xc3\xa9" },
+        { "\xe2\x82", "" },
+        { "\xe2\x82" "A", "A" },
+        { "\xa9", "" },
+        { "\xff\xfe", "" },
+        { "\xf0\x9f\x8e", "" },
+    };
+    char in[256], want[256];
+    for (size_t t = 0; t < sizeof(tokens) / sizeof(tokens[0]); t++) {
+        size_t tok_len = strlen(tokens[t].in);
+        size_t out_len = strlen(tokens[t].out);
+        for (size_t off = 0; off <= 72; off++) {
+            for (size_t trail = 0; trail <= 40; trail += 13) {
+                memset(in, 'a', off);
+                memcpy(in + off, tokens[t].in, tok_len);
+                memset(in + off + tok_len, 'z', trail);
+                size_t len = off + tok_len + trail;
+
+                memset(want, 'a', off);
+                memcpy(want + off, tokens[t].out, out_len);
+                memset(want + off + out_len, 'z', trail);
+
+                char name[64];
+                snprintf(name, sizeof(name), "token %zu at %zu+%zu", t, off, trail);
+                expect(name, in, len, want, off + out_len + trail);
+            }
+        }
+    }
+}
+
+static void test_limits(void) {
+    // Stops at the first NUL, even inside a SIMD block
+    char in[64];
+    memset(in, 'x', sizeof(in));
+    in[37] = '\0';
+    char out[65];
+    size_t n = json_clean_into(in, sizeof(in), out, sizeof(out));
+    if (n != 37 || strlen(out) != 37) {
+        printf("FAIL nul: got %zu\n", n);
+        failures++;
+    }
+
+    // Small output buffer: truncated and still terminated
+    memset(in, 'y', sizeof(in));
+    char small[8];
+    n = json_clean_into(in, sizeof(in), small, sizeof(small));
+    if (n != 7 || small[7] != '\0') {
+        printf("FAIL small buffer: got %zu\n", n);
+        failures++;
+    }
+
+    // Entity lookahead is bounded: a ';' 20+ bytes away is not an entity
+    const char *far = "&#65aaaaaaaaaaaaaaaaaaaaaa;";
+    expect("far semicolon", far, strlen(far), far, strlen(far));
+
+    if (json_clean_into(NULL, 10, out, sizeof(out)) != 0 || out[0] != '\0') {
+        printf("FAIL null input\n");
+        failures++;
+    }
+}
+
+static unsigned rng_state = 12345;
+static unsigned rng(void) {
+    rng_state = rng_state * 1103515245u + 12345u;
+    return rng_state >> 8;
+}
+
+// Random mix of plain runs, entities, escapes and (broken) UTF-8. Numeric
+// entities never produce '\\', where the fused pass deliberately differs
+// (decoded bytes are not decoded again as \xNN).
+static size_t gen_payload(char *buf, size_t cap) {
+    static const char *pieces[] = {
+        "&amp;", "&lt;", "&quot;", "&#61;", "&#x26;", "&#xe2;", "&bad;", "&",
+        "\\x3d", "\\x26", "\\xc3\\xa9", "\\x", "\\x0", "\\x00", "\\",
+        "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x8e\xb5", "\xe2\x82", "\xbf", "\xff",
+    };
+    static const char plain[] = "abcdefghijklmnopqrstuvwxyz0123456789\":{},;x#";
+    size_t n = 0;
+    while (n + 64 < cap) {
+        unsigned r = rng() % 4;
+        if (r < 2) {
+            size_t run = rng() % 48;
+            for (size_t i = 0; i < run; i++)
+                buf[n++] = plain[rng() % (sizeof(plain) - 1)];
+        } else {
+            const char *p = pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+            size_t l = strlen(p);
+            memcpy(buf + n, p, l);
+            n += l;
+        }
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+static void test_against_multipass(void) {
+    char buf[4096];
+    char out[4096];
+    for (int iter = 0; iter < 20000; iter++) {
+        size_t len = gen_payload(buf, 128 + rng() % (sizeof(buf) - 128));
+        char *ref = multipass_clean(buf, len);
+        size_t n = run_clean(buf, len, out);
+        if (!ref || strlen(ref) != n || memcmp(ref, out, n) != 0) {
+            printf("FAIL equivalence at iteration %d (len %zu)\n", iter, len);
+            failures++;
+            free(ref);
+            return;
+        }
+        free(ref);
+    }
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_payload(const char *name, const char *buf, size_t n, char *out) {
+    double t0 = now_sec();
+    char *ref = multipass_clean(buf, n);
+    double t_old = now_sec() - t0;
+
+    int reps = 20;
+    t0 = now_sec();
+    size_t out_len = 0;
+    for (int i = 0; i < reps; i++) out_len = run_clean(buf, n, out);
+    double t_new = (now_sec() - t0) / reps;
+
+    printf("%s: %zu bytes\n", name, n);
+    printf("  multi-pass: %8.2f ms  %8.1f MB/s\n", t_old * 1e3, n / t_old / 1e6);
+    printf("  fused:      %8.2f ms  %8.1f MB/s\n", t_new * 1e3, n / t_new / 1e6);
+    printf("  speedup:    %.1fx, output %s\n", t_old / t_new,
+           ref && strlen(ref) == out_len && memcmp(ref, out, out_len) == 0 ? "identical" : "DIFFERS");
+    free(ref);
+}
+
+// Mostly-ASCII payloads shaped like ytInitialPlayerResponse: long plain
+// runs with sparse \xNN escapes, entities and UTF-8 titles. The second one
+// is a stream URL list: bare '&' query separators and no ';' anywhere, so
+// the old entity decoder's strchr ran to the end of the input for every '&'.
+static size_t gen_bench_payload(char *buf, size_t size, int urls) {
+    static const char plain[] = "abcdefghijklmnopqrstuvwxyz0123456789\":{},";
+    static const char *sparse[] = { "\\x3d", "\\x26", "&amp;", "\xc3\xa9", "&quot;" };
+    static const char *query[] = { "&itag=18", "&mime=video", "\\x3d" };
+    size_t n = 0;
+    while (n + 64 < size) {
+        size_t run = 40 + rng() % 200;
+        for (size_t i = 0; i < run && n + 64 < size; i++)
+            buf[n++] = plain[rng() % (sizeof(plain) - 1)];
+        const char *s = urls ? query[rng() % 3] : sparse[rng() % 5];
+        memcpy(buf + n, s, strlen(s));
+        n += strlen(s);
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+static void bench(size_t size) {
+    char *buf = malloc(size + 1);
+    char *out = malloc(size + 1);
+    bench_payload("payload", buf, gen_bench_payload(buf, size, 0), out);
+    // Smaller, so the old decoder finishes in reasonable time
+    bench_payload("stream url list", buf, gen_bench_payload(buf, size / 16, 1), out);
+    free(buf);
+    free(out);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        bench(argc > 2 ? (size_t)atol(argv[2]) : 8u << 20);
+        return 0;
+    }
+
+    test_block_boundaries();
+    test_limits();
+    test_against_multipass();
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("All json_clean tests passed\n");
+    return 0;
+}
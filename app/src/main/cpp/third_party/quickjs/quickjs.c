@@ -51,7 +51,7 @@
 
 /* Ensure GC is initialized before any allocation */
 static inline void gc_assert_initialized(void) {
-    if (__builtin_expect(!g_gc.initialized, 0)) {
+    if (__builtin_expect(!gc_heap->initialized, 0)) {
         __android_log_print(ANDROID_LOG_ERROR, "QuickJS", 
             "FATAL: GC not initialized! Call gc_init() before any QuickJS operations.");
         __builtin_trap();  /* Hard crash in debug builds */
@@ -61,46 +61,15 @@ static inline void gc_assert_initialized(void) {
 #include "libunicode.h"
 #include "dtoa.h"
 
-/* Debug logging - disabled for production builds */
-#include <android/log.h>
-/* Set to 1 to enable debug logging, 0 to disable */
-#define QJS_DEBUG_ENABLED 1
-#if QJS_DEBUG_ENABLED
-#define QJS_LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "quickjs", __VA_ARGS__)
-#define QJS_LOGI(...) __android_log_print(ANDROID_LOG_INFO, "quickjs", __VA_ARGS__)
-#define QJS_LOGW(...) __android_log_print(ANDROID_LOG_WARN, "quickjs", __VA_ARGS__)
-#else
-#define QJS_LOGD(...) ((void)0)
-#define QJS_LOGI(...) ((void)0)
-#define QJS_LOGW(...) ((void)0)
-#endif
-
-/* File logging for debugging */
-#include <fcntl.h>
-#include <unistd.h>
-#include <stdarg.h>
-static void file_log_quickjs(const char *fmt, ...) {
-    static int log_fd = -1;
-    if (log_fd < 0) {
-        log_fd = open("/data/data/com.bgmdwldr.vulkan/qjs_debug.log", 
-                      O_WRONLY | O_CREAT | O_APPEND, 0644);
-    }
-    if (log_fd >= 0) {
-        char buf[1024];
-        va_list args;
-        va_start(args, fmt);
-        int n = vsnprintf(buf, sizeof(buf), fmt, args);
-        va_end(args);
-        if (n > 0 && n < sizeof(buf) - 1) {
-            buf[n++] = '\n';
-            write(log_fd, buf, n);
-        }
-    }
-}
-#define QJS_LOGE(...) do { \
-    __android_log_print(ANDROID_LOG_ERROR, "quickjs", __VA_ARGS__); \
-    file_log_quickjs(__VA_ARGS__); \
-} while(0)
+/* Logging goes through the native library's trace log; see trace_log.h.
+ * QJS_LOGT is for per-object and per-atom paths (allocation, marking,
+ * sweeping) and is compiled out unless TLOG_COMPILE_LEVEL is TRACE. */
+#include "../../trace_log.h"
+#define QJS_LOGT(...) TLOG_TRACE("quickjs", __VA_ARGS__)
+#define QJS_LOGD(...) TLOG_DEBUG("quickjs", __VA_ARGS__)
+#define QJS_LOGI(...) TLOG_INFO("quickjs", __VA_ARGS__)
+#define QJS_LOGW(...) TLOG_WARN("quickjs", __VA_ARGS__)
+#define QJS_LOGE(...) TLOG_ERROR("quickjs", __VA_ARGS__)
 
 #define OPTIMIZE         1
 #define SHORT_OPCODES    1
@@ -294,12 +263,13 @@ typedef enum OPCodeEnum OPCodeEnum;
 #define JS_MAX_HANDLE_ARRAY_SIZE 10000
 
 typedef struct {
-    GCHandle *handles;   /* Array of unified GC handles (indices into g_gc.handles) */
+    GCHandle *handles;   /* Array of unified GC handles (indices into the heap's handle table) */
     uint32_t count;      /* Current number of elements */
     uint32_t capacity;   /* Max capacity (10,000) */
 } JSHandleArray;
 
 struct JSRuntime {
+    GCState *gc_heap;   /* The heap this runtime lives in */
     JSMallocState malloc_state;
     const char *rt_info;
 
@@ -373,9 +343,10 @@ struct JSRuntime {
     int shape_hash_count; /* number of hashed shapes */
     GCHandle shape_hash_handle;  /* Handle to JSShape* array */
     void *user_opaque;
-    
-    /* Instruction counter for GC triggering */
-    uint32_t instruction_counter;
+
+    JSInterruptHandler *interrupt_handler;
+    void *interrupt_opaque;
+    int interrupt_counter; /* branches and calls left until the next poll */
 };
 
 /* Accessor macros for handle-based fields - deref immediately before use */
@@ -559,7 +530,6 @@ enum {
     JS_ATOM_TYPE_GLOBAL_SYMBOL,
     JS_ATOM_TYPE_SYMBOL,
     JS_ATOM_TYPE_PRIVATE,
-    JS_ATOM_TYPE_DEAD = 0xFF,  /* Atom is being freed, references are stale */
 };
 
 typedef enum {
@@ -1442,6 +1412,9 @@ static GCValue JS_EvalInternal(JSContext *ctx, GCValue this_obj,
 static void js_free_module_def(JSRuntime *rt, JSModuleDef *m);
 static void js_mark_module_def(JSRuntime *rt, JSModuleDef *m,
                                JS_MarkFunc *mark_func);
+static void mark_bytecode_atoms(JSRuntime *rt,
+                                const uint8_t *bc_buf, int bc_len,
+                                JS_MarkFunc *mark_func);
 static GCValue js_import_meta(JSContext *ctx);
 static GCValue js_dynamic_import(JSContext *ctx, GCValue specifier, GCValue options);
 static void free_var_ref(JSRuntime *rt, JSVarRef *var_ref);
@@ -1525,6 +1498,7 @@ static void map_delete_weakrefs(JSRuntime *rt, JSWeakRefHeader *wh);
 static void weakref_delete_weakref(JSRuntime *rt, JSWeakRefHeader *wh);
 static void finrec_delete_weakref(JSRuntime *rt, JSWeakRefHeader *wh);
 static void JS_RunGCInternal(JSRuntime *rt, BOOL remove_weak_objects);
+static void js_gc_exhausted(JSRuntime *rt);
 static GCValue js_array_from_iterator(JSContext *ctx, uint32_t *plen,
                                       GCValue obj, GCValue method);
 static int js_string_find_invalid_codepoint(JSString *p);
@@ -1543,9 +1517,6 @@ static const JSClassExoticMethods js_proxy_exotic_methods;
 static const JSClassExoticMethods js_module_ns_exotic_methods;
 static JSClassID js_class_id_alloc = JS_CLASS_INIT_COUNT;
 
-/* Forward declaration for unified GC functions */
-extern bool gc_should_run(void);
-extern void gc_set_threshold(size_t threshold);
 /* gc_deref is defined as a macro in quickjs.h pointing to gc_deref */
 
 static void js_trigger_gc(JSRuntime *rt, size_t size)
@@ -1718,6 +1689,29 @@ static inline BOOL js_check_stack_overflow(JSRuntime *rt, size_t alloca_size)
 }
 #endif
 
+#define JS_INTERRUPT_COUNTER_INIT 10000
+
+static no_inline __exception int __js_poll_interrupts(JSContext *ctx, JSRuntime *rt)
+{
+    rt->interrupt_counter = JS_INTERRUPT_COUNTER_INIT;
+    if (rt->interrupt_handler) {
+        if (rt->interrupt_handler(rt, rt->interrupt_opaque)) {
+            /* cannot be caught by the script, so it unwinds to the host */
+            JS_ThrowInternalError(ctx, "interrupted");
+            JS_SetUncatchableException(ctx, TRUE);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static inline __exception int js_poll_interrupts(JSContext *ctx, JSRuntime *rt)
+{
+    if (unlikely(--rt->interrupt_counter <= 0))
+        return __js_poll_interrupts(ctx, rt);
+    return 0;
+}
+
 JSRuntime *JS_NewRuntime(void)
 {
     JSRuntime *rt;
@@ -1739,9 +1733,11 @@ JSRuntime *JS_NewRuntime(void)
     }
     rt = gc_deref(rt_handle);
     memset(rt, 0, sizeof(*rt));
+    rt->gc_heap = gc_current_heap();
     
     /* Bug #2 fix: Set runtime pointer for GC tracking */
     gc_set_runtime(rt);
+    gc_set_exhausted_hook(js_gc_exhausted);
     
     rt->malloc_state = ms;
     rt->malloc_gc_threshold = 256 * 1024;
@@ -1851,6 +1847,7 @@ void JS_SetMemoryLimit(JSRuntime *rt, size_t limit)
 void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold)
 {
     rt->malloc_gc_threshold = gc_threshold;
+    gc_set_threshold(gc_threshold);
 }
 
 #define malloc(s) malloc_is_forbidden(s)
@@ -1862,6 +1859,14 @@ void JS_SetCanBlock(JSRuntime *rt, BOOL can_block)
     rt->can_block = can_block;
 }
 
+void JS_SetInterruptHandler(JSRuntime *rt, JSInterruptHandler *cb,
+                            void *opaque)
+{
+    rt->interrupt_handler = cb;
+    rt->interrupt_opaque = opaque;
+    rt->interrupt_counter = JS_INTERRUPT_COUNTER_INIT;
+}
+
 void JS_SetSharedArrayBufferFunctions(JSRuntime *rt,
                                       const JSSharedArrayBufferFunctions *sf)
 {
@@ -1896,6 +1901,9 @@ int JS_EnqueueJob(JSContext *ctx, JSJobFunc *job_func,
     for(i = 0; i < argc; i++) {
         e->argv[i] = argv[i];
     }
+    /* The job list keeps the entry and its arguments reachable */
+    if (js_handle_array_add(rt, &rt->job_handles, e_handle) < 0)
+        return -1;
     return 0;
 }
 
@@ -1916,6 +1924,9 @@ int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx)
     GCValue res;
     int i, ret;
 
+    /* Between jobs nothing is running and the queue is rooted */
+    JS_MaybeRunGC(rt);
+
     if (rt->job_handles.count == 0) {
         if (pctx)
             *pctx = NULL;
@@ -1926,14 +1937,22 @@ int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx)
     GCHandle job_handle = rt->job_handles.handles[0];
     e = (JSJobEntry *)gc_deref(job_handle);
     /* Remove from front by shifting everything down */
-    for (i = 0; i < rt->job_handles.count - 1; i++) {
-        rt->job_handles.handles[i] = rt->job_handles.handles[i + 1];
-    }
+    memmove(rt->job_handles.handles, rt->job_handles.handles + 1,
+            (rt->job_handles.count - 1) * sizeof(GCHandle));
     rt->job_handles.count--;
+    if (!e) {
+        if (pctx)
+            *pctx = NULL;
+        return 1;
+    }
+    /* Copy out the arguments: the entry is no longer a root and may move
+       or be collected while the job runs */
+    int argc = e->argc;
+    GCValue argv[argc > 0 ? argc : 1];
+    for(i = 0; i < argc; i++)
+        argv[i] = e->argv[i];
     ctx = (JSContext*)gc_deref(e->realm_handle);
-    res = e->job_func(ctx, e->argc, (GCValue *)e->argv);
-    for(i = 0; i < e->argc; i++)
-        
+    res = e->job_func(ctx, argc, argv);
     if (JS_IsException(res))
         ret = -1;
     else
@@ -1941,10 +1960,10 @@ int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx)
     
     /* GC frees automatically */;
     if (pctx) {
-        /* ref_count check removed - using mark-and-sweep GC */
+        /* ref_count check removed - using mark-and-sweep GC; the realm
+           lives on, so it is not freed here */
         *pctx = ctx;
     }
-    JS_FreeContext(ctx);
     return ret;
 }
 
@@ -1992,7 +2011,7 @@ static inline JSAtomStruct *js_atom_array_get(JSRuntime *rt, uint32_t atom_index
         int i, n = str->len < 20 ? str->len : 20;
         for(i=0; i<n; i++) snprintf(hex+i*3, 4, "%02x ", str->u.str8[i]);
         hex[n*3] = 0;
-        QJS_LOGI("js_atom_array_get: atom %d handle=%d entry=%p len=%d hex=%s", 
+        QJS_LOGT("js_atom_array_get: atom %d handle=%d entry=%p len=%d hex=%s", 
                  atom_index, handle, entry, str->len, hex);
     }
     return (JSAtomStruct *)entry;
@@ -2003,7 +2022,7 @@ static JSString *js_alloc_string_rt(JSRuntime *rt, int max_len, int is_wide_char
 {
     JSString *str;
     size_t str_size = sizeof(JSString) + (max_len << is_wide_char) + 1 - is_wide_char;
-    QJS_LOGI("js_alloc_string_rt: sizeof(JSString)=%zu max_len=%d str_size=%zu", sizeof(JSString), max_len, str_size);
+    QJS_LOGT("js_alloc_string_rt: sizeof(JSString)=%zu max_len=%d str_size=%zu", sizeof(JSString), max_len, str_size);
     str = gc_alloc_js_object(str_size, JS_GC_OBJ_TYPE_JS_STRING);
     if (unlikely(!str))
         return GC_HANDLE_NULL;
@@ -2049,6 +2068,9 @@ void JS_FreeRuntime(JSRuntime *rt)
     struct list_head *el, *el1;
     int i;
 
+    /* nothing is collected while the runtime comes apart */
+    gc_set_exhausted_hook(NULL);
+
     /* Free all pending jobs from handle array */
     for (i = 0; i < rt->job_handles.count; i++) {
         GCHandle job_handle = rt->job_handles.handles[i];
@@ -2276,12 +2298,14 @@ JSContext *JS_NewContextRaw(JSRuntime *rt)
     memset(ctx, 0, sizeof(JSContext));
     QJS_LOGI("STEP1: &ctx->loaded_modules=%p", (void*)&ctx->loaded_modules);
     QJS_LOGI("STEP1: ctx->loaded_modules.next=%p (should be NULL after memset)", (void*)ctx->loaded_modules.next);
-    /* Object already registered with GC by gc_alloc_js_object_ex (in context_handles) */
     QJS_LOGI("STEP2-done");
 
     QJS_LOGI("STEP3");
-    /* Context already in context_handles from gc_alloc_js_object_ex */
-    QJS_LOGI("STEP3: context already in context_handles");
+    /* The context is a root until JS_FreeContext, and JS_NewClass1 finds
+       it here to grow its prototype array */
+    if (js_handle_array_add(rt, &rt->context_handles, gc_header(ctx)->handle) < 0)
+        return GC_HANDLE_NULL;
+    QJS_LOGI("STEP3: context added to context_handles");
     QJS_LOGI("STEP4");
     ctx->rt_handle = gc_ptr_to_handle(rt);
     QJS_LOGI("STEP5: stored rt_handle=%u", ctx->rt_handle);
@@ -2339,9 +2363,9 @@ JSContext *JS_NewContext(JSRuntime *rt)
 {
     JSContext *ctx;
     
-    QJS_LOGE("JS_NewContext: rt=%p atom_array_handle=%u", rt, rt->atom_array_handle);
+    QJS_LOGT("JS_NewContext: rt=%p atom_array_handle=%u", rt, rt->atom_array_handle);
     ctx = JS_NewContextRaw(rt);
-    QJS_LOGE("JS_NewContextRaw returned ctx=%p", ctx);
+    QJS_LOGT("JS_NewContextRaw returned ctx=%p", ctx);
     if (!ctx)
         return GC_HANDLE_NULL;
     if (JS_AddIntrinsicBaseObjects(ctx)) {
@@ -2430,78 +2454,78 @@ static void JS_MarkContext(JSRuntime *rt, JSContext *ctx,
     int i;
     struct list_head *el;
 
-    QJS_LOGI("JS_MarkContext: ENTER ctx=%p", (void*)ctx);
-    QJS_LOGI("JS_MarkContext: &ctx->loaded_modules=%p", (void*)&ctx->loaded_modules);
-    QJS_LOGI("JS_MarkContext: ctx->loaded_modules.next=%p", (void*)ctx->loaded_modules.next);
+    QJS_LOGT("JS_MarkContext: ENTER ctx=%p", (void*)ctx);
+    QJS_LOGT("JS_MarkContext: &ctx->loaded_modules=%p", (void*)&ctx->loaded_modules);
+    QJS_LOGT("JS_MarkContext: ctx->loaded_modules.next=%p", (void*)ctx->loaded_modules.next);
     
-    QJS_LOGI("JS_MarkContext: about to enter list_for_each");
+    QJS_LOGT("JS_MarkContext: about to enter list_for_each");
     list_for_each(el, &ctx->loaded_modules) {
         JSModuleDef *m = list_entry(el, JSModuleDef, link);
         JS_MarkValue(rt, JS_MKPTR(JS_TAG_MODULE, m), mark_func);
     }
-    QJS_LOGI("JS_MarkContext: done with loaded_modules");
+    QJS_LOGT("JS_MarkContext: done with loaded_modules");
 
-    QJS_LOGI("JS_MarkContext: marking global_obj");
+    QJS_LOGT("JS_MarkContext: marking global_obj");
     JS_MarkValue(rt, ctx->global_obj, mark_func);
-    QJS_LOGI("JS_MarkContext: marking global_var_obj");
+    QJS_LOGT("JS_MarkContext: marking global_var_obj");
     JS_MarkValue(rt, ctx->global_var_obj, mark_func);
-    QJS_LOGI("JS_MarkContext: done with global values");
+    QJS_LOGT("JS_MarkContext: done with global values");
 
-    QJS_LOGI("JS_MarkContext: marking throw_type_error");
+    QJS_LOGT("JS_MarkContext: marking throw_type_error");
     JS_MarkValue(rt, ctx->throw_type_error, mark_func);
-    QJS_LOGI("JS_MarkContext: marking eval_obj");
+    QJS_LOGT("JS_MarkContext: marking eval_obj");
     JS_MarkValue(rt, ctx->eval_obj, mark_func);
 
-    QJS_LOGI("JS_MarkContext: marking array_proto_values");
+    QJS_LOGT("JS_MarkContext: marking array_proto_values");
     JS_MarkValue(rt, ctx->array_proto_values, mark_func);
-    QJS_LOGI("JS_MarkContext: marking native_error_proto");
+    QJS_LOGT("JS_MarkContext: marking native_error_proto");
     for(i = 0; i < JS_NATIVE_ERROR_COUNT; i++) {
         JS_MarkValue(rt, ctx->native_error_proto[i], mark_func);
     }
-    QJS_LOGI("JS_MarkContext: marking class_proto, rt->class_count=%d", rt->class_count);
-    QJS_LOGI("JS_MarkContext: ctx_class_proto=%p", (void*)ctx_class_proto);
+    QJS_LOGT("JS_MarkContext: marking class_proto, rt->class_count=%d", rt->class_count);
+    QJS_LOGT("JS_MarkContext: ctx_class_proto=%p", (void*)ctx_class_proto);
     for(i = 0; i < rt->class_count; i++) {
         GCValue val = ctx_class_proto[i];
         uint32_t tag = JS_VALUE_GET_TAG(val);
-        QJS_LOGI("JS_MarkContext: class_proto[%d] tag=%u", i, (unsigned)tag);
+        QJS_LOGT("JS_MarkContext: class_proto[%d] tag=%u", i, (unsigned)tag);
         if (tag == JS_TAG_OBJECT) {
             JSObject *p = JS_VALUE_GET_OBJ(val);
-            QJS_LOGI("JS_MarkContext: class_proto[%d] obj=%p", i, (void*)p);
+            QJS_LOGT("JS_MarkContext: class_proto[%d] obj=%p", i, (void*)p);
         }
         JS_MarkValue(rt, val, mark_func);
     }
-    QJS_LOGI("JS_MarkContext: done with class_proto");
+    QJS_LOGT("JS_MarkContext: done with class_proto");
     
-    QJS_LOGI("JS_MarkContext: iterator_ctor tag=%u", (unsigned)JS_VALUE_GET_TAG(ctx->iterator_ctor));
-    QJS_LOGI("JS_MarkContext: marking iterator_ctor");
+    QJS_LOGT("JS_MarkContext: iterator_ctor tag=%u", (unsigned)JS_VALUE_GET_TAG(ctx->iterator_ctor));
+    QJS_LOGT("JS_MarkContext: marking iterator_ctor");
     JS_MarkValue(rt, ctx->iterator_ctor, mark_func);
-    QJS_LOGI("JS_MarkContext: async_iterator_proto tag=%u", (unsigned)JS_VALUE_GET_TAG(ctx->async_iterator_proto));
-    QJS_LOGI("JS_MarkContext: marking async_iterator_proto");
+    QJS_LOGT("JS_MarkContext: async_iterator_proto tag=%u", (unsigned)JS_VALUE_GET_TAG(ctx->async_iterator_proto));
+    QJS_LOGT("JS_MarkContext: marking async_iterator_proto");
     JS_MarkValue(rt, ctx->async_iterator_proto, mark_func);
-    QJS_LOGI("JS_MarkContext: promise_ctor tag=%u", (unsigned)JS_VALUE_GET_TAG(ctx->promise_ctor));
-    QJS_LOGI("JS_MarkContext: marking promise_ctor");
+    QJS_LOGT("JS_MarkContext: promise_ctor tag=%u", (unsigned)JS_VALUE_GET_TAG(ctx->promise_ctor));
+    QJS_LOGT("JS_MarkContext: marking promise_ctor");
     JS_MarkValue(rt, ctx->promise_ctor, mark_func);
-    QJS_LOGI("JS_MarkContext: marking array_ctor");
+    QJS_LOGT("JS_MarkContext: marking array_ctor");
     JS_MarkValue(rt, ctx->array_ctor, mark_func);
-    QJS_LOGI("JS_MarkContext: marking regexp_ctor");
+    QJS_LOGT("JS_MarkContext: marking regexp_ctor");
     JS_MarkValue(rt, ctx->regexp_ctor, mark_func);
-    QJS_LOGI("JS_MarkContext: marking function_ctor");
+    QJS_LOGT("JS_MarkContext: marking function_ctor");
     JS_MarkValue(rt, ctx->function_ctor, mark_func);
-    QJS_LOGI("JS_MarkContext: marking function_proto");
+    QJS_LOGT("JS_MarkContext: marking function_proto");
     JS_MarkValue(rt, ctx->function_proto, mark_func);
 
-    QJS_LOGI("JS_MarkContext: checking shapes");
-    QJS_LOGI("JS_MarkContext: ctx=%p", (void*)ctx);
-    QJS_LOGI("JS_MarkContext: about to read array_shape");
+    QJS_LOGT("JS_MarkContext: checking shapes");
+    QJS_LOGT("JS_MarkContext: ctx=%p", (void*)ctx);
+    QJS_LOGT("JS_MarkContext: about to read array_shape");
     JSShape *array_shape = GC_SHAPE_DEREF(ctx->array_shape_handle);
-    QJS_LOGI("JS_MarkContext: array_shape=%p", (void*)array_shape);
+    QJS_LOGT("JS_MarkContext: array_shape=%p", (void*)array_shape);
     if (GC_SHAPE_DEREF(ctx->array_shape_handle)) {
-        QJS_LOGI("JS_MarkContext: marking array_shape");
+        QJS_LOGT("JS_MarkContext: marking array_shape");
         mark_func(rt, GC_SHAPE_DEREF(ctx->array_shape_handle));
     }
 
     if (GC_SHAPE_DEREF(ctx->arguments_shape_handle)) {
-        QJS_LOGI("JS_MarkContext: marking arguments_shape");
+        QJS_LOGT("JS_MarkContext: marking arguments_shape");
         mark_func(rt, GC_SHAPE_DEREF(ctx->arguments_shape_handle));
     }
 
@@ -2573,39 +2597,39 @@ void JS_FreeContext(JSContext *ctx)
     
     
 
-    QJS_LOGE("JS_FreeContext: about to free shapes...");
-    QJS_LOGE("JS_FreeContext: array_shape=%p", (void*)GC_SHAPE_DEREF(ctx->array_shape_handle));
+    QJS_LOGT("JS_FreeContext: about to free shapes...");
+    QJS_LOGT("JS_FreeContext: array_shape=%p", (void*)GC_SHAPE_DEREF(ctx->array_shape_handle));
     if (GC_SHAPE_DEREF(ctx->array_shape_handle)) {
-        QJS_LOGE("JS_FreeContext: array_shape->is_hashed=%d hash=%u next_handle=%u", 
+        QJS_LOGT("JS_FreeContext: array_shape->is_hashed=%d hash=%u next_handle=%u", 
                  GC_SHAPE_DEREF(ctx->array_shape_handle)->is_hashed, GC_SHAPE_DEREF(ctx->array_shape_handle)->hash, GC_SHAPE_DEREF(ctx->array_shape_handle)->shape_hash_next_handle);
         js_free_shape_null(ctx_rt, GC_SHAPE_DEREF(ctx->array_shape_handle));
-        QJS_LOGE("JS_FreeContext: array_shape freed");
+        QJS_LOGT("JS_FreeContext: array_shape freed");
     }
-    QJS_LOGE("JS_FreeContext: arguments_shape=%p", (void*)GC_SHAPE_DEREF(ctx->arguments_shape_handle));
+    QJS_LOGT("JS_FreeContext: arguments_shape=%p", (void*)GC_SHAPE_DEREF(ctx->arguments_shape_handle));
     if (GC_SHAPE_DEREF(ctx->arguments_shape_handle)) {
-        QJS_LOGE("JS_FreeContext: arguments_shape->is_hashed=%d hash=%u next_handle=%u", 
+        QJS_LOGT("JS_FreeContext: arguments_shape->is_hashed=%d hash=%u next_handle=%u", 
                  GC_SHAPE_DEREF(ctx->arguments_shape_handle)->is_hashed, GC_SHAPE_DEREF(ctx->arguments_shape_handle)->hash, GC_SHAPE_DEREF(ctx->arguments_shape_handle)->shape_hash_next_handle);
         js_free_shape_null(ctx_rt, GC_SHAPE_DEREF(ctx->arguments_shape_handle));
-        QJS_LOGE("JS_FreeContext: arguments_shape freed");
+        QJS_LOGT("JS_FreeContext: arguments_shape freed");
     }
-    QJS_LOGE("JS_FreeContext: mapped_arguments_shape=%p", (void*)GC_SHAPE_DEREF(ctx->mapped_arguments_shape_handle));
+    QJS_LOGT("JS_FreeContext: mapped_arguments_shape=%p", (void*)GC_SHAPE_DEREF(ctx->mapped_arguments_shape_handle));
     if (GC_SHAPE_DEREF(ctx->mapped_arguments_shape_handle)) {
-        QJS_LOGE("JS_FreeContext: mapped_arguments_shape->is_hashed=%d hash=%u next_handle=%u", 
+        QJS_LOGT("JS_FreeContext: mapped_arguments_shape->is_hashed=%d hash=%u next_handle=%u", 
                  GC_SHAPE_DEREF(ctx->mapped_arguments_shape_handle)->is_hashed, GC_SHAPE_DEREF(ctx->mapped_arguments_shape_handle)->hash, GC_SHAPE_DEREF(ctx->mapped_arguments_shape_handle)->shape_hash_next_handle);
         js_free_shape_null(ctx_rt, GC_SHAPE_DEREF(ctx->mapped_arguments_shape_handle));
-        QJS_LOGE("JS_FreeContext: mapped_arguments_shape freed");
+        QJS_LOGT("JS_FreeContext: mapped_arguments_shape freed");
     }
-    QJS_LOGE("JS_FreeContext: regexp_shape=%p", (void*)GC_SHAPE_DEREF(ctx->regexp_shape_handle));
+    QJS_LOGT("JS_FreeContext: regexp_shape=%p", (void*)GC_SHAPE_DEREF(ctx->regexp_shape_handle));
     if (GC_SHAPE_DEREF(ctx->regexp_shape_handle)) {
-        QJS_LOGE("JS_FreeContext: regexp_shape->is_hashed=%d", GC_SHAPE_DEREF(ctx->regexp_shape_handle)->is_hashed);
+        QJS_LOGT("JS_FreeContext: regexp_shape->is_hashed=%d", GC_SHAPE_DEREF(ctx->regexp_shape_handle)->is_hashed);
         js_free_shape_null(ctx_rt, GC_SHAPE_DEREF(ctx->regexp_shape_handle));
-        QJS_LOGE("JS_FreeContext: regexp_shape freed");
+        QJS_LOGT("JS_FreeContext: regexp_shape freed");
     }
-    QJS_LOGE("JS_FreeContext: regexp_result_shape=%p", (void*)GC_SHAPE_DEREF(ctx->regexp_result_shape_handle));
+    QJS_LOGT("JS_FreeContext: regexp_result_shape=%p", (void*)GC_SHAPE_DEREF(ctx->regexp_result_shape_handle));
     if (GC_SHAPE_DEREF(ctx->regexp_result_shape_handle)) {
-        QJS_LOGE("JS_FreeContext: regexp_result_shape->is_hashed=%d", GC_SHAPE_DEREF(ctx->regexp_result_shape_handle)->is_hashed);
+        QJS_LOGT("JS_FreeContext: regexp_result_shape->is_hashed=%d", GC_SHAPE_DEREF(ctx->regexp_result_shape_handle)->is_hashed);
         js_free_shape_null(ctx_rt, GC_SHAPE_DEREF(ctx->regexp_result_shape_handle));
-        QJS_LOGE("JS_FreeContext: regexp_result_shape freed");
+        QJS_LOGT("JS_FreeContext: regexp_result_shape freed");
     }
 
     /* Get handle from context's GC header and remove from handle array */
@@ -2637,6 +2661,7 @@ void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size)
 
 void JS_UpdateStackTop(JSRuntime *rt)
 {
+    gc_set_current_heap(rt->gc_heap);
     rt->stack_top = js_get_stack_pointer();
     update_stack_limit(rt);
 }
@@ -2839,6 +2864,7 @@ static int JS_ResizeAtomHash(JSRuntime *rt, int new_hash_size)
     new_hash_handle = gc_allocz(sizeof(uint32_t) * new_hash_size, JS_GC_OBJ_TYPE_DATA);
     if (new_hash_handle == 0)
         return -1;
+    gc_set_precise(new_hash_handle);
     new_hash = (uint32_t *)gc_deref(new_hash_handle);
     for(i = 0; i < rt->atom_hash_size; i++) {
         h = rt_atom_hash[i];
@@ -2862,7 +2888,10 @@ static int JS_ResizeAtomHash(JSRuntime *rt, int new_hash_size)
 static int js_handle_array_init(JSRuntime *rt, JSHandleArray *arr)
 {
     size_t alloc_size = sizeof(GCHandle) * JS_MAX_HANDLE_ARRAY_SIZE;
-    arr->handles = (GCHandle *)gc_deref(gc_allocz(alloc_size, JS_GC_OBJ_TYPE_DATA));
+    GCHandle handle = gc_allocz(alloc_size, JS_GC_OBJ_TYPE_DATA);
+    /* the collector marks what the arrays list itself, or leaves it weak */
+    gc_set_precise(handle);
+    arr->handles = (GCHandle *)gc_deref(handle);
     QJS_LOGI("js_handle_array_init: handles=%p, size=%zu", arr->handles, alloc_size);
     if (!arr->handles) {
         QJS_LOGE("js_handle_array_init: malloc failed for size %zu", alloc_size);
@@ -2901,7 +2930,7 @@ static int js_handle_array_add(JSRuntime *rt, JSHandleArray *arr, GCHandle handl
         return -1;
     }
     
-    QJS_LOGI("js_handle_array_add: ENTER arr=%p handle=%u", (void*)arr, handle);
+    QJS_LOGT("js_handle_array_add: ENTER arr=%p handle=%u", (void*)arr, handle);
     
     /* Bug #3 fix: Add safety checks */
     if (handle == GC_HANDLE_NULL) {
@@ -2909,7 +2938,7 @@ static int js_handle_array_add(JSRuntime *rt, JSHandleArray *arr, GCHandle handl
         return -1;
     }
     /* CRITICAL FIX: Check if handles array is allocated */
-    QJS_LOGI("js_handle_array_add: arr->handles=%p", (void*)arr->handles);
+    QJS_LOGT("js_handle_array_add: arr->handles=%p", (void*)arr->handles);
     if (!arr->handles) {
         QJS_LOGE("js_handle_array_add: arr->handles is NULL! arr=%p, count=%u, capacity=%u", 
                  (void*)arr, (unsigned)arr->count, (unsigned)arr->capacity);
@@ -2921,16 +2950,16 @@ static int js_handle_array_add(JSRuntime *rt, JSHandleArray *arr, GCHandle handl
                 (unsigned)arr->count, (unsigned)arr->capacity);
         return -1;
     }
-    QJS_LOGI("js_handle_array_add: about to write to arr->handles[%u]", (unsigned)arr->count);
-    QJS_LOGI("js_handle_array_add: arr=%p, &arr->count=%p", (void*)arr, (void*)&arr->count);
+    QJS_LOGT("js_handle_array_add: about to write to arr->handles[%u]", (unsigned)arr->count);
+    QJS_LOGT("js_handle_array_add: arr=%p, &arr->count=%p", (void*)arr, (void*)&arr->count);
     uint32_t idx = arr->count;
-    QJS_LOGI("js_handle_array_add: idx=%u", (unsigned)idx);
-    QJS_LOGI("js_handle_array_add: writing handle=%u to arr->handles[%u]", handle, (unsigned)idx);
+    QJS_LOGT("js_handle_array_add: idx=%u", (unsigned)idx);
+    QJS_LOGT("js_handle_array_add: writing handle=%u to arr->handles[%u]", handle, (unsigned)idx);
     arr->handles[idx] = handle;
-    QJS_LOGI("js_handle_array_add: write succeeded");
+    QJS_LOGT("js_handle_array_add: write succeeded");
     arr->count = idx + 1;
-    QJS_LOGI("js_handle_array_add: count updated to %u", (unsigned)arr->count);
-    QJS_LOGI("js_handle_array_add: SUCCESS");
+    QJS_LOGT("js_handle_array_add: count updated to %u", (unsigned)arr->count);
+    QJS_LOGT("js_handle_array_add: SUCCESS");
     return 0;
 }
 
@@ -2958,9 +2987,9 @@ static GCHandle js_handle_array_add_with_index(JSRuntime *rt, JSHandleArray *arr
     uint32_t index = arr->count++;  /* 0-based array index in runtime array */
     arr->handles[index] = handle;   /* Store unified GC handle */
     
-    QJS_LOGI("js_handle_array_add_with_index: &rt->atom_handles=%p rt->atom_handles.handles=%p rt->atom_handles.count=%u",
+    QJS_LOGT("js_handle_array_add_with_index: &rt->atom_handles=%p rt->atom_handles.handles=%p rt->atom_handles.count=%u",
              (void*)&rt->atom_handles, (void*)rt->atom_handles.handles, rt->atom_handles.count);
-    QJS_LOGI("js_handle_array_add_with_index: arr=%p arr->handles=%p added handle=%u (index=%u) ptr=%p", 
+    QJS_LOGT("js_handle_array_add_with_index: arr=%p arr->handles=%p added handle=%u (index=%u) ptr=%p", 
              (void*)arr, (void*)arr->handles, handle, index, ptr);
     return handle;
 }
@@ -2981,7 +3010,7 @@ static void js_handle_array_mark_freed(JSHandleArray *arr, GCHandle handle)
     
     for (i = 0; i < arr->count; i++) {
         if (arr->handles[i] == handle) {
-            QJS_LOGE("js_handle_array_mark_freed: marking arr=%p index=%u handle=%u as FREED", (void*)arr, i, handle);
+            QJS_LOGT("js_handle_array_mark_freed: marking arr=%p index=%u handle=%u as FREED", (void*)arr, i, handle);
             arr->handles[i] = JS_HANDLE_FREED;  /* Mark as freed */
             return;
         }
@@ -3102,11 +3131,13 @@ static int JS_InitAtoms(JSRuntime *rt)
         QJS_LOGE("JS_InitAtoms: atom_array allocation failed");
         return -1;
     }
+    /* atoms live by their indices, not by this array */
+    gc_set_precise(rt->atom_array_handle);
     rt->atom_size = init_size;
 
     /* Initialize atom 0 (JS_ATOM_NULL) - not used but needs to exist */
     QJS_LOGI("JS_InitAtoms: Allocating atom_null...");
-    atom_null = (JSAtomStruct *)gc_deref(gc_allocz(sizeof(JSAtomStruct), JS_GC_OBJ_TYPE_DATA));
+    atom_null = (JSAtomStruct *)gc_deref(gc_allocz(sizeof(JSAtomStruct), JS_GC_OBJ_TYPE_JS_STRING));
     if (!atom_null) {
         QJS_LOGE("JS_InitAtoms: atom_null allocation failed");
         /* GC frees: js_free_rt(rt, rt->atom_array_handle); */
@@ -3152,12 +3183,12 @@ static int JS_InitAtoms(JSRuntime *rt)
             atom_type = JS_ATOM_TYPE_STRING;
         len = strlen(p);
         /* Debug: Check source string for Symbol.iterator */
-        if (i >= 225 && i <= 237) {
+        if (i >= 225 && i <= 237 && TLOG_ENABLED(TLOG_LEVEL_TRACE)) {
             char hex[64];
             int j, n = len < 20 ? len : 20;
             for(j=0; j<n; j++) snprintf(hex+j*3, 4, "%02x ", (unsigned char)p[j]);
             hex[n*3] = 0;
-            QJS_LOGI("JS_InitAtoms: atom %d source='%.*s' len=%d hex=%s", i, len, p, len, hex);
+            QJS_LOGT("JS_InitAtoms: atom %d source='%.*s' len=%d hex=%s", i, len, p, len, hex);
         }
         JSAtom result = __JS_NewAtomInit(rt, p, len, atom_type);
         if (result == JS_ATOM_NULL) {
@@ -3252,6 +3283,17 @@ static JSAtom js_get_atom_index(JSRuntime *rt, JSAtomStruct *p)
     return i;
 }
 
+/* The next empty slot after i, 0 once the array must grow. gc_sweep_atoms
+   empties slots anywhere below. */
+static uint32_t js_atom_next_free(JSRuntime *rt, uint32_t i)
+{
+    for (i++; i < rt->atom_size; i++) {
+        if (rt_atom_array[i] == GC_HANDLE_NULL)
+            return i;
+    }
+    return 0;
+}
+
 /* string case (internal). Return JS_ATOM_NULL if error. 'str' is
    freed. */
 static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
@@ -3266,7 +3308,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
         int j, n = str->len < 20 ? str->len : 20;
         for(j=0; j<n; j++) snprintf(hex+j*3, 4, "%02x ", str->u.str8[j]);
         hex[n*3] = 0;
-        QJS_LOGI("__JS_NewAtom: ENTRY str='%s' len=%d hex=%s", str->u.str8, str->len, hex);
+        QJS_LOGT("__JS_NewAtom: ENTRY str='%s' len=%d hex=%s", str->u.str8, str->len, hex);
     }
     if (atom_type < JS_ATOM_TYPE_SYMBOL) {
         /* str is not NULL */
@@ -3330,7 +3372,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
         start = rt->atom_size;
         if (start == 0) {
             /* JS_ATOM_NULL entry - only when atom_array wasn't pre-allocated */
-            p = (JSAtomStruct *)gc_deref(gc_allocz(sizeof(JSAtomStruct), JS_GC_OBJ_TYPE_DATA));
+            p = (JSAtomStruct *)gc_deref(gc_allocz(sizeof(JSAtomStruct), JS_GC_OBJ_TYPE_JS_STRING));
             if (!p) {
                 /* GC frees automatically */;
                 goto fail;
@@ -3381,7 +3423,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
              * gc_mark_roots may have already cleared its mark. */
             {
                 GCHeader *atom_hdr = gc_header(p);
-                QJS_LOGI("__JS_NewAtom: PROTECT reused string atom %d, ptr=%p, mark was %d, atom_type now %d", 
+                QJS_LOGT("__JS_NewAtom: PROTECT reused string atom %d, ptr=%p, mark was %d, atom_type now %d", 
                          i, (void*)p, atom_hdr->mark, p->atom_type);
                 atom_hdr->mark = 1;
             }
@@ -3392,9 +3434,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
                 QJS_LOGE("__JS_NewAtom: invalid atom_free_index=%u, atom_size=%u", i, rt->atom_size);
                 goto fail;
             }
-            rt->atom_free_index++;
-            if (rt->atom_free_index >= rt->atom_size)
-                rt->atom_free_index = 0;
+            rt->atom_free_index = js_atom_next_free(rt, i);
             
             /* Add to atom_handles first to get handle, then store handle */
             uint32_t handle = js_handle_array_add_with_index(rt, &rt->atom_handles, p);
@@ -3405,7 +3445,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
             /* Duplicate string as new atom.
              * Atoms are permanent roots - allocate with gc_alloc to avoid GC interference */
             size_t str_size = sizeof(JSString) + (str->len << str->is_wide_char) + 1 - str->is_wide_char;
-            p = (JSAtomStruct *)gc_deref(gc_alloc(str_size, JS_GC_OBJ_TYPE_DATA));
+            p = (JSAtomStruct *)gc_deref(gc_alloc(str_size, JS_GC_OBJ_TYPE_JS_STRING));
             if (unlikely(!p))
                 goto fail;
             p->is_wide_char = str->is_wide_char;
@@ -3423,9 +3463,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
                 QJS_LOGE("__JS_NewAtom: invalid atom_free_index=%u, atom_size=%u", i, rt->atom_size);
                 goto fail;
             }
-            rt->atom_free_index++;
-            if (rt->atom_free_index >= rt->atom_size)
-                rt->atom_free_index = 0;
+            rt->atom_free_index = js_atom_next_free(rt, i);
             
             /* Add atom to root set.
              * Object already registered with GC by gc_alloc_js_object */
@@ -3437,7 +3475,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
     } else {
         /* Create empty atom.
          * Atoms are permanent roots - allocate with gc_alloc to avoid GC interference */
-        p = (JSAtomStruct *)gc_deref(gc_alloc(sizeof(JSAtomStruct), JS_GC_OBJ_TYPE_DATA));
+        p = (JSAtomStruct *)gc_deref(gc_alloc(sizeof(JSAtomStruct), JS_GC_OBJ_TYPE_JS_STRING));
         if (!p)
             return JS_ATOM_NULL;
         memset(p, 0, sizeof(JSAtomStruct));
@@ -3453,9 +3491,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
             QJS_LOGE("__JS_NewAtom: invalid atom_free_index=%u, atom_size=%u", i, rt->atom_size);
             return JS_ATOM_NULL;
         }
-        rt->atom_free_index++;
-        if (rt->atom_free_index >= rt->atom_size)
-            rt->atom_free_index = 0;
+        rt->atom_free_index = js_atom_next_free(rt, i);
         
         /* Add atom to root set.
          * Object already registered with GC by gc_alloc_js_object */
@@ -3488,7 +3524,7 @@ static JSAtom __JS_NewAtom(JSRuntime *rt, JSString *str, int atom_type)
             int j, n = ap->len < 20 ? ap->len : 20;
             for(j=0; j<n; j++) snprintf(hex+j*3, 4, "%02x ", ap->u.str8[j]);
             hex[n*3] = 0;
-            QJS_LOGI("__JS_NewAtom: EXIT atom %d str='%s' len=%d hex=%s", i, ap->u.str8, ap->len, hex);
+            QJS_LOGT("__JS_NewAtom: EXIT atom %d str='%s' len=%d hex=%s", i, ap->u.str8, ap->len, hex);
         }
     }
     
@@ -3508,12 +3544,12 @@ static JSAtom __JS_NewAtomInit(JSRuntime *rt, const char *str, int len,
 {
     JSString *p;
     /* Only log for symbol atoms to reduce noise */
-    if (atom_type == JS_ATOM_TYPE_SYMBOL) {
+    if (atom_type == JS_ATOM_TYPE_SYMBOL && TLOG_ENABLED(TLOG_LEVEL_TRACE)) {
         char src_hex[64];
         int j, n = len < 20 ? len : 20;
         for(j=0; j<n; j++) snprintf(src_hex+j*3, 4, "%02x ", (unsigned char)str[j]);
         src_hex[n*3] = 0;
-        QJS_LOGI("__JS_NewAtomInit: SYMBOL str='%.*s' len=%d src_hex=%s", len, str, len, src_hex);
+        QJS_LOGT("__JS_NewAtomInit: SYMBOL str='%.*s' len=%d src_hex=%s", len, str, len, src_hex);
     }
     p = js_alloc_string_rt(rt, len, 0);
     if (!p)
@@ -3525,7 +3561,7 @@ static JSAtom __JS_NewAtomInit(JSRuntime *rt, const char *str, int len,
         int j, n = len < 20 ? len : 20;
         for(j=0; j<n; j++) snprintf(dst_hex+j*3, 4, "%02x ", p->u.str8[j]);
         dst_hex[n*3] = 0;
-        QJS_LOGI("__JS_NewAtomInit: SYMBOL after memcpy p->u.str8='%s' len=%d dst_hex=%s", p->u.str8, p->len, dst_hex);
+        QJS_LOGT("__JS_NewAtomInit: SYMBOL after memcpy p->u.str8='%s' len=%d dst_hex=%s", p->u.str8, p->len, dst_hex);
     }
     return __JS_NewAtom(rt, p, atom_type);
 }
@@ -3550,7 +3586,7 @@ static JSAtom __JS_FindAtom(JSRuntime *rt, const char *str, size_t len,
         }
         /* Debug: log hash comparison details for 'parseInt' */
         if (len == 7 && memcmp(str, "parseInt", 7) == 0) {
-            QJS_LOGE("__JS_FindAtom: parseInt i=%u p->hash=%u h=%u type=%d len=%d is_wide=%d", 
+            QJS_LOGT("__JS_FindAtom: parseInt i=%u p->hash=%u h=%u type=%d len=%d is_wide=%d", 
                      i, p->hash, h, p->atom_type, p->len, p->is_wide_char);
         }
         if (p->hash == h &&
@@ -3559,7 +3595,7 @@ static JSAtom __JS_FindAtom(JSRuntime *rt, const char *str, size_t len,
             p->is_wide_char == 0 &&
             memcmp(p->u.str8, str, len) == 0) {
             if (len == 7 && memcmp(str, "parseInt", 7) == 0) {
-                QJS_LOGE("__JS_FindAtom: FOUND parseInt at atom %u", i);
+                QJS_LOGT("__JS_FindAtom: FOUND parseInt at atom %u", i);
             }
             if (!__JS_AtomIsConst(i))
                 /* ref_count removed - using mark-and-sweep GC */
@@ -3567,12 +3603,12 @@ static JSAtom __JS_FindAtom(JSRuntime *rt, const char *str, size_t len,
         }
         i = p->hash_next;
         if (++loop_count > 10000) {
-            QJS_LOGE("__JS_FindAtom: INFINITE LOOP for '%.*s'", len, str);
+            QJS_LOGE("__JS_FindAtom: INFINITE LOOP for '%.*s'", (int)len, str);
             return JS_ATOM_NULL;
         }
     }
     if (len == 7 && memcmp(str, "parseInt", 7) == 0) {
-        QJS_LOGE("__JS_FindAtom: NOT FOUND parseInt");
+        QJS_LOGT("__JS_FindAtom: NOT FOUND parseInt");
     }
     return JS_ATOM_NULL;
 }
@@ -4089,7 +4125,7 @@ BOOL JS_IsRegisteredClass(JSRuntime *rt, JSClassID class_id)
 static int JS_NewClass1(JSRuntime *rt, JSClassID class_id,
                         const JSClassDef *class_def, JSAtom name)
 {
-    int new_size, i;
+    int new_size, i, j;
     JSClass *cl, *new_class_array;
     struct list_head *el;
 
@@ -4114,8 +4150,8 @@ static int JS_NewClass1(JSRuntime *rt, JSClassID class_id,
             if (new_tab_handle == GC_HANDLE_NULL)
                 return -1;
             GCValue *new_tab = gc_deref(new_tab_handle);
-            for(i = rt->class_count; i < new_size; i++)
-                new_tab[i] = JS_NULL;
+            for(j = rt->class_count; j < new_size; j++)
+                new_tab[j] = JS_NULL;
             ctx->class_proto_handle = new_tab_handle;
         }
         /* reallocate the class array */
@@ -5483,6 +5519,8 @@ static int init_shape_hash(JSRuntime *rt)
                                    rt->shape_hash_size, JS_GC_OBJ_TYPE_DATA);
     if (rt->shape_hash_handle == 0)
         return -1;
+    /* weak: gc_sweep_object unlinks the dead shapes */
+    gc_set_precise(rt->shape_hash_handle);
     return 0;
 }
 
@@ -5521,6 +5559,7 @@ static int resize_shape_hash(JSRuntime *rt, int new_shape_hash_bits)
                                    new_shape_hash_size, JS_GC_OBJ_TYPE_DATA);
     if (new_shape_hash_handle == 0)
         return -1;
+    gc_set_precise(new_shape_hash_handle);
     new_shape_hash = (GCHandle *)gc_deref(new_shape_hash_handle);
     for(i = 0; i < rt->shape_hash_size; i++) {
         for(sh_handle = rt_shape_hash[i]; sh_handle != GC_HANDLE_NULL; sh_handle = sh_next_handle) {
@@ -5555,17 +5594,17 @@ static void js_shape_hash_unlink(JSRuntime *rt, JSShape *sh)
     GCHandle sh_handle = sh->handle;
     JSShape *current_sh;
 
-    QJS_LOGE("js_shape_hash_unlink: ENTER sh=%p handle=%u", (void*)sh, sh_handle);
+    QJS_LOGT("js_shape_hash_unlink: ENTER sh=%p handle=%u", (void*)sh, sh_handle);
     if (!sh || sh_handle == GC_HANDLE_NULL) {
         QJS_LOGE("js_shape_hash_unlink: ERROR - sh is NULL!");
         return;
     }
     
-    QJS_LOGE("js_shape_hash_unlink: sh->hash=%u sh->is_hashed=%d", sh->hash, sh->is_hashed);
+    QJS_LOGT("js_shape_hash_unlink: sh->hash=%u sh->is_hashed=%d", sh->hash, sh->is_hashed);
     h = get_shape_hash(sh->hash, rt->shape_hash_bits);
-    QJS_LOGE("js_shape_hash_unlink: h=%u shape_hash_bits=%d", h, rt->shape_hash_bits);
+    QJS_LOGT("js_shape_hash_unlink: h=%u shape_hash_bits=%d", h, rt->shape_hash_bits);
     psh_handle = &rt_shape_hash[h];
-    QJS_LOGE("js_shape_hash_unlink: psh_handle=%p *psh_handle=%u", (void*)psh_handle, *psh_handle);
+    QJS_LOGT("js_shape_hash_unlink: psh_handle=%p *psh_handle=%u", (void*)psh_handle, *psh_handle);
     
     int loop_count = 0;
     while (*psh_handle != sh_handle) {
@@ -5578,17 +5617,17 @@ static void js_shape_hash_unlink(JSRuntime *rt, JSShape *sh)
             QJS_LOGE("js_shape_hash_unlink: ERROR - corrupted list!");
             return;
         }
-        QJS_LOGE("js_shape_hash_unlink: traversing... handle=%u", *psh_handle);
+        QJS_LOGT("js_shape_hash_unlink: traversing... handle=%u", *psh_handle);
         psh_handle = &current_sh->shape_hash_next_handle;
         if (++loop_count > 1000) {
             QJS_LOGE("js_shape_hash_unlink: ERROR - infinite loop!");
             return;
         }
     }
-    QJS_LOGE("js_shape_hash_unlink: found sh, setting *psh_handle to next=%u", sh->shape_hash_next_handle);
+    QJS_LOGT("js_shape_hash_unlink: found sh, setting *psh_handle to next=%u", sh->shape_hash_next_handle);
     *psh_handle = sh->shape_hash_next_handle;
     rt->shape_hash_count--;
-    QJS_LOGE("js_shape_hash_unlink: DONE");
+    QJS_LOGT("js_shape_hash_unlink: DONE");
 }
 
 /* create a new empty shape with prototype 'proto'. It is not hashed */
@@ -5600,7 +5639,7 @@ static inline JSShape *js_new_shape_nohash(JSContext *ctx, JSObject *proto,
     JSShape *sh;
     GCHandle proto_handle = GC_PTR_TO_HANDLE(proto);  /* Save handle before allocation */
 
-    QJS_LOGI("js_new_shape_nohash: START ctx=%p rt=%p", (void*)ctx, (void*)rt);
+    QJS_LOGT("js_new_shape_nohash: START ctx=%p rt=%p", (void*)ctx, (void*)rt);
     if (!rt) {
         QJS_LOGE("js_new_shape_nohash: rt is NULL!");
         return GC_HANDLE_NULL;
@@ -5613,17 +5652,17 @@ static inline JSShape *js_new_shape_nohash(JSContext *ctx, JSObject *proto,
         QJS_LOGE("js_new_shape_nohash: malloc failed!");
         return GC_HANDLE_NULL;
     }
-    QJS_LOGI("js_new_shape_nohash: sh_alloc=%p", sh_alloc);
+    QJS_LOGT("js_new_shape_nohash: sh_alloc=%p", sh_alloc);
     /* Shape is now at the start of allocation, no offset needed */
     GCHandle sh_handle = GC_PTR_TO_HANDLE(sh_alloc);
-    QJS_LOGI("js_new_shape_nohash: sh_handle=%u", sh_handle);
+    QJS_LOGT("js_new_shape_nohash: sh_handle=%u", sh_handle);
     sh = get_shape_from_alloc(sh_alloc, hash_size);
-    QJS_LOGI("js_new_shape_nohash: sh=%p", (void*)sh);
+    QJS_LOGT("js_new_shape_nohash: sh=%p", (void*)sh);
     /* Store handle in shape for later retrieval */
     sh->handle = sh_handle;
     /* Object already registered with GC by gc_alloc_js_object */
     sh->proto_handle = proto_handle;  /* Use saved handle */
-    QJS_LOGI("js_new_shape_nohash: memset...");
+    QJS_LOGT("js_new_shape_nohash: memset...");
     /* Clear hash table (now located after properties) */
     memset(&sh->prop[prop_size], 0, sizeof(uint32_t) * hash_size);
     sh->prop_hash_mask = hash_size - 1;
@@ -5634,7 +5673,7 @@ static inline JSShape *js_new_shape_nohash(JSContext *ctx, JSObject *proto,
     sh->is_hashed = FALSE;
     sh->hash = 0;  /* Initialize hash */
     sh->shape_hash_next_handle = GC_HANDLE_NULL;  /* CRITICAL: Initialize to NULL */
-    QJS_LOGI("js_new_shape_nohash: SUCCESS sh=%p", (void*)sh);
+    QJS_LOGT("js_new_shape_nohash: SUCCESS sh=%p", (void*)sh);
     return sh;
 }
 
@@ -5699,7 +5738,7 @@ static JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1)
     
     sh = get_shape_from_alloc(sh_alloc, hash_size);
     /* Update handle to point to sh instead of sh_alloc */
-    g_gc.handles.ptrs[sh_handle] = sh;
+    gc_heap->handles.ptrs[sh_handle] = sh;
     /* Object already registered with GC by gc_alloc_js_object */
     sh->handle = sh_handle;  /* Store the correct handle */
     sh->is_hashed = FALSE;
@@ -5724,7 +5763,7 @@ static void js_free_shape0(JSRuntime *rt, JSShape *sh)
     uint32_t i;
     JSShapeProperty *pr;
 
-    QJS_LOGE("js_free_shape0: ENTER sh=%p", (void*)sh);
+    QJS_LOGT("js_free_shape0: ENTER sh=%p", (void*)sh);
     if (!sh) {
         QJS_LOGE("js_free_shape0: ERROR - sh is NULL!");
         return;
@@ -5740,15 +5779,15 @@ static void js_free_shape0(JSRuntime *rt, JSShape *sh)
         return;
     }
     
-    QJS_LOGE("js_free_shape0: sh->is_hashed=%d", sh->is_hashed);
+    QJS_LOGT("js_free_shape0: sh->is_hashed=%d", sh->is_hashed);
     
     /* ref_count check removed - using mark-and-sweep GC */
     if (sh->is_hashed) {
-        QJS_LOGE("js_free_shape0: calling js_shape_hash_unlink...");
+        QJS_LOGT("js_free_shape0: calling js_shape_hash_unlink...");
         js_shape_hash_unlink(rt, sh);
-        QJS_LOGE("js_free_shape0: js_shape_hash_unlink returned");
+        QJS_LOGT("js_free_shape0: js_shape_hash_unlink returned");
     }
-    QJS_LOGE("js_free_shape0: checking proto...");
+    QJS_LOGT("js_free_shape0: checking proto...");
     /* Validate proto handle if non-NULL */
     if (sh->proto_handle != GC_HANDLE_NULL) {
         void *proto_ptr = gc_deref(sh->proto_handle);
@@ -5756,7 +5795,7 @@ static void js_free_shape0(JSRuntime *rt, JSShape *sh)
             QJS_LOGE("js_free_shape0: WARNING - proto handle is invalid!");
             /* Don't crash, just don't dereference it */
         } else {
-            QJS_LOGE("js_free_shape0: proto is valid, class_id=%d", ((JSObject*)proto_ptr)->class_id);
+            QJS_LOGT("js_free_shape0: proto is valid, class_id=%d", ((JSObject*)proto_ptr)->class_id);
         }
     }
     
@@ -5767,18 +5806,18 @@ static void js_free_shape0(JSRuntime *rt, JSShape *sh)
         sh->prop_count = 0;
     }
     
-    QJS_LOGE("js_free_shape0: getting shape prop, prop_count=%d", sh->prop_count);
+    QJS_LOGT("js_free_shape0: getting shape prop, prop_count=%d", sh->prop_count);
     pr = get_shape_prop(sh);
-    QJS_LOGE("js_free_shape0: freeing atoms...");
+    QJS_LOGT("js_free_shape0: freeing atoms...");
     for(i = 0; i < sh->prop_count; i++) {
         JS_FreeAtomRT(rt, pr->atom);
         pr++;
     }
-    QJS_LOGE("js_free_shape0: removing from gc...");
+    QJS_LOGT("js_free_shape0: removing from gc...");
     remove_gc_object(gc_header(sh));
-    QJS_LOGE("js_free_shape0: freeing memory...");
+    QJS_LOGT("js_free_shape0: freeing memory...");
     /* GC frees: js_free_rt(rt, get_alloc_from_shape(sh)); */
-    QJS_LOGE("js_free_shape0: DONE");
+    QJS_LOGT("js_free_shape0: DONE");
 }
 
 static void js_free_shape(JSRuntime *rt, JSShape *sh)
@@ -5872,7 +5911,7 @@ static no_inline int resize_properties(JSContext *ctx, GCHandle *psh_handle,
     /* Update the handle */
     *psh_handle = sh_handle;
     /* Update handle to point to sh instead of sh_alloc so GC_SHAPE_DEREF works correctly */
-    g_gc.handles.ptrs[sh_handle] = sh;
+    gc_heap->handles.ptrs[sh_handle] = sh;
     sh->prop_size = new_size;
     return 0;
 }
@@ -5916,7 +5955,7 @@ static int compact_properties(JSContext *ctx, JSObject *p)
     sh->proto_handle = old_sh->proto_handle;
     sh->handle = old_sh->handle;
     /* Update handle to point to new sh instead of sh_alloc */
-    g_gc.handles.ptrs[sh->handle] = sh;
+    gc_heap->handles.ptrs[sh->handle] = sh;
 
     memset(prop_hash_start(sh), 0,
            sizeof(uint32_t) * new_hash_size);
@@ -6116,13 +6155,23 @@ static __maybe_unused void JS_DumpShapes(JSRuntime *rt)
 
 /* 'props[]' is used to initialized the object properties. The number
    of elements depends on the shape. */
+/* Runs from the collector's finalizer table when an embedder object dies */
+static void js_class_handle_finalizer(JSRuntime *rt, GCHandle handle,
+                                      void *user_ptr)
+{
+    JSObject *p = user_ptr;
+    JSClassFinalizer *finalizer = rt_class_array[p->class_id].finalizer;
+    if (finalizer)
+        finalizer(rt, GC_MKHANDLE(JS_TAG_OBJECT, handle));
+}
+
 static GCValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSClassID class_id,
                                      JSProperty *props)
 {
     JSObject *p;
     int i;
 
-    QJS_LOGE("JS_NewObjectFromShape: ctx=%p sh=%p class_id=%d", (void*)ctx, (void*)sh, class_id);
+    QJS_LOGT("JS_NewObjectFromShape: ctx=%p sh=%p class_id=%d", (void*)ctx, (void*)sh, class_id);
     /* Check if sh is valid */
     if ((uintptr_t)sh == 0xc0000000 || (uintptr_t)sh == 0) {
         QJS_LOGE("JS_NewObjectFromShape: INVALID sh=%p!", (void*)sh);
@@ -6132,11 +6181,11 @@ static GCValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSClassID clas
         return JS_EXCEPTION;
     }
     /* GC is automatically triggered by gc_object_alloc if needed */
-    QJS_LOGE("JS_NewObjectFromShape: allocating object...");
+    QJS_LOGT("JS_NewObjectFromShape: allocating object...");
     
     /* Use atomic allocation that sets gc_obj_type immediately */
     p = gc_alloc_js_object(sizeof(JSObject), JS_GC_OBJ_TYPE_JS_OBJECT);
-    QJS_LOGE("JS_NewObjectFromShape: allocated p=%p", (void*)p);
+    QJS_LOGT("JS_NewObjectFromShape: allocated p=%p", (void*)p);
     if (unlikely(!p))
         goto fail;
     p->class_id = class_id;
@@ -6155,24 +6204,24 @@ static GCValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSClassID clas
     p->shape_handle = sh->handle;
     
     /* DIAGNOSTIC: Verify shape was set correctly */
-    QJS_LOGE("JS_NewObjectFromShape: obj=%p shape=%p class_id=%d", (void*)p, (void*)GC_SHAPE_DEREF(p->shape_handle), class_id);
+    QJS_LOGT("JS_NewObjectFromShape: obj=%p shape=%p class_id=%d", (void*)p, (void*)GC_SHAPE_DEREF(p->shape_handle), class_id);
     if (GC_SHAPE_DEREF(p->shape_handle) != sh) {
         QJS_LOGE("JS_NewObjectFromShape: SHAPE MISMATCH! expected=%p got=%p", (void*)sh, (void*)GC_SHAPE_DEREF(p->shape_handle));
     }
     
     /* CRITICAL: Check shape validity before accessing prop_size */
-    QJS_LOGE("JS_NewObjectFromShape: checking shape validity sh=%p", (void*)sh);
+    QJS_LOGT("JS_NewObjectFromShape: checking shape validity sh=%p", (void*)sh);
     if (!sh) {
         QJS_LOGE("JS_NewObjectFromShape: ERROR - sh is NULL!");
         goto fail;
     }
-    QJS_LOGE("JS_NewObjectFromShape: sh->prop_size=%d", sh->prop_size);
+    QJS_LOGT("JS_NewObjectFromShape: sh->prop_size=%d", sh->prop_size);
     if (sh->prop_size < 0 || sh->prop_size > 1000000) {
         QJS_LOGE("JS_NewObjectFromShape: ERROR - invalid prop_size=%d", sh->prop_size);
         goto fail;
     }
     
-    QJS_LOGE("JS_NewObjectFromShape: allocating prop array, prop_size=%d", sh->prop_size);
+    QJS_LOGT("JS_NewObjectFromShape: allocating prop array, prop_size=%d", sh->prop_size);
     p->prop_handle = gc_alloc(sizeof(JSProperty) * sh->prop_size, JS_GC_OBJ_TYPE_DATA);
     if (unlikely(p->prop_handle == GC_HANDLE_NULL)) {
         /* GC frees automatically */;
@@ -6263,6 +6312,14 @@ static GCValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSClassID clas
             if (rt_class_array[class_id].exotic) {
                 p->is_exotic = 1;
             }
+            /* Embedder classes release their native state and clear the
+               native caches pointing at the wrapper. The predefined
+               finalizers still expect reference counting. */
+            if (class_id >= JS_CLASS_INIT_COUNT &&
+                rt_class_array[class_id].finalizer) {
+                gc_set_handle_finalizer(gc_header(p)->handle,
+                                        js_class_handle_finalizer);
+            }
         }
         break;
     }
@@ -6272,7 +6329,7 @@ static GCValue JS_NewObjectFromShape(JSContext *ctx, JSShape *sh, JSClassID clas
             p_prop[i] = props[i];
     }
     GCValue ret = JS_MKPTR(JS_TAG_OBJECT, p);
-    QJS_LOGI("JS_NewObjectFromShape: returning obj=%p tag=%d", (void*)p, (int)JS_VALUE_GET_TAG(ret));
+    QJS_LOGT("JS_NewObjectFromShape: returning obj=%p tag=%d", (void*)p, (int)JS_VALUE_GET_TAG(ret));
     return ret;
 }
 
@@ -6291,25 +6348,25 @@ GCValue JS_NewObjectProtoClass(JSContext *ctx, GCValue proto_val,
     JSShape *sh;
     JSObject *proto;
 
-    QJS_LOGE("JS_NewObjectProtoClass: START class_id=%d", class_id);
+    QJS_LOGT("JS_NewObjectProtoClass: START class_id=%d", class_id);
     proto = get_proto_obj(proto_val);
-    QJS_LOGE("JS_NewObjectProtoClass: proto=%p", (void*)proto);
+    QJS_LOGT("JS_NewObjectProtoClass: proto=%p", (void*)proto);
     sh = find_hashed_shape_proto(ctx_rt, proto);
-    QJS_LOGE("JS_NewObjectProtoClass: sh=%p", (void*)sh);
+    QJS_LOGT("JS_NewObjectProtoClass: sh=%p", (void*)sh);
     if (likely(sh)) {
-        QJS_LOGE("JS_NewObjectProtoClass: duplicating shape");
+        QJS_LOGT("JS_NewObjectProtoClass: duplicating shape");
         sh = js_dup_shape(sh);
-        QJS_LOGE("JS_NewObjectProtoClass: shape duplicated, sh=%p", (void*)sh);
+        QJS_LOGT("JS_NewObjectProtoClass: shape duplicated, sh=%p", (void*)sh);
     } else {
-        QJS_LOGE("JS_NewObjectProtoClass: creating new shape");
+        QJS_LOGT("JS_NewObjectProtoClass: creating new shape");
         sh = js_new_shape(ctx, proto);
-        QJS_LOGE("JS_NewObjectProtoClass: new shape created, sh=%p", (void*)sh);
+        QJS_LOGT("JS_NewObjectProtoClass: new shape created, sh=%p", (void*)sh);
         if (!sh)
             return JS_EXCEPTION;
     }
-    QJS_LOGE("JS_NewObjectProtoClass: calling JS_NewObjectFromShape");
+    QJS_LOGT("JS_NewObjectProtoClass: calling JS_NewObjectFromShape");
     GCValue ret = JS_NewObjectFromShape(ctx, sh, class_id, NULL);
-    QJS_LOGE("JS_NewObjectProtoClass: DONE");
+    QJS_LOGT("JS_NewObjectProtoClass: DONE");
     return ret;
 }
 
@@ -6322,8 +6379,8 @@ static GCValue JS_NewObjectProtoClassAlloc(JSContext *ctx, GCValue proto_val,
     JSObject *proto;
     int hash_size, hash_bits;
 
-    QJS_LOGI("JS_NewObjectProtoClassAlloc: START class_id=%d n_alloc_props=%d", class_id, n_alloc_props);
-    QJS_LOGI("JS_NewObjectProtoClassAlloc: ctx=%p rt=%p", (void*)ctx, (void*)ctx_rt);
+    QJS_LOGT("JS_NewObjectProtoClassAlloc: START class_id=%d n_alloc_props=%d", class_id, n_alloc_props);
+    QJS_LOGT("JS_NewObjectProtoClassAlloc: ctx=%p rt=%p", (void*)ctx, (void*)ctx_rt);
 
     if (n_alloc_props <= JS_PROP_INITIAL_SIZE) {
         n_alloc_props = JS_PROP_INITIAL_SIZE;
@@ -6332,15 +6389,15 @@ static GCValue JS_NewObjectProtoClassAlloc(JSContext *ctx, GCValue proto_val,
         hash_bits = 32 - clz32(n_alloc_props - 1); /* ceil(log2(radix)) */
         hash_size = 1 << hash_bits;
     }
-    QJS_LOGI("JS_NewObjectProtoClassAlloc: hash_size=%d n_alloc_props=%d", hash_size, n_alloc_props);
+    QJS_LOGT("JS_NewObjectProtoClassAlloc: hash_size=%d n_alloc_props=%d", hash_size, n_alloc_props);
     proto = get_proto_obj(proto_val);
-    QJS_LOGI("JS_NewObjectProtoClassAlloc: calling js_new_shape_nohash...");
+    QJS_LOGT("JS_NewObjectProtoClassAlloc: calling js_new_shape_nohash...");
     sh = js_new_shape_nohash(ctx, proto, hash_size, n_alloc_props);
     if (!sh) {
         QJS_LOGE("JS_NewObjectProtoClassAlloc: js_new_shape_nohash failed!");
         return JS_EXCEPTION;
     }
-    QJS_LOGI("JS_NewObjectProtoClassAlloc: calling JS_NewObjectFromShape...");
+    QJS_LOGT("JS_NewObjectProtoClassAlloc: calling JS_NewObjectFromShape...");
     return JS_NewObjectFromShape(ctx, sh, class_id, NULL);
 }
 
@@ -6694,13 +6751,13 @@ static force_inline JSShapeProperty *find_own_property(JSProperty **ppr,
     JSShape *sh;
     JSShapeProperty *pr, *prop;
     intptr_t h;
-    QJS_LOGE("find_own_property: ENTRY p=%p atom=%d", (void*)p, atom);
+    QJS_LOGT("find_own_property: ENTRY p=%p atom=%d", (void*)p, atom);
     if (unlikely(!p || !GC_SHAPE_DEREF(p->shape_handle))) {
         QJS_LOGE("find_own_property: NULL p or shape");
         *ppr = NULL;
         return GC_HANDLE_NULL;
     }
-    QJS_LOGE("find_own_property: p and shape non-null");
+    QJS_LOGT("find_own_property: p and shape non-null");
     
     /* Defensive: check if shape pointer is valid
      * Check for:
@@ -6711,7 +6768,7 @@ static force_inline JSShapeProperty *find_own_property(JSProperty **ppr,
      * NOTE: Relaxed for Android heap addresses (0xb4000000 range)
      */
     uintptr_t shape_val = (uintptr_t)GC_SHAPE_DEREF(p->shape_handle);
-    QJS_LOGE("find_own_property: shape_val=0x%llx", (unsigned long long)shape_val);
+    QJS_LOGT("find_own_property: shape_val=0x%llx", (unsigned long long)shape_val);
     /* Check for GCValue pattern in shape pointer (handle corruption indicator) */
     if (unlikely((shape_val & 0xF) == 0 && shape_val != 0 && shape_val < 0x10000000)) {
         QJS_LOGE("find_own_property: SHAPE IS JSVALUE! shape=%p (looks like handle=0x%x tag=0)", 
@@ -6725,13 +6782,13 @@ static force_inline JSShapeProperty *find_own_property(JSProperty **ppr,
         QJS_LOGE("find_own_property: CORRUPTED shape pointer %p (0x%llx) for object %p", 
                  (void*)GC_SHAPE_DEREF(p->shape_handle), (unsigned long long)shape_val, (void*)p);
         /* Log additional object info for debugging */
-        QJS_LOGE("find_own_property: object class_id=%d", p->class_id);
+        QJS_LOGT("find_own_property: object class_id=%d", p->class_id);
         *ppr = NULL;
         return GC_HANDLE_NULL;
     }
-    QJS_LOGE("find_own_property: shape check passed");
+    QJS_LOGT("find_own_property: shape check passed");
     sh = GC_SHAPE_DEREF(p->shape_handle);
-    QJS_LOGE("find_own_property: accessing sh->prop_hash_mask");
+    QJS_LOGT("find_own_property: accessing sh->prop_hash_mask");
     h = (uintptr_t)atom & sh->prop_hash_mask;
     h = prop_hash_start(sh)[h];
     prop = get_shape_prop(sh);
@@ -6870,7 +6927,7 @@ static void js_bytecode_function_mark(JSRuntime *rt, GCValue val,
         }
         /* must mark the function bytecode because template objects may be
            part of a cycle */
-        JS_MarkValue(rt, JS_MKPTR(JS_TAG_FUNCTION_BYTECODE, b), mark_func);
+        mark_func(rt, b);
     }
 }
 
@@ -6926,111 +6983,6 @@ static void js_for_in_iterator_mark(JSRuntime *rt, GCValue val,
     JS_MarkValue(rt, it->obj, mark_func);
 }
 
-static void free_object(JSRuntime *rt, JSObject *p)
-{
-    int i;
-    JSClassFinalizer *finalizer;
-    JSShape *sh;
-    JSShapeProperty *pr;
-
-    p->free_mark = 1; /* used to tell the object is invalid when
-                         freeing cycles */
-    /* free all the fields */
-    sh = GC_SHAPE_DEREF(p->shape_handle);
-    pr = get_shape_prop(sh);
-    for(i = 0; i < sh->prop_count; i++) {
-        free_property(rt, &p_prop[i], pr->flags);
-        pr++;
-    }
-    /* GC frees: js_free_rt(rt, p->prop_handle); */
-    /* as an optimization we destroy the shape immediately without
-       putting it in gc_zero_ref_count_list */
-    js_free_shape(rt, sh);
-
-    /* fail safe */
-    p->shape_handle = GC_PTR_TO_HANDLE(NULL);
-    p->prop_handle = GC_HANDLE_NULL;
-    p->prop_handle = 0;
-
-    finalizer = rt_class_array[p->class_id].finalizer;
-    if (finalizer)
-        (*finalizer)(rt, JS_MKPTR(JS_TAG_OBJECT, p));
-
-    /* fail safe */
-    p->class_id = 0;
-    p->u.opaque_handle = GC_HANDLE_NULL;
-    p->u.func.var_refs_handle = GC_HANDLE_NULL;
-    p->u.func.home_object_handle = GC_HANDLE_NULL;
-
-    remove_gc_object(gc_header(p));
-    /* keep the object structure in case there are weak references to it */
-    if (p->weakref_count == 0) {
-        /* GC frees automatically */;
-    } else {
-        gc_header(p)->mark = 0; /* reset the mark so that the weakref can be freed */
-    }
-}
-
-static void free_string(JSRuntime *rt, JSString *str)
-{
-    remove_gc_object(gc_header(str));
-#ifdef DUMP_LEAKS
-    list_del(&str->link);
-#endif
-    /* GC frees automatically */;
-}
-
-static void free_bigint(JSRuntime *rt, JSBigInt *p)
-{
-    remove_gc_object(gc_header(p));
-    /* GC frees automatically */;
-}
-
-static void free_string_rope(JSRuntime *rt, JSStringRope *r)
-{
-    remove_gc_object(gc_header(r));
-    /* GC frees automatically */;
-}
-
-static void free_gc_object(JSRuntime *rt, void *user_ptr)
-{
-    GCHeader *gp = gc_header(user_ptr);
-    switch(gp->gc_obj_type) {
-    case JS_GC_OBJ_TYPE_JS_OBJECT:
-        free_object(rt, (JSObject *)user_ptr);
-        break;
-    case JS_GC_OBJ_TYPE_FUNCTION_BYTECODE:
-        free_function_bytecode(rt, (JSFunctionBytecode *)user_ptr);
-        break;
-    case JS_GC_OBJ_TYPE_ASYNC_FUNCTION:
-        __async_func_free(rt, (JSAsyncFunctionState *)user_ptr);
-        break;
-    case JS_GC_OBJ_TYPE_MODULE:
-        js_free_module_def(rt, (JSModuleDef *)user_ptr);
-        break;
-    case JS_GC_OBJ_TYPE_JS_STRING:
-        /* Atoms are permanent roots - never freed by GC */
-        break;
-    case JS_GC_OBJ_TYPE_JS_BIGINT:
-        free_bigint(rt, (JSBigInt *)gp);
-        break;
-    case JS_GC_OBJ_TYPE_JS_STRING_ROPE:
-        free_string_rope(rt, (JSStringRope *)gp);
-        break;
-    case JS_GC_OBJ_TYPE_SHAPE:
-        js_free_shape(rt, (JSShape *)gp);
-        break;
-    case JS_GC_OBJ_TYPE_VAR_REF:
-        /* Var refs are freed when their containing object is freed */
-        /* GC frees automatically */;
-        break;
-    default:
-        /* Unknown object type - just free the header */
-        /* GC frees automatically */;
-        break;
-    }
-}
-
 /* garbage collection */
 
 static void gc_remove_weak_objects(JSRuntime *rt)
@@ -7130,7 +7082,7 @@ int js_handle_array_add_js_object_ex(JSRuntime *rt, void *obj, int js_gc_obj_typ
         return -1;
     }
     
-    QJS_LOGI("js_handle_array_add_js_object_ex: allocated handle=%u for ptr=%p type=%d", 
+    QJS_LOGT("js_handle_array_add_js_object_ex: allocated handle=%u for ptr=%p type=%d", 
              handle, obj, array_type);
     
     return 0;
@@ -7191,7 +7143,7 @@ typedef struct {
 static void add_gc_object(JSRuntime *rt, GCHeader *h,
                           JSGCObjectTypeEnum type)
 {
-    QJS_LOGI("add_gc_object: ENTER rt=%p h=%p", (void*)rt, (void*)h);
+    QJS_LOGT("add_gc_object: ENTER rt=%p h=%p", (void*)rt, (void*)h);
     
     /* CRITICAL FIX: Check for NULL inputs */
     if (!rt) {
@@ -7209,7 +7161,7 @@ static void add_gc_object(JSRuntime *rt, GCHeader *h,
         abort();  /* Crash with clear message */
     }
     
-    QJS_LOGI("add_gc_object: about to set h->mark, h=%p", (void*)h);
+    QJS_LOGT("add_gc_object: about to set h->mark, h=%p", (void*)h);
     h->mark = 0;
     h->gc_obj_type = type;
     
@@ -7223,12 +7175,12 @@ static void add_gc_object(JSRuntime *rt, GCHeader *h,
     }
     h->handle = handle;
     
-    QJS_LOGI("add_gc_object: calling js_handle_array_add with handle=%u...", handle);
+    QJS_LOGT("add_gc_object: calling js_handle_array_add with handle=%u...", handle);
     if (js_handle_array_add(rt, &rt->gc_handles, handle) < 0) {
         QJS_LOGE("add_gc_object: js_handle_array_add failed!");
         abort();  /* Crash with clear message */
     }
-    QJS_LOGI("add_gc_object: js_handle_array_add succeeded");
+    QJS_LOGT("add_gc_object: js_handle_array_add succeeded");
 }
 
 static void remove_gc_object(GCHeader *h)
@@ -7241,7 +7193,7 @@ static void remove_gc_object(GCHeader *h)
 void JS_MarkValue(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func)
 {
     int tag = JS_VALUE_GET_TAG(val);
-    QJS_LOGI("JS_MarkValue: ENTER ptr=%p tag=%d has_ref=%d", JS_VALUE_GET_PTR(val), tag, JS_VALUE_HAS_REF_COUNT(val));
+    QJS_LOGT("JS_MarkValue: ENTER ptr=%p tag=%d has_ref=%d", JS_VALUE_GET_PTR(val), tag, JS_VALUE_HAS_REF_COUNT(val));
     if (JS_VALUE_HAS_REF_COUNT(val)) {
         switch(tag) {
         case JS_TAG_OBJECT:
@@ -7249,24 +7201,36 @@ void JS_MarkValue(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func)
         case JS_TAG_MODULE:
         case JS_TAG_STRING:
         case JS_TAG_STRING_ROPE:
-            QJS_LOGI("JS_MarkValue: marking ptr=%p tag=%d", JS_VALUE_GET_PTR(val), tag);
+        case JS_TAG_SYMBOL:
+        case JS_TAG_BIG_INT:
+            QJS_LOGT("JS_MarkValue: marking ptr=%p tag=%d", JS_VALUE_GET_PTR(val), tag);
             mark_func(rt, JS_VALUE_GET_PTR(val));
-            QJS_LOGI("JS_MarkValue: done marking ptr=%p", JS_VALUE_GET_PTR(val));
+            QJS_LOGT("JS_MarkValue: done marking ptr=%p", JS_VALUE_GET_PTR(val));
             break;
         default:
-            QJS_LOGI("JS_MarkValue: skipping ptr=%p tag=%d (not in switch)", JS_VALUE_GET_PTR(val), tag);
+            QJS_LOGT("JS_MarkValue: skipping ptr=%p tag=%d (not in switch)", JS_VALUE_GET_PTR(val), tag);
             break;
         }
     } else {
-        QJS_LOGI("JS_MarkValue: skipping ptr=%p tag=%d (no ref count)", JS_VALUE_GET_PTR(val), tag);
+        QJS_LOGT("JS_MarkValue: skipping ptr=%p tag=%d (no ref count)", JS_VALUE_GET_PTR(val), tag);
     }
 }
 
+static void js_mark_atom(JSRuntime *rt, JSAtom atom, JS_MarkFunc *mark_func)
+{
+    GCHandle handle;
+    if (__JS_AtomIsTaggedInt(atom) || atom >= rt->atom_size)
+        return;
+    handle = rt_atom_array[atom];
+    if (handle != GC_HANDLE_NULL)
+        mark_func(rt, gc_deref(handle));
+}
+
 static void mark_children(JSRuntime *rt, void *user_ptr,
                           JS_MarkFunc *mark_func)
 {
     GCHeader *gp = gc_header(user_ptr);
-    QJS_LOGI("mark_children: ENTER user_ptr=%p gc_obj_type=%u", (void*)user_ptr, (unsigned)gp->gc_obj_type);
+    QJS_LOGT("mark_children: ENTER user_ptr=%p gc_obj_type=%u", (void*)user_ptr, (unsigned)gp->gc_obj_type);
     switch(gp->gc_obj_type) {
     case JS_GC_OBJ_TYPE_JS_OBJECT:
         {
@@ -7275,6 +7239,8 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
             JSShape *sh;
             int i;
             sh = GC_SHAPE_DEREF(p->shape_handle);
+            if (!sh)
+                break;
             mark_func(rt, sh);
             /* mark all the fields */
             prs = get_shape_prop(sh);
@@ -7303,11 +7269,13 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
                 prs++;
             }
 
-            if (p->class_id != JS_CLASS_OBJECT) {
+            /* The object's own handle: JS_MKPTR would allocate one, and
+               this runs on the mark helper threads too */
+            if (p->class_id != JS_CLASS_OBJECT && gp->handle != GC_HANDLE_NULL) {
                 JSClassGCMark *gc_mark;
                 gc_mark = rt_class_array[p->class_id].gc_mark;
                 if (gc_mark)
-                    gc_mark(rt, JS_MKPTR(JS_TAG_OBJECT, p), mark_func);
+                    gc_mark(rt, GC_MKHANDLE(JS_TAG_OBJECT, gp->handle), mark_func);
             }
         }
         break;
@@ -7321,6 +7289,11 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
             }
             if (b->realm_handle)
                 mark_func(rt, (JSContext*)gc_deref(b->realm_handle));
+            /* the operands are not word aligned, so the heap scan
+               misses them */
+            if (b->byte_code_buf)
+                mark_bytecode_atoms(rt, b->byte_code_buf, b->byte_code_len,
+                                    mark_func);
         }
         break;
     case JS_GC_OBJ_TYPE_VAR_REF:
@@ -7330,7 +7303,7 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
                 JS_MarkValue(rt, *var_ref->pvalue, mark_func);
             } else {
                 JSStackFrame *sf = (JSStackFrame *)gc_deref(var_ref->stack_frame_handle);
-                if (sf->js_mode & JS_MODE_ASYNC) {
+                if (sf && (sf->js_mode & JS_MODE_ASYNC)) {
                     JSAsyncFunctionState *async_func = container_of(sf, JSAsyncFunctionState, frame);
                     mark_func(rt, async_func);
                 }
@@ -7365,7 +7338,7 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
             JSShape *sh = (JSShape *)user_ptr;
             JSShapeProperty *prs;
             int i;
-            QJS_LOGI("mark_children: SHAPE sh=%p, proto_handle=%u, prop_count=%d", (void*)sh, sh->proto_handle, sh->prop_count);
+            QJS_LOGT("mark_children: SHAPE sh=%p, proto_handle=%u, prop_count=%d", (void*)sh, sh->proto_handle, sh->prop_count);
             if (sh->proto_handle != GC_HANDLE_NULL) {
                 GCValue proto_val = GC_MKHANDLE(JS_TAG_OBJECT, sh->proto_handle);
                 JS_MarkValue(rt, proto_val, mark_func);
@@ -7387,11 +7360,11 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
                         continue;
                     }
                     if (gc_ptr_is_valid(atom_ptr)) {
-                        QJS_LOGI("mark_children: marking shape atom %d at index %d, ptr=%p", 
+                        QJS_LOGT("mark_children: marking shape atom %d at index %d, ptr=%p", 
                                  prs[i].atom, i, (void*)atom_ptr);
                         mark_func(rt, atom_ptr);
                     } else {
-                        QJS_LOGI("mark_children: shape atom %d at index %d is malloc'd, skipping mark", 
+                        QJS_LOGT("mark_children: shape atom %d at index %d is malloc'd, skipping mark", 
                                  prs[i].atom, i);
                     }
                 }
@@ -7412,15 +7385,18 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
         break;
     case JS_GC_OBJ_TYPE_JS_STRING:
     case JS_GC_OBJ_TYPE_JS_BIGINT:
-        /* Atoms are permanent roots - no children, never freed */
+        /* no children */
         break;
     case JS_GC_OBJ_TYPE_JS_STRING_ROPE:
         {
-            JSStringRope *r = (JSStringRope *)gp;
+            JSStringRope *r = (JSStringRope *)user_ptr;
             JS_MarkValue(rt, r->left, mark_func);
             JS_MarkValue(rt, r->right, mark_func);
         }
         break;
+    case JS_GC_OBJ_TYPE_DATA:
+        /* no layout to walk: the heap scans it for handles */
+        break;
     default:
         /* Unknown object type - skip it */
         QJS_LOGE("mark_children: unknown gc_obj_type=%d, skipping", gp->gc_obj_type);
@@ -7428,44 +7404,40 @@ static void mark_children(JSRuntime *rt, void *user_ptr,
     }
 }
 
-/* Mark an object and all its children as reachable */
-/* Wrapper for mark_func callbacks that converts user_ptr to header internally.
+/* Mark an object as reachable and queue it so its children get marked.
  * mark_func callbacks receive user_ptr (after header), not GCHeader*.
+ * This runs on the mark helper threads too, see gc_mark_begin.
  */
-static void gc_mark_recursive(JSRuntime *rt, void *user_ptr);
-
-static void gc_mark_recursive(JSRuntime *rt, void *user_ptr)
+static void gc_mark_reachable(JSRuntime *rt, void *user_ptr)
 {
-    QJS_LOGI("gc_mark_recursive: ENTER user_ptr=%p", (void*)user_ptr);
+    QJS_LOGT("gc_mark_reachable: ENTER user_ptr=%p", (void*)user_ptr);
     if (!user_ptr) {
-        QJS_LOGE("gc_mark_recursive: user_ptr is NULL!");
+        QJS_LOGT("gc_mark_reachable: user_ptr is NULL!");
         return;
     }
     /* Defensive check: user_ptr must be in valid GC heap range (relaxed for Android) */
     if (unlikely((uintptr_t)user_ptr < 0x1000 || (uintptr_t)user_ptr > 0xF000000000000000)) {
-        QJS_LOGE("gc_mark_recursive: user_ptr=%p is outside valid address range, skipping", (void*)user_ptr);
+        QJS_LOGT("gc_mark_reachable: user_ptr=%p is outside valid address range, skipping", (void*)user_ptr);
         return;
     }
     /* Check alignment - should be at least 8-byte aligned */
     if (unlikely((uintptr_t)user_ptr & 0x7)) {
-        QJS_LOGE("gc_mark_recursive: user_ptr=%p is not 8-byte aligned, skipping", (void*)user_ptr);
+        QJS_LOGT("gc_mark_reachable: user_ptr=%p is not 8-byte aligned, skipping", (void*)user_ptr);
         return;
     }
     
-    /* Get header from user_ptr */
-    GCHeader *hdr = gc_header(user_ptr);
-    
-    /* Skip objects that haven't been fully initialized yet */
-    if (hdr->gc_obj_type == 0) {
-        QJS_LOGI("gc_mark_recursive: skipping uninitialized object user_ptr=%p", (void*)user_ptr);
-        return;
-    }
-    QJS_LOGI("gc_mark_recursive: hdr->mark=%d", hdr->mark);
-    if (hdr->mark)
-        return;  /* Already marked */
-    hdr->mark = 1;
-    QJS_LOGI("gc_mark_recursive: calling mark_children");
-    mark_children(rt, user_ptr, gc_mark_recursive);
+    gc_mark_object(user_ptr);
+}
+
+static void gc_trace_object(JSRuntime *rt, void *user_ptr)
+{
+    mark_children(rt, user_ptr, gc_mark_reachable);
+}
+
+/* Atom indices in scanned memory keep their atoms alive */
+static void gc_mark_atom_word(JSRuntime *rt, uint32_t word)
+{
+    js_mark_atom(rt, word, gc_mark_reachable);
 }
 
 /* Mark all objects reachable from roots */
@@ -7473,40 +7445,40 @@ static void gc_mark_roots(JSRuntime *rt)
 {
     int i;
 
-    QJS_LOGI("gc_mark_roots: ENTER, gc_handles.count=%d", rt->gc_handles.count);
-    QJS_LOGI("gc_mark_roots: handles=%p", (void*)rt->gc_handles.handles);
+    QJS_LOGT("gc_mark_roots: ENTER");
     
     /* First, clear all marks */
-    for (i = 0; i < rt->gc_handles.count; i++) {
-        QJS_LOGI("gc_mark_roots: accessing entry %d", i);
-        GCHandle handle = rt->gc_handles.handles[i];
-        QJS_LOGI("gc_mark_roots: entry %d handle=%u", i, handle);
-        if (js_handle_array_entry_is_valid(handle)) {
-            void *user_ptr = gc_deref(handle);
-            if (user_ptr) {
-                GCHeader *hdr = gc_header(user_ptr);
-                QJS_LOGI("gc_mark_roots: clearing mark for entry %d, hdr=%p", i, (void*)hdr);
-                hdr->mark = 0;
-            }
-        }
-    }
+    gc_clear_marks();
+
+    /* Everything marked from here on is traced when gc_mark_end drains
+       the queue, on the helper threads as well for a large heap */
+    gc_mark_begin(rt, gc_trace_object);
+    gc_mark_words(rt->permanent_atom_count, rt->atom_size, gc_mark_atom_word);
+
+    /* The runtime holds the class array, the handle arrays and the atom
+       tables; the tables are precise, so they keep nothing alive */
+    gc_mark_reachable(rt, rt);
+
+    /* Handles the embedder registered, and whatever native code holds in
+       its locals: the collection may have started inside a call */
+    gc_mark_native_roots();
 
     /* Mark from contexts (roots) */
-    QJS_LOGI("gc_mark_roots: context_handles.count=%u", rt->context_handles.count);
+    QJS_LOGT("gc_mark_roots: context_handles.count=%u", rt->context_handles.count);
     for (i = 0; i < rt->context_handles.count; i++) {
         GCHandle ctx_handle = rt->context_handles.handles[i];
-        QJS_LOGI("gc_mark_roots: marking context entry %d, ctx_handle=%u", i, ctx_handle);
+        QJS_LOGT("gc_mark_roots: marking context entry %d, ctx_handle=%u", i, ctx_handle);
         if (!js_handle_array_entry_is_valid(ctx_handle)) {
-            QJS_LOGI("gc_mark_roots: context entry %d invalid, skipping", i);
+            QJS_LOGT("gc_mark_roots: context entry %d invalid, skipping", i);
             continue;
         }
         void *ctx_ptr = gc_deref(ctx_handle);
-        /* ctx_ptr is user_ptr (after header), pass directly to gc_mark_recursive */
-        gc_mark_recursive(rt, ctx_ptr);
+        /* ctx_ptr is user_ptr (after header), pass directly to gc_mark_reachable */
+        gc_mark_reachable(rt, ctx_ptr);
     }
 
     /* Mark the runtime's current_exception */
-    JS_MarkValue(rt, rt->current_exception, gc_mark_recursive);
+    JS_MarkValue(rt, rt->current_exception, gc_mark_reachable);
 
     /* Mark jobs in the job list */
     for (i = 0; i < rt->job_handles.count; i++) {
@@ -7514,253 +7486,172 @@ static void gc_mark_roots(JSRuntime *rt)
         if (!js_handle_array_entry_is_valid(job_handle)) continue;
         JSJobEntry *job = (JSJobEntry *)gc_deref(job_handle);
         if (!job) continue;
+        gc_mark_reachable(rt, job);
         /* Mark the job's realm to prevent it from being GC'd */
         if (job->realm_handle)
-            gc_mark_recursive(rt, (JSContext*)gc_deref(job->realm_handle));
+            gc_mark_reachable(rt, (JSContext*)gc_deref(job->realm_handle));
         int j;
         for(j = 0; j < job->argc; j++) {
-            JS_MarkValue(rt, job->argv[j], gc_mark_recursive);
+            JS_MarkValue(rt, job->argv[j], gc_mark_reachable);
         }
     }
     
-    /* 3-tier atom marking:
-     * Tier 1: Permanent atoms (0 to permanent_atom_count-1) are always roots
-     * Tier 2: Dynamic atoms are marked through shape references below
-     */
-    QJS_LOGI("gc_mark_roots: Tier 1 - marking %u permanent atoms", rt->permanent_atom_count);
-    for (i = 0; i < rt->permanent_atom_count && i < rt->atom_handles.count; i++) {
-        GCHandle atom_handle = rt->atom_handles.handles[i];
-        if (!js_handle_array_entry_is_valid(atom_handle)) {
-            continue;
-        }
-        void *atom = gc_deref(atom_handle);
-        if (atom && gc_ptr_is_valid(atom)) {
-            QJS_LOGI("gc_mark_roots: marking permanent atom %d, ptr=%p", i, atom);
-            gc_mark_recursive(rt, atom);
-        }
+    /* Permanent atoms are always roots. Dynamic ones live while an index
+       to them is found: in shapes, bytecode or scanned memory */
+    QJS_LOGT("gc_mark_roots: marking %u permanent atoms", rt->permanent_atom_count);
+    for (i = 0; i < rt->permanent_atom_count && i < rt->atom_size; i++) {
+        js_mark_atom(rt, i, gc_mark_reachable);
     }
-    
-    /* Tier 2: Mark atoms referenced by shapes.
-     * Dynamic atoms must be reachable through shapes to stay alive.
-     */
-    QJS_LOGI("gc_mark_roots: Tier 2 - marking atoms referenced by shapes");
-    for (i = 0; i < rt->gc_handles.count; i++) {
-        GCHandle handle = rt->gc_handles.handles[i];
-        if (!js_handle_array_entry_is_valid(handle)) continue;
-        void *user_ptr = gc_deref(handle);
-        if (!user_ptr) continue;
-        
-        GCHeader *hdr = gc_header(user_ptr);
-        if (hdr->gc_obj_type == JS_GC_OBJ_TYPE_SHAPE) {
+
+    /* Trace everything reachable from what was marked above */
+    gc_mark_end();
+}
+
+/* Tears down an unreachable object for gc_sweep_unmarked, which runs it
+   with every unreachable object still intact. Returns FALSE to keep the
+   block. Nothing reachable from it is freed here: the sweep offers
+   those objects on their own when they are unreachable too. */
+static bool gc_sweep_object(JSRuntime *rt, void *user_ptr)
+{
+    GCHeader *hdr = gc_header(user_ptr);
+
+    switch(hdr->gc_obj_type) {
+    case JS_GC_OBJ_TYPE_JS_OBJECT:
+        {
+            JSObject *p = (JSObject *)user_ptr;
+            /* embedder finalizers already ran from the handle finalizer
+               table */
+            p->free_mark = 1;
+            /* the shape and the property array go in this sweep as
+               well, the structure stays for its weak references */
+            if (p->weakref_count != 0) {
+                p->shape_handle = GC_HANDLE_NULL;
+                p->prop_handle = GC_HANDLE_NULL;
+                return FALSE;
+            }
+            return TRUE;
+        }
+    case JS_GC_OBJ_TYPE_SHAPE:
+        {
             JSShape *sh = (JSShape *)user_ptr;
-            JSShapeProperty *prs = get_shape_prop(sh);
-            int j;
-            for (j = 0; j < sh->prop_count; j++) {
-                if (prs[j].atom != JS_ATOM_NULL) {
-                    JSAtom atom_idx = prs[j].atom;
-                    if (atom_idx < rt->atom_handles.count) {
-                        GCHandle atom_handle = rt->atom_handles.handles[atom_idx];
-                        void *atom = gc_deref(atom_handle);
-                        if (atom && js_handle_array_entry_is_valid(atom_handle) && gc_ptr_is_valid(atom)) {
-                            JSAtomStruct *p = (JSAtomStruct *)atom;
-                            if (p->atom_type != JS_ATOM_TYPE_DEAD) {
-                                QJS_LOGI("gc_mark_roots: marking shape-referenced atom %d", atom_idx);
-                                gc_mark_recursive(rt, atom);
-                            }
-                        }
-                    }
-                }
+            if (sh->is_hashed) {
+                js_shape_hash_unlink(rt, sh);
+                sh->is_hashed = FALSE;
             }
+            return TRUE;
         }
+    case JS_GC_OBJ_TYPE_VAR_REF:
+        /* an open one is still listed in its frame */
+        return ((JSVarRef *)user_ptr)->is_detached;
+    case JS_GC_OBJ_TYPE_JS_STRING:
+        /* an atom goes once gc_sweep_atoms has forgotten it */
+        return ((JSString *)user_ptr)->atom_type == 0;
+    case JS_GC_OBJ_TYPE_FUNCTION_BYTECODE:
+    case JS_GC_OBJ_TYPE_ASYNC_FUNCTION:
+    case JS_GC_OBJ_TYPE_JS_STRING_ROPE:
+    case JS_GC_OBJ_TYPE_JS_BIGINT:
+    case JS_GC_OBJ_TYPE_DATA:
+        return TRUE;
+    default:
+        /* contexts and modules stay linked in the runtime's lists */
+        return FALSE;
     }
 }
 
 /* Sweep: free all unmarked objects */
 static void gc_sweep(JSRuntime *rt)
 {
-    int i;
-    void *user_ptr;
-    GCHeader *hdr;
-
-    QJS_LOGI("gc_sweep: ENTER, gc_handles.count=%d", rt->gc_handles.count);
     rt->gc_phase = JS_GC_PHASE_REMOVE_CYCLES;
-
-    /* Iterate over gc_handles and free unmarked objects */
-    for (i = 0; i < rt->gc_handles.count; i++) {
-        GCHandle handle = rt->gc_handles.handles[i];
-        QJS_LOGI("gc_sweep: entry %d, handle=%u", i, handle);
-        
-        if (!js_handle_array_entry_is_valid(handle)) {
-            QJS_LOGI("gc_sweep: entry %d invalid, skipping", i);
-            continue;
-        }
-        
-        user_ptr = gc_deref(handle);
-        if (!user_ptr) {
-            QJS_LOGI("gc_sweep: entry %d has NULL pointer, marking freed", i);
-            rt->gc_handles.handles[i] = JS_HANDLE_FREED;
-            continue;
-        }
-        
-        /* Get header from user_ptr */
-        hdr = gc_header(user_ptr);
-        
-        /* Safety check: user_ptr must point to valid memory in GC heap */
-        if (unlikely(!gc_ptr_is_valid(user_ptr))) {
-            QJS_LOGE("gc_sweep: entry %d user_ptr=%p not in GC heap, marking freed", i, (void*)user_ptr);
-            rt->gc_handles.handles[i] = JS_HANDLE_FREED;
-            continue;
-        }
-        
-        /* Additional safety: check minimum object alignment (8-byte for 64-bit) */
-        if (unlikely((uintptr_t)user_ptr & 0x7)) {
-            QJS_LOGE("gc_sweep: entry %d user_ptr=%p not 8-byte aligned, marking freed", i, (void*)user_ptr);
-            rt->gc_handles.handles[i] = JS_HANDLE_FREED;
-            continue;
-        }
-        
-        QJS_LOGI("gc_sweep: entry %d, hdr->size=%u", i, (unsigned)hdr->size);
-        
-        /* Bug #4 fix: Check if already freed via gc_free() (size == 0) */
-        if (hdr->size == 0) {
-            /* Object was already freed, just mark handle entry */
-            QJS_LOGI("gc_sweep: entry %d already freed (size=0), marking gc_handles[%d] as freed", i, i);
-            rt->gc_handles.handles[i] = JS_HANDLE_FREED;
-            continue;
-        }
-        
-        if (!hdr->mark) {
-            /* Object is unreachable - free it and mark entry as freed */
-            QJS_LOGI("gc_sweep: FREEING entry %d, user_ptr=%p, gc_obj_type=%d, marking gc_handles[%d] as freed", i, (void*)user_ptr, hdr->gc_obj_type, i);
-            free_gc_object(rt, user_ptr);
-            rt->gc_handles.handles[i] = JS_HANDLE_FREED;
-        }
-    }
-
+    gc_sweep_unmarked(rt, gc_sweep_object);
     rt->gc_phase = JS_GC_PHASE_NONE;
 }
 
-/* 3-tier atom system: Sweep dynamic atoms that are no longer referenced.
- * This runs after gc_sweep to free unmarked dynamic atoms.
- */
+/* Forget the dynamic atoms nothing marked, so that gc_sweep frees them
+   as plain strings. Runs between marking and gc_sweep. A symbol stays
+   while weak references name it. */
 static void gc_sweep_atoms(JSRuntime *rt)
 {
-    uint32_t i;
+    uint32_t i, first_free = 0;
     int freed_count = 0;
     
-    QJS_LOGI("gc_sweep_atoms: ENTER, atom_handles.count=%u, permanent_atom_count=%u", 
-             rt->atom_handles.count, rt->permanent_atom_count);
+    QJS_LOGT("gc_sweep_atoms: ENTER, atom_size=%u, permanent_atom_count=%u", 
+             rt->atom_size, rt->permanent_atom_count);
     
-    /* Phase 1: Mark unreferenced dynamic atoms as DEAD and remove from hash table */
-    for (i = rt->permanent_atom_count; i < rt->atom_handles.count; i++) {
-        GCHandle atom_handle = rt->atom_handles.handles[i];
-        if (!js_handle_array_entry_is_valid(atom_handle)) {
+    for (i = rt->permanent_atom_count; i < rt->atom_size; i++) {
+        JSAtomStruct *p;
+        if (rt_atom_array[i] == GC_HANDLE_NULL)
             continue;
-        }
-        void *atom = gc_deref(atom_handle);
-        if (!atom || !gc_ptr_is_valid(atom)) {
-            continue;  /* Skip malloc'd atoms */
-        }
-        
-        JSAtomStruct *p = (JSAtomStruct *)atom;
-        GCHeader *hdr = gc_header(atom);
-        
-        /* Skip already dead atoms */
-        if (p->atom_type == JS_ATOM_TYPE_DEAD) {
+        p = js_atom_array_get(rt, i);
+        if (!p || gc_header(p)->mark)
+            continue;
+        if (p->atom_type == JS_ATOM_TYPE_SYMBOL &&
+            p->hash != 0 && p->hash != JS_ATOM_HASH_PRIVATE)
             continue;
-        }
         
-        /* If atom is not marked, it will be freed */
-        if (!hdr->mark) {
-            /* Remove from atom_hash so it can't be looked up anymore */
-            if (p->atom_type != JS_ATOM_TYPE_SYMBOL) {
-                uint32_t h0 = p->hash & (rt->atom_hash_size - 1);
-                uint32_t idx = rt_atom_hash[h0];
-                JSAtomStruct *p1 = js_atom_array_get(rt, idx);
-                if (p1 == p) {
-                    rt_atom_hash[h0] = p1->hash_next;
-                } else if (p1 != NULL) {
-                    JSAtomStruct *p0;
-                    for(;;) {
-                        if (idx == 0) break;
-                        p0 = p1;
-                        idx = p0->hash_next;
-                        p1 = js_atom_array_get(rt, idx);
-                        if (p1 == p) {
-                            p0->hash_next = p1->hash_next;
-                            break;
-                        }
+        /* Remove from atom_hash so it can't be looked up anymore */
+        if (p->atom_type != JS_ATOM_TYPE_SYMBOL) {
+            uint32_t h0 = p->hash & (rt->atom_hash_size - 1);
+            uint32_t idx = rt_atom_hash[h0];
+            if (idx == i) {
+                rt_atom_hash[h0] = p->hash_next;
+            } else {
+                while (idx != 0) {
+                    JSAtomStruct *p0 = js_atom_array_get(rt, idx);
+                    if (p0->hash_next == i) {
+                        p0->hash_next = p->hash_next;
+                        break;
                     }
+                    idx = p0->hash_next;
                 }
             }
-            
-            /* Mark as dead so shapes know to skip it */
-            QJS_LOGI("gc_sweep_atoms: marking atom %u as DEAD", i);
-            p->atom_type = JS_ATOM_TYPE_DEAD;
-            freed_count++;
         }
-    }
-    
-    /* Phase 2: Scan all shapes and null out dead atom references */
-    for (i = 0; i < rt->gc_handles.count; i++) {
-        GCHandle handle = rt->gc_handles.handles[i];
-        if (!js_handle_array_entry_is_valid(handle)) continue;
-        void *user_ptr = gc_deref(handle);
-        if (!user_ptr) continue;
         
-        GCHeader *hdr = gc_header(user_ptr);
-        if (hdr->gc_obj_type == JS_GC_OBJ_TYPE_SHAPE) {
-            JSShape *sh = (JSShape *)user_ptr;
-            JSShapeProperty *prs = get_shape_prop(sh);
-            int j;
-            for (j = 0; j < sh->prop_count; j++) {
-                if (prs[j].atom != JS_ATOM_NULL) {
-                    JSAtom atom_idx = prs[j].atom;
-                    if (atom_idx < rt->atom_handles.count) {
-                        GCHandle atom_handle = rt->atom_handles.handles[atom_idx];
-                        if (js_handle_array_entry_is_valid(atom_handle)) {
-                            void *atom = gc_deref(atom_handle);
-                            if (!atom) continue;
-                            JSAtomStruct *p = (JSAtomStruct *)atom;
-                            if (p->atom_type == JS_ATOM_TYPE_DEAD) {
-                                QJS_LOGI("gc_sweep_atoms: nulling dead atom %u in shape %p prop %d", 
-                                         atom_idx, (void*)sh, j);
-                                prs[j].atom = JS_ATOM_NULL;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        QJS_LOGT("gc_sweep_atoms: freeing atom %u", i);
+        rt_atom_array[i] = GC_HANDLE_NULL;
+        p->atom_type = 0;
+        p->hash = 0;
+        p->hash_next = 0;
+        rt->atom_count--;
+        if (first_free == 0)
+            first_free = i;
+        freed_count++;
     }
     
-    /* Phase 3: Free dead atoms */
-    for (i = rt->permanent_atom_count; i < rt->atom_handles.count; i++) {
+    /* The entries of the forgotten atoms; their handles go with the
+       blocks in gc_sweep */
+    for (i = 0; i < rt->atom_handles.count; i++) {
         GCHandle atom_handle = rt->atom_handles.handles[i];
-        if (!js_handle_array_entry_is_valid(atom_handle)) {
-            continue;
-        }
-        void *atom = gc_deref(atom_handle);
-        if (!atom || !gc_ptr_is_valid(atom)) {
+        JSAtomStruct *p;
+        if (!js_handle_array_entry_is_valid(atom_handle))
             continue;
-        }
-        
-        JSAtomStruct *p = (JSAtomStruct *)atom;
-        if (p->atom_type == JS_ATOM_TYPE_DEAD) {
-            QJS_LOGI("gc_sweep_atoms: freeing dead atom %u", i);
-            /* Free the atom memory */
-            GCHeader *hdr = gc_header(atom);
-            hdr->size = 0;  /* Mark as freed */
+        p = gc_deref(atom_handle);
+        if (p && p->atom_type == 0 && !gc_header(p)->mark)
             rt->atom_handles.handles[i] = JS_HANDLE_FREED;
-        }
     }
     
-    QJS_LOGI("gc_sweep_atoms: freed %d dynamic atoms", freed_count);
+    /* New atoms take the freed slots before the array grows */
+    if (first_free != 0 &&
+        (rt->atom_free_index == 0 || first_free < rt->atom_free_index))
+        rt->atom_free_index = first_free;
+    
+    QJS_LOGT("gc_sweep_atoms: freed %d dynamic atoms", freed_count);
+}
+
+/* A weak structure's header handle pointed into its block, and was
+   released with it */
+static void gc_sweep_weakrefs(JSRuntime *rt)
+{
+    uint32_t i;
+    for (i = 0; i < rt->weakref_handles.count; i++) {
+        GCHandle handle = rt->weakref_handles.handles[i];
+        if (js_handle_array_entry_is_valid(handle) && !gc_deref(handle))
+            rt->weakref_handles.handles[i] = JS_HANDLE_FREED;
+    }
 }
 
 static void JS_RunGCInternal(JSRuntime *rt, BOOL remove_weak_objects)
 {
-    QJS_LOGE("JS_RunGCInternal: ENTER rt=%p", (void*)rt);
+    QJS_LOGT("JS_RunGCInternal: ENTER rt=%p", (void*)rt);
     if (!rt) {
         QJS_LOGE("JS_RunGCInternal: rt is NULL!");
         return;
@@ -7769,43 +7660,78 @@ static void JS_RunGCInternal(JSRuntime *rt, BOOL remove_weak_objects)
         /* free the weakly referenced object or symbol structures, delete
            the associated Map/Set entries and queue the finalization
            registry callbacks. */
-        QJS_LOGE("JS_RunGCInternal: removing weak objects...");
+        QJS_LOGT("JS_RunGCInternal: removing weak objects...");
         gc_remove_weak_objects(rt);
-        QJS_LOGE("JS_RunGCInternal: weak objects removed");
+        QJS_LOGT("JS_RunGCInternal: weak objects removed");
     }
 
-    QJS_LOGE("JS_RunGCInternal: about to mark roots...");
+    QJS_LOGT("JS_RunGCInternal: about to mark roots...");
     /* Mark phase: mark all reachable objects from roots */
     gc_mark_roots(rt);
-    QJS_LOGE("JS_RunGCInternal: roots marked");
+    QJS_LOGT("JS_RunGCInternal: roots marked");
 
-    QJS_LOGE("JS_RunGCInternal: about to sweep...");
+    /* Unmarked dynamic atoms become plain strings for the sweep */
+    gc_sweep_atoms(rt);
+    QJS_LOGT("JS_RunGCInternal: atoms swept");
+
+    QJS_LOGT("JS_RunGCInternal: about to sweep...");
     /* Sweep phase: free all unmarked objects */
     gc_sweep(rt);
-    QJS_LOGE("JS_RunGCInternal: sweep complete");
-    
-    QJS_LOGE("JS_RunGCInternal: about to sweep atoms...");
-    /* 3-tier atom system: sweep dynamic atoms that are no longer referenced */
-    gc_sweep_atoms(rt);
-    QJS_LOGE("JS_RunGCInternal: atoms swept");
+    gc_sweep_weakrefs(rt);
+    QJS_LOGT("JS_RunGCInternal: sweep complete");
 
-    QJS_LOGE("JS_RunGCInternal: about to compact handle arrays...");
+    QJS_LOGT("JS_RunGCInternal: about to compact handle arrays...");
     /* Compact handle arrays to remove NULL entries (like stack allocator) */
     js_compact_all_handle_arrays(rt);
-    QJS_LOGE("JS_RunGCInternal: handle arrays compacted");
+    QJS_LOGT("JS_RunGCInternal: handle arrays compacted");
     
-    QJS_LOGE("JS_RunGCInternal: EXIT");
+    QJS_LOGT("JS_RunGCInternal: EXIT");
+}
+
+/* The heap filled up inside an allocation, see gc_alloc_ex. The marker
+   scans the native stack, so whatever the caller holds survives. The
+   atoms stay: a function being compiled names them from a buffer the
+   scan cannot read. Weak references are left for the next full
+   collection, which may queue jobs, and the handle arrays are not
+   compacted under a caller that may be walking them. */
+static void js_gc_exhausted(JSRuntime *rt)
+{
+    if (rt->gc_disabled || rt->gc_phase != JS_GC_PHASE_NONE)
+        return;
+    QJS_LOGI("js_gc_exhausted: heap full, collecting");
+    gc_collection_begin();
+    gc_mark_roots(rt);
+    gc_sweep(rt);
+    gc_sweep_weakrefs(rt);
+    gc_collection_end(gc_allocated_bytes());
+}
+
+/* Collect if enough has been allocated since the last collection. Runs
+   between calls, where weak references can be cleared and jobs queued;
+   a heap that fills between two of these collects in js_gc_exhausted. */
+BOOL JS_MaybeRunGC(JSRuntime *rt)
+{
+    if (!rt || rt->current_stack_frame || rt->gc_phase != JS_GC_PHASE_NONE)
+        return FALSE;
+    if (!gc_should_run())
+        return FALSE;
+    gc_collection_begin();
+    JS_RunGCInternal(rt, TRUE);
+    gc_collection_end(gc_allocated_bytes());
+    return TRUE;
 }
 
 void JS_RunGC(JSRuntime *rt)
 {
-    QJS_LOGI("JS_RunGC: ENTER rt=%p", (void*)rt);
+    QJS_LOGD("JS_RunGC: ENTER rt=%p", (void*)rt);
     if (!rt) {
         QJS_LOGE("JS_RunGC: rt is NULL!");
         return;
     }
+    gc_collection_begin();
     JS_RunGCInternal(rt, TRUE);
-    QJS_LOGI("JS_RunGC: returned");
+    gc_collection_end(gc_allocated_bytes());
+    QJS_LOGD("JS_RunGC: returned");
 }
 
 /* Return false if not an object or if the object has already been
@@ -10201,7 +10127,7 @@ static JSProperty *add_property(JSContext *ctx,
 {
     JSShape *sh, *new_sh;
 
-    QJS_LOGE("add_property: ENTER p=%p prop=%d", (void*)p, prop);
+    QJS_LOGT("add_property: ENTER p=%p prop=%d", (void*)p, prop);
     if (!p) {
         QJS_LOGE("add_property: ERROR - p is NULL!");
         return GC_HANDLE_NULL;
@@ -10210,7 +10136,7 @@ static JSProperty *add_property(JSContext *ctx,
         QJS_LOGE("add_property: ERROR - p is invalid %p!", (void*)p);
         return GC_HANDLE_NULL;
     }
-    QJS_LOGE("add_property: GC_SHAPE_DEREF(p->shape_handle)=%p", (void*)GC_SHAPE_DEREF(p->shape_handle));
+    QJS_LOGT("add_property: GC_SHAPE_DEREF(p->shape_handle)=%p", (void*)GC_SHAPE_DEREF(p->shape_handle));
     if (!GC_SHAPE_DEREF(p->shape_handle)) {
         QJS_LOGE("add_property: ERROR - GC_SHAPE_DEREF(p->shape_handle) is NULL!");
         return GC_HANDLE_NULL;
@@ -10709,15 +10635,15 @@ int JS_SetPropertyInternal(JSContext *ctx, GCValue obj,
     JSPropertyDescriptor desc;
     int ret;
     
-    QJS_LOGE("JS_SetPropertyInternal: ENTER prop=%d", prop);
-    QJS_LOGE("JS_SetPropertyInternal: obj tag=%u this_obj tag=%u", 
+    QJS_LOGT("JS_SetPropertyInternal: ENTER prop=%d", prop);
+    QJS_LOGT("JS_SetPropertyInternal: obj tag=%u this_obj tag=%u", 
              (unsigned)JS_VALUE_GET_TAG(obj), (unsigned)JS_VALUE_GET_TAG(this_obj));
     
     /* DIAGNOSTIC: Check object shape before processing */
     if (JS_VALUE_GET_TAG(this_obj) == JS_TAG_OBJECT) {
         JSObject *p_check = JS_VALUE_GET_OBJ(this_obj);
         if (p_check) {
-            QJS_LOGE("JS_SetPropertyInternal: obj=%p shape=%p", (void*)p_check, (void*)GC_SHAPE_DEREF(p_check->shape_handle));
+            QJS_LOGT("JS_SetPropertyInternal: obj=%p shape=%p", (void*)p_check, (void*)GC_SHAPE_DEREF(p_check->shape_handle));
             if (GC_SHAPE_DEREF(p_check->shape_handle) == (JSShape*)-1 || GC_SHAPE_DEREF(p_check->shape_handle) == NULL || (uintptr_t)GC_SHAPE_DEREF(p_check->shape_handle) < 0x1000) {
                 QJS_LOGE("JS_SetPropertyInternal: CORRUPTED SHAPE DETECTED! obj=%p shape=%p prop=%d", 
                          (void*)p_check, (void*)GC_SHAPE_DEREF(p_check->shape_handle), prop);
@@ -10729,59 +10655,59 @@ int JS_SetPropertyInternal(JSContext *ctx, GCValue obj,
     printf("JS_SetPropertyInternal: "); print_atom(ctx, prop); printf("\n");
 #endif
     tag = JS_VALUE_GET_TAG(this_obj);
-    QJS_LOGE("JS_SetPropertyInternal: tag=%u JS_TAG_OBJECT=%d", (unsigned)tag, JS_TAG_OBJECT);
+    QJS_LOGT("JS_SetPropertyInternal: tag=%u JS_TAG_OBJECT=%d", (unsigned)tag, JS_TAG_OBJECT);
     if (unlikely(tag != JS_TAG_OBJECT)) {
-        QJS_LOGE("JS_SetPropertyInternal: not an object (tag=%u != %d), checking obj tag", (unsigned)tag, JS_TAG_OBJECT);
+        QJS_LOGT("JS_SetPropertyInternal: not an object (tag=%u != %d), checking obj tag", (unsigned)tag, JS_TAG_OBJECT);
         uint32_t obj_tag = JS_VALUE_GET_TAG(obj);
-        QJS_LOGE("JS_SetPropertyInternal: obj_tag=%u", (unsigned)obj_tag);
+        QJS_LOGT("JS_SetPropertyInternal: obj_tag=%u", (unsigned)obj_tag);
         if (obj_tag == JS_TAG_OBJECT) {
-            QJS_LOGE("JS_SetPropertyInternal: obj is object, going to prototype_lookup");
+            QJS_LOGT("JS_SetPropertyInternal: obj is object, going to prototype_lookup");
             p = NULL;
             p1 = JS_VALUE_GET_OBJ(obj);
             goto prototype_lookup;
         } else {
-            QJS_LOGE("JS_SetPropertyInternal: obj is not object (tag=%u), switch on this_obj tag", (unsigned)obj_tag);
+            QJS_LOGT("JS_SetPropertyInternal: obj is not object (tag=%u), switch on this_obj tag", (unsigned)obj_tag);
             switch(tag) {
             case JS_TAG_NULL:
-                QJS_LOGE("JS_SetPropertyInternal: tag is NULL, throwing error");
+                QJS_LOGT("JS_SetPropertyInternal: tag is NULL, throwing error");
                 JS_ThrowTypeErrorAtom(ctx, "cannot set property '%s' of null", prop);
                 return -1;
             case JS_TAG_UNDEFINED:
-                QJS_LOGE("JS_SetPropertyInternal: tag is UNDEFINED, throwing error");
+                QJS_LOGT("JS_SetPropertyInternal: tag is UNDEFINED, throwing error");
                 JS_ThrowTypeErrorAtom(ctx, "cannot set property '%s' of undefined", prop);
                 return -1;
             default:
-                QJS_LOGE("JS_SetPropertyInternal: default case, calling JS_GetPrototypePrimitive");
+                QJS_LOGT("JS_SetPropertyInternal: default case, calling JS_GetPrototypePrimitive");
                 /* even on a primitive type we can have setters on the prototype */
                 p = NULL;
                 p1 = JS_VALUE_GET_OBJ(JS_GetPrototypePrimitive(ctx, obj));
-                QJS_LOGE("JS_SetPropertyInternal: JS_GetPrototypePrimitive returned p1=%p", (void*)p1);
+                QJS_LOGT("JS_SetPropertyInternal: JS_GetPrototypePrimitive returned p1=%p", (void*)p1);
                 goto prototype_lookup;
             }
         }
     } else {
-        QJS_LOGE("JS_SetPropertyInternal: getting objects from values");
+        QJS_LOGT("JS_SetPropertyInternal: getting objects from values");
         p = JS_VALUE_GET_OBJ(this_obj);
         p1 = JS_VALUE_GET_OBJ(obj);
-        QJS_LOGE("JS_SetPropertyInternal: p=%p p1=%p", (void*)p, (void*)p1);
+        QJS_LOGT("JS_SetPropertyInternal: p=%p p1=%p", (void*)p, (void*)p1);
         if (unlikely(p != p1))
             goto retry2;
     }
 
     /* fast path if obj == this_obj */
  retry:
-    QJS_LOGE("JS_SetPropertyInternal: calling find_own_property p1=%p prop=%d", (void*)p1, prop);
+    QJS_LOGT("JS_SetPropertyInternal: calling find_own_property p1=%p prop=%d", (void*)p1, prop);
     prs = find_own_property(&pr, p1, prop);
-    QJS_LOGE("JS_SetPropertyInternal: find_own_property returned prs=%p pr=%p", (void*)prs, (void*)pr);
+    QJS_LOGT("JS_SetPropertyInternal: find_own_property returned prs=%p pr=%p", (void*)prs, (void*)pr);
     if (prs) {
-        QJS_LOGE("JS_SetPropertyInternal: prs is non-null, checking flags prs->flags=0x%x", prs ? prs->flags : 0);
+        QJS_LOGT("JS_SetPropertyInternal: prs is non-null, checking flags prs->flags=0x%x", prs ? prs->flags : 0);
         uint32_t flag_check = prs->flags & (JS_PROP_TMASK | JS_PROP_WRITABLE | JS_PROP_LENGTH);
-        QJS_LOGE("JS_SetPropertyInternal: flag_check=0x%x JS_PROP_WRITABLE=0x%x", flag_check, JS_PROP_WRITABLE);
+        QJS_LOGT("JS_SetPropertyInternal: flag_check=0x%x JS_PROP_WRITABLE=0x%x", flag_check, JS_PROP_WRITABLE);
         if (likely(flag_check == JS_PROP_WRITABLE)) {
             /* fast case */
-            QJS_LOGE("JS_SetPropertyInternal: fast path, pr=%p pr->u.value=...", (void*)pr);
+            QJS_LOGT("JS_SetPropertyInternal: fast path, pr=%p pr->u.value=...", (void*)pr);
             set_value(ctx, &pr->u.value, val);
-            QJS_LOGE("JS_SetPropertyInternal: fast path done");
+            QJS_LOGT("JS_SetPropertyInternal: fast path done");
             return TRUE;
         } else if (prs->flags & JS_PROP_LENGTH) {
             assert(p->class_id == JS_CLASS_ARRAY);
@@ -10809,10 +10735,10 @@ int JS_SetPropertyInternal(JSContext *ctx, GCValue obj,
             goto read_only_prop;
         }
     }
-    QJS_LOGE("JS_SetPropertyInternal: property not found, entering for loop p1=%p", (void*)p1);
+    QJS_LOGT("JS_SetPropertyInternal: property not found, entering for loop p1=%p", (void*)p1);
 
     for(;;) {
-        QJS_LOGE("JS_SetPropertyInternal: checking p1->is_exotic=%d", p1 ? p1->is_exotic : -1);
+        QJS_LOGT("JS_SetPropertyInternal: checking p1->is_exotic=%d", p1 ? p1->is_exotic : -1);
         if (p1->is_exotic) {
             if (p1->fast_array) {
                 if (__JS_AtomIsTaggedInt(prop)) {
@@ -10907,9 +10833,9 @@ int JS_SetPropertyInternal(JSContext *ctx, GCValue obj,
                 }
             }
         }
-        QJS_LOGE("JS_SetPropertyInternal: accessing GC_SHAPE_DEREF(p1->shape_handle) p1=%p shape=%p", (void*)p1, (void*)(p1 ? GC_SHAPE_DEREF(p1->shape_handle) : NULL));
+        QJS_LOGT("JS_SetPropertyInternal: accessing GC_SHAPE_DEREF(p1->shape_handle) p1=%p shape=%p", (void*)p1, (void*)(p1 ? GC_SHAPE_DEREF(p1->shape_handle) : NULL));
         p1 = gc_deref(GC_SHAPE_DEREF(p1->shape_handle)->proto_handle);
-        QJS_LOGE("JS_SetPropertyInternal: got proto p1=%p", (void*)p1);
+        QJS_LOGT("JS_SetPropertyInternal: got proto p1=%p", (void*)p1);
     prototype_lookup:
         if (!p1)
             break;
@@ -11437,23 +11363,23 @@ int JS_DefineProperty(JSContext *ctx, GCValue this_obj,
     GCValue val = val_const;  /* Make a mutable copy */
 
     /* Debug: Log this_obj value */
-    QJS_LOGE("JS_DefineProperty: ENTRY this_obj tag=%d", 
+    QJS_LOGT("JS_DefineProperty: ENTRY this_obj tag=%d", 
              JS_VALUE_GET_TAG(this_obj));
 
     if (JS_VALUE_GET_TAG(this_obj) != JS_TAG_OBJECT) {
         JS_ThrowTypeErrorNotAnObject(ctx);
         return -1;
     }
-    QJS_LOGE("JS_DefineProperty: tag check passed");
+    QJS_LOGT("JS_DefineProperty: tag check passed");
     p = JS_VALUE_GET_OBJ(this_obj);
-    QJS_LOGE("JS_DefineProperty: got obj p=%p", (void*)p);
+    QJS_LOGT("JS_DefineProperty: got obj p=%p", (void*)p);
     if (!p) {
         QJS_LOGE("JS_DefineProperty: p is NULL!");
         return -1;
     }
 
  redo_prop_update:
-    QJS_LOGE("JS_DefineProperty: calling find_own_property p=%p prop=%d", (void*)p, prop);
+    QJS_LOGT("JS_DefineProperty: calling find_own_property p=%p prop=%d", (void*)p, prop);
     prs = find_own_property(&pr, p, prop);
     if (prs) {
         /* the range of the Array length property is always tested before */
@@ -12105,6 +12031,13 @@ void JS_SetUncatchableException(JSContext *ctx, BOOL flag)
     ctx_rt->current_exception_is_uncatchable = flag;
 }
 
+BOOL JS_IsUncatchableException(JSContext *ctx)
+{
+    JSRuntime *rt = ctx_rt;
+    return !JS_IsUninitialized(rt->current_exception) &&
+        rt->current_exception_is_uncatchable;
+}
+
 void JS_SetOpaque(GCValue obj, void *opaque)
 {
    JSObject *p;
@@ -18879,16 +18812,8 @@ static GCValue JS_CallInternal(JSContext *caller_ctx, GCValue func_obj,
     JSVarRef **var_refs;
     size_t alloca_size;
 
-#define GC_INSTRUCTION_THRESHOLD 100
-
 #if !DIRECT_DISPATCH
-#define SWITCH(pc)      do { \
-        if (++rt->instruction_counter >= GC_INSTRUCTION_THRESHOLD) { \
-            rt->instruction_counter = 0; \
-            gc_run(); \
-        } \
-    } while(0); \
-    switch (opcode = *pc++)
+#define SWITCH(pc)      switch (opcode = *pc++)
 #define CASE(op)        case op
 #define DEFAULT         default
 #define BREAK           break
@@ -18903,18 +18828,14 @@ static GCValue JS_CallInternal(JSContext *caller_ctx, GCValue func_obj,
 #include "quickjs-opcode.h"
         [ OP_COUNT ... 255 ] = &&case_default
     };
-#define SWITCH(pc)      do { \
-        if (++rt->instruction_counter >= GC_INSTRUCTION_THRESHOLD) { \
-            rt->instruction_counter = 0; \
-            gc_run(); \
-        } \
-    } while(0); \
-    goto *dispatch_table[opcode = *pc++];
+#define SWITCH(pc)      goto *dispatch_table[opcode = *pc++];
 #define CASE(op)        case_ ## op
 #define DEFAULT         case_default
 #define BREAK           SWITCH(pc)
 #endif
 
+    if (js_poll_interrupts(caller_ctx, rt))
+        return JS_EXCEPTION;
     if (unlikely(JS_VALUE_GET_TAG(func_obj) != JS_TAG_OBJECT)) {
         if (flags & JS_CALL_FLAG_GENERATOR) {
             JSAsyncFunctionState *s = JS_VALUE_GET_PTR(func_obj);
@@ -19961,13 +19882,19 @@ static GCValue JS_CallInternal(JSContext *caller_ctx, GCValue func_obj,
 
         CASE(OP_goto):
             pc += (int32_t)get_u32(pc);
+            if (unlikely(js_poll_interrupts(ctx, rt)))
+                goto exception;
             BREAK;
 #if SHORT_OPCODES
         CASE(OP_goto16):
             pc += (int16_t)get_u16(pc);
+            if (unlikely(js_poll_interrupts(ctx, rt)))
+                goto exception;
             BREAK;
         CASE(OP_goto8):
             pc += (int8_t)pc[0];
+            if (unlikely(js_poll_interrupts(ctx, rt)))
+                goto exception;
             BREAK;
 #endif
         CASE(OP_if_true):
@@ -19986,6 +19913,8 @@ static GCValue JS_CallInternal(JSContext *caller_ctx, GCValue func_obj,
                 if (res) {
                     pc += (int32_t)get_u32(pc - 4) - 4;
                 }
+                if (unlikely(js_poll_interrupts(ctx, rt)))
+                    goto exception;
             }
             BREAK;
         CASE(OP_if_false):
@@ -20005,6 +19934,8 @@ static GCValue JS_CallInternal(JSContext *caller_ctx, GCValue func_obj,
                 if (!res) {
                     pc += (int32_t)get_u32(pc - 4) - 4;
                 }
+                if (unlikely(js_poll_interrupts(ctx, rt)))
+                    goto exception;
             }
             BREAK;
 #if SHORT_OPCODES
@@ -20024,6 +19955,8 @@ static GCValue JS_CallInternal(JSContext *caller_ctx, GCValue func_obj,
                 if (res) {
                     pc += (int8_t)pc[-1] - 1;
                 }
+                if (unlikely(js_poll_interrupts(ctx, rt)))
+                    goto exception;
             }
             BREAK;
         CASE(OP_if_false8):
@@ -20042,6 +19975,8 @@ static GCValue JS_CallInternal(JSContext *caller_ctx, GCValue func_obj,
                 if (!res) {
                     pc += (int8_t)pc[-1] - 1;
                 }
+                if (unlikely(js_poll_interrupts(ctx, rt)))
+                    goto exception;
             }
             BREAK;
 #endif
@@ -33290,6 +33225,36 @@ static void free_bytecode_atoms(JSRuntime *rt,
     }
 }
 
+/* Same walk as free_bytecode_atoms, for the collector. Only finished
+   bytecode is walked, which always uses the short opcodes. */
+static void mark_bytecode_atoms(JSRuntime *rt,
+                                const uint8_t *bc_buf, int bc_len,
+                                JS_MarkFunc *mark_func)
+{
+    int pos, op;
+    const JSOpCode *oi;
+
+    pos = 0;
+    while (pos < bc_len) {
+        op = bc_buf[pos];
+        oi = &short_opcode_info(op);
+        switch(oi->fmt) {
+        case OP_FMT_atom:
+        case OP_FMT_atom_u8:
+        case OP_FMT_atom_u16:
+        case OP_FMT_atom_label_u8:
+        case OP_FMT_atom_label_u16:
+            if ((pos + 1 + 4) > bc_len)
+                break;
+            js_mark_atom(rt, get_u32(bc_buf + pos + 1), mark_func);
+            break;
+        default:
+            break;
+        }
+        pos += oi->size;
+    }
+}
+
 static void js_free_function_def(JSContext *ctx, JSFunctionDef *fd)
 {
     int i;
@@ -40680,11 +40645,11 @@ static JSAtom find_atom(JSContext *ctx, const char *name)
             QJS_LOGE("find_atom: atom_array is NULL!");
             return JS_ATOM_NULL;
         }
-        QJS_LOGI("find_atom: searching for symbol '%s' (len=%d) range=[%d, %d)", name, len, JS_ATOM_Symbol_toPrimitive, JS_ATOM_END);
+        QJS_LOGT("find_atom: searching for symbol '%s' (len=%d) range=[%d, %d)", name, len, JS_ATOM_Symbol_toPrimitive, JS_ATOM_END);
         for(atom = JS_ATOM_Symbol_toPrimitive; atom < JS_ATOM_END; atom++) {
             JSAtomStruct *p = js_atom_array_get(ctx_rt, atom);
             if (!p) {
-                QJS_LOGI("find_atom: atom %d is NULL", atom);
+                QJS_LOGT("find_atom: atom %d is NULL", atom);
                 continue;  /* Skip null atoms */
             }
             if ((uintptr_t)p < 0x10000) {
@@ -40692,7 +40657,7 @@ static JSAtom find_atom(JSContext *ctx, const char *name)
                 return JS_ATOM_NULL;
             }
             JSString *str = p;
-            QJS_LOGI("find_atom: atom %d: type=%d len=%d is_wide=%d str8=%p", atom, str->atom_type, str->len, str->is_wide_char, str->u.str8);
+            QJS_LOGT("find_atom: atom %d: type=%d len=%d is_wide=%d str8=%p", atom, str->atom_type, str->len, str->is_wide_char, str->u.str8);
             /* Check if 8-bit string and lengths match */
             if (!str->is_wide_char && str->len == len) {
                 /* Print full hex dump */
@@ -40705,9 +40670,9 @@ static JSAtom find_atom(JSContext *ctx, const char *name)
                 }
                 atom_hex[pos*3] = 0; name_hex[pos*3] = 0;
                 int cmp = memcmp(str->u.str8, name, len);
-                QJS_LOGI("find_atom: atom %d len=%d cmp=%d", atom, str->len, cmp);
-                QJS_LOGI("find_atom: atom hex: %s", atom_hex);
-                QJS_LOGI("find_atom: name hex: %s", name_hex);
+                QJS_LOGT("find_atom: atom %d len=%d cmp=%d", atom, str->len, cmp);
+                QJS_LOGT("find_atom: atom hex: %s", atom_hex);
+                QJS_LOGT("find_atom: name hex: %s", name_hex);
                 /* Safe to access str8 */
                 if (cmp == 0)
                     return JS_DupAtom(ctx, atom);
@@ -40717,11 +40682,11 @@ static JSAtom find_atom(JSContext *ctx, const char *name)
         /* This allows the caller to handle the error gracefully */
         return JS_ATOM_NULL;
     } else {
-        QJS_LOGE("find_atom: calling JS_NewAtom for '%s'", name);
+        QJS_LOGT("find_atom: calling JS_NewAtom for '%s'", name);
         atom = JS_NewAtom(ctx, name);
-        QJS_LOGE("find_atom: JS_NewAtom returned %d for '%s'", atom, name);
+        QJS_LOGT("find_atom: JS_NewAtom returned %d for '%s'", atom, name);
     }
-    QJS_LOGE("find_atom: returning atom %d for '%s'", atom, name);
+    QJS_LOGT("find_atom: returning atom %d for '%s'", atom, name);
     return atom;
 }
 
@@ -40795,9 +40760,9 @@ static int JS_InstantiateFunctionListItem(JSContext *ctx, GCValue obj,
     switch(e->def_type) {
     case JS_DEF_ALIAS: /* using autoinit for aliases is not safe */
         {
-            QJS_LOGE("JS_InstantiateFunctionListItem: JS_DEF_ALIAS for atom=%d", atom);
+            QJS_LOGT("JS_InstantiateFunctionListItem: JS_DEF_ALIAS for atom=%d", atom);
             JSAtom atom1 = find_atom(ctx, e->u.alias.name);
-            QJS_LOGE("JS_InstantiateFunctionListItem: alias find_atom returned %d", atom1);
+            QJS_LOGT("JS_InstantiateFunctionListItem: alias find_atom returned %d", atom1);
             if (atom1 == JS_ATOM_NULL) {
                 return -1;
             }
@@ -40806,7 +40771,7 @@ static int JS_InstantiateFunctionListItem(JSContext *ctx, GCValue obj,
                 JS_FreeAtom(ctx, atom1);
                 return -1;
             }
-            QJS_LOGE("JS_InstantiateFunctionListItem: calling JS_GetProperty base=%d", e->u.alias.base);
+            QJS_LOGT("JS_InstantiateFunctionListItem: calling JS_GetProperty base=%d", e->u.alias.base);
             /* Safety check: ensure object is valid before calling JS_GetProperty */
             switch (e->u.alias.base) {
             case -1:
@@ -40831,9 +40796,9 @@ static int JS_InstantiateFunctionListItem(JSContext *ctx, GCValue obj,
                 {
                     /* Debug: verify global_obj is valid */
                     JSObject *p = JS_VALUE_GET_OBJ(ctx->global_obj);
-                    QJS_LOGE("JS_InstantiateFunctionListItem: global_obj=%p shape=%p", (void*)p, (void*)GC_SHAPE_DEREF(p->shape_handle));
+                    QJS_LOGT("JS_InstantiateFunctionListItem: global_obj=%p shape=%p", (void*)p, (void*)GC_SHAPE_DEREF(p->shape_handle));
                     if (GC_SHAPE_DEREF(p->shape_handle)) {
-                        QJS_LOGE("JS_InstantiateFunctionListItem: shape->prop_hash_mask=%u prop_count=%d", 
+                        QJS_LOGT("JS_InstantiateFunctionListItem: shape->prop_hash_mask=%u prop_count=%d", 
                                  GC_SHAPE_DEREF(p->shape_handle)->prop_hash_mask, GC_SHAPE_DEREF(p->shape_handle)->prop_count);
                     }
                     val = JS_GetProperty(ctx, ctx->global_obj, atom1);
@@ -40853,16 +40818,16 @@ static int JS_InstantiateFunctionListItem(JSContext *ctx, GCValue obj,
                 JS_FreeAtom(ctx, atom1);
                 return -1;
             }
-            QJS_LOGE("JS_InstantiateFunctionListItem: JS_GetProperty returned");
-            QJS_LOGE("JS_InstantiateFunctionListItem: calling JS_FreeAtom atom1=%d", atom1);
+            QJS_LOGT("JS_InstantiateFunctionListItem: JS_GetProperty returned");
+            QJS_LOGT("JS_InstantiateFunctionListItem: calling JS_FreeAtom atom1=%d", atom1);
             JS_FreeAtom(ctx, atom1);
-            QJS_LOGE("JS_InstantiateFunctionListItem: JS_FreeAtom done");
-            QJS_LOGE("JS_InstantiateFunctionListItem: checking JS_IsException");
+            QJS_LOGT("JS_InstantiateFunctionListItem: JS_FreeAtom done");
+            QJS_LOGT("JS_InstantiateFunctionListItem: checking JS_IsException");
             if (JS_IsException(val)) {
-                QJS_LOGE("JS_InstantiateFunctionListItem: JS_IsException true");
+                QJS_LOGT("JS_InstantiateFunctionListItem: JS_IsException true");
                 return -1;
             }
-            QJS_LOGE("JS_InstantiateFunctionListItem: checking atom %d", atom);
+            QJS_LOGT("JS_InstantiateFunctionListItem: checking atom %d", atom);
             if (atom == JS_ATOM_Symbol_toPrimitive) {
                 /* Symbol.toPrimitive functions are not writable */
                 prop_flags = JS_PROP_CONFIGURABLE;
@@ -40972,18 +40937,18 @@ int JS_SetPropertyFunctionList(JSContext *ctx, GCValue obj,
                                const JSCFunctionListEntry *tab, int len)
 {
     int i, ret;
-    QJS_LOGI("JS_SetPropertyFunctionList: START len=%d", len);
+    QJS_LOGT("JS_SetPropertyFunctionList: START len=%d", len);
     for(i = 0; i < len; i++) {
         const JSCFunctionListEntry *e = &tab[i];
-        QJS_LOGE("JS_SetProp: [%d/%d] name='%s'", i, len, e->name);
+        QJS_LOGT("JS_SetProp: [%d/%d] name='%s'", i, len, e->name);
         JSAtom atom = find_atom(ctx, e->name);
         if (atom == JS_ATOM_NULL) {
             QJS_LOGE("JS_SetPropertyFunctionList: find_atom NULL for '%s'", e->name);
             return -1;
         }
-        QJS_LOGE("JS_SetProp: calling JS_InstantiateFunctionListItem for '%s' atom=%d", e->name, atom);
+        QJS_LOGT("JS_SetProp: calling JS_InstantiateFunctionListItem for '%s' atom=%d", e->name, atom);
         ret = JS_InstantiateFunctionListItem(ctx, obj, atom, e);
-        QJS_LOGE("JS_SetProp: JS_InstantiateFunctionListItem returned %d for '%s'", ret, e->name);
+        QJS_LOGT("JS_SetProp: JS_InstantiateFunctionListItem returned %d for '%s'", ret, e->name);
         JS_FreeAtom(ctx, atom);
         if (ret)
             return -1;
@@ -41085,7 +41050,7 @@ static GCValue JS_NewCConstructor(JSContext *ctx, int class_id, const char *name
     GCValue ctor = JS_UNDEFINED, proto, parent_proto;
     int proto_class_id, proto_flags, ctor_flags;
 
-    QJS_LOGI("JS_NewCConstructor: START name=%s class_id=%d", name, class_id);
+    QJS_LOGT("JS_NewCConstructor: START name=%s class_id=%d", name, class_id);
 
     proto_flags = 0;
     if (flags & JS_NEW_CTOR_READONLY) {
@@ -41113,7 +41078,7 @@ static GCValue JS_NewCConstructor(JSContext *ctx, int class_id, const char *name
         else
             proto_class_id = JS_CLASS_OBJECT;
         /* one additional field: constructor */
-        QJS_LOGI("JS_NewCConstructor: Creating proto for %s...", name);
+        QJS_LOGT("JS_NewCConstructor: Creating proto for %s...", name);
         proto = JS_NewObjectProtoClassAlloc(ctx, parent_proto, proto_class_id,
                                             n_proto_fields + 1);
         if (JS_IsException(proto)) {
@@ -41123,27 +41088,27 @@ static GCValue JS_NewCConstructor(JSContext *ctx, int class_id, const char *name
         if (class_id >= 0)
             ctx_class_proto[class_id] = proto;
     }
-    QJS_LOGI("JS_NewCConstructor: Setting proto properties for %s...", name);
+    QJS_LOGT("JS_NewCConstructor: Setting proto properties for %s...", name);
     if (JS_SetPropertyFunctionList(ctx, proto, proto_fields, n_proto_fields)) {
         QJS_LOGE("JS_NewCConstructor: proto fields failed for %s", name);
         goto fail;
     }
 
     /* additional fields: name, length, prototype */
-    QJS_LOGI("JS_NewCConstructor: Creating ctor function for %s...", name);
+    QJS_LOGT("JS_NewCConstructor: Creating ctor function for %s...", name);
     ctor = JS_NewCFunction3(ctx, func, name, length, cproto, magic, parent_ctor,
                             n_ctor_fields + 3);
     if (JS_IsException(ctor)) {
         QJS_LOGE("JS_NewCConstructor: ctor function failed for %s", name);
         goto fail;
     }
-    QJS_LOGI("JS_NewCConstructor: Setting ctor properties for %s...", name);
+    QJS_LOGT("JS_NewCConstructor: Setting ctor properties for %s...", name);
     if (JS_SetPropertyFunctionList(ctx, ctor, ctor_fields, n_ctor_fields)) {
         QJS_LOGE("JS_NewCConstructor: ctor fields failed for %s", name);
         goto fail;
     }
     if (!(flags & JS_NEW_CTOR_NO_GLOBAL)) {
-        QJS_LOGI("JS_NewCConstructor: Defining global property for %s...", name);
+        QJS_LOGT("JS_NewCConstructor: Defining global property for %s...", name);
         if (JS_DefinePropertyValueStr(ctx, ctx->global_obj, name,
                                       ctor,
                                       JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE) < 0) {
@@ -41153,7 +41118,7 @@ static GCValue JS_NewCConstructor(JSContext *ctx, int class_id, const char *name
     }
     JS_SetConstructor2(ctx, ctor, proto, proto_flags, ctor_flags);
 
-    QJS_LOGI("JS_NewCConstructor: SUCCESS for %s", name);
+    QJS_LOGT("JS_NewCConstructor: SUCCESS for %s", name);
     return ctor;
  fail:
     
@@ -52878,6 +52843,9 @@ static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
     mr = (JSMapRecord *)gc_deref(mr_handle);
     if (!mr)
         return GC_HANDLE_NULL;
+    /* the key is weak, js_map_mark marks the value */
+    if (s->is_weak)
+        gc_set_precise(mr_handle);
     mr->ref_count = 1;
     mr->empty = FALSE;
     if (s->is_weak) {
@@ -53345,6 +53313,8 @@ static void js_map_mark(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func)
     if (s) {
         list_for_each(el, &s->records) {
             mr = list_entry(el, JSMapRecord, link);
+            /* weak records are not scanned, so the list is not followed */
+            mark_func(rt, mr);
             if (!s->is_weak)
                 JS_MarkValue(rt, mr->key, mark_func);
             JS_MarkValue(rt, mr->value, mark_func);
@@ -57435,7 +57405,7 @@ int JS_AddIntrinsicBaseObjects(JSContext *ctx)
     if (JS_IsException(ctx->throw_type_error))
         return -1;
     /* add caller and arguments properties to throw a TypeError */
-    QJS_LOGE("JS_AddIntrinsicBaseObjects: function_proto tag=%d", 
+    QJS_LOGT("JS_AddIntrinsicBaseObjects: function_proto tag=%d", 
              JS_VALUE_GET_TAG(ctx->function_proto));
     if (JS_VALUE_GET_TAG(ctx->function_proto) != JS_TAG_OBJECT) {
         QJS_LOGE("JS_AddIntrinsicBaseObjects: function_proto is not an object!");
@@ -61250,11 +61220,14 @@ static GCValue js_weakref_constructor(JSContext *ctx, GCValue new_target,
     obj = js_create_from_ctor(ctx, new_target, JS_CLASS_WEAK_REF);
     if (JS_IsException(obj))
         return JS_EXCEPTION;
-    JSWeakRefData *wrd = (JSWeakRefData *)gc_deref(gc_allocz(sizeof(*wrd), JS_GC_OBJ_TYPE_DATA));
+    GCHandle wrd_handle = gc_allocz(sizeof(JSWeakRefData), JS_GC_OBJ_TYPE_DATA);
+    JSWeakRefData *wrd = (JSWeakRefData *)gc_deref(wrd_handle);
     if (!wrd) {
         
         return JS_EXCEPTION;
     }
+    /* the target is weak */
+    gc_set_precise(wrd_handle);
     wrd->target = js_weakref_new(ctx, arg);
     wrd->weakref_header.weakref_type = JS_WEAKREF_TYPE_WEAKREF;
     /* Register handle for weakref header (not a GC object, so register manually) */
@@ -61333,6 +61306,8 @@ static void js_finrec_mark(JSRuntime *rt, GCValue val,
     if (frd) {
         list_for_each(el, &frd->entries) {
             JSFinRecEntry *fre = list_entry(el, JSFinRecEntry, link);
+            /* entries are not scanned, so the list is not followed */
+            mark_func(rt, fre);
             JS_MarkValue(rt, fre->held_val, mark_func);
         }
         JS_MarkValue(rt, frd->cb, mark_func);
@@ -61440,9 +61415,12 @@ static GCValue js_finrec_register(JSContext *ctx, GCValue this_val,
         return JS_ThrowTypeError(ctx, "held value cannot be the target");
     if (!JS_IsUndefined(token) && !js_weakref_is_target(token))
         return JS_ThrowTypeError(ctx, "invalid unregister token");
-    fre = (JSFinRecEntry *)gc_deref(gc_alloc(sizeof(*fre), JS_GC_OBJ_TYPE_DATA));
+    GCHandle fre_handle = gc_alloc(sizeof(*fre), JS_GC_OBJ_TYPE_DATA);
+    fre = (JSFinRecEntry *)gc_deref(fre_handle);
     if (!fre)
         return JS_EXCEPTION;
+    /* the target and the token are weak, js_finrec_mark marks held_val */
+    gc_set_precise(fre_handle);
     fre->target = js_weakref_new(ctx, target);
     fre->held_val = held_val;
     fre->token = js_weakref_new(ctx, token);
@@ -1093,7 +1093,8 @@ void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold);
 /* use 0 to disable maximum stack size check */
 void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size);
 /* should be called when changing thread to update the stack top value
-   used to check stack overflow. */
+   used to check stack overflow. It also makes the runtime's GC heap the
+   current one on the calling thread. */
 void JS_UpdateStackTop(JSRuntime *rt);
 void JS_FreeRuntime(JSRuntime *rt);
 void *JS_GetRuntimeOpaque(JSRuntime *rt);
@@ -1101,6 +1102,10 @@ void JS_SetRuntimeOpaque(JSRuntime *rt, void *opaque);
 typedef void JS_MarkFunc(JSRuntime *rt, void *user_ptr);
 void JS_MarkValue(JSRuntime *rt, GCValue val, JS_MarkFunc *mark_func);
 void JS_RunGC(JSRuntime *rt);
+/* Runs a collection if allocation since the last one calls for it. Only
+   collects when no JS code is running on rt; the caller must not hold
+   values that are unreachable from a context. Returns TRUE if it ran. */
+JS_BOOL JS_MaybeRunGC(JSRuntime *rt);
 JS_BOOL JS_IsLiveObject(JSRuntime *rt, GCValue obj);
 
 JSContext *JS_NewContext(JSRuntime *rt);
@@ -1390,6 +1395,8 @@ static inline JS_BOOL JS_IsObject(GCValue v)
 
 GCValue JS_Throw(JSContext *ctx, GCValue obj);
 void JS_SetUncatchableException(JSContext *ctx, JS_BOOL flag);
+/* true if the pending exception cannot be caught, e.g. an interrupt */
+JS_BOOL JS_IsUncatchableException(JSContext *ctx);
 GCValue JS_GetException(JSContext *ctx);
 JS_BOOL JS_HasException(JSContext *ctx);
 JS_BOOL JS_IsError(JSContext *ctx, GCValue val);
@@ -1605,6 +1612,13 @@ void JS_SetHostPromiseRejectionTracker(JSRuntime *rt, JSHostPromiseRejectionTrac
 
 /* if can_block is TRUE, Atomics.wait() can be used */
 void JS_SetCanBlock(JSRuntime *rt, JS_BOOL can_block);
+
+/* return != 0 if the JS code needs to be interrupted */
+typedef int JSInterruptHandler(JSRuntime *rt, void *opaque);
+/* The handler is polled every JS_INTERRUPT_COUNTER_INIT branches and
+   calls. When it returns != 0 an uncatchable InternalError "interrupted"
+   is thrown and unwinds to the caller of JS_Eval/JS_Call. */
+void JS_SetInterruptHandler(JSRuntime *rt, JSInterruptHandler *cb, void *opaque);
 /* select which debug info is stripped from the compiled code */
 #define JS_STRIP_SOURCE (1 << 0) /* strip source code */
 #define JS_STRIP_DEBUG  (1 << 1) /* strip all debug info including source code */
@@ -1,163 +1,762 @@
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE                 /* mremap */
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
-#include <android/log.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include "quickjs_gc_unified.h"
 #include "quickjs.h"
 
 #define ALIGN16(size) (((size) + 15) & ~15)
 #define MIN_OBJECT_SIZE (sizeof(GCHeader) + 16)
 
-GCState g_gc = {0};
+/* Threads without a heap of their own see this one: empty and never
+ * initialized, so lookups fail instead of crashing */
+static GCState gc_no_heap;
+__thread GCState *gc_heap = &gc_no_heap;
 
-static void gc_run_internal(void);
-static void gc_maybe_run(void);
+typedef struct GCMarking GCMarking;
+
+static void large_free_all(void);
+static GCMarking *marking_new(void);
+static void marking_free(GCMarking *m);
+static void trace_block(GCMarking *m, void *ptr);
+
+static uint64_t gc_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ============================================================================
+ * Reserved regions
+ *
+ * The object heap, the handle table, its free stack and the root set each
+ * get their own reserved address range, committed as they grow. The ranges
+ * never move, so handles, object pointers and table pointers stay valid
+ * while the committed part grows.
+ * ============================================================================ */
+
+static size_t page_round(size_t bytes) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (bytes + page - 1) & ~(page - 1);
+}
+
+static void *region_reserve(size_t bytes) {
+    void *base = mmap(NULL, page_round(bytes), PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+static void region_release(void *base, size_t bytes) {
+    if (base) munmap(base, page_round(bytes));
+}
+
+/* Makes the first bytes of a reserved range usable; fresh pages read as zero */
+static bool region_commit(void *base, size_t bytes) {
+    return mprotect(base, page_round(bytes), PROT_READ | PROT_WRITE) == 0;
+}
+
+/* Commits the heap in GC_HEAP_COMMIT_CHUNK steps to cover end. Racing
+ * callers may both mprotect the same pages, which is harmless. */
+static bool heap_commit(size_t end) {
+    size_t committed = atomic_load(&gc_heap->bump.committed);
+    if (end <= committed) return true;
+    size_t target = (end + GC_HEAP_COMMIT_CHUNK - 1) & ~((size_t)GC_HEAP_COMMIT_CHUNK - 1);
+    if (target > gc_heap->heap_size) target = gc_heap->heap_size;
+    if (!region_commit(gc_heap->heap, target)) return false;
+    while (committed < target &&
+           !atomic_compare_exchange_weak(&gc_heap->bump.committed, &committed, target)) {
+    }
+    return true;
+}
+
+/* Records that the bump pointer reached end, so heap_release_tail knows
+ * which pages may be back in memory. Once per page the tail grows into. */
+static void bump_note_dirty(size_t end) {
+    size_t dirty = atomic_load_explicit(&gc_heap->bump.dirty_end, memory_order_relaxed);
+    while (end > dirty &&
+           !atomic_compare_exchange_weak(&gc_heap->bump.dirty_end, &dirty, page_round(end))) {
+    }
+}
+
+/* Gives the pages past the bump pointer back to the OS. They stay committed
+ * and read as zero when the heap grows into them again. Only pages the bump
+ * pointer has reached since the last release can be back in memory. */
+static void heap_release_tail(void) {
+    size_t start = page_round(atomic_load(&gc_heap->bump.offset));
+    size_t end = page_round(atomic_load(&gc_heap->bump.dirty_end));
+    size_t committed = atomic_load(&gc_heap->bump.committed);
+    if (end > committed) end = committed;
+    if (start < end) {
+        madvise(gc_heap->heap + start, end - start, MADV_DONTNEED);
+    }
+    atomic_store(&gc_heap->bump.dirty_end, start);
+}
+
+size_t gc_resident_bytes(void) {
+    if (!gc_heap->initialized) return 0;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t committed = atomic_load(&gc_heap->bump.committed);
+    size_t resident = 0;
+    unsigned char vec[256];
+    for (size_t offset = 0; offset < committed; offset += sizeof(vec) * page) {
+        size_t len = committed - offset;
+        if (len > sizeof(vec) * page) len = sizeof(vec) * page;
+        if (mincore(gc_heap->heap + offset, len, vec) != 0) return 0;
+        for (size_t i = 0; i < len / page; i++) {
+            if (vec[i] & 1) resident += page;
+        }
+    }
+    return resident;
+}
+
+/* Doubles the handle table (and free stack) up to GC_MAX_HANDLES */
+static bool grow_handles(void) {
+    if (gc_heap->handles.capacity >= GC_MAX_HANDLES) return false;
+    uint32_t capacity = gc_heap->handles.capacity * 2;
+    if (capacity > GC_MAX_HANDLES) capacity = GC_MAX_HANDLES;
+    if (!region_commit(gc_heap->handles.ptrs, capacity * sizeof(void*)) ||
+        !region_commit(gc_heap->handles.free, capacity * sizeof(uint32_t))) {
+        return false;
+    }
+    gc_heap->handles.capacity = capacity;
+    return true;
+}
+
+static bool grow_roots(void) {
+    if (gc_heap->root_set.capacity >= GC_MAX_ROOTS) return false;
+    uint32_t capacity = gc_heap->root_set.capacity * 2;
+    if (capacity > GC_MAX_ROOTS) capacity = GC_MAX_ROOTS;
+    if (!region_commit(gc_heap->root_set.roots, capacity * sizeof(GCHandle))) return false;
+    gc_heap->root_set.capacity = capacity;
+    return true;
+}
+
+static size_t released_map_bytes(void) {
+    size_t pages = GC_HEAP_SIZE / (size_t)sysconf(_SC_PAGESIZE);
+    return (pages / 64 + 1) * sizeof(uint64_t);
+}
+
+static size_t starts_map_bytes(void) {
+    return (GC_HEAP_SIZE / 16 / 64 + 1) * sizeof(uint64_t);
+}
+
+static void release_tables(void) {
+    region_release(gc_heap->free_space.released, released_map_bytes());
+    gc_heap->free_space.released = NULL;
+    region_release(gc_heap->starts, starts_map_bytes());
+    gc_heap->starts = NULL;
+    region_release(gc_heap->handles.ptrs, GC_MAX_HANDLES * sizeof(void*));
+    region_release(gc_heap->handles.free, GC_MAX_HANDLES * sizeof(uint32_t));
+    region_release(gc_heap->root_set.roots, GC_MAX_ROOTS * sizeof(GCHandle));
+    gc_heap->handles.ptrs = NULL;
+    gc_heap->handles.free = NULL;
+    gc_heap->root_set.roots = NULL;
+}
+
+static bool init_tables(void) {
+    gc_heap->handles.ptrs = region_reserve(GC_MAX_HANDLES * sizeof(void*));
+    gc_heap->handles.free = region_reserve(GC_MAX_HANDLES * sizeof(uint32_t));
+    gc_heap->root_set.roots = region_reserve(GC_MAX_ROOTS * sizeof(GCHandle));
+    gc_heap->free_space.released = region_reserve(released_map_bytes());
+    gc_heap->starts = region_reserve(starts_map_bytes());
+    if (!gc_heap->handles.ptrs || !gc_heap->handles.free || !gc_heap->root_set.roots ||
+        !gc_heap->free_space.released || !gc_heap->starts ||
+        !region_commit(gc_heap->free_space.released, released_map_bytes()) ||
+        !region_commit(gc_heap->starts, starts_map_bytes()) ||
+        !region_commit(gc_heap->handles.ptrs, GC_INITIAL_HANDLES * sizeof(void*)) ||
+        !region_commit(gc_heap->handles.free, GC_INITIAL_HANDLES * sizeof(uint32_t)) ||
+        !region_commit(gc_heap->root_set.roots, GC_INITIAL_ROOTS * sizeof(GCHandle))) {
+        release_tables();
+        return false;
+    }
+    gc_heap->handles.capacity = GC_INITIAL_HANDLES;
+    gc_heap->handles.count = 1;
+    gc_heap->handles.free_count = 0;
+    gc_heap->root_set.capacity = GC_INITIAL_ROOTS;
+    gc_heap->root_set.count = 0;
+    return true;
+}
 
 bool gc_init(void) {
-    if (g_gc.initialized) return true;
-    
-    g_gc.heap = malloc(GC_HEAP_SIZE);
-    if (!g_gc.heap) return false;
-    
-    g_gc.heap_size = GC_HEAP_SIZE;
-    g_gc.bump.base = g_gc.heap;
-    atomic_store(&g_gc.bump.offset, 0);
-    g_gc.bump.capacity = GC_HEAP_SIZE;
-    
-    size_t handle_table_size = ALIGN16(GC_INITIAL_HANDLES * sizeof(void*));
-    g_gc.handles.ptrs = (void**)g_gc.heap;
-    memset(g_gc.handles.ptrs, 0, handle_table_size);
-    g_gc.handles.capacity = GC_INITIAL_HANDLES;
-    g_gc.handles.count = 1;
-    
-    size_t root_capacity = 1024;
-    size_t root_size = ALIGN16(root_capacity * sizeof(GCHandle));
-    g_gc.root_set.roots = (GCHandle*)(g_gc.heap + handle_table_size);
-    g_gc.root_set.capacity = root_capacity;
-    g_gc.root_set.count = 0;
-    
-    atomic_store(&g_gc.bump.offset, handle_table_size + root_size);
-    g_gc.bytes_allocated = 0;
-    g_gc.gc_threshold = GC_DEFAULT_THRESHOLD;
-    g_gc.rt = NULL;
-    
-    g_gc.initialized = true;
+    if (gc_heap->initialized) return true;
+    
+    GCState *heap = calloc(1, sizeof(GCState));
+    if (!heap) return false;
+    heap->marking = marking_new();
+    if (!heap->marking) {
+        free(heap);
+        return false;
+    }
+    gc_heap = heap;
+    
+    /* Address space only; pages are committed as the bump pointer advances */
+    gc_heap->heap = region_reserve(GC_HEAP_SIZE);
+    if (!gc_heap->heap || !init_tables()) {
+        region_release(gc_heap->heap, GC_HEAP_SIZE);
+        marking_free(heap->marking);
+        gc_heap = &gc_no_heap;
+        free(heap);
+        return false;
+    }
+    
+    gc_heap->heap_size = GC_HEAP_SIZE;
+    gc_heap->bump.base = gc_heap->heap;
+    atomic_store(&gc_heap->bump.offset, 0);
+    atomic_store(&gc_heap->bump.committed, 0);
+    gc_heap->bump.capacity = GC_HEAP_SIZE;
+    
+    gc_heap->bytes_allocated = 0;
+    gc_heap->gc_threshold = GC_DEFAULT_THRESHOLD;
+    gc_heap->min_threshold = GC_DEFAULT_THRESHOLD;
+    gc_heap->growth_percent = GC_DEFAULT_GROWTH_PERCENT;
+    gc_heap->bytes_since_gc = 0;
+    memset(&gc_heap->stats, 0, sizeof(gc_heap->stats));
+    gc_heap->stats.init_ns = gc_now_ns();
+    gc_heap->rt = NULL;
+    
+    gc_heap->initialized = true;
     return true;
 }
 
 bool gc_is_initialized(void) {
-    return g_gc.initialized;
+    return gc_heap->initialized;
 }
 
 void gc_cleanup(void) {
-    if (g_gc.heap) {
-        free(g_gc.heap);
-        g_gc.heap = NULL;
-    }
-    memset(&g_gc, 0, sizeof(g_gc));
+    GCState *heap = gc_heap;
+    if (heap == &gc_no_heap) return;
+    
+    region_release(heap->heap, heap->heap_size);
+    large_free_all();
+    free(heap->large.objects);
+    free(heap->finalizers.entries);
+    marking_free(heap->marking);
+    release_tables();
+    gc_heap = &gc_no_heap;
+    free(heap);
+}
+
+GCState *gc_current_heap(void) {
+    return gc_heap == &gc_no_heap ? NULL : gc_heap;
+}
+
+void gc_set_current_heap(GCState *heap) {
+    gc_heap = heap ? heap : &gc_no_heap;
 }
 
 void gc_set_runtime(JSRuntime *rt) {
-    g_gc.rt = rt;
+    gc_heap->rt = rt;
+}
+
+/* ============================================================================
+ * Finalizer table
+ *
+ * Few objects have a finalizer, so rather than a pointer in every header
+ * they are kept here, keyed by handle. GC_FLAG_FINALIZER on the header says
+ * an entry exists, so a dying object without one costs no lookup.
+ * ============================================================================ */
+
+static uint32_t finalizer_home(GCHandle handle) {
+    return (handle * 2654435761u) & (gc_heap->finalizers.capacity - 1);
+}
+
+static GCFinalizerEntry *finalizer_find(GCHandle handle) {
+    if (gc_heap->finalizers.count == 0) return NULL;
+    uint32_t mask = gc_heap->finalizers.capacity - 1;
+    for (uint32_t i = finalizer_home(handle);; i = (i + 1) & mask) {
+        GCFinalizerEntry *entry = &gc_heap->finalizers.entries[i];
+        if (entry->handle == handle) return entry;
+        if (entry->handle == GC_HANDLE_NULL) return NULL;
+    }
+}
+
+static bool finalizer_put(GCHandle handle, GCFinalizerFunc *finalizer);
+
+static bool finalizer_grow(void) {
+    GCFinalizerEntry *old = gc_heap->finalizers.entries;
+    uint32_t old_capacity = gc_heap->finalizers.capacity;
+    uint32_t capacity = old_capacity ? old_capacity * 2 : 64;
+    
+    GCFinalizerEntry *entries = calloc(capacity, sizeof(GCFinalizerEntry));
+    if (!entries) return false;
+    gc_heap->finalizers.entries = entries;
+    gc_heap->finalizers.capacity = capacity;
+    gc_heap->finalizers.count = 0;
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].handle != GC_HANDLE_NULL) finalizer_put(old[i].handle, old[i].finalizer);
+    }
+    free(old);
+    return true;
+}
+
+/* Kept at most half full */
+static bool finalizer_put(GCHandle handle, GCFinalizerFunc *finalizer) {
+    if ((gc_heap->finalizers.count + 1) * 2 > gc_heap->finalizers.capacity && !finalizer_grow()) {
+        return false;
+    }
+    uint32_t mask = gc_heap->finalizers.capacity - 1;
+    for (uint32_t i = finalizer_home(handle);; i = (i + 1) & mask) {
+        GCFinalizerEntry *entry = &gc_heap->finalizers.entries[i];
+        if (entry->handle == GC_HANDLE_NULL) {
+            entry->handle = handle;
+            gc_heap->finalizers.count++;
+        } else if (entry->handle != handle) {
+            continue;
+        }
+        entry->finalizer = finalizer;
+        return true;
+    }
+}
+
+/* Shifts later entries of the probe run back into the hole, so lookups
+ * never need tombstones */
+static void finalizer_remove(GCHandle handle) {
+    GCFinalizerEntry *entry = finalizer_find(handle);
+    if (!entry) return;
+    
+    GCFinalizerEntry *entries = gc_heap->finalizers.entries;
+    uint32_t mask = gc_heap->finalizers.capacity - 1;
+    uint32_t hole = (uint32_t)(entry - entries);
+    for (uint32_t i = (hole + 1) & mask; entries[i].handle != GC_HANDLE_NULL; i = (i + 1) & mask) {
+        uint32_t home = finalizer_home(entries[i].handle);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            entries[hole] = entries[i];
+            hole = i;
+        }
+    }
+    entries[hole].handle = GC_HANDLE_NULL;
+    entries[hole].finalizer = NULL;
+    gc_heap->finalizers.count--;
+}
+
+/* Runs the finalizer of a dying object, if it has one. The entry goes
+ * first, so an object the sweep keeps is not finalized twice. */
+static void finalize_object(JSRuntime *rt, GCHeader *hdr) {
+    if (!rt || !(hdr->flags & GC_FLAG_FINALIZER)) return;
+    GCFinalizerEntry *entry = finalizer_find(hdr->handle);
+    GCFinalizerFunc *finalizer = entry ? entry->finalizer : NULL;
+    finalizer_remove(hdr->handle);
+    hdr->flags &= ~GC_FLAG_FINALIZER;
+    if (finalizer) finalizer(rt, hdr->handle, (uint8_t*)hdr + sizeof(GCHeader));
 }
 
 void gc_set_handle_finalizer(GCHandle handle, GCFinalizerFunc *finalizer) {
-    if (handle == GC_HANDLE_NULL || handle >= g_gc.handles.count) return;
+    if (handle == GC_HANDLE_NULL || handle >= gc_heap->handles.count) return;
     
-    void *ptr = g_gc.handles.ptrs[handle];
+    void *ptr = gc_heap->handles.ptrs[handle];
     if (!ptr) return;
     
     GCHeader *hdr = gc_header(ptr);
-    if (!hdr) return;
-    
-    hdr->finalizer = finalizer;
+    if (finalizer && finalizer_put(handle, finalizer)) {
+        hdr->flags |= GC_FLAG_FINALIZER;
+    } else {
+        finalizer_remove(handle);
+        hdr->flags &= ~GC_FLAG_FINALIZER;
+    }
 }
 
 GCFinalizerFunc *gc_get_handle_finalizer(GCHandle handle) {
-    if (handle == GC_HANDLE_NULL || handle >= g_gc.handles.count) return NULL;
-    
-    void *ptr = g_gc.handles.ptrs[handle];
-    if (!ptr) return NULL;
+    if (handle == GC_HANDLE_NULL || handle >= gc_heap->handles.count) return NULL;
+    if (!gc_heap->handles.ptrs[handle]) return NULL;
     
-    GCHeader *hdr = gc_header(ptr);
-    if (!hdr) return NULL;
-    
-    return hdr->finalizer;
+    GCFinalizerEntry *entry = finalizer_find(handle);
+    return entry ? entry->finalizer : NULL;
 }
 
 void gc_run_finalizer(JSRuntime *rt, GCHandle handle) {
-    if (handle == GC_HANDLE_NULL || handle >= g_gc.handles.count) return;
+    if (handle == GC_HANDLE_NULL || handle >= gc_heap->handles.count) return;
     
-    void *ptr = g_gc.handles.ptrs[handle];
+    void *ptr = gc_heap->handles.ptrs[handle];
     if (!ptr) return;
     
-    GCHeader *hdr = gc_header(ptr);
-    if (!hdr) return;
-    
     /* Call per-handle finalizer if registered */
-    if (hdr->finalizer) {
-        hdr->finalizer(rt, handle, ptr);
+    GCFinalizerEntry *entry = finalizer_find(handle);
+    if (entry) {
+        entry->finalizer(rt, handle, ptr);
+    }
+}
+
+/* ============================================================================
+ * Block starts
+ *
+ * gc_heap->starts has a bit per 16 bytes of heap, set where a block
+ * begins, so a pointer into the middle of a block finds its header. Free
+ * blocks keep the bit of their own start only, and nothing past the bump
+ * pointer has one.
+ * ============================================================================ */
+
+/* Bump allocations may race, so setting is atomic */
+static void start_set(size_t offset) {
+    size_t i = offset / 16;
+    __atomic_fetch_or(&gc_heap->starts[i / 64], 1ull << (i % 64), __ATOMIC_RELAXED);
+}
+
+/* Clears the bits of the blocks that begin in [start, end) */
+static void starts_clear_range(size_t start, size_t end) {
+    size_t i = start / 16;
+    for (; i < end / 16 && i % 64 != 0; i++) gc_heap->starts[i / 64] &= ~(1ull << (i % 64));
+    for (; i + 64 <= end / 16; i += 64) gc_heap->starts[i / 64] = 0;
+    for (; i < end / 16; i++) gc_heap->starts[i / 64] &= ~(1ull << (i % 64));
+}
+
+/* No heap block spans more granules than this, see heap_resize_in_place */
+#define GC_BLOCK_MAX_GRANULES ((sizeof(GCHeader) + GC_LARGE_OBJECT_SIZE) / 16)
+
+/* The live heap block holding the byte at offset, or NULL: the nearest
+ * start at or below it, if the block there reaches it and has a handle */
+static GCHeader *heap_block_at(size_t offset) {
+    size_t i = offset / 16;
+    size_t word = i / 64;
+    size_t floor = i > GC_BLOCK_MAX_GRANULES ? (i - GC_BLOCK_MAX_GRANULES) / 64 : 0;
+    uint64_t bits = gc_heap->starts[word] & (~0ull >> (63 - i % 64));
+    while (!bits) {
+        if (word == floor) return NULL;
+        bits = gc_heap->starts[--word];
     }
+    size_t start = (word * 64 + 63 - (size_t)__builtin_clzll(bits)) * 16;
+    GCHeader *hdr = (GCHeader*)(gc_heap->heap + start);
+    if (offset >= start + hdr->size || hdr->handle == GC_HANDLE_NULL) return NULL;
+    return hdr;
 }
 
 static void *bump_alloc(size_t size) {
     size_t total_size = sizeof(GCHeader) + ALIGN16(size);
     
-    size_t old_offset = atomic_load(&g_gc.bump.offset);
+    size_t old_offset = atomic_load(&gc_heap->bump.offset);
     size_t new_offset;
     
     do {
         new_offset = old_offset + total_size;
-        if (new_offset > g_gc.heap_size) return NULL;
-    } while (!atomic_compare_exchange_weak(&g_gc.bump.offset, &old_offset, new_offset));
+        if (new_offset > gc_heap->heap_size) return NULL;
+        if (!heap_commit(new_offset)) return NULL;
+    } while (!atomic_compare_exchange_weak(&gc_heap->bump.offset, &old_offset, new_offset));
+    
+    bump_note_dirty(new_offset);
+    start_set(old_offset);
     
-    uint8_t *ptr = g_gc.heap + old_offset;
+    uint8_t *ptr = gc_heap->heap + old_offset;
     GCHeader *hdr = (GCHeader*)ptr;
     
-    hdr->ref_count_unused = 0;
-    hdr->gc_obj_type = 0;
-    hdr->mark = 0;
-    hdr->dummy0 = 0;
-    hdr->dummy1 = 0;
-    hdr->dummy2 = 0;
-    hdr->link.next = NULL;
-    hdr->link.prev = NULL;
     hdr->handle = GC_HANDLE_NULL;
     hdr->size = total_size;
+    hdr->mark = 0;
+    hdr->gc_obj_type = 0;
     hdr->flags = 0;
+    hdr->reserved = 0;
     hdr->pad = 0;
-    hdr->finalizer = NULL;  /* No finalizer by default */
     
     memset(ptr + sizeof(GCHeader), 0, ALIGN16(size));
     return ptr + sizeof(GCHeader);
 }
 
+/* ============================================================================
+ * Large-object space
+ *
+ * Allocations of GC_LARGE_OBJECT_SIZE and up get their own page-aligned
+ * mapping instead of bump space. They are marked like any other object but
+ * never moved, and a dead one is unmapped. They are tracked in
+ * gc_heap->large.objects, sorted by address, so finding the object that
+ * holds a pointer is a binary search.
+ * ============================================================================ */
+
+/* Index of the large object whose mapping holds ptr, or UINT32_MAX */
+static uint32_t large_find(const void *ptr) {
+    uint32_t lo = 0, hi = gc_heap->large.count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if ((const uint8_t*)gc_heap->large.objects[mid] <= (const uint8_t*)ptr) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return UINT32_MAX;
+    GCHeader *hdr = gc_heap->large.objects[lo - 1];
+    return (const uint8_t*)ptr < (uint8_t*)hdr + hdr->size ? lo - 1 : UINT32_MAX;
+}
+
+static uint32_t large_index(GCHeader *hdr) {
+    return large_find(hdr);
+}
+
+/* Capacity is reserved by the caller */
+static void large_insert(GCHeader *hdr) {
+    uint32_t i = gc_heap->large.count;
+    while (i > 0 && gc_heap->large.objects[i - 1] > hdr) {
+        gc_heap->large.objects[i] = gc_heap->large.objects[i - 1];
+        i--;
+    }
+    gc_heap->large.objects[i] = hdr;
+    gc_heap->large.count++;
+}
+
+static void large_remove_at(uint32_t index) {
+    memmove(&gc_heap->large.objects[index], &gc_heap->large.objects[index + 1],
+            (gc_heap->large.count - index - 1) * sizeof(GCHeader*));
+    gc_heap->large.count--;
+}
+
+/* The size of a large object covers its whole mapping, so the page slack is
+ * usable */
+static void *large_alloc(size_t size) {
+    size_t total_size = page_round(sizeof(GCHeader) + ALIGN16(size));
+    if (total_size > UINT32_MAX) return NULL;
+    
+    if (gc_heap->large.count == gc_heap->large.capacity) {
+        uint32_t capacity = gc_heap->large.capacity ? gc_heap->large.capacity * 2 : 16;
+        GCHeader **objects = realloc(gc_heap->large.objects, capacity * sizeof(GCHeader*));
+        if (!objects) return NULL;
+        gc_heap->large.objects = objects;
+        gc_heap->large.capacity = capacity;
+    }
+    
+    /* Fresh anonymous pages are zeroed, header included */
+    uint8_t *base = mmap(NULL, total_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    
+    GCHeader *hdr = (GCHeader*)base;
+    hdr->size = total_size;
+    hdr->flags = GC_FLAG_LARGE;
+    large_insert(hdr);
+    gc_heap->large.bytes += total_size;
+    return base + sizeof(GCHeader);
+}
+
+static void large_free_at(uint32_t index) {
+    GCHeader *hdr = gc_heap->large.objects[index];
+    large_remove_at(index);
+    gc_heap->large.bytes -= hdr->size;
+    munmap(hdr, hdr->size);
+}
+
+static void large_free(GCHeader *hdr) {
+    large_free_at(large_index(hdr));
+}
+
+static void large_free_all(void) {
+    while (gc_heap->large.count > 0) {
+        large_free_at(gc_heap->large.count - 1);
+    }
+}
+
+static bool large_contains(void *ptr) {
+    return large_find(ptr) != UINT32_MAX;
+}
+
+/* Released slots are reused most recent first, so handle allocation and
+ * release are both O(1) */
 static GCHandle allocate_handle(void *ptr) {
     if (!ptr) return GC_HANDLE_NULL;
     
-    for (uint32_t i = 1; i < g_gc.handles.count; i++) {
-        if (g_gc.handles.ptrs[i] == NULL) {
-            g_gc.handles.ptrs[i] = ptr;
-            return i;
-        }
+    if (gc_heap->handles.free_count > 0) {
+        GCHandle handle = gc_heap->handles.free[--gc_heap->handles.free_count];
+        gc_heap->handles.ptrs[handle] = ptr;
+        return handle;
     }
     
-    if (g_gc.handles.count >= g_gc.handles.capacity) {
+    if (gc_heap->handles.count >= gc_heap->handles.capacity && !grow_handles()) {
         return GC_HANDLE_NULL;
     }
     
-    GCHandle handle = g_gc.handles.count++;
-    g_gc.handles.ptrs[handle] = ptr;
+    GCHandle handle = gc_heap->handles.count++;
+    gc_heap->handles.ptrs[handle] = ptr;
     return handle;
 }
 
+/* A slot goes on the free stack only when it actually held a pointer, so
+ * releasing twice cannot hand the same handle out twice */
+static void release_handle(GCHandle handle) {
+    if (handle == GC_HANDLE_NULL || handle >= gc_heap->handles.count) return;
+    if (!gc_heap->handles.ptrs[handle]) return;
+    finalizer_remove(handle);
+    gc_heap->handles.ptrs[handle] = NULL;
+    gc_heap->handles.free[gc_heap->handles.free_count++] = handle;
+}
+
+/* A dead heap block keeps its size so the heap walk can step over it; with
+ * no handle and no finalizer, the next sweep merges it into a free block */
+static void heap_block_kill(GCHeader *hdr) {
+    hdr->handle = GC_HANDLE_NULL;
+    hdr->flags &= ~GC_FLAG_FINALIZER;
+    hdr->mark = 0;
+}
+
+/* ============================================================================
+ * Free space
+ *
+ * Dead blocks stay where they are, threaded onto free lists through their
+ * first payload word. Below GC_FREE_CLASSES * 16 bytes there is a list per
+ * block size, so reusing one is a pop; bigger blocks are binned by power of
+ * two. A free block is a dead block like any other, no handle and no mark,
+ * so heap walks step over it. gc_sweep_unmarked rebuilds the lists.
+ * ============================================================================ */
+
+#define GC_FREE_BIG_MIN (GC_FREE_CLASSES * 16)
+
+static GCHeader **free_next(GCHeader *hdr) {
+    return (GCHeader**)(hdr + 1);
+}
+
+static uint32_t free_bin(size_t size) {
+    uint32_t bin = (uint32_t)(63 - __builtin_clzll(size / GC_FREE_BIG_MIN));
+    return bin < GC_FREE_BINS ? bin : GC_FREE_BINS - 1;
+}
+
+static GCHeader **free_list(size_t size) {
+    return size < GC_FREE_BIG_MIN ? &gc_heap->free_space.exact[size / 16]
+                                  : &gc_heap->free_space.big[free_bin(size)];
+}
+
+static void free_push(GCHeader *hdr) {
+    GCHeader **list = free_list(hdr->size);
+    *free_next(hdr) = *list;
+    *list = hdr;
+    gc_heap->free_space.bytes += hdr->size;
+}
+
+static GCHeader *free_pop(GCHeader **list) {
+    GCHeader *hdr = *list;
+    if (hdr) *list = *free_next(hdr);
+    return hdr;
+}
+
+static GCHeader *free_pop_fit(GCHeader **list, size_t total) {
+    for (GCHeader **link = list; *link; link = free_next(*link)) {
+        GCHeader *hdr = *link;
+        if (hdr->size >= total) {
+            *link = *free_next(hdr);
+            return hdr;
+        }
+    }
+    return NULL;
+}
+
+/* Any block of at least total bytes: the first that fits in its own bin,
+ * else any from a higher one */
+static GCHeader *free_pop_big(size_t total) {
+    uint32_t bin = total < GC_FREE_BIG_MIN ? 0 : free_bin(total);
+    GCHeader *hdr = free_pop_fit(&gc_heap->free_space.big[bin], total);
+    while (!hdr && ++bin < GC_FREE_BINS) {
+        hdr = free_pop(&gc_heap->free_space.big[bin]);
+    }
+    return hdr;
+}
+
+/* free_space.released marks heap pages already given back. A page stays
+ * marked while it lies inside free blocks, so a block that survives several
+ * sweeps is not released again; reusing a block, or the bump pointer
+ * retreating over pages, clears their marks. */
+static bool released_test(size_t page) {
+    return (gc_heap->free_space.released[page / 64] >> (page % 64)) & 1;
+}
+
+/* Clears the marks on every page that overlaps [start, end) of the heap */
+static void released_clear_range(size_t start, size_t end) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (size_t i = start / page; i < (end + page - 1) / page; i++) {
+        gc_heap->free_space.released[i / 64] &= ~(1ull << (i % 64));
+    }
+}
+
+/* The whole pages inside a free block go back to the OS, except those
+ * still released from an earlier sweep; they read as zero once the block
+ * is reused */
+static void free_release_pages(GCHeader *hdr) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = page_round((size_t)((uint8_t*)(free_next(hdr) + 1) - gc_heap->heap));
+    size_t end = ((size_t)((uint8_t*)hdr - gc_heap->heap) + hdr->size) & ~(page - 1);
+    size_t run = SIZE_MAX;
+    for (size_t p = start / page; p <= end / page; p++) {
+        bool fresh = p < end / page && !released_test(p);
+        if (fresh) {
+            if (run == SIZE_MAX) run = p;
+            gc_heap->free_space.released[p / 64] |= 1ull << (p % 64);
+        } else if (run != SIZE_MAX) {
+            madvise(gc_heap->heap + run * page, (p - run) * page, MADV_DONTNEED);
+            run = SIZE_MAX;
+        }
+    }
+}
+
+/* Empties the lists. The released marks describe pages, not lists, and
+ * stay; free_reset_all drops them too, for when the pages get rewritten. */
+static void free_reset(void) {
+    uint64_t *released = gc_heap->free_space.released;
+    memset(&gc_heap->free_space, 0, sizeof(gc_heap->free_space));
+    gc_heap->free_space.released = released;
+}
+
+static void free_reset_all(void) {
+    free_reset();
+    memset(gc_heap->free_space.released, 0, released_map_bytes());
+}
+
+/* Turns a block taken off a list into a fresh allocation of total bytes.
+ * A tail big enough to be a block of its own goes back on a list. */
+static void *free_take(GCHeader *hdr, size_t total) {
+    size_t start = (size_t)((uint8_t*)hdr - gc_heap->heap);
+    /* The block, and the header and link of a tail left behind */
+    released_clear_range(start, start + total + sizeof(GCHeader) + sizeof(GCHeader*));
+    gc_heap->free_space.bytes -= hdr->size;
+    if (hdr->size - total >= MIN_OBJECT_SIZE) {
+        GCHeader *tail = (GCHeader*)((uint8_t*)hdr + total);
+        memset(tail, 0, sizeof(GCHeader));
+        tail->size = hdr->size - total;
+        start_set(start + total);
+        free_push(tail);
+        hdr->size = total;
+    }
+    uint32_t size = hdr->size;
+    memset(hdr, 0, size);
+    hdr->size = size;
+    return hdr + 1;
+}
+
+/* A free block of the exact size, else a piece of a big one, else fresh
+ * bump space. Once the bump space runs out, small allocations also split
+ * blocks of the other small sizes. */
+static void *heap_alloc(size_t size) {
+    size_t total = sizeof(GCHeader) + ALIGN16(size);
+    GCHeader *hdr = total < GC_FREE_BIG_MIN ? free_pop(free_list(total)) : NULL;
+    if (!hdr && gc_heap->free_space.bytes >= total) hdr = free_pop_big(total);
+    if (hdr) return free_take(hdr, total);
+    
+    void *ptr = bump_alloc(size);
+    if (ptr || gc_heap->free_space.bytes < total) return ptr;
+    
+    for (size_t i = total / 16 + 1; !hdr && i < GC_FREE_CLASSES; i++) {
+        hdr = free_pop(&gc_heap->free_space.exact[i]);
+    }
+    return hdr ? free_take(hdr, total) : NULL;
+}
+
+/* Gives a dead heap block's space back: the most recent block to the bump
+ * pointer, any other to a free list. During a sweep the block is only
+ * killed; the sweep collects it with the rest. */
+static void heap_block_free(GCHeader *hdr) {
+    heap_block_kill(hdr);
+    if (gc_heap->sweeping) return;
+    size_t start = (size_t)((uint8_t*)hdr - gc_heap->heap);
+    size_t end = start + hdr->size;
+    if (atomic_compare_exchange_strong(&gc_heap->bump.offset, &end, start)) {
+        starts_clear_range(start, start + 16);
+    } else {
+        free_push(hdr);
+    }
+}
+
 bool gc_ptr_is_valid(void *ptr) {
     if (!ptr) return false;
-    if (!g_gc.initialized) return false;
+    if (!gc_heap->initialized) return false;
     /* Check if pointer is within heap range */
-    if ((uint8_t*)ptr < g_gc.heap || (uint8_t*)ptr >= g_gc.heap + g_gc.heap_size)
-        return false;
-    return true;
+    if ((uint8_t*)ptr >= gc_heap->heap && (uint8_t*)ptr < gc_heap->heap + gc_heap->heap_size)
+        return true;
+    return large_contains(ptr);
 }
 
 GCHandle gc_alloc_handle_for_ptr(void *ptr) {
@@ -172,29 +771,108 @@ GCHandle gc_alloc_ex(size_t size, JSGCObjectTypeEnum gc_obj_type,
                      GCHandleArrayType array_type) {
     (void)array_type;
     
-    if (!g_gc.initialized) return GC_HANDLE_NULL;
+    if (!gc_heap->initialized) return GC_HANDLE_NULL;
     
-    void *ptr = bump_alloc(size);
-    if (!ptr) {
-        gc_run_internal();
-        ptr = bump_alloc(size);
-        if (!ptr) return GC_HANDLE_NULL;
+    /* gc_should_run() asks for a collection at the next safepoint long
+     * before the heap fills. When a burst between safepoints fills it
+     * anyway, the exhausted hook collects right here: the marker scans the
+     * native stack, so the caller's locals stay alive. */
+    void *ptr = size >= GC_LARGE_OBJECT_SIZE ? large_alloc(size) : heap_alloc(size);
+    if (!ptr && gc_heap->exhausted_hook && gc_heap->rt && !gc_heap->in_exhausted_hook) {
+        gc_heap->in_exhausted_hook = true;
+        gc_heap->exhausted_hook(gc_heap->rt);
+        gc_heap->in_exhausted_hook = false;
+        ptr = size >= GC_LARGE_OBJECT_SIZE ? large_alloc(size) : heap_alloc(size);
     }
+    if (!ptr) return GC_HANDLE_NULL;
     
     GCHeader *hdr = gc_header(ptr);
     hdr->gc_obj_type = gc_obj_type;
     
     GCHandle handle = allocate_handle(ptr);
     if (handle == GC_HANDLE_NULL) {
-        hdr->size = 0;
+        if (hdr->flags & GC_FLAG_LARGE) large_free(hdr);
+        else heap_block_free(hdr);
         return GC_HANDLE_NULL;
     }
     hdr->handle = handle;
-    g_gc.bytes_allocated += hdr->size;
+    gc_heap->bytes_allocated += hdr->size;
+    gc_heap->bytes_since_gc += hdr->size;
+    gc_heap->stats.total_allocated += hdr->size;
     
     return handle;
 }
 
+static void note_resize(size_t old_size, size_t new_size) {
+    if (new_size > old_size) {
+        size_t grown = new_size - old_size;
+        gc_heap->bytes_allocated += grown;
+        gc_heap->bytes_since_gc += grown;
+        gc_heap->stats.total_allocated += grown;
+    } else {
+        gc_heap->bytes_allocated -= old_size - new_size;
+    }
+}
+
+/* A heap block can grow only if it is the most recent bump allocation.
+ * Any block can shrink: the last one gives the space back to the bump
+ * pointer, others put the tail on a free list. */
+static bool heap_resize_in_place(GCHeader *hdr, size_t new_size) {
+    size_t old_total = hdr->size;
+    size_t new_total = sizeof(GCHeader) + ALIGN16(new_size);
+    size_t end = (size_t)((uint8_t*)hdr - gc_heap->heap) + old_total;
+    bool last = end == atomic_load(&gc_heap->bump.offset);
+    
+    if (new_total == old_total) return true;
+    if (new_total > old_total) {
+        size_t new_end = end + (new_total - old_total);
+        if (!last || new_end > gc_heap->heap_size || !heap_commit(new_end)) return false;
+        if (!atomic_compare_exchange_strong(&gc_heap->bump.offset, &end, new_end)) return false;
+        bump_note_dirty(new_end);
+        /* gc_alloc hands out zeroed memory, and so does growth */
+        memset((uint8_t*)hdr + old_total, 0, new_total - old_total);
+    } else if (last) {
+        size_t new_end = end - (old_total - new_total);
+        if (!atomic_compare_exchange_strong(&gc_heap->bump.offset, &end, new_end)) return false;
+    } else if (old_total - new_total >= MIN_OBJECT_SIZE) {
+        GCHeader *tail = (GCHeader*)((uint8_t*)hdr + new_total);
+        memset(tail, 0, sizeof(GCHeader));
+        tail->gc_obj_type = JS_GC_OBJ_TYPE_DATA;
+        tail->size = old_total - new_total;
+        start_set((size_t)((uint8_t*)tail - gc_heap->heap));
+        if (gc_heap->sweeping) heap_block_kill(tail);
+        else free_push(tail);
+    } else {
+        return true;                /* Too small a tail to split off */
+    }
+    
+    note_resize(old_total, new_total);
+    hdr->size = new_total;
+    return true;
+}
+
+/* mremap keeps the pages and may move the mapping; the handle follows it */
+static bool large_resize_in_place(GCHeader *hdr, GCHandle handle, size_t new_size) {
+    size_t old_total = hdr->size;
+    size_t new_total = page_round(sizeof(GCHeader) + ALIGN16(new_size));
+    if (new_total == old_total) return true;
+    if (new_total > UINT32_MAX) return false;
+    
+    uint32_t index = large_index(hdr);
+    void *base = mremap(hdr, old_total, new_total, MREMAP_MAYMOVE);
+    if (base == MAP_FAILED) return false;
+    
+    hdr = (GCHeader*)base;
+    hdr->size = new_total;
+    /* A moved mapping takes its place in address order */
+    large_remove_at(index);
+    large_insert(hdr);
+    gc_heap->large.bytes = gc_heap->large.bytes - old_total + new_total;
+    gc_heap->handles.ptrs[handle] = (uint8_t*)hdr + sizeof(GCHeader);
+    note_resize(old_total, new_total);
+    return true;
+}
+
 GCHandle gc_realloc(GCHandle handle, size_t new_size) {
     if (handle == GC_HANDLE_NULL) {
         return gc_alloc(new_size, JS_GC_OBJ_TYPE_DATA);
@@ -208,20 +886,49 @@ GCHandle gc_realloc(GCHandle handle, size_t new_size) {
     GCHeader *old_hdr = gc_header(old_ptr);
     JSGCObjectTypeEnum old_type = old_hdr->gc_obj_type;
     
+    /* In place keeps the handle. Only when the header is this handle's
+     * own: some handles point past the start of their allocation. */
+    if (old_hdr->handle == handle) {
+        if (old_hdr->flags & GC_FLAG_LARGE) {
+            if (large_resize_in_place(old_hdr, handle, new_size)) return handle;
+        } else if (new_size < GC_LARGE_OBJECT_SIZE) {
+            if (heap_resize_in_place(old_hdr, new_size)) return handle;
+        }
+    }
+    
     GCHandle new_handle = gc_alloc(new_size, old_type);
     if (new_handle == GC_HANDLE_NULL) return GC_HANDLE_NULL;
     
     void *new_ptr = gc_deref(new_handle);
+    gc_header(new_ptr)->flags |= old_hdr->flags & GC_FLAG_PRECISE;
     size_t old_user_size = old_hdr->size - sizeof(GCHeader);
     size_t copy_size = old_user_size < new_size ? old_user_size : new_size;
     memcpy(new_ptr, old_ptr, copy_size);
     
-    old_hdr->size = 0;
-    g_gc.handles.ptrs[handle] = NULL;
-    
+    gc_free(handle);
     return new_handle;
 }
 
+/* Frees the allocation behind a handle. Some handles point into the middle
+ * of an allocation; for those only the handle goes. */
+void gc_free(GCHandle handle) {
+    void *ptr = gc_deref(handle);
+    if (!ptr) return;
+    
+    GCHeader *hdr = gc_header(ptr);
+    bool block = hdr->handle != GC_HANDLE_NULL && hdr->handle < gc_heap->handles.count &&
+                 gc_heap->handles.ptrs[hdr->handle] == ptr;
+    release_handle(handle);
+    if (!block) return;
+    release_handle(hdr->handle);
+    gc_heap->bytes_allocated -= hdr->size;
+    if (!(hdr->flags & GC_FLAG_LARGE)) heap_block_free(hdr);
+    else if (gc_heap->sweeping) heap_block_kill(hdr);
+    else large_free(hdr);
+}
+
+/* The slack is what the block can hold beyond new_size without another
+ * resize: alignment padding, or the rest of the last page for large objects */
 GCHandle gc_realloc2(GCHandle handle, size_t new_size, size_t *pslack) {
     GCHandle new_handle = gc_realloc(handle, new_size);
     if (pslack && new_handle != GC_HANDLE_NULL) {
@@ -232,17 +939,17 @@ GCHandle gc_realloc2(GCHandle handle, size_t new_size, size_t *pslack) {
 }
 
 void *gc_deref(GCHandle handle) {
-    if (handle == GC_HANDLE_NULL || handle >= g_gc.handles.count) {
+    if (handle == GC_HANDLE_NULL || handle >= gc_heap->handles.count) {
         return NULL;
     }
-    return g_gc.handles.ptrs[handle];
+    return gc_heap->handles.ptrs[handle];
 }
 
 bool gc_handle_is_valid(GCHandle handle) {
-    if (handle == GC_HANDLE_NULL || handle >= g_gc.handles.count) {
+    if (handle == GC_HANDLE_NULL || handle >= gc_heap->handles.count) {
         return false;
     }
-    void *ptr = g_gc.handles.ptrs[handle];
+    void *ptr = gc_heap->handles.ptrs[handle];
     if (!ptr) return false;
     GCHeader *hdr = gc_header(ptr);
     return hdr->size > 0;
@@ -256,142 +963,722 @@ JSGCObjectTypeEnum gc_handle_get_type(GCHandle handle) {
     return (JSGCObjectTypeEnum)hdr->gc_obj_type;
 }
 
-static void gc_mark(void) {
-    size_t offset = ALIGN16(GC_INITIAL_HANDLES * sizeof(void*)) + 
-                    ALIGN16(1024 * sizeof(GCHandle));
+void gc_clear_marks(void) {
+    size_t bump = atomic_load(&gc_heap->bump.offset);
+    for (size_t offset = 0; offset < bump;) {
+        GCHeader *hdr = (GCHeader*)(gc_heap->heap + offset);
+        hdr->mark = 0;
+        offset += hdr->size > 0 ? hdr->size : MIN_OBJECT_SIZE;
+    }
+    for (uint32_t i = 0; i < gc_heap->large.count; i++) {
+        gc_heap->large.objects[i]->mark = 0;
+    }
+}
+
+void gc_set_precise(GCHandle handle) {
+    void *ptr = gc_deref(handle);
+    if (ptr) gc_header(ptr)->flags |= GC_FLAG_PRECISE;
+}
+
+/* One bit per 16 bytes of heap, set over dead blocks */
+static void dead_bits_set(uint64_t *bits, size_t start, size_t end) {
+    for (size_t i = start / 16; i < end / 16; i++) {
+        bits[i / 64] |= 1ull << (i % 64);
+    }
+}
+
+static bool dead_bits_test(const uint64_t *bits, size_t offset) {
+    size_t i = offset / 16;
+    return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+/* A block is dead once it has neither a handle nor a mark. Runs of dead
+ * blocks merge into one free block, and a run at the end goes back to the
+ * bump pointer. */
+size_t gc_sweep_unmarked(JSRuntime *rt, GCSweepFunc *destroy) {
+    size_t bump = atomic_load(&gc_heap->bump.offset);
     
-    while (offset < atomic_load(&g_gc.bump.offset)) {
-        GCHeader *hdr = (GCHeader*)(g_gc.heap + offset);
-        if (hdr->size > 0) {
-            hdr->mark = 0;
-            offset += hdr->size;
-        } else {
-            offset += MIN_OBJECT_SIZE;
+    gc_heap->sweeping = true;
+    for (size_t offset = 0; offset < bump;) {
+        GCHeader *hdr = (GCHeader*)(gc_heap->heap + offset);
+        offset += hdr->size > 0 ? hdr->size : MIN_OBJECT_SIZE;
+        if (hdr->handle == GC_HANDLE_NULL || hdr->mark) continue;
+        finalize_object(rt, hdr);
+        if (destroy(rt, (uint8_t*)hdr + sizeof(GCHeader))) heap_block_kill(hdr);
+    }
+    /* gc_free leaves large objects mapped while sweeping, so the table
+     * does not shift under this loop */
+    for (uint32_t i = 0; i < gc_heap->large.count; i++) {
+        GCHeader *hdr = gc_heap->large.objects[i];
+        if (hdr->handle == GC_HANDLE_NULL || hdr->mark) continue;
+        finalize_object(rt, hdr);
+        if (destroy(rt, (uint8_t*)hdr + sizeof(GCHeader))) heap_block_kill(hdr);
+    }
+    gc_heap->sweeping = false;
+    
+    bool any_dead = false;
+    for (uint32_t i = 0; i < gc_heap->large.count && !any_dead; i++) {
+        GCHeader *hdr = gc_heap->large.objects[i];
+        any_dead = hdr->handle == GC_HANDLE_NULL && !hdr->mark;
+    }
+    
+    /* Without the bitmap, handles into dead blocks stay allocated */
+    uint64_t *dead = calloc(bump / (16 * 64) + 1, sizeof(uint64_t));
+    size_t live = 0;
+    size_t run = SIZE_MAX;          /* Start of the dead run being merged */
+    free_reset();
+    for (size_t offset = 0; offset < bump;) {
+        GCHeader *hdr = (GCHeader*)(gc_heap->heap + offset);
+        size_t size = hdr->size > 0 ? hdr->size : MIN_OBJECT_SIZE;
+        if (hdr->handle != GC_HANDLE_NULL || hdr->mark) {
+            if (run != SIZE_MAX) {
+                GCHeader *block = (GCHeader*)(gc_heap->heap + run);
+                memset(block, 0, sizeof(GCHeader));
+                block->size = offset - run;
+                starts_clear_range(run + 16, offset);
+                free_push(block);
+                free_release_pages(block);
+                if (dead) dead_bits_set(dead, run, offset);
+                any_dead = true;
+                run = SIZE_MAX;
+            }
+            live += size;
+        } else if (run == SIZE_MAX) {
+            run = offset;
         }
+        offset += size;
+    }
+    if (run != SIZE_MAX) {
+        if (dead) dead_bits_set(dead, run, bump);
+        /* Pages past the bump pointer carry no released marks, and
+         * nothing there starts a block */
+        released_clear_range(run, bump);
+        starts_clear_range(run, bump);
+        atomic_store(&gc_heap->bump.offset, run);
+        any_dead = true;
     }
+    heap_release_tail();
     
-    for (uint32_t i = 0; i < g_gc.root_set.count; i++) {
-        GCHandle h = g_gc.root_set.roots[i];
-        if (h < g_gc.handles.count && g_gc.handles.ptrs[h]) {
-            GCHeader *hdr = gc_header(g_gc.handles.ptrs[h]);
-            if (hdr->size > 0) hdr->mark = 1;
+    /* A dead block's own handle went with it. What is left are handles made
+     * for interior pointers (gc_alloc_handle_for_ptr), which only a pass
+     * over the table finds: a bit test for the heap, a binary search for
+     * large objects. */
+    bool handles_released = dead != NULL;
+    if (dead && any_dead) {
+        for (uint32_t h = 1; h < gc_heap->handles.count; h++) {
+            uint8_t *ptr = gc_heap->handles.ptrs[h];
+            if (!ptr) continue;
+            if (ptr >= gc_heap->heap && ptr < gc_heap->heap + bump) {
+                if (dead_bits_test(dead, (size_t)(ptr - gc_heap->heap))) release_handle(h);
+                continue;
+            }
+            uint32_t i = large_find(ptr);
+            if (i != UINT32_MAX && gc_heap->large.objects[i]->handle == GC_HANDLE_NULL &&
+                !gc_heap->large.objects[i]->mark) {
+                release_handle(h);
+            }
         }
     }
+    free(dead);
+    
+    /* Dead large objects stay mapped until a sweep that could release the
+     * handles into them. Walking down, the entries that shift into a freed
+     * slot have already been seen. */
+    for (uint32_t i = gc_heap->large.count; handles_released && i-- > 0;) {
+        GCHeader *hdr = gc_heap->large.objects[i];
+        if (hdr->handle == GC_HANDLE_NULL && !hdr->mark) large_free_at(i);
+    }
+    
+    gc_heap->bytes_allocated = live + gc_heap->large.bytes;
+    return gc_heap->bytes_allocated;
+}
+
+size_t gc_allocated_bytes(void) {
+    return gc_heap->bytes_allocated;
 }
 
-static void gc_compact(void) {
-    size_t skip = ALIGN16(GC_INITIAL_HANDLES * sizeof(void*)) + 
-                  ALIGN16(1024 * sizeof(GCHandle));
+void gc_reset(void) {
+    if (!gc_heap->initialized) return;
     
-    uint8_t *read = g_gc.heap + skip;
-    uint8_t *write = read;
-    size_t bump = atomic_load(&g_gc.bump.offset);
-    size_t new_bytes = 0;
-    JSRuntime *rt = g_gc.rt;
+    starts_clear_range(0, atomic_load(&gc_heap->bump.offset));
+    atomic_store(&gc_heap->bump.offset, 0);
+    free_reset_all();
+    heap_release_tail();
+    large_free_all();
     
-    while ((size_t)(read - g_gc.heap) < bump) {
-        GCHeader *hdr = (GCHeader*)read;
-        
-        if (hdr->size == 0 || hdr->size < sizeof(GCHeader)) {
-            read += MIN_OBJECT_SIZE;
-            continue;
+    for (uint32_t i = 1; i < gc_heap->handles.count; i++) {
+        gc_heap->handles.ptrs[i] = NULL;
+    }
+    gc_heap->handles.count = 1;
+    gc_heap->handles.free_count = 0;
+    if (gc_heap->finalizers.count > 0) {
+        memset(gc_heap->finalizers.entries, 0, gc_heap->finalizers.capacity * sizeof(GCFinalizerEntry));
+        gc_heap->finalizers.count = 0;
+    }
+    gc_heap->root_set.count = 0;
+    gc_heap->bytes_allocated = 0;
+    gc_heap->bytes_since_gc = 0;
+}
+
+void gc_set_reset_hook(GCResetHook *hook) {
+    if (gc_heap != &gc_no_heap) gc_heap->reset_hook = hook;
+}
+
+void gc_set_exhausted_hook(GCExhaustedHook *hook) {
+    if (gc_heap != &gc_no_heap) gc_heap->exhausted_hook = hook;
+}
+
+void gc_reset_full(void) {
+    GCResetHook *hook = gc_heap->reset_hook;
+    if (hook) hook();
+    gc_cleanup();
+    if (gc_init()) gc_heap->reset_hook = hook;
+}
+
+bool gc_add_root(GCHandle handle) {
+    if (handle == GC_HANDLE_NULL) return false;
+    if (gc_heap->root_set.count >= gc_heap->root_set.capacity && !grow_roots()) return false;
+    gc_heap->root_set.roots[gc_heap->root_set.count++] = handle;
+    return true;
+}
+
+void gc_remove_root(GCHandle handle) {
+    for (uint32_t i = 0; i < gc_heap->root_set.count; i++) {
+        if (gc_heap->root_set.roots[i] == handle) {
+            gc_heap->root_set.roots[i] = gc_heap->root_set.roots[--gc_heap->root_set.count];
+            return;
         }
-        
-        uint32_t size = hdr->size;
-        
-        if (hdr->mark) {
-            if (read != write) {
-                memmove(write, read, size);
-                GCHeader *new_hdr = (GCHeader*)write;
-                if (new_hdr->handle < g_gc.handles.count) {
-                    g_gc.handles.ptrs[new_hdr->handle] = write + sizeof(GCHeader);
-                }
+    }
+}
+
+size_t gc_used_bytes(void) {
+    if (!gc_heap->initialized) return 0;
+    return atomic_load(&gc_heap->bump.offset);
+}
+
+size_t gc_available_bytes(void) {
+    if (!gc_heap->initialized) return 0;
+    return gc_heap->heap_size - atomic_load(&gc_heap->bump.offset);
+}
+
+size_t gc_total_bytes(void) {
+    return gc_heap->heap_size;
+}
+
+/* ============================================================================
+ * Parallel marking
+ *
+ * The collecting thread and the helper threads each own a Chase-Lev deque
+ * of objects waiting to be traced: the owner pushes and takes at the
+ * bottom, a worker that runs dry steals from the top of the others. A full
+ * deque spills into a shared overflow stack. Marks are set with an atomic
+ * exchange, so each object is traced by exactly one worker. Marking ends
+ * when every worker is idle and no deque or overflow holds work.
+ *
+ * Each heap keeps its own marking state, so heaps on different threads
+ * mark at the same time. The helpers are started on first use and live
+ * for the process, sleeping between collections. They serve one marking at
+ * a time: a heap that finds them busy marks on its own thread instead of
+ * waiting.
+ * ============================================================================ */
+
+#define GC_MARK_DEQUE_SIZE 16384    /* Entries, a power of two */
+
+typedef struct GCMarkDeque {
+    _Atomic size_t top;             /* Stolen from here */
+    _Atomic size_t bottom;          /* Pushed and taken here by the owner */
+    _Atomic(void *) *slots;
+} __attribute__((aligned(64))) GCMarkDeque;
+
+struct GCMarking {
+    JSRuntime *rt;
+    GCTraceFunc *trace;
+    uint32_t words_lo;              /* See gc_mark_words */
+    uint32_t words_hi;
+    GCWordFunc *words;
+    uint32_t workers;               /* Deques in use, the collector's first */
+    _Atomic uint32_t active;
+    pthread_mutex_t overflow_lock;
+    void **overflow;
+    size_t overflow_count;
+    size_t overflow_capacity;
+    _Atomic size_t overflow_pending;
+    uint64_t begin_ns;
+    GCMarkDeque deques[GC_MAX_MARK_HELPERS + 1];
+};
+
+static struct {
+    pthread_mutex_t busy;           /* Held while the helpers serve a marking */
+    pthread_mutex_t lock;           /* Guards the helper bookkeeping */
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint32_t helpers;               /* Started */
+    uint32_t helpers_wanted;        /* 0 until set or defaulted */
+    bool helpers_set;
+    uint32_t epoch;                 /* Bumped to hand the helpers a marking */
+    uint32_t helper_epoch[GC_MAX_MARK_HELPERS + 1];  /* Last one each helper saw */
+    uint32_t participants;          /* Helpers taking part in this one */
+    uint32_t finished;
+    GCState *heap;                  /* Made current on the helpers while they mark */
+} g_mark = {
+    .busy = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+/* The deque gc_mark_object pushes to on this thread, NULL when not marking */
+static __thread GCMarkDeque *t_mark_deque;
+
+static bool deque_push(GCMarkDeque *deque, void *ptr) {
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    size_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (!deque->slots || bottom - top >= GC_MARK_DEQUE_SIZE) return false;
+    atomic_store_explicit(&deque->slots[bottom & (GC_MARK_DEQUE_SIZE - 1)], ptr,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return true;
+}
+
+static void *deque_take(GCMarkDeque *deque) {
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    size_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if (bottom == top) return NULL;
+    bottom--;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    
+    void *ptr = NULL;
+    if (top <= bottom) {
+        ptr = atomic_load_explicit(&deque->slots[bottom & (GC_MARK_DEQUE_SIZE - 1)],
+                                   memory_order_relaxed);
+        if (top == bottom) {
+            /* Last entry: race the thieves for it */
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                         memory_order_seq_cst,
+                                                         memory_order_relaxed)) {
+                ptr = NULL;
             }
-            write += size;
-            new_bytes += size;
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return ptr;
+}
+
+static void *deque_steal(GCMarkDeque *deque) {
+    size_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) return NULL;
+    
+    void *ptr = atomic_load_explicit(&deque->slots[top & (GC_MARK_DEQUE_SIZE - 1)],
+                                     memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return NULL;                /* Lost to the owner or another thief */
+    }
+    return ptr;
+}
+
+static bool deque_empty(GCMarkDeque *deque) {
+    return atomic_load(&deque->top) >= atomic_load(&deque->bottom);
+}
+
+static bool overflow_push(GCMarking *m, void *ptr) {
+    bool pushed = true;
+    pthread_mutex_lock(&m->overflow_lock);
+    if (m->overflow_count == m->overflow_capacity) {
+        size_t capacity = m->overflow_capacity ? m->overflow_capacity * 2 : 4096;
+        void **overflow = realloc(m->overflow, capacity * sizeof(void*));
+        if (overflow) {
+            m->overflow = overflow;
+            m->overflow_capacity = capacity;
         } else {
-            /* Object is being freed - run finalizer if registered */
-            if (hdr->handle < g_gc.handles.count) {
-                /* Call per-handle finalizer if one is registered */
-                if (rt && hdr->finalizer) {
-                    hdr->finalizer(rt, hdr->handle, read + sizeof(GCHeader));
-                }
-                g_gc.handles.ptrs[hdr->handle] = NULL;
+            pushed = false;
+        }
+    }
+    if (pushed) {
+        m->overflow[m->overflow_count++] = ptr;
+        atomic_fetch_add(&m->overflow_pending, 1);
+    }
+    pthread_mutex_unlock(&m->overflow_lock);
+    return pushed;
+}
+
+static void *overflow_pop(GCMarking *m) {
+    if (atomic_load(&m->overflow_pending) == 0) return NULL;
+    void *ptr = NULL;
+    pthread_mutex_lock(&m->overflow_lock);
+    if (m->overflow_count > 0) {
+        ptr = m->overflow[--m->overflow_count];
+        atomic_fetch_sub(&m->overflow_pending, 1);
+    }
+    pthread_mutex_unlock(&m->overflow_lock);
+    return ptr;
+}
+
+static void *mark_next(GCMarking *m, GCMarkDeque *own) {
+    void *ptr = deque_take(own);
+    if (!ptr) ptr = overflow_pop(m);
+    uint32_t workers = m->workers;
+    uint32_t start = (uint32_t)(own - m->deques);
+    for (uint32_t i = 1; !ptr && i < workers; i++) {
+        ptr = deque_steal(&m->deques[(start + i) % workers]);
+    }
+    return ptr;
+}
+
+static bool mark_work_left(GCMarking *m) {
+    if (atomic_load(&m->overflow_pending) > 0) return true;
+    for (uint32_t i = 0; i < m->workers; i++) {
+        if (!deque_empty(&m->deques[i])) return true;
+    }
+    return false;
+}
+
+/* Traces until no worker has anything left. A worker only queues work
+ * while active and drains its own deque before going idle, so once all of
+ * them are idle with nothing queued, no more work can appear. */
+static void mark_work(GCMarking *m, GCMarkDeque *own) {
+    for (;;) {
+        void *ptr;
+        while ((ptr = mark_next(m, own))) {
+            trace_block(m, ptr);
+        }
+        atomic_fetch_sub(&m->active, 1);
+        for (;;) {
+            if (mark_work_left(m)) {
+                atomic_fetch_add(&m->active, 1);
+                break;
             }
+            if (atomic_load(&m->active) == 0) return;
+            sched_yield();
         }
+    }
+}
+
+static void *mark_helper(void *arg) {
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+    pthread_mutex_lock(&g_mark.lock);
+    for (;;) {
+        while (g_mark.epoch == g_mark.helper_epoch[index]) {
+            pthread_cond_wait(&g_mark.wake, &g_mark.lock);
+        }
+        g_mark.helper_epoch[index] = g_mark.epoch;
+        if (index > g_mark.participants) continue;
+        pthread_mutex_unlock(&g_mark.lock);
+        
+        gc_heap = g_mark.heap;
+        GCMarking *m = gc_heap->marking;
+        t_mark_deque = &m->deques[index];
+        mark_work(m, t_mark_deque);
+        t_mark_deque = NULL;
+        gc_heap = &gc_no_heap;
         
-        read += size;
+        pthread_mutex_lock(&g_mark.lock);
+        g_mark.finished++;
+        pthread_cond_signal(&g_mark.done);
     }
-    
-    atomic_store(&g_gc.bump.offset, write - g_gc.heap);
-    g_gc.bytes_allocated = new_bytes;
+    return NULL;
 }
 
-static void gc_run_internal(void) {
-    if (!g_gc.initialized) return;
-    gc_mark();
-    gc_compact();
+static bool deque_alloc(GCMarkDeque *deque) {
+    if (!deque->slots) deque->slots = malloc(GC_MARK_DEQUE_SIZE * sizeof(void*));
+    return deque->slots != NULL;
 }
 
-static void gc_maybe_run(void) {
-    if (g_gc.bytes_allocated > g_gc.gc_threshold) {
-        gc_run_internal();
+/* Called with g_mark.lock held. Returns how many helpers can join m. */
+static uint32_t mark_start_helpers(GCMarking *m) {
+    if (!g_mark.helpers_set) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        g_mark.helpers_wanted = cpus > 1 ? (uint32_t)(cpus - 1) : 0;
+        if (g_mark.helpers_wanted > GC_MAX_MARK_HELPERS) g_mark.helpers_wanted = GC_MAX_MARK_HELPERS;
+        g_mark.helpers_set = true;
+    }
+    while (g_mark.helpers < g_mark.helpers_wanted) {
+        uint32_t index = g_mark.helpers + 1;
+        /* It may only get the lock after the marking it was started for
+         * has been handed out */
+        g_mark.helper_epoch[index] = g_mark.epoch;
+        
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        bool started = pthread_create(&thread, &attr, mark_helper, (void*)(uintptr_t)index) == 0;
+        pthread_attr_destroy(&attr);
+        if (!started) break;
+        g_mark.helpers++;
     }
+    uint32_t helpers = g_mark.helpers < g_mark.helpers_wanted ? g_mark.helpers : g_mark.helpers_wanted;
+    for (uint32_t i = 1; i <= helpers; i++) {
+        if (!deque_alloc(&m->deques[i])) return i - 1;
+    }
+    return helpers;
 }
 
-void gc_run(void) {
-    gc_run_internal();
+void gc_set_mark_helpers(uint32_t helpers) {
+    pthread_mutex_lock(&g_mark.lock);
+    g_mark.helpers_wanted = helpers > GC_MAX_MARK_HELPERS ? GC_MAX_MARK_HELPERS : helpers;
+    g_mark.helpers_set = true;
+    pthread_mutex_unlock(&g_mark.lock);
 }
 
-void gc_reset(void) {
-    if (!g_gc.initialized) return;
+static GCMarking *marking_new(void) {
+    GCMarking *m = calloc(1, sizeof(GCMarking));
+    if (m) pthread_mutex_init(&m->overflow_lock, NULL);
+    return m;
+}
+
+static void marking_free(GCMarking *m) {
+    if (!m) return;
+    for (uint32_t i = 0; i <= GC_MAX_MARK_HELPERS; i++) free(m->deques[i].slots);
+    free(m->overflow);
+    pthread_mutex_destroy(&m->overflow_lock);
+    free(m);
+}
+
+void gc_mark_begin(JSRuntime *rt, GCTraceFunc *trace) {
+    GCMarking *m = gc_heap->marking;
+    if (!m) return;                 /* No heap: nothing to mark */
+    m->begin_ns = gc_now_ns();
+    m->rt = rt;
+    m->trace = trace;
+    m->words_lo = m->words_hi = 0;
+    m->words = NULL;
+    m->workers = 1;
+    deque_alloc(&m->deques[0]);
+    t_mark_deque = &m->deques[0];
+}
+
+bool gc_mark_object(void *user_ptr) {
+    GCHeader *hdr = gc_header(user_ptr);
+    /* Several workers can reach the same object; the exchange picks one */
+    if (__atomic_exchange_n(&hdr->mark, 1, __ATOMIC_RELAXED)) return false;
+    if (!t_mark_deque) return true;
+    GCMarking *m = gc_heap->marking;
+    if (!deque_push(t_mark_deque, user_ptr) && !overflow_push(m, user_ptr)) {
+        /* Nowhere to queue it: trace it right here, on the C stack */
+        trace_block(m, user_ptr);
+    }
+    return true;
+}
+
+void gc_mark_words(uint32_t lo, uint32_t hi, GCWordFunc *func) {
+    GCMarking *m = gc_heap->marking;
+    if (!m || lo >= hi) return;
+    m->words_lo = lo;
+    m->words_hi = hi;
+    m->words = func;
+}
+
+void gc_mark_end(void) {
+    GCMarking *m = gc_heap->marking;
+    if (!m || !t_mark_deque) return;
+    
+    uint32_t helpers = 0;
+    if (gc_heap->handles.count - gc_heap->handles.free_count >= GC_PARALLEL_MARK_MIN_OBJECTS &&
+        mark_work_left(m) && pthread_mutex_trylock(&g_mark.busy) == 0) {
+        pthread_mutex_lock(&g_mark.lock);
+        helpers = mark_start_helpers(m);
+        if (helpers > 0) {
+            m->workers = 1 + helpers;
+            atomic_store(&m->active, m->workers);
+            g_mark.heap = gc_heap;
+            g_mark.participants = helpers;
+            g_mark.finished = 0;
+            g_mark.epoch++;
+            pthread_cond_broadcast(&g_mark.wake);
+        }
+        pthread_mutex_unlock(&g_mark.lock);
+        if (helpers == 0) pthread_mutex_unlock(&g_mark.busy);
+    }
+    if (helpers == 0) atomic_store(&m->active, 1);
     
-    size_t skip = ALIGN16(GC_INITIAL_HANDLES * sizeof(void*)) + 
-                  ALIGN16(1024 * sizeof(GCHandle));
-    atomic_store(&g_gc.bump.offset, skip);
+    mark_work(m, &m->deques[0]);
     
-    for (uint32_t i = 1; i < g_gc.handles.count; i++) {
-        g_gc.handles.ptrs[i] = NULL;
+    if (helpers > 0) {
+        pthread_mutex_lock(&g_mark.lock);
+        while (g_mark.finished < helpers) {
+            pthread_cond_wait(&g_mark.done, &g_mark.lock);
+        }
+        g_mark.heap = NULL;
+        pthread_mutex_unlock(&g_mark.lock);
+        pthread_mutex_unlock(&g_mark.busy);
     }
-    g_gc.handles.count = 1;
-    g_gc.root_set.count = 0;
-    g_gc.bytes_allocated = 0;
+    t_mark_deque = NULL;
+    gc_heap->stats.mark_ns += gc_now_ns() - m->begin_ns;
+    gc_heap->stats.last_mark_threads = 1 + helpers;
 }
 
-void gc_reset_full(void) {
-    extern void browser_stubs_reset(void);
-    extern void js_quickjs_reset_class_ids(void);
-    browser_stubs_reset();
-    js_quickjs_reset_class_ids();
-    gc_cleanup();
-    gc_init();
+/* ============================================================================
+ * Native roots
+ *
+ * Native code holds objects in C locals and in registers, as handles or as
+ * raw pointers, often into the middle of a block. No runtime structure
+ * lists them, so the stack is scanned conservatively: every aligned word
+ * that is a live handle, or points into a live block, marks that block.
+ * Marked blocks are scanned the same way, see trace_block.
+ * A word that only happens to look like one keeps garbage alive until it
+ * changes, which costs memory but never frees a block in use.
+ * ============================================================================ */
+
+/* Marks the live block holding ptr, if any */
+static void mark_address(const uint8_t *ptr) {
+    GCHeader *hdr = NULL;
+    if (ptr >= gc_heap->heap && ptr < gc_heap->heap + atomic_load(&gc_heap->bump.offset)) {
+        hdr = heap_block_at((size_t)(ptr - gc_heap->heap));
+    } else if (gc_heap->large.count > 0) {
+        uint32_t i = large_find(ptr);
+        if (i != UINT32_MAX && gc_heap->large.objects[i]->handle != GC_HANDLE_NULL) {
+            hdr = gc_heap->large.objects[i];
+        }
+    }
+    if (hdr) gc_mark_object(hdr + 1);
 }
 
-void gc_add_root(GCHandle handle) {
-    if (handle == GC_HANDLE_NULL) return;
-    if (g_gc.root_set.count >= g_gc.root_set.capacity) return;
-    g_gc.root_set.roots[g_gc.root_set.count++] = handle;
+/* Reads the stack between frames, so it must not trip the address
+ * sanitizer's redzones */
+__attribute__((no_sanitize_address))
+static void scan_words(GCMarking *m, const uint8_t *start, const uint8_t *end) {
+    const uint8_t *heap_end = gc_heap->heap + atomic_load(&gc_heap->bump.offset);
+    uint32_t count = gc_heap->handles.count;
+    start = (const uint8_t*)(((uintptr_t)start + 3) & ~(uintptr_t)3);
+    for (const uint8_t *w = start; w + sizeof(uint32_t) <= end; w += sizeof(uint32_t)) {
+        uint32_t word = *(const uint32_t*)w;
+        if (word - 1 < count - 1) {
+            void *ptr = gc_heap->handles.ptrs[word];
+            if (ptr) mark_address(ptr);
+        }
+        if (word - m->words_lo < m->words_hi - m->words_lo) m->words(m->rt, word);
+        if ((uintptr_t)w % sizeof(void*) == 0 && w + sizeof(void*) <= end) {
+            const uint8_t *ptr = *(const uint8_t *const *)w;
+            if ((ptr >= gc_heap->heap && ptr < heap_end) ||
+                (gc_heap->large.count > 0 && ptr >= (uint8_t*)gc_heap->large.objects[0])) {
+                mark_address(ptr);
+            }
+        }
+    }
 }
 
-void gc_remove_root(GCHandle handle) {
-    for (uint32_t i = 0; i < g_gc.root_set.count; i++) {
-        if (g_gc.root_set.roots[i] == handle) {
-            g_gc.root_set.roots[i] = g_gc.root_set.roots[--g_gc.root_set.count];
-            return;
+/* Highest address of the calling thread's stack, looked up once */
+static __thread const uint8_t *t_stack_top;
+
+static const uint8_t *stack_top(void) {
+    if (!t_stack_top) {
+        pthread_attr_t attr;
+        void *base;
+        size_t size;
+        if (pthread_getattr_np(pthread_self(), &attr) != 0) return NULL;
+        if (pthread_attr_getstack(&attr, &base, &size) == 0) {
+            t_stack_top = (const uint8_t*)base + size;
         }
+        pthread_attr_destroy(&attr);
     }
+    return t_stack_top;
 }
 
-size_t gc_used_bytes(void) {
-    if (!g_gc.initialized) return 0;
-    return atomic_load(&g_gc.bump.offset);
+/* Scans every frame above this one. Kept out of line so the caller's
+ * frame, where the registers were spilled, is among them. */
+__attribute__((noinline))
+static void scan_stack(GCMarking *m) {
+    const uint8_t *top = stack_top();
+    const uint8_t *here = __builtin_frame_address(0);
+    if (top && here < top) scan_words(m, here, top);
 }
 
-size_t gc_available_bytes(void) {
-    if (!g_gc.initialized) return 0;
-    return g_gc.heap_size - atomic_load(&g_gc.bump.offset);
+/* Strings and big ints are characters and digits, shapes are traced in
+ * full by the runtime */
+static void trace_block(GCMarking *m, void *ptr) {
+    m->trace(m->rt, ptr);
+    GCHeader *hdr = gc_header(ptr);
+    if ((hdr->flags & GC_FLAG_PRECISE) ||
+        hdr->gc_obj_type == JS_GC_OBJ_TYPE_JS_STRING ||
+        hdr->gc_obj_type == JS_GC_OBJ_TYPE_JS_BIGINT ||
+        hdr->gc_obj_type == JS_GC_OBJ_TYPE_SHAPE) {
+        return;
+    }
+    scan_words(m, ptr, (uint8_t*)hdr + hdr->size);
 }
 
-size_t gc_total_bytes(void) {
-    return g_gc.heap_size;
+void gc_mark_native_roots(void) {
+    GCMarking *m = gc_heap->marking;
+    if (!m || !t_mark_deque) return;
+    for (uint32_t i = 0; i < gc_heap->root_set.count; i++) {
+        void *ptr = gc_deref(gc_heap->root_set.roots[i]);
+        if (ptr) mark_address(ptr);
+    }
+    /* Callee-saved registers go to this frame */
+    __builtin_unwind_init();
+    scan_stack(m);
+}
+
+/* ============================================================================
+ * Pacing
+ * ============================================================================ */
+
+static void gc_update_threshold(void) {
+    size_t growth = gc_heap->stats.live_bytes / 100 * gc_heap->growth_percent;
+    gc_heap->gc_threshold = growth > gc_heap->min_threshold ? growth : gc_heap->min_threshold;
+}
+
+bool gc_should_run(void) {
+    return gc_heap->initialized && gc_heap->bytes_since_gc >= gc_heap->gc_threshold;
+}
+
+void gc_set_threshold(size_t threshold) {
+    gc_heap->min_threshold = threshold;
+    gc_update_threshold();
+}
+
+void gc_set_growth_percent(uint32_t percent) {
+    gc_heap->growth_percent = percent;
+    gc_update_threshold();
+}
+
+void gc_collection_begin(void) {
+    gc_heap->stats.begin_ns = gc_now_ns();
+}
+
+void gc_collection_end(size_t live_bytes) {
+    uint64_t pause = gc_now_ns() - gc_heap->stats.begin_ns;
+    gc_heap->stats.collections++;
+    gc_heap->stats.last_pause_ns = pause;
+    gc_heap->stats.total_pause_ns += pause;
+    if (pause > gc_heap->stats.max_pause_ns) gc_heap->stats.max_pause_ns = pause;
+    gc_heap->stats.live_bytes = live_bytes;
+    gc_heap->bytes_since_gc = 0;
+    gc_update_threshold();
+}
+
+void gc_get_stats(GCStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (!gc_heap->initialized) return;
+    uint64_t lifetime = gc_now_ns() - gc_heap->stats.init_ns;
+    stats->collections = gc_heap->stats.collections;
+    stats->total_pause_ns = gc_heap->stats.total_pause_ns;
+    stats->max_pause_ns = gc_heap->stats.max_pause_ns;
+    stats->last_pause_ns = gc_heap->stats.last_pause_ns;
+    stats->mutator_ns = lifetime > stats->total_pause_ns ?
+                        lifetime - stats->total_pause_ns : 0;
+    stats->live_bytes = gc_heap->stats.live_bytes;
+    stats->allocated_since_gc = gc_heap->bytes_since_gc;
+    stats->next_collection_bytes = gc_heap->gc_threshold;
+    stats->total_allocated = gc_heap->stats.total_allocated;
+    stats->heap_used_bytes = atomic_load(&gc_heap->bump.offset);
+    stats->heap_free_bytes = gc_heap->free_space.bytes;
+    stats->heap_committed_bytes = atomic_load(&gc_heap->bump.committed);
+    stats->large_objects = gc_heap->large.count;
+    stats->large_object_bytes = gc_heap->large.bytes;
+    stats->handles_used = gc_heap->handles.count - 1 - gc_heap->handles.free_count;
+    stats->handle_capacity = gc_heap->handles.capacity;
+    stats->roots_used = gc_heap->root_set.count;
+    stats->root_capacity = gc_heap->root_set.capacity;
+    stats->mark_ns = gc_heap->stats.mark_ns;
+    stats->last_mark_threads = gc_heap->stats.last_mark_threads;
 }
@@ -25,9 +25,35 @@ typedef struct JSContext JSContext;
 typedef uint32_t GCHandle;
 #define GC_HANDLE_NULL 0
 
+/* Reserved address space for the object heap, committed in chunks */
 #define GC_HEAP_SIZE (512 * 1024 * 1024)
-#define GC_INITIAL_HANDLES 100000
-#define GC_DEFAULT_THRESHOLD (256 * 1024)
+#define GC_HEAP_COMMIT_CHUNK (1024 * 1024)
+
+/* Allocations this size and up get their own mapping and are never moved */
+#define GC_LARGE_OBJECT_SIZE (128 * 1024)
+/* Handle table and root set live in their own reserved ranges and grow
+ * geometrically from the initial to the maximum capacity */
+#define GC_INITIAL_HANDLES 65536
+#define GC_MAX_HANDLES (16u * 1024 * 1024)
+#define GC_INITIAL_ROOTS 1024
+#define GC_MAX_ROOTS (1024u * 1024)
+/* Collections are paced by allocation: the next one is due once the bytes
+ * allocated since the last one exceed the live heap it left behind times
+ * the growth factor, but never fewer than the minimum threshold. Every
+ * collection is full: there is no nursery, because blocks hold raw pointers
+ * into each other and the native stack is scanned conservatively, so
+ * objects cannot move, and stores into objects have no write barrier. */
+#define GC_DEFAULT_THRESHOLD (4 * 1024 * 1024)
+#define GC_DEFAULT_GROWTH_PERCENT 100
+/* Marking runs on the collecting thread plus up to this many helper
+ * threads, once the heap has GC_PARALLEL_MARK_MIN_OBJECTS live handles;
+ * below that, waking the helpers costs more than it saves */
+#define GC_MAX_MARK_HELPERS 7
+#define GC_PARALLEL_MARK_MIN_OBJECTS 50000
+/* Swept heap blocks are reused from free lists: one per 16-byte size
+ * below GC_FREE_CLASSES * 16 bytes, then one per power of two */
+#define GC_FREE_CLASSES 64
+#define GC_FREE_BINS 20
 
 typedef enum {
     JS_GC_OBJ_TYPE_JS_OBJECT = 0,
@@ -87,32 +113,49 @@ typedef enum {
     GC_HANDLE_ARRAY_WEAKREF,
 } GCHandleArrayType;
 
+/* Every object carries this header, so it holds only what the collector
+ * touches on each object. The rare extras live in side tables: finalizers
+ * in the heap's finalizer table, keyed by handle, and large objects in
+ * its large-object array.
+ * 16 bytes, which keeps the object after it 16-byte aligned. */
 typedef struct GCHeader {
-    int ref_count_unused;
-    unsigned int gc_obj_type : 4;
-    unsigned int mark : 1;
-    unsigned int dummy0 : 3;
-    uint8_t dummy1;
-    uint16_t dummy2;
-    struct {
-        void *next;
-        void *prev;
-    } link;
     uint32_t handle;
-    uint32_t size;
-    uint8_t flags;
-    uint16_t pad;
-    GCFinalizerFunc *finalizer;  /* Per-handle finalizer - called when object is freed */
+    uint32_t size;                  /* Header included */
+    uint8_t mark;                   /* A byte of its own, set atomically by gc_mark_object */
+    unsigned int gc_obj_type : 4;
+    unsigned int flags : 3;         /* GC_FLAG_* */
+    unsigned int reserved : 17;
+    uint32_t pad;
 } GCHeader;
 
+#define GC_FLAG_LARGE 0x01          /* In the large-object space, see gc_alloc_ex */
+#define GC_FLAG_FINALIZER 0x02      /* Has an entry in the finalizer table */
+#define GC_FLAG_PRECISE 0x04        /* Never scanned, see gc_set_precise */
+
+/* Each runtime has a heap of its own: object space, handle table, root set
+ * and pacing. Every gc_* call works on the calling thread's current heap,
+ * so independent runtimes can run on different threads at once.
+ *
+ * gc_init creates a heap and makes it current on the calling thread (it
+ * does nothing if one is current already); gc_cleanup destroys the current
+ * heap. A runtime that moves to another thread brings its heap along, see
+ * JS_UpdateStackTop. */
 bool gc_init(void);
 bool gc_is_initialized(void);
 void gc_cleanup(void);
 void gc_set_runtime(JSRuntime *rt);
 
+typedef struct GCState GCState;
+/* NULL when the calling thread has no heap */
+GCState *gc_current_heap(void);
+void gc_set_current_heap(GCState *heap);
+
 GCHandle gc_alloc(size_t size, JSGCObjectTypeEnum gc_obj_type);
 GCHandle gc_alloc_ex(size_t size, JSGCObjectTypeEnum gc_obj_type,
                      GCHandleArrayType array_type);
+/* Resizes in place, keeping the handle, when the block is the most recent
+ * allocation, is shrinking or is a large object; otherwise moves it to a
+ * new handle */
 GCHandle gc_realloc(GCHandle handle, size_t new_size);
 
 /* Allocate a handle for an existing pointer */
@@ -121,6 +164,10 @@ GCHandle gc_alloc_handle_for_ptr(void *ptr);
 /* Like gc_realloc but returns slack (extra usable space) for array optimization */
 GCHandle gc_realloc2(GCHandle handle, size_t new_size, size_t *pslack);
 
+/* Releases an allocation the caller knows is dead. Large objects are
+ * unmapped right away, others go back to the bump pointer or a free list. */
+void gc_free(GCHandle handle);
+
 /* Forward declaration needed by inline functions below */
 void *gc_deref(GCHandle handle);
 static inline GCHeader *gc_header(void *user_ptr) {
@@ -188,15 +235,117 @@ static inline void *gc_alloc_js_object_ex(size_t size, JSGCObjectTypeEnum gc_obj
 bool gc_handle_is_valid(GCHandle handle);
 JSGCObjectTypeEnum gc_handle_get_type(GCHandle handle);
 
-void gc_run(void);
 void gc_reset(void);
+
+/* Called by gc_reset_full before the heap is torn down, for embedder state
+ * (class IDs, stub globals) that must not outlive it. Registered per heap
+ * and carried over to the heap gc_reset_full creates. */
+typedef void GCResetHook(void);
+void gc_set_reset_hook(GCResetHook *hook);
 void gc_reset_full(void);
 
+/* Called by gc_alloc_ex when the heap is full, with the heap's runtime, so
+ * that a collection can make room; the allocation is then retried once.
+ * Never re-entered. Registered per heap. */
+typedef void GCExhaustedHook(JSRuntime *rt);
+void gc_set_exhausted_hook(GCExhaustedHook *hook);
+
 size_t gc_used_bytes(void);
 size_t gc_available_bytes(void);
 size_t gc_total_bytes(void);
 
-void gc_add_root(GCHandle handle);
+/* Collection pacing. The interpreter asks gc_should_run() at its safepoints
+ * and brackets each collection with gc_collection_begin/end. */
+bool gc_should_run(void);
+void gc_set_threshold(size_t threshold);        /* Minimum bytes between collections, SIZE_MAX disables */
+void gc_set_growth_percent(uint32_t percent);   /* Allowed growth over the live heap */
+void gc_collection_begin(void);
+void gc_collection_end(size_t live_bytes);
+/* Bytes of live allocations, large objects included; exact right after
+ * gc_sweep_unmarked */
+size_t gc_allocated_bytes(void);
+
+/* Transitive marking, shared between the collecting thread and the mark
+ * helpers. Between gc_mark_begin and gc_mark_end, gc_mark_object sets an
+ * object's mark and queues it; gc_mark_end traces the queue to a fixpoint,
+ * calling trace on each queued object, which must report the children
+ * through gc_mark_object. trace may run on any of the marking threads at
+ * once, so it must only read the heap. Heaps mark independently; the
+ * helper threads join one marking at a time.
+ *
+ * After trace, the block itself is scanned conservatively, the way
+ * gc_mark_native_roots scans the stack, so plain data and payloads the
+ * runtime has no layout for keep what they name. Strings and big ints
+ * hold no references and shapes are traced in full, so those are not
+ * scanned, nor are blocks set precise. */
+typedef void GCTraceFunc(JSRuntime *rt, void *user_ptr);
+void gc_mark_begin(JSRuntime *rt, GCTraceFunc *trace);
+/* Returns false if the object was already marked */
+bool gc_mark_object(void *user_ptr);
+void gc_mark_end(void);
+/* For references that are not handles, such as atom indices: each 32-bit
+ * word the scans find in [lo, hi) is passed to func, on any of the marking
+ * threads. Set after gc_mark_begin, for that marking only. */
+typedef void GCWordFunc(JSRuntime *rt, uint32_t word);
+void gc_mark_words(uint32_t lo, uint32_t hi, GCWordFunc *func);
+/* Leaves the block to trace alone: its handles do not keep anything alive,
+ * which is what a weak table wants. Moves with the block on gc_realloc. */
+void gc_set_precise(GCHandle handle);
+/* Helper threads to use, up to GC_MAX_MARK_HELPERS. Defaults to one less
+ * than the number of CPUs; 0 marks on the collecting thread only. */
+void gc_set_mark_helpers(uint32_t helpers);
+/* Marks what native code holds, between gc_mark_begin and gc_mark_end: the
+ * handles registered with gc_add_root, and every block the calling
+ * thread's stack and registers name, by handle or by a pointer anywhere
+ * into it. The scan is conservative: a word that only looks like a handle
+ * keeps its block too. */
+void gc_mark_native_roots(void);
+
+/* Non-moving collection driven by the runtime's marks. gc_clear_marks
+ * clears them before the runtime marks from its roots.
+ * gc_sweep_unmarked then runs the handle finalizer of each unmarked object
+ * that still has a handle, once, and offers the object to destroy, which
+ * tears it down and returns true for the heap to take its block back, or
+ * false to keep it. Every unmarked object is still intact while destroy
+ * runs. Dead blocks are coalesced onto the free lists
+ * or returned to the bump pointer, dead large objects are unmapped, and
+ * every handle into either is released. Returns the live bytes. */
+typedef bool GCSweepFunc(JSRuntime *rt, void *user_ptr);
+void gc_clear_marks(void);
+size_t gc_sweep_unmarked(JSRuntime *rt, GCSweepFunc *destroy);
+
+typedef struct GCStats {
+    uint32_t collections;
+    uint64_t total_pause_ns;
+    uint64_t max_pause_ns;
+    uint64_t last_pause_ns;
+    uint64_t mutator_ns;            /* Time outside collections since gc_init */
+    size_t live_bytes;              /* Live after the last collection */
+    size_t allocated_since_gc;
+    size_t next_collection_bytes;   /* Allocation that triggers the next collection */
+    uint64_t total_allocated;
+    size_t heap_used_bytes;         /* Bump pointer, live and dead objects */
+    size_t heap_free_bytes;         /* On the free lists, below the bump pointer */
+    size_t heap_committed_bytes;    /* Readable and writable */
+    uint32_t large_objects;
+    size_t large_object_bytes;      /* Mapped for large objects */
+    uint32_t handles_used;          /* Table occupancy */
+    uint32_t handle_capacity;
+    uint32_t roots_used;
+    uint32_t root_capacity;
+    uint64_t mark_ns;               /* Transitive marking, all collections */
+    uint32_t last_mark_threads;     /* Collecting thread included */
+} GCStats;
+
+void gc_get_stats(GCStats *stats);
+/* Committed heap pages actually in memory. Asks the kernel page by page,
+ * so it is for diagnostics, not for every collection. */
+size_t gc_resident_bytes(void);
+
+/* Keeps a handle's block alive for native code that holds it where no
+ * collection looks, see gc_mark_native_roots. Returns false once
+ * GC_MAX_ROOTS roots are registered. */
+bool gc_add_root(GCHandle handle);
 void gc_remove_root(GCHandle handle);
 
 /*
@@ -209,31 +358,80 @@ static inline GCHandle gc_ptr_to_handle(void *ptr) {
     return hdr ? hdr->handle : GC_HANDLE_NULL;
 }
 
-typedef struct GCState {
+typedef struct GCFinalizerEntry {
+    GCHandle handle;                /* GC_HANDLE_NULL for an empty slot */
+    GCFinalizerFunc *finalizer;
+} GCFinalizerEntry;
+
+struct GCState {
     uint8_t *heap;
     size_t heap_size;
     struct {
         uint8_t *base;
         _Atomic size_t offset;
+        _Atomic size_t committed;   /* Usable prefix of the reservation */
+        _Atomic size_t dirty_end;   /* Pages below it may have been written since the tail was released */
         size_t capacity;
     } bump;
     struct {
         void **ptrs;
         uint32_t count;
         uint32_t capacity;
+        uint32_t *free;             /* Stack of released slots below count */
+        uint32_t free_count;
     } handles;
+    uint64_t *starts;               /* A bit per 16 bytes of heap, set where a block begins */
+    struct {
+        GCHeader *exact[GC_FREE_CLASSES];   /* Blocks of exactly index * 16 bytes */
+        GCHeader *big[GC_FREE_BINS];        /* From 2^i * GC_FREE_CLASSES * 16 bytes */
+        size_t bytes;
+        uint64_t *released;                 /* A bit per heap page given back to the OS */
+    } free_space;
+    bool sweeping;                  /* Freed blocks are left to gc_sweep_unmarked */
+    struct {
+        GCHeader **objects;         /* Sorted by address */
+        uint32_t count;
+        uint32_t capacity;
+        size_t bytes;
+    } large;
+    struct {
+        GCFinalizerEntry *entries;  /* Open addressing on the handle */
+        uint32_t count;
+        uint32_t capacity;          /* Power of two, or 0 */
+    } finalizers;
     struct {
         GCHandle *roots;
         uint32_t count;
         uint32_t capacity;
     } root_set;
     size_t bytes_allocated;
-    size_t gc_threshold;
+    size_t gc_threshold;            /* Bytes since the last collection that trigger the next */
+    size_t min_threshold;
+    uint32_t growth_percent;
+    size_t bytes_since_gc;
+    struct {
+        uint32_t collections;
+        uint64_t total_pause_ns;
+        uint64_t max_pause_ns;
+        uint64_t last_pause_ns;
+        uint64_t init_ns;
+        uint64_t begin_ns;          /* Start of the collection in progress */
+        size_t live_bytes;
+        uint64_t total_allocated;
+        uint64_t mark_ns;
+        uint32_t last_mark_threads;
+    } stats;
+    struct GCMarking *marking;      /* This heap's mark deques, see gc_mark_begin */
+    GCResetHook *reset_hook;
+    GCExhaustedHook *exhausted_hook;
+    bool in_exhausted_hook;
     JSRuntime *rt;
     bool initialized;
-} GCState;
+};
 
-extern GCState g_gc;
+/* The calling thread's heap; an empty, uninitialized one when it has none.
+ * Set it through gc_init and gc_set_current_heap. */
+extern __thread GCState *gc_heap;
 
 #ifdef __cplusplus
 }
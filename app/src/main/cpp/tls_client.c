@@ -1,4 +1,5 @@
 #include "tls_client.h"
+#include "trace_log.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -9,13 +10,12 @@
 #include <netinet/tcp.h>
 #include <netinet/in.h>
 #include <pthread.h>
-#include <android/log.h>
 #include <time.h>
 
 #define TLS_ERR_GENERIC -0x7000
 #define LOG_TAG "minimalvulkan"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
 
 // Perfect Chrome TLS fingerprint - beyond JA3
 // JA3: 771,4865-4866-4867-49195-49199-49196-49200-52393-52392-49171-49172-156-157-47-53,0-23-65281-10-11-35-16-5-13-18-51-45-43-27-21,29-23-30-25-24,0
@@ -376,20 +376,10 @@ void tls_client_close(TlsClient *client) {
 // Global connection pools (one per host like browsers do)
 static ConnectionPool *g_connection_pools[100];
 static int g_pool_count = 0;
-static pthread_mutex_t g_pools_mutex;
-
-// Initialize global resources
-static void initialize_global_resources() {
-    static int initialized = 0;
-    if (!initialized) {
-        pthread_mutex_init(&g_pools_mutex, NULL);
-        initialized = 1;
-    }
-}
+static pthread_mutex_t g_pools_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // Find or create connection pool for host
 ConnectionPool *connection_pool_create(const char *host) {
-    initialize_global_resources();
     pthread_mutex_lock(&g_pools_mutex);
 
     // Look for existing pool
@@ -466,9 +456,10 @@ TlsClient *connection_pool_get(ConnectionPool *pool, const char *host, const cha
         int oldest_idx = -1;
         time_t oldest_time = time(NULL);
 
+        // Connections handed out to other threads are never evicted
         for (int i = 0; i < pool->count; i++) {
-            if (pool->connections[i] &&
-                pool->connections[i]->last_used < oldest_time) {
+            if (pool->connections[i] && pool->connections[i]->reusable &&
+                pool->connections[i]->last_used <= oldest_time) {
                 oldest = pool->connections[i];
                 oldest_time = pool->connections[i]->last_used;
                 oldest_idx = i;
@@ -483,6 +474,10 @@ TlsClient *connection_pool_get(ConnectionPool *pool, const char *host, const cha
                 pool->connections[j] = pool->connections[j + 1];
             }
             pool->count--;
+        } else {
+            pthread_mutex_unlock(&pool->mutex);
+            set_err(err, errLen, "Connection pool exhausted", 0);
+            return NULL;
         }
     }
 
@@ -532,8 +527,8 @@ void connection_pool_cleanup_expired(ConnectionPool *pool) {
     for (int i = 0; i < pool->count; i++) {
         TlsClient *client = pool->connections[i];
         if (client) {
-            if (!client->connected ||
-                (now - client->last_used) > CONNECTION_TIMEOUT) {
+            if (client->reusable && (!client->connected ||
+                (now - client->last_used) > CONNECTION_TIMEOUT)) {
                 // Connection expired or dead
                 tls_client_close(client);
                 free(client);
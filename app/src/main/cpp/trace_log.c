@@ -0,0 +1,283 @@
+#include "trace_log.h"
+
+#include <android/log.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TLOG_RING_SLOTS 128            /* Power of two */
+#define TLOG_TEXT_MAX 480
+#define TLOG_BATCH_BYTES (64 * 1024)
+#define TLOG_WRITER_PERIOD_MS 50
+
+typedef struct TLogRecord {
+    uint64_t time_ns;
+    const char *tag;
+    int tid;
+    uint16_t len;
+    uint8_t level;
+    char text[TLOG_TEXT_MAX];
+} TLogRecord;
+
+/* Single producer (the owning thread), single consumer (whoever holds
+ * g_drain_lock). Rings are never freed; a ring whose thread exited is
+ * handed to the next new thread once it has been drained. */
+typedef struct TLogRing {
+    atomic_uint head;                  /* Next slot the owner writes */
+    atomic_uint tail;                  /* Next slot the drain reads */
+    atomic_bool in_use;
+    int tid;
+    struct TLogRing *next;
+    TLogRecord slots[TLOG_RING_SLOTS];
+} TLogRing;
+
+int g_tlog_level = TLOG_LEVEL_INFO;
+static int g_logcat_level = TLOG_LEVEL_INFO;
+
+static _Atomic(TLogRing *) g_rings;
+static atomic_ulong g_dropped;
+static unsigned long g_dropped_reported;
+static __thread TLogRing *t_ring;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+/* Drain state */
+static pthread_mutex_t g_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static char g_path[256] = TLOG_DEFAULT_PATH;
+static bool g_path_changed = true;
+static int g_fd = -1;
+static char g_batch[TLOG_BATCH_BYTES];
+static size_t g_batch_used;
+
+static const char g_level_chars[] = "TDIWE";
+
+static int android_priority(int level) {
+    switch (level) {
+        case TLOG_LEVEL_TRACE: return ANDROID_LOG_VERBOSE;
+        case TLOG_LEVEL_DEBUG: return ANDROID_LOG_DEBUG;
+        case TLOG_LEVEL_INFO:  return ANDROID_LOG_INFO;
+        case TLOG_LEVEL_WARN:  return ANDROID_LOG_WARN;
+        default:               return ANDROID_LOG_ERROR;
+    }
+}
+
+/* ============================================================================
+ * Drain
+ * ============================================================================ */
+
+static void batch_flush(void) {
+    size_t off = 0;
+    while (g_fd >= 0 && off < g_batch_used) {
+        ssize_t n = write(g_fd, g_batch + off, g_batch_used - off);
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    g_batch_used = 0;
+}
+
+static void batch_line(const TLogRecord *rec) {
+    if (g_fd < 0) return;
+    size_t need = rec->len + 64 + strlen(rec->tag);
+    if (g_batch_used + need > sizeof(g_batch)) batch_flush();
+
+    int n = snprintf(g_batch + g_batch_used, sizeof(g_batch) - g_batch_used,
+                     "%llu.%03u %5d %c/%s: %.*s\n",
+                     (unsigned long long)(rec->time_ns / 1000000000ull),
+                     (unsigned)(rec->time_ns / 1000000ull % 1000ull),
+                     rec->tid, g_level_chars[rec->level < TLOG_LEVEL_OFF ? rec->level : 4],
+                     rec->tag, (int)rec->len, rec->text);
+    if (n > 0) {
+        size_t room = sizeof(g_batch) - g_batch_used - 1;
+        g_batch_used += (size_t)n < room ? (size_t)n : room;
+    }
+}
+
+static void drain_locked(void) {
+    if (g_path_changed) {
+        if (g_fd >= 0) close(g_fd);
+        g_fd = g_path[0] ? open(g_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644) : -1;
+        g_path_changed = false;
+    }
+
+    int logcat_level = __atomic_load_n(&g_logcat_level, __ATOMIC_RELAXED);
+    for (TLogRing *ring = atomic_load(&g_rings); ring; ring = ring->next) {
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail == head) continue;
+
+        for (; tail != head; tail++) {
+            const TLogRecord *rec = &ring->slots[tail & (TLOG_RING_SLOTS - 1)];
+            if (rec->level >= logcat_level) {
+                __android_log_write(android_priority(rec->level), rec->tag, rec->text);
+            }
+            batch_line(rec);
+        }
+        /* Hand the slots back only after the records are copied out */
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+
+    unsigned long dropped = atomic_load(&g_dropped);
+    if (dropped != g_dropped_reported) {
+        TLogRecord note = { .tag = "tlog", .level = TLOG_LEVEL_WARN, .tid = getpid() };
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        note.time_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+        int n = snprintf(note.text, sizeof(note.text), "%lu records dropped, rings full",
+                         dropped - g_dropped_reported);
+        note.len = (uint16_t)(n > 0 ? n : 0);
+        batch_line(&note);
+        g_dropped_reported = dropped;
+    }
+    batch_flush();
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_drain_lock);
+    for (;;) {
+        drain_locked();
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TLOG_WRITER_PERIOD_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_wake, &g_drain_lock, &deadline);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Producer side
+ * ============================================================================ */
+
+static void ring_release(void *arg) {
+    TLogRing *ring = arg;
+    atomic_store_explicit(&ring->in_use, false, memory_order_release);
+}
+
+static void tlog_start(void) {
+    pthread_key_create(&g_ring_key, ring_release);
+
+    pthread_t writer;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    /* Without a writer records still reach the file through tlog_flush() */
+    pthread_create(&writer, &attr, writer_main, NULL);
+    pthread_attr_destroy(&attr);
+}
+
+static TLogRing *ring_acquire(void) {
+    int tid = (int)syscall(SYS_gettid);
+
+    /* Reuse a drained ring left behind by an exited thread */
+    for (TLogRing *ring = atomic_load(&g_rings); ring; ring = ring->next) {
+        if (atomic_load(&ring->in_use)) continue;
+        if (atomic_load(&ring->head) != atomic_load(&ring->tail)) continue;
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&ring->in_use, &expected, true)) {
+            ring->tid = tid;
+            pthread_setspecific(g_ring_key, ring);
+            return ring;
+        }
+    }
+
+    TLogRing *ring = calloc(1, sizeof(TLogRing));
+    if (!ring) return NULL;
+    atomic_init(&ring->in_use, true);
+    ring->tid = tid;
+    TLogRing *first = atomic_load(&g_rings);
+    do {
+        ring->next = first;
+    } while (!atomic_compare_exchange_weak(&g_rings, &first, ring));
+    pthread_setspecific(g_ring_key, ring);
+    return ring;
+}
+
+void tlog_write(int level, const char *tag, const char *fmt, ...) {
+    pthread_once(&g_once, tlog_start);
+
+    TLogRing *ring = t_ring;
+    if (!ring) {
+        ring = t_ring = ring_acquire();
+        if (!ring) {
+            atomic_fetch_add(&g_dropped, 1);
+            return;
+        }
+    }
+
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= TLOG_RING_SLOTS) {
+        atomic_fetch_add(&g_dropped, 1);
+        pthread_cond_signal(&g_wake);
+        return;
+    }
+
+    TLogRecord *rec = &ring->slots[head & (TLOG_RING_SLOTS - 1)];
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->time_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    rec->tag = tag ? tag : "";
+    rec->tid = ring->tid;
+    rec->level = (uint8_t)level;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(rec->text, sizeof(rec->text), fmt, args);
+    va_end(args);
+    if (n < 0) n = 0;
+    if (n >= (int)sizeof(rec->text)) n = sizeof(rec->text) - 1;
+    rec->len = (uint16_t)n;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    /* Errors and half-full rings don't wait for the next period */
+    if (level >= TLOG_LEVEL_ERROR || head + 1 - tail >= TLOG_RING_SLOTS / 2) {
+        pthread_cond_signal(&g_wake);
+    }
+}
+
+/* ============================================================================
+ * Control
+ * ============================================================================ */
+
+void tlog_set_level(int level) {
+    __atomic_store_n(&g_tlog_level, level, __ATOMIC_RELAXED);
+}
+
+int tlog_get_level(void) {
+    return __atomic_load_n(&g_tlog_level, __ATOMIC_RELAXED);
+}
+
+void tlog_set_logcat_level(int level) {
+    __atomic_store_n(&g_logcat_level, level, __ATOMIC_RELAXED);
+}
+
+void tlog_set_path(const char *path) {
+    pthread_mutex_lock(&g_drain_lock);
+    snprintf(g_path, sizeof(g_path), "%s", path ? path : "");
+    g_path_changed = true;
+    pthread_mutex_unlock(&g_drain_lock);
+}
+
+void tlog_flush(void) {
+    pthread_mutex_lock(&g_drain_lock);
+    drain_locked();
+    pthread_mutex_unlock(&g_drain_lock);
+}
+
+unsigned long tlog_dropped(void) {
+    return atomic_load(&g_dropped);
+}
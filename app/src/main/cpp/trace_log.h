@@ -0,0 +1,73 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Logging and tracing for the whole native library.
+ *
+ * A call site below TLOG_COMPILE_LEVEL compiles to nothing. Above it, a
+ * call below the runtime level costs one relaxed load; in both cases the
+ * arguments are not evaluated. An enabled call formats into a ring owned
+ * by the calling thread without locking or blocking; a background thread
+ * drains all rings to the trace file and to logcat. When a ring is full
+ * the record is dropped and counted.
+ *
+ * Tags must be string literals or otherwise live for the whole process. */
+
+#define TLOG_LEVEL_TRACE 0
+#define TLOG_LEVEL_DEBUG 1
+#define TLOG_LEVEL_INFO  2
+#define TLOG_LEVEL_WARN  3
+#define TLOG_LEVEL_ERROR 4
+#define TLOG_LEVEL_OFF   5
+
+#ifndef TLOG_COMPILE_LEVEL
+#define TLOG_COMPILE_LEVEL TLOG_LEVEL_DEBUG
+#endif
+
+#define TLOG_DEFAULT_PATH "/data/data/com.bgmdwldr.vulkan/trace.log"
+
+extern int g_tlog_level;
+
+#define TLOG_ENABLED(level) \
+    ((level) >= TLOG_COMPILE_LEVEL && (level) >= __atomic_load_n(&g_tlog_level, __ATOMIC_RELAXED))
+
+#define TLOG(level, tag, ...) do { \
+    if (TLOG_ENABLED(level)) tlog_write((level), (tag), __VA_ARGS__); \
+} while (0)
+
+#define TLOG_TRACE(tag, ...) TLOG(TLOG_LEVEL_TRACE, tag, __VA_ARGS__)
+#define TLOG_DEBUG(tag, ...) TLOG(TLOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#define TLOG_INFO(tag, ...)  TLOG(TLOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define TLOG_WARN(tag, ...)  TLOG(TLOG_LEVEL_WARN, tag, __VA_ARGS__)
+#define TLOG_ERROR(tag, ...) TLOG(TLOG_LEVEL_ERROR, tag, __VA_ARGS__)
+
+/* Use the macros; this is the out-of-line half of an enabled call */
+void tlog_write(int level, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* Records below level are skipped at the call site. Default INFO. */
+void tlog_set_level(int level);
+int tlog_get_level(void);
+
+/* Records at or above level are also sent to logcat. Default INFO. */
+void tlog_set_logcat_level(int level);
+
+/* Trace file to write to, NULL for none. Takes effect on the next drain. */
+void tlog_set_path(const char *path);
+
+/* Writes out everything logged so far, on the calling thread */
+void tlog_flush(void);
+
+/* Records dropped because a ring was full */
+unsigned long tlog_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
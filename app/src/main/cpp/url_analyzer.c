@@ -1,37 +1,17 @@
 #include "url_analyzer.h"
 #include "html_media_extract.h"
 #include "http_download.h"
+#include "media_cache.h"
+#include "trace_log.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <android/log.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <stdarg.h>
+#include <time.h>
 
 #define LOG_TAG "url_analyzer"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
-
-/* File logging */
-static void file_log(const char *fmt, ...) {
-    static int log_fd = -1;
-    if (log_fd < 0) {
-        log_fd = open("/data/data/com.bgmdwldr.vulkan/analyzer_debug.log", 
-                      O_WRONLY | O_CREAT | O_APPEND, 0644);
-    }
-    if (log_fd >= 0) {
-        char buf[1024];
-        va_list args;
-        va_start(args, fmt);
-        int n = vsnprintf(buf, sizeof(buf), fmt, args);
-        va_end(args);
-        if (n > 0 && n < sizeof(buf) - 1) {
-            buf[n++] = '\n';
-            write(log_fd, buf, n);
-        }
-    }
-}
+#define LOGI(...) TLOG_INFO(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) TLOG_ERROR(LOG_TAG, __VA_ARGS__)
 
 static bool has_media_extension(const char *url) {
     const char *ext = strrchr(url, '.');
@@ -79,10 +59,25 @@ static void resolve_url(const char *baseUrl, const char *candidate,
              (int)hostLen, hostStart, candidate);
 }
 
-bool url_analyze(const char *inputUrl, MediaUrl *outMedia, char *err, size_t errLen) {
+static void copy_streams(const MediaUrl *src, int srcCount, MediaUrl *outStreams,
+                         int maxStreams, int *outStreamCount) {
+    int n = 0;
+    for (int i = 0; outStreams && i < srcCount && i < maxStreams; i++) {
+        outStreams[n++] = src[i];
+    }
+    if (outStreamCount) {
+        *outStreamCount = n;
+    }
+}
+
+bool url_analyze_streams(const char *inputUrl, MediaUrl *outMedia,
+                         MediaUrl *outStreams, int maxStreams, int *outStreamCount,
+                         char *err, size_t errLen) {
     LOGI("Starting URL analysis for: %.100s...", inputUrl);
-    file_log("Starting URL analysis for: %.100s...", inputUrl);
     
+    if (outStreamCount) {
+        *outStreamCount = 0;
+    }
     if (!inputUrl || !outMedia) {
         set_err(err, errLen, "Invalid URL input");
         LOGE("Invalid input: url=%p, out=%p", (void*)inputUrl, (void*)outMedia);
@@ -93,39 +88,157 @@ bool url_analyze(const char *inputUrl, MediaUrl *outMedia, char *err, size_t err
     
     if (has_media_extension(inputUrl)) {
         LOGI("URL has media extension, using directly");
-        file_log("URL has media extension, using directly");
         snprintf(outMedia->url, sizeof(outMedia->url), "%s", inputUrl);
+        copy_streams(outMedia, 1, outStreams, maxStreams, outStreamCount);
         return true;
     }
 
-    LOGI("Fetching HTML from URL...");
-    file_log("Fetching HTML from URL...");
-    HttpBuffer html = {0};
-    if (!http_get_to_memory(inputUrl, &html, err, errLen)) {
-        LOGE("HTTP fetch failed: %s", err);
-        file_log("HTTP fetch failed: %s", err);
-        return false;
+    char videoId[HTML_VIDEO_ID_MAX] = {0};
+    if (html_extract_yt_video_id(inputUrl, videoId, sizeof(videoId))) {
+        MediaCacheEntry cached;
+        if (media_cache_lookup(videoId, MEDIA_CACHE_POLICY_FIRST, &cached)) {
+            LOGI("Using cached resolution for %s", videoId);
+            *outMedia = cached.chosen;
+            copy_streams(cached.streams, cached.stream_count, outStreams, maxStreams,
+                         outStreamCount);
+            return true;
+        }
     }
-    LOGI("Received %zu bytes of HTML", html.size);
-    file_log("Received %zu bytes of HTML", html.size);
 
-    LOGI("Extracting media URL from HTML...");
-    file_log("Extracting media URL from HTML...");
-    HtmlMediaCandidate candidate;
-    if (!html_extract_media_url(html.data, &candidate, err, errLen)) {
+    LOGI("Fetching and extracting media URLs from HTML...");
+    HtmlMediaCandidate *candidates = calloc(MEDIA_CACHE_MAX_STREAMS, sizeof(HtmlMediaCandidate));
+    if (!candidates) {
+        set_err(err, errLen, "Out of memory");
+        return false;
+    }
+    /* The page is parsed while it downloads; scripts fetch alongside it */
+    int candidateCount = html_extract_media_candidates_from_url(inputUrl, candidates,
+                                                                MEDIA_CACHE_MAX_STREAMS, err, errLen);
+    if (candidateCount == 0) {
         LOGE("Media extraction failed: %s", err);
-        file_log("Media extraction failed: %s", err);
-        http_free_buffer(&html);
+        free(candidates);
         return false;
     }
-    LOGI("Found media URL: %.100s...", candidate.url);
-    file_log("Found media URL: %.100s...", candidate.url);
-    
-    http_free_buffer(&html);
-    resolve_url(inputUrl, candidate.url, outMedia->url, sizeof(outMedia->url));
-    if (candidate.mime[0]) {
-        snprintf(outMedia->mime, sizeof(outMedia->mime), "%s", candidate.mime);
+
+    MediaUrl streams[MEDIA_CACHE_MAX_STREAMS];
+    for (int i = 0; i < candidateCount; i++) {
+        resolve_url(inputUrl, candidates[i].url, streams[i].url, sizeof(streams[i].url));
+        snprintf(streams[i].mime, sizeof(streams[i].mime), "%s", candidates[i].mime);
+    }
+    free(candidates);
+
+    /* Selection policy: first captured URL */
+    *outMedia = streams[0];
+    LOGI("Found media URL: %.100s...", outMedia->url);
+
+    if (videoId[0]) {
+        media_cache_store(videoId, MEDIA_CACHE_POLICY_FIRST, outMedia, streams, candidateCount);
     }
+    copy_streams(streams, candidateCount, outStreams, maxStreams, outStreamCount);
     LOGI("URL analysis complete");
     return true;
 }
+
+bool url_analyze(const char *inputUrl, MediaUrl *outMedia, char *err, size_t errLen) {
+    return url_analyze_streams(inputUrl, outMedia, NULL, 0, NULL, err, errLen);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int url_expand_playlist(const char *playlistUrl, char (*outUrls)[MEDIA_URL_MAX],
+                        int maxUrls, char *err, size_t errLen) {
+    if (!playlistUrl || !outUrls || maxUrls <= 0) {
+        set_err(err, errLen, "Invalid playlist input");
+        return 0;
+    }
+    const char *list = strstr(playlistUrl, "list=");
+    if (!list) {
+        set_err(err, errLen, "Not a playlist URL");
+        return 0;
+    }
+    list += 5;
+    size_t listLen = strcspn(list, "&#");
+
+    char pageUrl[MEDIA_URL_MAX];
+    snprintf(pageUrl, sizeof(pageUrl), "https://www.youtube.com/playlist?list=%.*s",
+             (int)listLen, list);
+    LOGI("Expanding playlist: %s", pageUrl);
+
+    HttpBuffer page = {0};
+    if (!http_get_to_memory(pageUrl, &page, err, errLen)) {
+        LOGE("Playlist fetch failed: %s", err);
+        return 0;
+    }
+
+    /* Entries appear as "videoId":"XXXXXXXXXXX", often more than once each */
+    int count = 0;
+    const char *p = page.data;
+    while (count < maxUrls && (p = strstr(p, "\"videoId\":\"")) != NULL) {
+        p += 11;
+        size_t idLen = strcspn(p, "\"");
+        if (idLen == 0 || idLen >= HTML_VIDEO_ID_MAX) {
+            continue;
+        }
+        char url[MEDIA_URL_MAX];
+        snprintf(url, sizeof(url), "https://www.youtube.com/watch?v=%.*s", (int)idLen, p);
+        bool seen = false;
+        for (int i = 0; i < count && !seen; i++) {
+            seen = strcmp(outUrls[i], url) == 0;
+        }
+        if (!seen) {
+            snprintf(outUrls[count++], MEDIA_URL_MAX, "%s", url);
+        }
+        p += idLen;
+    }
+    http_free_buffer(&page);
+
+    if (count == 0) {
+        set_err(err, errLen, "No videos found in playlist");
+    }
+    LOGI("Playlist expanded to %d videos", count);
+    return count;
+}
+
+bool url_analyze_batch(UrlBatchItem *items, int count, UrlBatchStats *outStats) {
+    UrlBatchStats stats = {0};
+    if (!items || count <= 0) {
+        if (outStats) {
+            *outStats = stats;
+        }
+        return false;
+    }
+
+    html_extract_batch_begin();
+    double batchStart = now_ms();
+    for (int i = 0; i < count; i++) {
+        UrlBatchItem *item = &items[i];
+        double start = now_ms();
+        item->err[0] = '\0';
+        // A page that runs scripts gets a fresh context on the same runtime
+        // (see run_scripts_and_get_urls); cache hits run none
+        item->ok = url_analyze(item->input, &item->media, item->err, sizeof(item->err));
+        item->elapsed_ms = now_ms() - start;
+        if (item->ok) {
+            stats.succeeded++;
+        }
+        LOGI("Batch item %d/%d %s in %.0f ms: %.100s", i + 1, count,
+             item->ok ? "resolved" : "failed", item->elapsed_ms, item->input);
+    }
+    html_extract_batch_end();
+
+    stats.count = count;
+    stats.total_ms = now_ms() - batchStart;
+    stats.first_ms = items[0].elapsed_ms;
+    stats.amortized_ms = stats.total_ms / count;
+    LOGI("Batch resolved %d/%d in %.0f ms (first %.0f ms, amortized %.0f ms/item)",
+         stats.succeeded, count, stats.total_ms, stats.first_ms, stats.amortized_ms);
+
+    if (outStats) {
+        *outStats = stats;
+    }
+    return stats.succeeded > 0;
+}
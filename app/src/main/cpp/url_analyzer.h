@@ -18,6 +18,42 @@ typedef struct MediaUrl {
 
 bool url_analyze(const char *inputUrl, MediaUrl *outMedia, char *err, size_t errLen);
 
+/* Like url_analyze, and also returns every resolved stream (up to maxStreams).
+ * Resolutions are served from the media cache while their URLs are valid. */
+bool url_analyze_streams(const char *inputUrl, MediaUrl *outMedia,
+                         MediaUrl *outStreams, int maxStreams, int *outStreamCount,
+                         char *err, size_t errLen);
+
+#define URL_BATCH_MAX_ITEMS 50
+#define URL_BATCH_ERR_MAX 256
+
+typedef struct UrlBatchItem {
+    char input[MEDIA_URL_MAX];   /* Filled by the caller */
+    MediaUrl media;
+    bool ok;
+    char err[URL_BATCH_ERR_MAX];
+    double elapsed_ms;
+} UrlBatchItem;
+
+typedef struct UrlBatchStats {
+    int count;
+    int succeeded;
+    double total_ms;
+    double first_ms;       /* First item pays for cold caches */
+    double amortized_ms;   /* total_ms / count */
+} UrlBatchStats;
+
+/* Expands a playlist URL (list=...) into watch URLs, in playlist order.
+ * Returns the number of URLs written, 0 on failure. */
+int url_expand_playlist(const char *playlistUrl, char (*outUrls)[MEDIA_URL_MAX],
+                        int maxUrls, char *err, size_t errLen);
+
+/* Resolves every item back to back on the caller's JS runtime, reusing
+ * fetched player scripts between items. Each page that runs scripts does so
+ * in a fresh context, so no page sees another's globals. Returns true if any
+ * item resolved. */
+bool url_analyze_batch(UrlBatchItem *items, int count, UrlBatchStats *outStats);
+
 #ifdef __cplusplus
 }
 #endif